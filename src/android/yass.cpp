@@ -203,8 +203,8 @@ JNIEXPORT jlongArray JNICALL Java_it_gui_yass_MainActivity_getRealtimeTransferRa
   static uint64_t rx_rate = 0;
   static uint64_t tx_rate = 0;
   if (delta_time > NS_PER_SECOND) {
-    uint64_t rx_bytes = net::cli::total_rx_bytes;
-    uint64_t tx_bytes = net::cli::total_tx_bytes;
+    uint64_t rx_bytes = net::cli::total_rx_bytes();
+    uint64_t tx_bytes = net::cli::total_tx_bytes();
     rx_rate = static_cast<double>(rx_bytes - g_last_rx_bytes) / delta_time * NS_PER_SECOND;
     tx_rate = static_cast<double>(tx_bytes - g_last_tx_bytes) / delta_time * NS_PER_SECOND;
     g_last_sync_time = sync_time;
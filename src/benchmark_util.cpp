@@ -0,0 +1,79 @@
+// SPDX-License-Identifier: GPL-2.0
+/* Copyright (c) 2024 Chilledheart  */
+
+#include "benchmark_util.hpp"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+#include <base/rand_util.h>
+
+#include "net/stats.hpp"
+
+#if !defined(HAVE_TCMALLOC) && !defined(HAVE_MIMALLOC) && !defined(ADDRESS_SANITIZER) && \
+    !defined(MEMORY_SANITIZER) && !defined(THREAD_SANITIZER)
+#define COUNT_OPERATOR_NEW
+#endif
+
+#ifdef COUNT_OPERATOR_NEW
+static std::atomic<uint64_t> g_operator_new_count;
+
+static void* CountedAlloc(size_t size) {
+  g_operator_new_count.fetch_add(1, std::memory_order_relaxed);
+  void* p = malloc(size ? size : 1);
+  if (p == nullptr) {
+    std::abort();
+  }
+  return p;
+}
+
+void* operator new(size_t size) {
+  return CountedAlloc(size);
+}
+
+void* operator new[](size_t size) {
+  return CountedAlloc(size);
+}
+
+void operator delete(void* p) noexcept {
+  free(p);
+}
+
+void operator delete[](void* p) noexcept {
+  free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+  free(p);
+}
+
+void operator delete[](void* p, size_t) noexcept {
+  free(p);
+}
+#endif  // COUNT_OPERATOR_NEW
+
+namespace benchmark {
+
+uint64_t GetAllocationCount() {
+  uint64_t count = net::process_stats().GetSnapshot()[net::Stats::kIOBufAllocations];
+#ifdef COUNT_OPERATOR_NEW
+  count += g_operator_new_count.load(std::memory_order_relaxed);
+#endif
+  return count;
+}
+
+void ReportComponentCounters(State& state, uint64_t allocations, int64_t bytes_per_iteration) {
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * bytes_per_iteration);
+  state.counters["allocs_per_iter"] =
+      Counter(static_cast<double>(GetAllocationCount() - allocations), Counter::kAvgIterations);
+}
+
+std::unique_ptr<net::IOBuf> GenerateRandContent(size_t size) {
+  auto buf = net::IOBuf::create(size);
+  gurl_base::RandBytes(buf->mutable_data(), size);
+  buf->append(size);
+  return buf;
+}
+
+}  // namespace benchmark
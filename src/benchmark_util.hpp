@@ -0,0 +1,31 @@
+// SPDX-License-Identifier: GPL-2.0
+/* Copyright (c) 2024 Chilledheart  */
+
+#ifndef _BENCHMARK_UTIL_H
+#define _BENCHMARK_UTIL_H
+
+#include <benchmark/benchmark.h>
+
+#include <cstdint>
+#include <memory>
+
+#include "net/iobuf.hpp"
+
+namespace benchmark {
+
+// GetAllocationCount returns the number of heap allocations made by the
+// process so far: the buffers allocated by IOBuf and, unless the allocator is
+// replaced (tcmalloc, mimalloc or sanitizers), the calls to operator new.
+uint64_t GetAllocationCount();
+
+// ReportComponentCounters sets the byte throughput and the allocations per
+// iteration of a microbenchmark. |allocations| is the value returned by
+// GetAllocationCount before the benchmark loop.
+void ReportComponentCounters(State& state, uint64_t allocations, int64_t bytes_per_iteration);
+
+// GenerateRandContent returns a buffer filled with |size| random bytes.
+std::unique_ptr<net::IOBuf> GenerateRandContent(size_t size);
+
+}  // namespace benchmark
+
+#endif  // _BENCHMARK_UTIL_H
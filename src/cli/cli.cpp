@@ -2,6 +2,7 @@
 /* Copyright (c) 2019-2024 Chilledheart  */
 
 #include "cli/cli_server.hpp"
+#include "cli/cli_worker.hpp"
 #include "config/config.hpp"
 #include "crypto/crypter_export.hpp"
 
@@ -12,52 +13,64 @@
 #include <absl/strings/str_join.h>
 #include <build/build_config.h>
 #include <locale.h>
+#include <future>
 #include "third_party/boringssl/src/include/openssl/crypto.h"
 
 #include "cli/cli_connection_stats.hpp"
 #include "core/logging.hpp"
+#include "core/utils.hpp"
 #include "crypto/crypter_export.hpp"
 #include "net/asio.hpp"
-#include "net/resolver.hpp"
+#include "net/metrics_server.hpp"
+#include "net/route_rules.hpp"
 #include "version.h"
 
+ABSL_FLAG(std::string,
+          compile_route_rules,
+          "",
+          "Compile the rules file of --route_rules into the binary form at given path, then exit");
+
 namespace config {
 const ProgramType pType = YASS_CLIENT_DEFAULT;
 }  // namespace config
 
 using namespace net::cli;
 
-static asio::ip::tcp::resolver::results_type ResolveAddress(const std::string& domain_name, int port) {
-  asio::error_code ec;
-  auto addr = asio::ip::make_address(domain_name.c_str(), ec);
-  bool host_is_ip_address = !ec;
-  if (host_is_ip_address) {
-    asio::ip::tcp::endpoint endpoint(addr, port);
-    auto results = asio::ip::tcp::resolver::results_type::create(endpoint, domain_name, std::to_string(port));
-    return results;
-  } else {
-    asio::io_context io_context;
-    auto work_guard =
-        std::make_unique<asio::executor_work_guard<asio::io_context::executor_type>>(io_context.get_executor());
-    net::Resolver resolver(io_context);
-    if (resolver.Init() < 0) {
-      LOG(WARNING) << "Resolver: Init failure";
-      return {};
-    }
-    asio::ip::tcp::resolver::results_type results;
-    resolver.AsyncResolve(domain_name, port, [&](asio::error_code ec, asio::ip::tcp::resolver::results_type _results) {
-      work_guard.reset();
-      if (ec) {
-        LOG(WARNING) << "resolved domain name: " << domain_name << " failed due to: " << ec;
-        return;
-      }
-      results = std::move(_results);
-    });
-    io_context.run();
-
-    return results;
+#ifdef SIGHUP
+/// re-read the config file and apply the changes to the running worker in place
+///
+/// \param io_context the io context handling the signals
+/// \param worker the worker running the tcp server
+/// \param reloading set while a reload is in flight, cleared in \p io_context
+static void ReloadConfig(asio::io_context* io_context, Worker* worker, bool* reloading) {
+  if (*reloading) {
+    LOG(WARNING) << "reload: another reload is in progress";
+    return;
   }
+  config::ConfigSnapshot snapshot = config::SnapshotConfig();
+
+  config::ReadConfig();
+  std::string err = config::ValidateConfig();
+  if (!err.empty()) {
+    LOG(WARNING) << "reload: invalid config: " << err;
+    config::RestoreConfig(snapshot);
+    return;
+  }
+
+  *reloading = true;
+  worker->Reload([io_context, reloading, snapshot = std::move(snapshot)](asio::error_code ec) {
+    if (ec == asio::error::operation_not_supported) {
+      LOG(WARNING) << "reload: config changes require restart";
+    } else if (ec) {
+      LOG(WARNING) << "reload: failed to apply config changes due to: " << ec;
+    }
+    if (ec) {
+      config::RestoreConfig(snapshot);
+    }
+    asio::post(*io_context, [reloading]() { *reloading = false; });
+  });
 }
+#endif
 
 int main(int argc, const char* argv[]) {
 #ifndef _WIN32
@@ -115,25 +128,29 @@ int main(int argc, const char* argv[]) {
     LOG(WARNING) << "Failed to validate config: " << err;
     return -1;
   }
+  if (!net::RouteRules::LoadGlobal(absl::GetFlag(FLAGS_route_rules), &err)) {
+    LOG(WARNING) << "Failed to load route rules: " << err;
+    return -1;
+  }
+  if (std::string output = absl::GetFlag(FLAGS_compile_route_rules); !output.empty()) {
+    auto rules = net::RouteRules::Global();
+    if (!rules) {
+      LOG(WARNING) << "No route rules to compile";
+      return -1;
+    }
+    std::string binary = rules->Serialize();
+    if (WriteFileWithBuffer(output, binary) != static_cast<ssize_t>(binary.size())) {
+      LOG(WARNING) << "Failed to write route rules to: " << output;
+      return -1;
+    }
+    LOG(WARNING) << "Route rules compiled to: " << output;
+    return 0;
+  }
   if (config::testOnlyMode) {
     LOG(WARNING) << "Configuration Validated";
     return 0;
   }
-
-#ifdef _WIN32
-  int iResult = 0;
-  WSADATA wsaData = {0};
-  iResult = WSAStartup(MAKEWORD(2, 2), &wsaData);
-  CHECK_EQ(iResult, 0) << "WSAStartup failure";
-#endif
-
-  // Start Io Context
-  asio::io_context io_context;
-  auto work_guard =
-      std::make_unique<asio::executor_work_guard<asio::io_context::executor_type>>(io_context.get_executor());
-
-  std::string remote_host_name = absl::GetFlag(FLAGS_server_host);
-  std::string remote_host_sni = remote_host_name;
+  std::string remote_host_sni = absl::GetFlag(FLAGS_server_host);
   if (!absl::GetFlag(FLAGS_server_sni).empty()) {
     remote_host_sni = absl::GetFlag(FLAGS_server_sni);
   }
@@ -141,69 +158,60 @@ int main(int argc, const char* argv[]) {
     LOG(WARNING) << "Invalid server name or SNI: " << remote_host_sni;
     return -1;
   }
-
-  std::string remote_host_ips;
   uint16_t remote_port = absl::GetFlag(FLAGS_server_port);
   if (remote_port == 0u) {
     LOG(WARNING) << "Invalid server port: " << remote_port;
     return -1;
   }
 
-  auto results = ResolveAddress(remote_host_name, remote_port);
-  if (results.empty()) {
+  // The tcp server runs in the worker thread, shared with the gui variants,
+  // while the main thread handles the signals.
+  Worker worker;
+  std::promise<asio::error_code> started;
+  worker.Start([&started](asio::error_code ec) { started.set_value(ec); });
+  asio::error_code ec = started.get_future().get();
+  if (ec) {
+    LOG(ERROR) << "tcp server failed to start due to: " << ec;
     return -1;
-  } else {
-    std::vector<std::string> remote_ips;
-    for (auto result : results) {
-      if (result.endpoint().address().is_unspecified()) {
-        LOG(WARNING) << "Unspecified remote address: " << remote_host_name;
-        return -1;
-      }
-      remote_ips.push_back(result.endpoint().address().to_string());
-    }
-    remote_host_ips = absl::StrJoin(remote_ips, ";");
-    LOG(INFO) << "resolved server ips: " << remote_host_ips << " from " << remote_host_name;
   }
+  LOG(WARNING) << "tcp server listening at " << absl::GetFlag(FLAGS_local_host) << ":" << worker.GetLocalPort()
+               << " with upstream sni: " << remote_host_sni << ":" << remote_port;
 
-  std::vector<asio::ip::tcp::endpoint> endpoints;
-  std::string local_host_name = absl::GetFlag(FLAGS_local_host);
-  uint16_t local_port = absl::GetFlag(FLAGS_local_port);
-
-  results = ResolveAddress(local_host_name, local_port);
-
-  if (results.empty()) {
-    return -1;
-  } else {
-    endpoints.insert(endpoints.end(), std::begin(results), std::end(results));
-
-    std::vector<std::string> local_ips;
-    for (auto result : results) {
-      local_ips.push_back(result.endpoint().address().to_string());
+  std::unique_ptr<net::MetricsServer> metrics_server;
+  if (uint16_t metrics_port = absl::GetFlag(FLAGS_metrics_port)) {
+    auto metrics_addr = asio::ip::make_address(absl::GetFlag(FLAGS_metrics_host), ec);
+    if (ec) {
+      LOG(ERROR) << "invalid metrics host: " << absl::GetFlag(FLAGS_metrics_host);
+      return -1;
     }
-    LOG(INFO) << "resolved local ips: " << absl::StrJoin(local_ips, ";") << " from " << local_host_name;
-  }
-
-  asio::error_code ec;
-  CliServer server(io_context, remote_host_ips, remote_host_sni, remote_port);
-  for (auto& endpoint : endpoints) {
-    server.listen(endpoint, std::string(), SOMAXCONN, ec);
+    metrics_server =
+        std::make_unique<net::MetricsServer>(std::vector<net::Stats*>{&net::cli::stats(), &net::process_stats()});
+    metrics_server->listen(asio::ip::tcp::endpoint(metrics_addr, metrics_port), ec);
     if (ec) {
-      LOG(ERROR) << "listen failed due to: " << ec;
-      server.stop();
-      work_guard.reset();
+      LOG(ERROR) << "metrics server listen failed due to: " << ec;
       return -1;
     }
-    endpoint = server.endpoint();
-    LOG(WARNING) << "tcp server listening at " << endpoint << " with upstream sni: " << remote_host_sni << ":"
-                 << remote_port << " (ip " << remote_host_ips << " )";
+    LOG(WARNING) << "metrics server listening at " << metrics_server->endpoint();
   }
 
+  asio::io_context io_context;
+  auto work_guard =
+      std::make_unique<asio::executor_work_guard<asio::io_context::executor_type>>(io_context.get_executor());
+  auto stopped = [&io_context, &work_guard]() { asio::post(io_context, [&work_guard]() { work_guard.reset(); }); };
+
+#ifdef SIGHUP
+  bool reloading = false;
+#endif
+
   asio::signal_set signals(io_context);
   signals.add(SIGINT, ec);
   signals.add(SIGTERM, ec);
 #ifdef SIGQUIT
   signals.add(SIGQUIT, ec);
 #endif
+#ifdef SIGHUP
+  signals.add(SIGHUP, ec);
+#endif
 #if defined(SIGUSR1)
   signals.add(SIGUSR1, ec);
 #endif
@@ -217,18 +225,27 @@ int main(int argc, const char* argv[]) {
       return;
     }
 #endif
+#ifdef SIGHUP
+    if (signal_number == SIGHUP) {
+      ReloadConfig(&io_context, &worker, &reloading);
+      signals.async_wait(cb);
+      return;
+    }
+#endif
 #ifdef SIGQUIT
     if (signal_number == SIGQUIT) {
       LOG(WARNING) << "Application shuting down";
-      server.shutdown();
+      worker.Shutdown(stopped);
     } else {
 #endif
       LOG(WARNING) << "Application exiting";
-      server.stop();
+      worker.Stop(stopped);
 #ifdef SIGQUIT
     }
 #endif
-    work_guard.reset();
+    if (metrics_server) {
+      metrics_server->stop();
+    }
     signals.clear();
   };
   signals.async_wait(cb);
@@ -3,7 +3,11 @@
 
 #include "cli/cli_connection.hpp"
 
+#include <algorithm>
+#include <array>
+
 #include <absl/flags/flag.h>
+#include <absl/strings/match.h>
 #include <absl/strings/str_cat.h>
 #include <base/rand_util.h>
 #include <base/strings/string_util.h>
@@ -16,6 +20,7 @@
 #include "net/padding.hpp"
 #include "net/socks4_request_parser.hpp"
 #include "net/socks5_request_parser.hpp"
+#include "net/udp_batch.hpp"
 
 #include <build/build_config.h>
 
@@ -48,8 +53,8 @@ static std::vector<http2::adapter::Header> GenerateHeaders(std::vector<std::pair
   return response_vector;
 }
 
-static std::string GetProxyAuthorizationIdentity() {
-  auto user_pass = absl::StrCat(absl::GetFlag(FLAGS_username), ":", absl::GetFlag(FLAGS_password));
+static std::string GetProxyAuthorizationIdentity(const std::string& username, const std::string& password) {
+  auto user_pass = absl::StrCat(username, ":", password);
   return Base64Encode(as_bytes(make_span(user_pass)));
 }
 
@@ -87,6 +92,8 @@ static void FillNonindexHeaderValue(uint64_t unique_bits, char* buf, int len) {
 namespace net::cli {
 
 constexpr const std::string_view CliConnection::http_connect_reply_ = "HTTP/1.1 200 Connection established\r\n\r\n";
+constexpr const std::string_view CliConnection::http_forbidden_reply_ =
+    "HTTP/1.1 403 Forbidden\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
 
 #if BUILDFLAG(IS_MAC)
 #include <xnu_private/net_pfvar.h>
@@ -103,26 +110,30 @@ static bool IsIPv4MappedIPv6(const asio::ip::tcp::endpoint& address) {
 
 #ifdef HAVE_QUICHE
 bool DataFrameSource::Send(absl::string_view frame_header, size_t payload_length) {
-  std::string concatenated;
-  if (payload_length) {
-    DCHECK(!chunks_.empty());
-    absl::string_view payload(reinterpret_cast<const char*>(chunks_.front()->data()), payload_length);
-    concatenated = absl::StrCat(frame_header, payload);
-  } else {
-    concatenated = std::string{frame_header};
-  }
-
-  const int64_t result = connection_->OnReadyToSend(concatenated);
-  DCHECK_EQ(static_cast<size_t>(result), concatenated.size());
-
   if (!payload_length) {
+    connection_->OnReadyToSendDataFrame(IOBuf::copyBuffer(frame_header.data(), frame_header.size()));
     return true;
   }
 
-  chunks_.front()->trimStart(payload_length);
-
-  if (chunks_.front()->empty()) {
+  DCHECK(!chunks_.empty());
+  std::shared_ptr<IOBuf> chunk = chunks_.front();
+  if (payload_length == chunk->length() && chunk->headroom() >= frame_header.size()) {
+    // write the frame header in place and hand the chunk over
+    chunk->prepend(frame_header.size());
+    memcpy(chunk->mutable_data(), frame_header.data(), frame_header.size());
     chunks_.pop_front();
+    connection_->OnReadyToSendDataFrame(std::move(chunk));
+  } else {
+    std::shared_ptr<IOBuf> frame = IOBuf::create(frame_header.size() + payload_length);
+    memcpy(frame->mutable_tail(), frame_header.data(), frame_header.size());
+    memcpy(frame->mutable_tail() + frame_header.size(), chunk->data(), payload_length);
+    frame->append(frame_header.size() + payload_length);
+    connection_->OnReadyToSendDataFrame(std::move(frame));
+
+    chunk->trimStart(payload_length);
+    if (chunk->empty()) {
+      chunks_.pop_front();
+    }
   }
 
   if (chunks_.empty() && send_completion_callback_) {
@@ -166,14 +177,57 @@ CliConnection::~CliConnection() {
 }
 
 void CliConnection::start() {
-  SetState(state_method_select);
+  stats().Add(Stats::kConnectionsOpened);
+  SetupQueues(&upstream_, &downstream_, &stats());
   closed_ = false;
+  SetState(state_method_select);
   upstream_writable_ = false;
   downstream_readable_ = true;
 
+  scoped_refptr<CliConnection> self(this);
+  StartIdleTimer([this, self](IdleEvent event) {
+    if (closed_) {
+      return;
+    }
+    if (event == kIdleTrim) {
+      size_t bytes = ReleaseIdleMemory();
+      VLOG(2) << "Connection (client) " << connection_id() << " idle: released " << bytes << " bytes";
+      stats().Add(Stats::kIdleTrims);
+      stats().Add(Stats::kIdleTrimmedBytes, bytes);
+      return;
+    }
+    VLOG(1) << "Connection (client) " << connection_id() << " closed due to idle timeout";
+    stats().Add(Stats::kIdleTimeouts);
+    // nothing is in flight, let the client see an orderly shutdown
+    if (!shutdown_) {
+      shutdown_ = true;
+      asio::error_code ec;
+      downlink_->shutdown(ec);
+    }
+    OnDisconnect(asio::error::timed_out);
+  });
+
   ReadMethodSelect();
 }
 
+size_t CliConnection::ReleaseIdleMemory() {
+  size_t bytes = 0;
+  bytes += upstream_.shrink_to_fit();
+  bytes += downstream_.shrink_to_fit();
+  bytes += pending_data_.shrink_to_fit();
+  if (padding_in_middle_buf_ && padding_in_middle_buf_->empty()) {
+    bytes += padding_in_middle_buf_->capacity();
+    padding_in_middle_buf_.reset();
+  }
+  if (encoder_) {
+    bytes += encoder_->trim();
+  }
+  if (decoder_) {
+    bytes += decoder_->trim();
+  }
+  return bytes;
+}
+
 void CliConnection::close() {
   if (closed_) {
     return;
@@ -182,14 +236,29 @@ void CliConnection::close() {
           << " disconnected with client at stage: " << CliConnection::state_to_str(CurrentState());
   asio::error_code ec;
   closed_ = true;
+  stats().Add(Stats::kConnectionsClosed);
+  LogAccessRecord("client", ss_request_.get(), upstream_, downstream_);
+  if (state_reported_) {
+    stats().Add(state_to_gauge(state_), -1);
+    state_reported_ = false;
+  }
+#ifdef HAVE_QUICHE
+  stats().Add(Stats::kH2BufferedBytes, -static_cast<int64_t>(http2_buffered_bytes_));
+  http2_buffered_bytes_ = 0;
+#endif
+  StopIdleTimer();
   resolver_.Reset();
   downlink_->close(ec);
   if (ec) {
     VLOG(1) << "close() error: " << ec;
   }
+  if (udp_socket_) {
+    udp_socket_->close(ec);
+  }
   if (channel_) {
     channel_->close();
   }
+  SwitchServer(nullptr);
   on_disconnect();
 }
 
@@ -203,6 +272,16 @@ void CliConnection::SendIfNotProcessing() {
     processing_responses_ = false;
   }
 }
+
+void CliConnection::CoalesceHttp2Frames() {
+  if (!adapter_) {
+    return;
+  }
+  // only the frames already queued are merged, nothing waits for more
+  if (size_t coalesced = upstream_.coalesce_front(kMaxTlsRecordPayload, kHttp2MaxCopiedFrame)) {
+    stats().Add(Stats::kH2CoalescedFrames, coalesced);
+  }
+}
 #endif
 
 //
@@ -231,6 +310,10 @@ int64_t CliConnection::OnReadyToSend(absl::string_view serialized) {
   return serialized.size();
 }
 
+void CliConnection::OnReadyToSendDataFrame(std::shared_ptr<IOBuf> frame) {
+  upstream_.push_back(std::move(frame));
+}
+
 http2::adapter::Http2VisitorInterface::OnHeaderResult CliConnection::OnHeaderForStream(StreamId stream_id,
                                                                                        absl::string_view key,
                                                                                        absl::string_view value) {
@@ -239,6 +322,14 @@ http2::adapter::Http2VisitorInterface::OnHeaderResult CliConnection::OnHeaderFor
 }
 
 bool CliConnection::OnEndHeadersForStream(http2::adapter::Http2StreamId stream_id) {
+  auto status = request_map_.find(":status"s);
+  if (status == request_map_.end() || status->second != "200"sv) {
+    LOG(WARNING) << "Connection (client) " << connection_id() << " upstream server returns: "
+                 << (status == request_map_.end() ? "(none)"sv : std::string_view(status->second));
+    // handled in OnConnectionError
+    return false;
+  }
+  OnUpstreamAccepted();
   bool padding_support = request_map_.find("padding"s) != request_map_.end();
   padding_support_ &= padding_support;
   std::string_view server_field = "(unknown)"sv;
@@ -297,38 +388,106 @@ bool CliConnection::OnBeginDataForStream(StreamId stream_id, size_t payload_leng
 }
 
 bool CliConnection::OnDataForStream(StreamId stream_id, absl::string_view data) {
+  size_t held_before = http2_buffered_bytes_ + (padding_in_middle_buf_ ? padding_in_middle_buf_->length() : 0);
+  QueueDataForStream(data);
+  size_t held_after = http2_buffered_bytes_ + (padding_in_middle_buf_ ? padding_in_middle_buf_->length() : 0);
+  // the payloads held are consumed once written (see OnHttp2DataWritten), the paddings right away
+  adapter_->MarkDataConsumedForStream(stream_id, data.size() + held_before - held_after);
+  return true;
+}
+
+void CliConnection::QueueDataForStream(absl::string_view data) {
+  const uint8_t* p = reinterpret_cast<const uint8_t*>(data.data());
+  size_t length = data.size();
+
   if (padding_support_ && num_padding_recv_ < kFirstPaddings) {
     asio::error_code ec;
-    // Append buf to in_middle_buf
-    if (padding_in_middle_buf_) {
-      padding_in_middle_buf_->reserve(0, data.size());
-      memcpy(padding_in_middle_buf_->mutable_tail(), data.data(), data.size());
-      padding_in_middle_buf_->append(data.size());
-    } else {
-      padding_in_middle_buf_ = IOBuf::copyBuffer(data.data(), data.size());
-    }
-    adapter_->MarkDataConsumedForStream(stream_id, data.size());
-
-    // Deal with in_middle_buf
-    while (num_padding_recv_ < kFirstPaddings) {
-      auto buf = RemovePadding(padding_in_middle_buf_, ec);
+    // strip the paddings of the records inside data by offsets
+    while (num_padding_recv_ < kFirstPaddings && (!padding_in_middle_buf_ || padding_in_middle_buf_->empty())) {
+      size_t payload_size;
+      size_t record_size = ParsePadding(p, length, &payload_size, ec);
       if (ec) {
-        return true;
+        break;
       }
-      DCHECK(buf);
-      downstream_.push_back(buf);
+      QueueHttp2Data(IOBuf::shareBuffer(http2_input_buf_, p + kPaddingHeaderSize, payload_size));
       ++num_padding_recv_;
+      p += record_size;
+      length -= record_size;
     }
-    // Deal with in_middle_buf outside paddings
-    if (num_padding_recv_ >= kFirstPaddings && !padding_in_middle_buf_->empty()) {
-      downstream_.push_back(std::move(padding_in_middle_buf_));
+    if (num_padding_recv_ < kFirstPaddings) {
+      if (!length) {
+        return;
+      }
+      // Append the record split across frames to in_middle_buf
+      if (padding_in_middle_buf_) {
+        padding_in_middle_buf_->reserve(0, length);
+        memcpy(padding_in_middle_buf_->mutable_tail(), p, length);
+        padding_in_middle_buf_->append(length);
+      } else {
+        padding_in_middle_buf_ = IOBuf::copyBuffer(p, length);
+      }
+
+      // Deal with in_middle_buf
+      while (num_padding_recv_ < kFirstPaddings) {
+        auto buf = RemovePadding(padding_in_middle_buf_, ec);
+        if (ec) {
+          return;
+        }
+        DCHECK(buf && buf->length());
+        QueueHttp2Data(buf);
+        ++num_padding_recv_;
+      }
+      // Deal with in_middle_buf outside paddings
+      if (!padding_in_middle_buf_->empty()) {
+        QueueHttp2Data(std::move(padding_in_middle_buf_));
+      }
+      return;
     }
-    return true;
   }
 
-  downstream_.push_back(data.data(), data.size());
-  adapter_->MarkDataConsumedForStream(stream_id, data.size());
-  return true;
+  // refer to the decrypted input instead of copying
+  if (length) {
+    QueueHttp2Data(IOBuf::shareBuffer(http2_input_buf_, p, length));
+  }
+}
+
+void CliConnection::QueueHttp2Data(std::shared_ptr<IOBuf> buf) {
+  http2_buffered_bytes_ += buf->length();
+  stats().Add(Stats::kH2BufferedBytes, static_cast<int64_t>(buf->length()));
+  downstream_.push_back(std::move(buf));
+}
+
+void CliConnection::OnHttp2DataWritten(size_t bytes) {
+  // other bytes might be queued ahead, e.g. the handshake replies
+  bytes = std::min(bytes, http2_buffered_bytes_);
+  if (!bytes) {
+    return;
+  }
+  http2_buffered_bytes_ -= bytes;
+  stats().Add(Stats::kH2BufferedBytes, -static_cast<int64_t>(bytes));
+  if (!stream_id_) {
+    return;
+  }
+  adapter_->MarkDataConsumedForStream(stream_id_, bytes);
+
+  uint64_t now = GetMonotonicTime();
+  // the local socket doesn't keep up if most of the window is still queued
+  bool backlogged = http2_buffered_bytes_ >= window_tuner_.window() / 2 || downstream_.above_watermark();
+  size_t increment = window_tuner_.OnDataConsumed(bytes, now, backlogged);
+  if (increment) {
+    // the connection carries a single stream, so its window follows the stream's
+    adapter_->SubmitWindowUpdate(0, increment);
+    adapter_->SubmitWindowUpdate(stream_id_, increment);
+    stats().Add(Stats::kH2WindowGrowths);
+  }
+  if (window_tuner_.WantsRttProbe(now)) {
+    adapter_->SubmitPing(Http2WindowTuner::kPingId);
+    window_tuner_.OnPingSent(now);
+  }
+  if (!http2_in_recv_callback_ && adapter_->want_write()) {
+    SendIfNotProcessing();
+    OnUpstreamWriteFlush();
+  }
 }
 
 bool CliConnection::OnDataPaddingLength(StreamId stream_id, size_t padding_length) {
@@ -340,6 +499,19 @@ void CliConnection::OnRstStream(StreamId stream_id, http2::adapter::Http2ErrorCo
   disconnected(asio::error::connection_reset);
 }
 
+void CliConnection::OnPing(http2::adapter::Http2PingId ping_id, bool is_ack) {
+  if (!is_ack || ping_id != Http2WindowTuner::kPingId) {
+    return;
+  }
+  uint64_t rtt = window_tuner_.OnPingAck(GetMonotonicTime());
+  if (rtt) {
+    stats().RecordNanoseconds(Stats::kH2RttLatency, rtt);
+    if (server_) {
+      server_->OnRttSample(rtt);
+    }
+  }
+}
+
 bool CliConnection::OnGoAway(StreamId last_accepted_stream_id,
                              http2::adapter::Http2ErrorCode error_code,
                              absl::string_view opaque_data) {
@@ -540,6 +712,10 @@ asio::error_code CliConnection::OnReadRedirHandshake(std::shared_ptr<IOBuf> buf)
   }
 
   VLOG(2) << "Connection (client) " << connection_id() << " redir stream from " << endpoint_ << " to " << endpoint;
+  // there is no reply to carry the rejection
+  if (!MatchRoute(endpoint)) {
+    return asio::error::connection_refused;
+  }
   OnCmdConnect(endpoint);
 
   asio::error_code ec;
@@ -587,6 +763,10 @@ asio::error_code CliConnection::OnReadRedirHandshake(std::shared_ptr<IOBuf> buf)
     if (ret == 0 && strlen(hostname) != 0 && strlen(hostname) <= TLSEXT_MAXLEN_host_name) {
       VLOG(2) << "Connection (client) " << connection_id() << " redir stream from " << hostname << ":" << port << " to "
               << endpoint;
+      // there is no reply to carry the rejection
+      if (!MatchRoute(hostname)) {
+        return asio::error::connection_refused;
+      }
       OnCmdConnect(hostname, port);
     } else {
       if (ret) {
@@ -597,6 +777,9 @@ asio::error_code CliConnection::OnReadRedirHandshake(std::shared_ptr<IOBuf> buf)
         VLOG(3) << "Connection (client) " << connection_id() << " redir getnameinfo failure: truncated host name";
       }
       VLOG(2) << "Connection (client) " << connection_id() << " redir stream from " << endpoint_ << " to " << endpoint;
+      if (!MatchRoute(endpoint)) {
+        return asio::error::connection_refused;
+      }
       OnCmdConnect(endpoint);
     }
 
@@ -690,20 +873,21 @@ asio::error_code CliConnection::OnReadHttpRequest(std::shared_ptr<IOBuf> buf) {
   http_is_keep_alive_ = false;
 
   if (ok) {
-    buf->trimStart(nparsed);
-    buf->retreat(nparsed);
-
     http_host_ = parser.host();
     http_port_ = parser.port();
     http_is_connect_ = parser.is_connect();
 
     if (!http_is_connect_) {
+      // reforge before consuming the input, the parsed header lines refer to it
       std::string header;
       parser.ReforgeHttpRequest(&header);
+      buf->trimStart(nparsed);
+      buf->retreat(nparsed);
       buf->reserve(header.size(), 0);
       buf->prepend(header.size());
       memcpy(buf->mutable_data(), header.c_str(), header.size());
       http_is_keep_alive_ = gurl_base::CompareCaseInsensitiveASCII(parser.connection(), "Keep-Alive"sv) == 0;
+      http_is_head_ = absl::StartsWith(header, "HEAD ");
       http_keep_alive_remaining_bytes_ += parser.content_length() + header.size() - buf->length();
       VLOG(3) << "Connection (client) " << connection_id() << " Host: " << http_host_ << " Port: " << http_port_
               << " KEEPALIVE: " << std::boolalpha << http_is_keep_alive_;
@@ -714,6 +898,8 @@ asio::error_code CliConnection::OnReadHttpRequest(std::shared_ptr<IOBuf> buf) {
         http_is_keep_alive_ = false;
       }
     } else {
+      buf->trimStart(nparsed);
+      buf->retreat(nparsed);
       VLOG(3) << "Connection (client) " << connection_id() << " CONNECT: " << http_host_ << " Port: " << http_port_;
     }
 
@@ -740,7 +926,7 @@ void CliConnection::ReadStream(bool yield) {
 
   downstream_read_inprogress_ = true;
   if (yield) {
-    asio::post(*io_context_, [this, self]() {
+    FairScheduler::Get(*io_context_).Yield(&upload_flow_, [this, self]() {
       downstream_read_inprogress_ = false;
       if (closed_) {
         return;
@@ -844,8 +1030,7 @@ void CliConnection::WriteStream() {
   bool try_again = false;
   bool yield = false;
 
-  int bytes_read_without_yielding = 0;
-  uint64_t yield_after_time = GetMonotonicTime() + kYieldAfterDurationMilliseconds * 1000 * 1000;
+  FairScheduler& scheduler = FairScheduler::Get(*io_context_);
 
   asio::error_code ec;
   size_t wbytes_transferred = 0u;
@@ -857,13 +1042,16 @@ void CliConnection::WriteStream() {
     auto buf = downstream_.front();
     size_t written;
     do {
-      written = downlink_->write_some(buf, ec);
+      written = udp_associate_ ? WriteUdpAssociate(buf, ec) : downlink_->write_some(buf, ec);
       if (UNLIKELY(ec == asio::error::interrupted)) {
         continue;
       }
     } while (false);
+    if (http_track_responses_ && written) {
+      http_responses_.OnResponseData(buf->data(), written);
+    }
     buf->trimStart(written);
-    bytes_read_without_yielding += written;
+    bool quantum_used = scheduler.Charge(&download_flow_, written);
     wbytes_transferred += written;
     // continue to resume
     if (LIKELY(buf->empty())) {
@@ -879,8 +1067,8 @@ void CliConnection::WriteStream() {
       ec = asio::error::try_again;
       break;
     }
-    if (UNLIKELY(bytes_read_without_yielding > kYieldAfterBytesRead || GetMonotonicTime() > yield_after_time)) {
-      ++total_tx_yields;
+    if (UNLIKELY(quantum_used)) {
+      stats().Add(Stats::kTxYields);
       if (downstream_.empty()) {
         try_again = true;
         yield = true;
@@ -891,6 +1079,12 @@ void CliConnection::WriteStream() {
     }
   } while (true);
 
+#ifdef HAVE_QUICHE
+  if (adapter_ && wbytes_transferred) {
+    OnHttp2DataWritten(wbytes_transferred);
+  }
+#endif
+
   if (try_again) {
     if (channel_ && channel_->connected() && !channel_->read_inprogress()) {
       ReadUpstreamAsync(yield);
@@ -988,7 +1182,7 @@ void CliConnection::ReadUpstreamAsync(bool yield) {
         }
         received();
       },
-      yield);
+      yield ? &download_flow_ : nullptr);
 }
 
 std::shared_ptr<IOBuf> CliConnection::GetNextDownstreamBuf(asio::error_code& ec, size_t* bytes_transferred) {
@@ -1035,6 +1229,11 @@ try_again:
   } else {
     goto out;
   }
+  if (UNLIKELY(upstream_connect_time_)) {
+    ttfb_ns_ = GetMonotonicTime() - upstream_connect_time_;
+    stats().RecordNanoseconds(Stats::kTtfbLatency, ttfb_ns_);
+    upstream_connect_time_ = 0;
+  }
   *bytes_transferred += read;
 
 #ifdef HAVE_QUICHE
@@ -1042,7 +1241,9 @@ try_again:
     absl::string_view remaining_buffer(reinterpret_cast<const char*>(buf->data()), buf->length());
     while (!remaining_buffer.empty() && adapter_->want_read()) {
       http2_in_recv_callback_ = true;
+      http2_input_buf_ = buf;
       int64_t result = adapter_->ProcessBytes(remaining_buffer);
+      http2_input_buf_ = nullptr;
       http2_in_recv_callback_ = false;
       if (result < 0) {
         /* handled in OnConnectionError inside ProcessBytes call */
@@ -1056,13 +1257,19 @@ try_again:
       disconnected(ec);
       return nullptr;
     }
-    // not enough buffer for recv window
-    if (downstream_.byte_length() < H2_STREAM_WINDOW_SIZE) {
-      goto try_again;
+    // not enough buffer for recv window, unless the local socket doesn't keep up
+    if (http2_buffered_bytes_ < window_tuner_.window()) {
+      if (UNLIKELY(downstream_.above_watermark())) {
+        stats().Add(Stats::kReadPauses);
+      } else {
+        goto try_again;
+      }
     }
   } else
 #endif
-      if (upstream_https_fallback_) {
+      if (direct_) {
+    downstream_.push_back(buf);
+  } else if (upstream_https_fallback_) {
     if (upstream_https_handshake_) {
       ReadUpstreamHttpsHandshake(buf, ec);
       if (ec) {
@@ -1098,6 +1305,8 @@ try_again:
     if (CIPHER_METHOD_IS_SOCKS(method())) {
       downstream_.push_back(buf);
     } else {
+      // no reply to the request, the first bytes tell it is accepted
+      OnUpstreamAccepted();
       decoder_->process_bytes(buf);
     }
   }
@@ -1136,6 +1345,7 @@ void CliConnection::ReadUpstreamHttpsHandshake(std::shared_ptr<IOBuf> buf, asio:
             << " http: " << std::string_view(reinterpret_cast<const char*>(buf->data()), nparsed);
   }
   if (ok && parser.status_code() == 200) {
+    OnUpstreamAccepted();
     buf->trimStart(nparsed);
     buf->retreat(nparsed);
     if (parser.transfer_encoding_is_chunked()) {
@@ -1203,7 +1413,7 @@ void CliConnection::WriteUpstreamMethodSelectRequest() {
   method_select_header.ver = socks5::version;
   method_select_header.nmethods = 1;  // we only support auth or non-auth but not all of them.
 
-  bool auth_required = !absl::GetFlag(FLAGS_username).empty() && !absl::GetFlag(FLAGS_password).empty();
+  bool auth_required = !upstream_username().empty() && !upstream_password().empty();
 
   ByteRange req(reinterpret_cast<const uint8_t*>(&method_select_header), sizeof(method_select_header));
   std::shared_ptr<IOBuf> buf = IOBuf::copyBuffer(req);
@@ -1272,8 +1482,8 @@ void CliConnection::WriteUpstreamAuthRequest() {
   DCHECK(CIPHER_METHOD_IS_SOCKS5(method()));
   socks5::auth_request_header header;
   header.ver = socks5::version;
-  std::string username = absl::GetFlag(FLAGS_username);
-  std::string password = absl::GetFlag(FLAGS_password);
+  std::string username = upstream_username();
+  std::string password = upstream_password();
 
   ByteRange req(reinterpret_cast<const uint8_t*>(&header), sizeof(header));
   std::shared_ptr<IOBuf> buf = IOBuf::copyBuffer(req);
@@ -1333,7 +1543,7 @@ err_out:
 }
 
 void CliConnection::WriteUpstreamSocks4Request() {
-  bool auth_required = !absl::GetFlag(FLAGS_username).empty() && !absl::GetFlag(FLAGS_password).empty();
+  bool auth_required = !upstream_username().empty() && !upstream_password().empty();
   if (auth_required) {
     LOG(WARNING) << "Client specifies username and password but SOCKS4 doesn't support it";
   }
@@ -1367,7 +1577,7 @@ void CliConnection::WriteUpstreamSocks4Request() {
 }
 
 void CliConnection::WriteUpstreamSocks4ARequest() {
-  bool auth_required = !absl::GetFlag(FLAGS_username).empty() && !absl::GetFlag(FLAGS_password).empty();
+  bool auth_required = !upstream_username().empty() && !upstream_password().empty();
   if (auth_required) {
     LOG(WARNING) << "Client specifies username and password but SOCKS4A doesn't support it";
   }
@@ -1525,6 +1735,7 @@ void CliConnection::ReadUpstreamSocksResponse(std::shared_ptr<IOBuf> buf, asio::
       CHECK(false);
       break;
   }
+  OnUpstreamAccepted();
   if (buf->empty()) {
     ec = asio::error::try_again;
     return;
@@ -1543,8 +1754,7 @@ void CliConnection::WriteUpstreamInPipe() {
   bool try_again = false;
   bool yield = false;
 
-  int bytes_read_without_yielding = 0;
-  uint64_t yield_after_time = GetMonotonicTime() + kYieldAfterDurationMilliseconds * 1000 * 1000;
+  FairScheduler& scheduler = FairScheduler::Get(*io_context_);
 
   if (UNLIKELY(channel_ && channel_->write_inprogress())) {
     return;
@@ -1586,7 +1796,7 @@ void CliConnection::WriteUpstreamInPipe() {
     } while (false);
     buf->trimStart(written);
     wbytes_transferred += written;
-    bytes_read_without_yielding += written;
+    bool quantum_used = scheduler.Charge(&upload_flow_, written);
     if (UNLIKELY(ec == asio::error::try_again || ec == asio::error::would_block)) {
       DCHECK_EQ(0u, written);
       break;
@@ -1607,8 +1817,8 @@ void CliConnection::WriteUpstreamInPipe() {
       ec = asio::error::try_again;
       break;
     }
-    if (UNLIKELY(bytes_read_without_yielding > kYieldAfterBytesRead || GetMonotonicTime() > yield_after_time)) {
-      ++total_rx_yields;
+    if (UNLIKELY(quantum_used)) {
+      stats().Add(Stats::kRxYields);
       if (upstream_.empty()) {
         try_again = true;
         yield = true;
@@ -1641,12 +1851,21 @@ std::shared_ptr<IOBuf> CliConnection::GetNextUpstreamBuf(asio::error_code& ec,
     }
     DCHECK(!upstream_.front()->empty());
     ec = asio::error_code();
+#ifdef HAVE_QUICHE
+    CoalesceHttp2Frames();
+#endif
     return upstream_.front();
   }
   if (pending_upstream_read_error_) {
     ec = std::move(pending_upstream_read_error_);
     return nullptr;
   }
+  // pending on the responses from the current origin
+  if (http_rerouted_request_) {
+    *upstream_blocked = true;
+    ec = asio::error::try_again;
+    return nullptr;
+  }
   // RstStream might be sent in ProcessBytes
   if (closed_) {
     ec = asio::error::eof;
@@ -1666,8 +1885,17 @@ std::shared_ptr<IOBuf> CliConnection::GetNextUpstreamBuf(asio::error_code& ec,
 #endif
 
   do {
-    buf = IOBuf::create(SOCKET_BUF_SIZE);
-    read = downlink_->socket_.read_some(tail_buffer(*buf, SOCKET_BUF_SIZE), ec);
+#ifdef HAVE_QUICHE
+    if (adapter_) {
+      buf = IOBuf::create(kHttp2ReadHeadroom + kHttp2ReadSize);
+      buf->advance(kHttp2ReadHeadroom);
+    } else
+#endif
+    {
+      buf = IOBuf::create(SOCKET_BUF_HEADROOM + SOCKET_BUF_SIZE);
+      buf->advance(SOCKET_BUF_HEADROOM);
+    }
+    read = downlink_->read_some(buf, ec);
     if (ec == asio::error::interrupted) {
       continue;
     }
@@ -1679,8 +1907,8 @@ std::shared_ptr<IOBuf> CliConnection::GetNextUpstreamBuf(asio::error_code& ec,
     goto out;
   }
   rbytes_transferred_ += read;
-  total_rx_bytes += read;
-  ++total_rx_times;
+  stats().Add(Stats::kRxBytes, read);
+  stats().Add(Stats::kRxTimes);
   *bytes_transferred += read;
   if (read) {
     VLOG(2) << "Connection (client) " << connection_id() << " received data (pipe): " << read << " bytes."
@@ -1689,6 +1917,13 @@ std::shared_ptr<IOBuf> CliConnection::GetNextUpstreamBuf(asio::error_code& ec,
     goto out;
   }
 
+  // the control connection of udp associate carries nothing
+  if (udp_associate_) {
+    VLOG(2) << "Connection (client) " << connection_id() << " discarded data on udp associate: " << read << " bytes.";
+    ec = asio::error::try_again;
+    return nullptr;
+  }
+
   if (!channel_ || !channel_->connected()) {
     OnStreamRead(buf);
     ec = asio::error::try_again;
@@ -1698,12 +1933,26 @@ std::shared_ptr<IOBuf> CliConnection::GetNextUpstreamBuf(asio::error_code& ec,
   if (http_is_keep_alive_) {
     if (http_keep_alive_remaining_bytes_ < (int64_t)read) {
       VLOG(1) << "Connection (client) " << connection_id() << " reused for keep-alive connection";
-      // currently, we assume the host doesn't change
+      std::string host = http_host_;
+      uint16_t port = http_port_;
       ec = OnReadHttpRequest(buf);
       SetState(state_stream);
       if (ec) {
         return nullptr;
       }
+      if (http_track_responses_ && !http_is_connect_) {
+        if (http_host_ != host || http_port_ != port) {
+          // hold the request until the responses from the current origin are delivered
+          VLOG(1) << "Connection (client) " << connection_id() << " keep-alive request to another origin: " << http_host_
+                  << ":" << http_port_;
+          http_rerouted_request_ = buf;
+          MaybeRerouteHttpRequest();
+          *upstream_blocked = true;
+          ec = asio::error::try_again;
+          return nullptr;
+        }
+        http_responses_.OnRequest(http_is_head_);
+      }
     } else {
       http_keep_alive_remaining_bytes_ -= read;
     }
@@ -1722,7 +1971,7 @@ std::shared_ptr<IOBuf> CliConnection::GetNextUpstreamBuf(asio::error_code& ec,
     data_frame_->AddChunk(buf);
   } else
 #endif
-      if (upstream_https_fallback_) {
+      if (direct_ || upstream_https_fallback_) {
     upstream_.push_back(buf);
   } else {
     if (CIPHER_METHOD_IS_SOCKS(method())) {
@@ -1752,6 +2001,9 @@ out:
   if (ec && ec != asio::error::try_again && ec != asio::error::would_block) {
     pending_upstream_read_error_ = std::move(ec);
   }
+#ifdef HAVE_QUICHE
+  CoalesceHttp2Frames();
+#endif
   return upstream_.front();
 }
 
@@ -1768,6 +2020,14 @@ asio::error_code CliConnection::PerformCmdOpsV5(const socks5::request* request,
         break;
       }
 
+      if (request->address_type() == socks5::domain ? !MatchRoute(request->domain_name())
+                                                     : !MatchRoute(request->endpoint())) {
+        reply->set_endpoint(asio::ip::tcp::endpoint(asio::ip::tcp::v4(), 0));
+        reply->mutable_status() = socks5::reply::request_failed_not_allowed;
+        ec = asio::error::connection_refused;
+        break;
+      }
+
       asio::ip::tcp::endpoint endpoint;
       if (request->address_type() == socks5::domain) {
         endpoint = asio::ip::tcp::endpoint(asio::ip::tcp::v4(), 0);
@@ -1784,8 +2044,33 @@ asio::error_code CliConnection::PerformCmdOpsV5(const socks5::request* request,
         OnCmdConnect(request->endpoint());
       }
     } break;
+    case socks5::cmd_udp_associate: {
+      // the datagrams are carried by the tunnel to the yass server, which
+      // the socks upstreams don't understand
+      if (CIPHER_METHOD_IS_SOCKS(method())) {
+        LOG(WARNING) << "Connection (client) " << connection_id() << " socks5: udp associate not supported by upstream";
+        reply->mutable_status() = socks5::reply::request_failed_cmd_not_supported;
+        ec = asio::error::operation_not_supported;
+        break;
+      }
+      asio::ip::tcp::endpoint endpoint;
+      ec = OpenUdpAssociate(request, &endpoint);
+      if (ec) {
+        LOG(WARNING) << "Connection (client) " << connection_id() << " socks5: failed to open udp associate: " << ec;
+        reply->mutable_status() = socks5::reply::request_failed;
+        break;
+      }
+      reply->set_endpoint(endpoint);
+      reply->mutable_status() = socks5::reply::request_granted;
+
+      udp_associate_ = true;
+      stats().Add(Stats::kUdpAssociations);
+      // the pseudo target is the tunnel itself, the route rules don't apply
+      direct_ = false;
+      OnCmdConnect(std::string(kUdpOverTcpHost), kUdpOverTcpPort);
+      ReadUdpAssociate();
+    } break;
     case socks5::cmd_bind:
-    case socks5::cmd_udp_associate:
     default:
       // NOT IMPLETMENTED
       LOG(WARNING) << "Connection (client) " << connection_id() << " not supported command 0x" << std::hex
@@ -1797,6 +2082,182 @@ asio::error_code CliConnection::PerformCmdOpsV5(const socks5::request* request,
   return ec;
 }
 
+asio::error_code CliConnection::OpenUdpAssociate(const socks5::request* request,
+                                                 asio::ip::tcp::endpoint* bound_endpoint) {
+  asio::error_code ec;
+  // listen on the address the client reached us at
+  asio::ip::tcp::endpoint local_endpoint = downlink_->socket_.local_endpoint(ec);
+  if (ec) {
+    return ec;
+  }
+  asio::ip::address local_address =
+      UnmapUdpEndpoint(asio::ip::udp::endpoint(local_endpoint.address(), 0)).address();
+
+  udp_socket_ = std::make_unique<asio::ip::udp::socket>(*io_context_);
+  udp_socket_->open(local_address.is_v4() ? asio::ip::udp::v4() : asio::ip::udp::v6(), ec);
+  if (ec) {
+    return ec;
+  }
+  udp_socket_->non_blocking(true, ec);
+  if (ec) {
+    return ec;
+  }
+  udp_socket_->bind(asio::ip::udp::endpoint(local_address, 0), ec);
+  if (ec) {
+    return ec;
+  }
+  SetUdpReceiveOffload(udp_socket_.get());
+  asio::ip::udp::endpoint udp_endpoint = udp_socket_->local_endpoint(ec);
+  if (ec) {
+    return ec;
+  }
+  *bound_endpoint = asio::ip::tcp::endpoint(udp_endpoint.address(), udp_endpoint.port());
+
+  // DST.ADDR and DST.PORT are the address the client sends from, if known
+  if (request->address_type() != socks5::domain) {
+    udp_client_port_ = request->port();
+  }
+  VLOG(1) << "Connection (client) " << connection_id() << " socks5: udp associate on " << udp_endpoint;
+  return ec;
+}
+
+void CliConnection::ReadUdpAssociate() {
+  scoped_refptr<CliConnection> self(this);
+  udp_socket_->async_wait(asio::ip::udp::socket::wait_read, [this, self](asio::error_code ec) {
+    if (closed_) {
+      return;
+    }
+    if (ec == asio::error::bad_descriptor || ec == asio::error::operation_aborted) {
+      return;
+    }
+    if (ec) {
+      OnDisconnect(ec);
+      return;
+    }
+    OnUdpAssociateRead();
+  });
+}
+
+void CliConnection::OnUdpAssociateRead() {
+  // the datagrams are dropped instead of queued above the watermark (or while
+  // too many are pending on the connect), like a congested link
+  constexpr const size_t kMaxUdpPending = 512 * 1024;
+  bool congested = upstream_.above_watermark() || pending_data_.byte_length() >= kMaxUdpPending;
+  asio::ip::address client_address = UnmapUdpEndpoint(asio::ip::udp::endpoint(peer_endpoint_.address(), 0)).address();
+
+  asio::error_code ec;
+  std::shared_ptr<IOBuf> buf = IOBuf::create(SOCKET_BUF_SIZE);
+  size_t dropped = 0;
+  size_t received = ReceiveUdpPackets(
+      udp_socket_.get(),
+      [&](const asio::ip::udp::endpoint& peer, const uint8_t* data, size_t length) {
+        asio::ip::udp::endpoint endpoint = UnmapUdpEndpoint(peer);
+        if (!udp_client_locked_) {
+          // only the client of the control connection may use the association
+          if (endpoint.address() != client_address || (udp_client_port_ && endpoint.port() != udp_client_port_)) {
+            VLOG(2) << "Connection (client) " << connection_id() << " udp: dropped datagram from " << endpoint;
+            ++dropped;
+            return;
+          }
+          udp_client_endpoint_ = peer;
+          udp_client_locked_ = true;
+        } else if (peer != udp_client_endpoint_) {
+          VLOG(2) << "Connection (client) " << connection_id() << " udp: dropped datagram from " << endpoint;
+          ++dropped;
+          return;
+        }
+        UdpAddress address;
+        size_t header_length;
+        if (!ParseSocks5UdpHeader(data, length, &address, &header_length)) {
+          VLOG(2) << "Connection (client) " << connection_id() << " udp: dropped malformed datagram";
+          ++dropped;
+          return;
+        }
+        if (congested) {
+          ++dropped;
+          return;
+        }
+        AppendUdpOverTcpFrame(address, data + header_length, length - header_length, buf.get());
+      },
+      ec);
+  stats().Add(Stats::kUdpDatagramsReceived, received);
+  stats().Add(Stats::kUdpDatagramsDropped, dropped);
+  if (ec && ec != asio::error::try_again && ec != asio::error::would_block) {
+    OnDisconnect(ec);
+    return;
+  }
+
+  if (!buf->empty()) {
+    rbytes_transferred_ += buf->length();
+    stats().Add(Stats::kRxBytes, buf->length());
+    stats().Add(Stats::kRxTimes);
+    VLOG(2) << "Connection (client) " << connection_id() << " received data (udp): " << buf->length() << " bytes."
+            << " done: " << rbytes_transferred_ << " bytes.";
+    OnStreamRead(buf);
+  }
+  if (!closed_) {
+    ReadUdpAssociate();
+  }
+}
+
+size_t CliConnection::WriteUdpAssociate(std::shared_ptr<IOBuf> buf, asio::error_code& ec) {
+  // RSV + FRAG + the address
+  constexpr const size_t kMaxSocks5UdpHeaderLength = 3 + kMaxUdpAddressLength;
+  ec = asio::error_code();
+  std::vector<UdpPacket> packets;
+  // stable addresses for the headers referred by packets
+  std::deque<std::array<uint8_t, kMaxSocks5UdpHeaderLength>> headers;
+  size_t dropped = 0, sent = 0;
+  auto flush = [&]() {
+    size_t count = 0;
+    while (count < packets.size() && !ec) {
+      count += SendUdpPackets(udp_socket_.get(), packets.data() + count, packets.size() - count, ec);
+    }
+    sent += count;
+    dropped += packets.size() - count;
+    packets.clear();
+    headers.clear();
+  };
+  const uint8_t* begin = buf->data();
+  const uint8_t* end = buf->data() + buf->length();
+  bool ok = udp_frames_.Process(buf->data(), buf->length(), [&](const UdpAddress& address, const uint8_t* data,
+                                                                size_t length) {
+    // the association is unusable until the client sends the first datagram
+    if (!udp_client_locked_ || address.is_domain()) {
+      ++dropped;
+      return;
+    }
+    auto& header = headers.emplace_back();
+    UdpPacket packet;
+    packet.endpoint = udp_client_endpoint_;
+    packet.header = header.data();
+    packet.header_length = SerializeSocks5UdpHeader(address.endpoint, header.data());
+    packet.data = data;
+    packet.length = length;
+    packets.push_back(packet);
+    // the frame completed from the bytes kept by decoder is gone after the call
+    if (data < begin || data >= end) {
+      flush();
+    }
+  });
+  if (!ok) {
+    LOG(WARNING) << "Connection (client) " << connection_id() << " udp: malformed datagram frames";
+    ec = asio::error::invalid_argument;
+    return 0;
+  }
+  flush();
+  stats().Add(Stats::kUdpDatagramsSent, sent);
+  stats().Add(Stats::kUdpDatagramsDropped, dropped);
+  // like a congested link, drop what the socket buffer can't take
+  if (ec == asio::error::would_block || ec == asio::error::try_again) {
+    ec = asio::error_code();
+  }
+  if (ec) {
+    return 0;
+  }
+  return buf->length();
+}
+
 asio::error_code CliConnection::PerformCmdOpsV4(const socks4::request* request, socks4::reply* reply) {
   asio::error_code ec;
 
@@ -1814,15 +2275,22 @@ asio::error_code CliConnection::PerformCmdOpsV4(const socks4::request* request,
       reply->set_endpoint(endpoint);
       reply->mutable_status() = socks4::reply::request_granted;
 
-      if (request->is_socks4a()) {
-        if (request->domain_name().size() > TLSEXT_MAXLEN_host_name) {
-          LOG(WARNING) << "Connection (client) " << connection_id()
-                       << " socks4a: too long domain name: " << request->domain_name();
-          reply->mutable_status() = socks4::reply::request_failed;
-          ec = asio::error::invalid_argument;
-          break;
-        }
+      if (request->is_socks4a() && request->domain_name().size() > TLSEXT_MAXLEN_host_name) {
+        LOG(WARNING) << "Connection (client) " << connection_id()
+                     << " socks4a: too long domain name: " << request->domain_name();
+        reply->mutable_status() = socks4::reply::request_failed;
+        ec = asio::error::invalid_argument;
+        break;
+      }
 
+      if (request->is_socks4a() ? !MatchRoute(request->domain_name()) : !MatchRoute(request->endpoint())) {
+        // "request rejected or failed"
+        reply->mutable_status() = socks4::reply::request_failed;
+        ec = asio::error::connection_refused;
+        break;
+      }
+
+      if (request->is_socks4a()) {
         OnCmdConnect(request->domain_name(), request->port());
       } else {
         OnCmdConnect(request->endpoint());
@@ -1851,6 +2319,10 @@ asio::error_code CliConnection::PerformCmdOpsHttp() {
     return asio::error::invalid_argument;
   }
 
+  if (!MatchRoute(http_host_)) {
+    return asio::error::connection_refused;
+  }
+
   OnCmdConnect(http_host_, http_port_);
 
   return asio::error_code();
@@ -1862,8 +2334,8 @@ void CliConnection::ProcessReceivedData(std::shared_ptr<IOBuf> buf, asio::error_
           << " ec: " << ec;
 
   rbytes_transferred_ += bytes_transferred;
-  total_rx_bytes += bytes_transferred;
-  ++total_rx_times;
+  stats().Add(Stats::kRxBytes, bytes_transferred);
+  stats().Add(Stats::kRxTimes);
 
   if (buf) {
     DCHECK_LE(bytes_transferred, buf->length());
@@ -1896,15 +2368,23 @@ void CliConnection::ProcessReceivedData(std::shared_ptr<IOBuf> buf, asio::error_
         goto handle_stream;
       case state_http_handshake:
         ec = PerformCmdOpsHttp();
+        if (ec == asio::error::connection_refused) {
+          WriteHttpForbidden();
+          return;
+        }
         if (ec) {
           break;
         }
+        if (!http_is_connect_) {
+          http_track_responses_ = true;
+          http_responses_.OnRequest(http_is_head_);
+        }
         WriteHandshake();
         VLOG(2) << "Connection (client) " << connection_id() << " http handshake finished";
         goto handle_stream;
       case state_stream:
       handle_stream:
-        if (buf->length()) {
+        if (buf->length() && !udp_associate_) {
           OnStreamRead(buf);
           return;
         }
@@ -1927,8 +2407,8 @@ void CliConnection::ProcessReceivedData(std::shared_ptr<IOBuf> buf, asio::error_
 
 void CliConnection::ProcessSentData(asio::error_code ec, size_t bytes_transferred) {
   wbytes_transferred_ += bytes_transferred;
-  total_tx_bytes += bytes_transferred;
-  ++total_tx_times;
+  stats().Add(Stats::kTxBytes, bytes_transferred);
+  stats().Add(Stats::kTxTimes);
 
   VLOG(2) << "Connection (client) " << connection_id() << " sent data: " << bytes_transferred << " bytes."
           << " done: " << wbytes_transferred_ << " bytes."
@@ -1974,7 +2454,9 @@ void CliConnection::OnCmdConnect(const asio::ip::tcp::endpoint& endpoint) {
 void CliConnection::OnCmdConnect(const std::string& domain_name, uint16_t port) {
   DCHECK_LE(domain_name.size(), (unsigned int)TLSEXT_MAXLEN_host_name);
 
-  if (CIPHER_METHOD_IS_SOCKS_NON_DOMAIN_NAME(method())) {
+  ss_request_ = std::make_unique<ss::request>(domain_name, port);
+
+  if (CIPHER_METHOD_IS_SOCKS_NON_DOMAIN_NAME(method()) && !direct_) {
     VLOG(1) << "Connection (client) " << connection_id() << " resolving domain name " << domain_name << " locally";
     scoped_refptr<CliConnection> self(this);
     int ret = resolver_.Init();
@@ -1983,6 +2465,7 @@ void CliConnection::OnCmdConnect(const std::string& domain_name, uint16_t port)
       OnDisconnect(asio::error::host_not_found);
       return;
     }
+    process_stats().Add(Stats::kDnsLookups);
     resolver_.AsyncResolve(
         domain_name, port,
         [this, self, domain_name](const asio::error_code& ec, asio::ip::tcp::resolver::results_type results) {
@@ -2018,33 +2501,203 @@ void CliConnection::OnCmdConnect(const std::string& domain_name, uint16_t port)
   }
   DCHECK(!domain_name.empty());
   DCHECK_NE(0u, port);
-  ss_request_ = std::make_unique<ss::request>(domain_name, port);
   OnConnect();
 }
 
+bool CliConnection::MatchRoute(const asio::ip::tcp::endpoint& endpoint) {
+  auto rules = RouteRules::Global();
+  if (!ApplyRoute(rules ? rules->Match(endpoint.address()) : RouteRules::kProxy)) {
+    LOG(INFO) << "Connection (client) " << connection_id() << " route: rejected " << endpoint;
+    return false;
+  }
+  return true;
+}
+
+bool CliConnection::MatchRoute(const std::string& domain_name) {
+  RouteRules::Action action = RouteRules::kProxy;
+  if (auto rules = RouteRules::Global()) {
+    // http requests might carry address literals
+    asio::error_code ec;
+    auto address = asio::ip::make_address(domain_name, ec);
+    action = ec ? rules->Match(domain_name) : rules->Match(address);
+  }
+  if (!ApplyRoute(action)) {
+    LOG(INFO) << "Connection (client) " << connection_id() << " route: rejected " << domain_name;
+    return false;
+  }
+  return true;
+}
+
+bool CliConnection::ApplyRoute(RouteRules::Action action) {
+  direct_ = action == RouteRules::kDirect;
+  if (action == RouteRules::kReject) {
+    stats().Add(Stats::kRouteRejected);
+    return false;
+  }
+  if (direct_) {
+    VLOG(1) << "Connection (client) " << connection_id() << " route: connecting directly";
+    stats().Add(Stats::kRouteDirect);
+  }
+  return true;
+}
+
+void CliConnection::WriteHttpForbidden() {
+  // best effort, the reply fits into the socket buffer of a fresh request
+  asio::error_code ec;
+  std::shared_ptr<IOBuf> buf = IOBuf::copyBuffer(http_forbidden_reply_.data(), http_forbidden_reply_.size());
+  downlink_->write_some(buf, ec);
+  if (!ec) {
+    shutdown_ = true;
+    downlink_->shutdown(ec);
+  }
+  SetState(state_error);
+  OnDisconnect(asio::error::connection_refused);
+}
+
 void CliConnection::OnConnect() {
   scoped_refptr<CliConnection> self(this);
-  LOG(INFO) << "Connection (client) " << connection_id() << " connect " << remote_domain();
-  // create lazy
-  if (enable_upstream_tls_) {
-    channel_ = ssl_stream::create(ssl_socket_data_index(), *io_context_, remote_host_ips_, remote_host_sni_,
-                                  remote_port_, this, upstream_https_fallback_, upstream_ssl_ctx_);
+  VLOG(1) << "Connection (client) " << connection_id() << " connect " << remote_domain();
+  upstream_connect_time_ = GetMonotonicTime();
+  // keep-alive requests rerouted to another origin are not handshakes
+  if (!handshake_ns_) {
+    handshake_ns_ = upstream_connect_time_ - accept_time_;
+    stats().RecordNanoseconds(Stats::kHandshakeLatency, handshake_ns_);
+  }
+  connect_attempts_ = 0;
+  SwitchServer(direct_ ? nullptr : UpstreamPool::Get(*io_context_).Pick(upstream_connect_time_));
+  ConnectUpstream();
+}
 
+void CliConnection::ConnectUpstream() {
+  scoped_refptr<CliConnection> self(this);
+  ++connect_attempts_;
+  // create lazy
+  if (direct_) {
+    std::string host_name;
+    if (ss_request_->address_type() == ss::domain) {
+      host_name = ss_request_->domain_name();
+    } else {
+      host_name = ss_request_->endpoint().address().to_string();
+    }
+    channel_ = stream::create(*io_context_, std::string(), host_name, ss_request_->port(), this);
   } else {
-    channel_ = stream::create(*io_context_, remote_host_ips_, remote_host_sni_, remote_port_, this);
+    // the other servers than the primary one are resolved by the stream
+    std::string host_ips = remote_host_ips_;
+    std::string host_sni = remote_host_sni_;
+    uint16_t port = remote_port_;
+    if (server_ && !server_->primary()) {
+      host_ips.clear();
+      host_sni = server_->host();
+      port = server_->port();
+    }
+    if (enable_upstream_tls_) {
+      channel_ = ssl_stream::create(ssl_socket_data_index(), *io_context_, host_ips, host_sni, port, this,
+                                    upstream_https_fallback_, upstream_ssl_ctx_.get());
+
+    } else {
+      channel_ = stream::create(*io_context_, host_ips, host_sni, port, this);
+    }
   }
-  channel_->async_connect([this, self](asio::error_code ec) {
-    if (UNLIKELY(closed_)) {
+  channel_->set_rate_limiter(rate_limiter_);
+  upstream_start_time_ = GetMonotonicTime();
+  upstream_reported_ = false;
+  stream* channel = channel_.get();
+  channel_->async_connect([this, self, channel](asio::error_code ec) {
+    if (UNLIKELY(closed_ || channel != channel_.get())) {
       return;
     }
     if (UNLIKELY(ec)) {
+      stats().Add(Stats::kConnectErrors);
+      if (server_) {
+        OnUpstreamFailed();
+        // the connect might fail within async_connect, so the channel is not
+        // replaced on its own stack
+        asio::post(*io_context_, [this, self, channel, ec]() {
+          if (UNLIKELY(closed_ || channel != channel_.get())) {
+            return;
+          }
+          if (!FailoverUpstream()) {
+            disconnected(ec);
+          }
+        });
+        return;
+      }
       disconnected(ec);
       return;
     }
+    // the servers other than the primary one are resolved by the stream, leave
+    // the resolve out of the latency compared between the servers
+    upstream_latency_ = GetMonotonicTime() - upstream_start_time_ - channel->dns_latency();
     connected();
   });
 }
 
+bool CliConnection::FailoverUpstream() {
+  // a tunnel tries up to 3 servers
+  constexpr int kMaxConnectAttempts = 3;
+  if (connect_attempts_ >= kMaxConnectAttempts) {
+    return false;
+  }
+  auto server = UpstreamPool::Get(*io_context_).Pick(GetMonotonicTime(), server_.get());
+  if (!server || server == server_) {
+    return false;
+  }
+  LOG(WARNING) << "Connection (client) " << connection_id() << " upstream: failed to connect " << server_->host() << ":"
+               << server_->port() << ", trying " << server->host() << ":" << server->port();
+  stats().Add(Stats::kUpstreamFailovers);
+  channel_->close();
+  channel_ = nullptr;
+  SwitchServer(std::move(server));
+  ConnectUpstream();
+  return true;
+}
+
+void CliConnection::SwitchServer(std::shared_ptr<UpstreamServer> server) {
+  if (server_) {
+    server_->OnTunnelClosed();
+  }
+  server_ = std::move(server);
+  if (server_) {
+    server_->OnTunnelOpened();
+  }
+}
+
+void CliConnection::OnUpstreamAccepted() {
+  if (server_ && !upstream_reported_) {
+    upstream_reported_ = true;
+    server_->OnConnected(upstream_latency_);
+  }
+}
+
+void CliConnection::OnUpstreamFailed() {
+  if (server_ && !upstream_reported_) {
+    upstream_reported_ = true;
+    server_->OnConnectFailed(upstream_start_time_, GetMonotonicTime());
+  }
+}
+
+std::string CliConnection::upstream_username() const {
+  if (server_ && server_->has_credentials()) {
+    return server_->username();
+  }
+  return absl::GetFlag(FLAGS_username);
+}
+
+std::string CliConnection::upstream_password() const {
+  if (server_ && server_->has_credentials()) {
+    return server_->password();
+  }
+  return absl::GetFlag(FLAGS_password);
+}
+
+// static
+bool CliConnection::ConfigureUpstreams(asio::io_context& io_context, std::string* err) {
+  UpstreamServer::Config primary;
+  primary.host = absl::GetFlag(FLAGS_server_host);
+  primary.port = absl::GetFlag(FLAGS_server_port);
+  return UpstreamPool::Get(io_context).Configure(primary, absl::GetFlag(FLAGS_upstream_servers), err);
+}
+
 void CliConnection::OnStreamRead(std::shared_ptr<IOBuf> buf) {
   if (!channel_ || !channel_->connected()) {
     constexpr const size_t kMaxHeaderSize = 1024 * 1024 + 1024;
@@ -2073,7 +2726,7 @@ void CliConnection::OnStreamRead(std::shared_ptr<IOBuf> buf) {
     SendIfNotProcessing();
   } else
 #endif
-      if (upstream_https_fallback_) {
+      if (direct_ || upstream_https_fallback_) {
     upstream_.push_back(buf);
   } else {
     if (CIPHER_METHOD_IS_SOCKS(method())) {
@@ -2085,9 +2738,90 @@ void CliConnection::OnStreamRead(std::shared_ptr<IOBuf> buf) {
   OnUpstreamWriteFlush();
 }
 
+void CliConnection::MaybeRerouteHttpRequest() {
+  if (!http_rerouted_request_ || !downstream_.empty()) {
+    return;
+  }
+  if (http_responses_.failed()) {
+    // the responses from the current origin can't be told apart, the client
+    // retries the held request on a new connection
+    LOG(WARNING) << "Connection (client) " << connection_id()
+                 << " keep-alive: unable to follow the responses, closing before switching origin";
+    if (!shutdown_) {
+      shutdown_ = true;
+      asio::error_code ec;
+      downlink_->shutdown(ec);
+    }
+    return;
+  }
+  if (!http_responses_.idle()) {
+    return;
+  }
+  scoped_refptr<CliConnection> self(this);
+  // the tunnel might be torn down inside its own callbacks, do it later
+  asio::post(*io_context_, [this, self]() {
+    if (closed_ || !http_rerouted_request_) {
+      return;
+    }
+    RerouteHttpRequest();
+  });
+}
+
+void CliConnection::RerouteHttpRequest() {
+  VLOG(1) << "Connection (client) " << connection_id() << " keep-alive: switching origin from " << remote_domain()
+          << " to " << http_host_ << ":" << http_port_;
+  stats().Add(Stats::kHttpReroutes);
+
+  // tear down the tunnel to the current origin
+  if (channel_) {
+    channel_->close();
+    channel_ = nullptr;
+  }
+  upstream_readable_ = false;
+  upstream_writable_ = false;
+  upstream_.clear();
+  pending_upstream_read_error_ = asio::error_code();
+#ifdef HAVE_QUICHE
+  data_frame_ = nullptr;
+  adapter_.reset();
+  request_map_.clear();
+  stream_id_ = 0;
+  blocked_stream_ = 0;
+#endif
+  encoder_.reset();
+  decoder_.reset();
+  upstream_https_handshake_ = true;
+  upstream_https_chunked_ = false;
+  socks5_method_select_handshake_ = false;
+  socks5_auth_handshake_ = false;
+  socks_handshake_ = false;
+  num_padding_send_ = 0;
+  num_padding_recv_ = 0;
+  padding_in_middle_buf_.reset();
+
+  // the held request is sent once the tunnel to the new origin is established
+  http_responses_.OnRequest(http_is_head_);
+  pending_data_.push_back(std::move(http_rerouted_request_));
+
+  asio::error_code ec = PerformCmdOpsHttp();
+  if (ec == asio::error::connection_refused) {
+    WriteHttpForbidden();
+    return;
+  }
+  if (ec) {
+    OnDisconnect(ec);
+  }
+}
+
 void CliConnection::OnStreamWrite() {
   OnDownstreamWriteFlush();
 
+  /* switch to the origin of the held request if all responses are sent */
+  if (http_rerouted_request_ && http_responses_.idle()) {
+    MaybeRerouteHttpRequest();
+    return;
+  }
+
   /* shutdown the socket if upstream is eof and all remaining data sent */
   if (channel_ && channel_->eof() && downstream_.empty() && !shutdown_) {
     VLOG(2) << "Connection (client) " << connection_id() << " last data sent: shutting down";
@@ -2108,7 +2842,8 @@ void CliConnection::OnDisconnect(asio::error_code ec) {
     ec = asio::error_code();
   }
 #endif
-  LOG(INFO) << "Connection (client) " << connection_id() << " closed: " << ec;
+  VLOG(1) << "Connection (client) " << connection_id() << " closed: " << ec;
+  close_reason_ = ec;
   close();
 }
 
@@ -2163,8 +2898,9 @@ void CliConnection::connected() {
   scoped_refptr<CliConnection> self(this);
   VLOG(2) << "Connection (client) " << connection_id()
           << " remote: established upstream connection with: " << remote_domain();
+  channel_->report_stats(&stats());
 
-  bool http2 = CIPHER_METHOD_IS_HTTP2(method());
+  bool http2 = !direct_ && CIPHER_METHOD_IS_HTTP2(method());
   if (http2 && channel_->https_fallback()) {
     http2 = false;
     upstream_https_fallback_ = true;
@@ -2183,15 +2919,17 @@ void CliConnection::connected() {
     padding_support_ = absl::GetFlag(FLAGS_padding_support);
   } else
 #endif
-      if (upstream_https_fallback_) {
+      if (direct_) {
+    // nothing to create, the data is relayed as is
+  } else if (upstream_https_fallback_) {
     // nothing to create
     // TODO should we support it?
     // padding_support_ = absl::GetFlag(FLAGS_padding_support);
   } else {
     DCHECK(!http2);
     if (!CIPHER_METHOD_IS_SOCKS(method())) {
-      encoder_ = std::make_unique<cipher>("", absl::GetFlag(FLAGS_password), method(), this, true);
-      decoder_ = std::make_unique<cipher>("", absl::GetFlag(FLAGS_password), method(), this);
+      encoder_ = std::make_unique<cipher>("", upstream_password(), method(), this, true);
+      decoder_ = std::make_unique<cipher>("", upstream_password(), method(), this);
     }
   }
 
@@ -2206,6 +2944,11 @@ void CliConnection::connected() {
         {http2::adapter::Http2KnownSettingsId::ENABLE_PUSH, kSpdyDisablePush},
     };
     adapter_->SubmitSettings(settings);
+    // the connection window stays at 64 KiB until updated
+    adapter_->SubmitWindowUpdate(0, H2_STREAM_WINDOW_SIZE - kSpdyDefaultInitialWindowSize);
+    // measure the round trip time for Http2WindowTuner
+    adapter_->SubmitPing(Http2WindowTuner::kPingId);
+    window_tuner_.OnPingSent(GetMonotonicTime());
     SendIfNotProcessing();
   }
 
@@ -2238,9 +2981,12 @@ void CliConnection::connected() {
     //    authority   = [ userinfo "@" ] host [ ":" port ]
     headers.emplace_back(":authority"s, hostname_and_port);
     headers.emplace_back("host"s, hostname_and_port);
-    bool auth_required = !absl::GetFlag(FLAGS_username).empty() && !absl::GetFlag(FLAGS_password).empty();
+    std::string username = upstream_username();
+    std::string password = upstream_password();
+    bool auth_required = !username.empty() && !password.empty();
     if (auth_required) {
-      headers.emplace_back("proxy-authorization"s, absl::StrCat("basic ", GetProxyAuthorizationIdentity()));
+      headers.emplace_back("proxy-authorization"s,
+                           absl::StrCat("basic ", GetProxyAuthorizationIdentity(username, password)));
     }
     // Send "Padding" header
     // originated from naive_proxy_delegate.go;func ServeHTTP
@@ -2261,7 +3007,9 @@ void CliConnection::connected() {
     SendIfNotProcessing();
   } else
 #endif
-      if (upstream_https_fallback_) {
+      if (direct_) {
+    // nothing to send ahead of the data
+  } else if (upstream_https_fallback_) {
     std::string hostname_and_port;
     std::string host;
     int port;
@@ -2282,7 +3030,9 @@ void CliConnection::connected() {
       hostname_and_port = absl::StrCat("[", host, "]", ":", port);
     }
 
-    bool auth_required = !absl::GetFlag(FLAGS_username).empty() && !absl::GetFlag(FLAGS_password).empty();
+    std::string username = upstream_username();
+    std::string password = upstream_password();
+    bool auth_required = !username.empty() && !password.empty();
 
     std::string hdr = absl::StrFormat(
         "CONNECT %s HTTP/1.1\r\n"
@@ -2290,7 +3040,8 @@ void CliConnection::connected() {
         "Proxy-Authorization: %s\r\n"
         "Proxy-Connection: Close\r\n"
         "\r\n",
-        hostname_and_port.c_str(), hostname_and_port.c_str(), absl::StrCat("basic ", GetProxyAuthorizationIdentity()));
+        hostname_and_port.c_str(), hostname_and_port.c_str(),
+        absl::StrCat("basic ", GetProxyAuthorizationIdentity(username, password)));
     if (!auth_required) {
       hdr = absl::StrFormat(
           "CONNECT %s HTTP/1.1\r\n"
@@ -2374,9 +3125,27 @@ void CliConnection::disconnected(asio::error_code ec) {
   scoped_refptr<CliConnection> self(this);
   VLOG(1) << "Connection (client) " << connection_id() << " upstream: lost connection with: " << remote_domain()
           << " due to " << ec;
+  // refused, reset or closed before the tunnel is accepted, e.g. a rejected
+  // CONNECT, a GOAWAY or an early EOF
+  if (ec) {
+    OnUpstreamFailed();
+  }
   upstream_readable_ = false;
   upstream_writable_ = false;
   channel_->close();
+  /* the origin might close the connection to end the last response */
+  if (http_track_responses_ && ec == asio::error::eof) {
+    http_responses_.OnEof();
+  }
+  /* go on with the held request once the responses are sent */
+  if (http_rerouted_request_ && http_responses_.idle()) {
+    if (downstream_.empty()) {
+      MaybeRerouteHttpRequest();
+    } else {
+      WriteStream();
+    }
+    return;
+  }
   /* delay the socket's close because downstream is buffered */
   if (downstream_.empty() && !shutdown_) {
     VLOG(2) << "Connection (client) " << connection_id() << " last data sent: shutting down";
@@ -9,10 +9,13 @@
 #include "net/channel.hpp"
 #include "net/cipher.hpp"
 #include "net/connection.hpp"
+#include "net/http2_window_tuner.hpp"
+#include "net/http_response_tracker.hpp"
 #include "net/io_queue.hpp"
 #include "net/iobuf.hpp"
 #include "net/protocol.hpp"
 #include "net/resolver.hpp"
+#include "net/route_rules.hpp"
 #include "net/socks4.hpp"
 #include "net/socks4_request.hpp"
 #include "net/socks5.hpp"
@@ -20,6 +23,8 @@
 #include "net/ss_request.hpp"
 #include "net/ssl_stream.hpp"
 #include "net/stream.hpp"
+#include "net/udp_over_tcp.hpp"
+#include "net/upstream_pool.hpp"
 
 #include <absl/container/flat_hash_map.h>
 #include <absl/strings/str_cat.h>
@@ -59,6 +64,8 @@ class DataFrameSource : public http2::adapter::DataFrameSource {
     if (chunks_.empty())
       return {kBlocked, last_frame_};
 
+    // a full DATA frame fits in a TLS record
+    max_length = std::min(max_length, kMaxTlsRecordPayload - kHttp2FrameHeaderSize);
     bool finished = (chunks_.size() <= 1) && (chunks_.front()->length() <= max_length) && last_frame_;
 
     return {std::min(chunks_.front()->length(), max_length), finished};
@@ -96,6 +103,14 @@ class CliConnection : public gurl_base::RefCountedThreadSafe<CliConnection>,
   static constexpr const ConnectionFactoryType Type = CONNECTION_FACTORY_CLIENT;
   static constexpr const std::string_view Name = "client";
 
+  /// configure the UpstreamPool of the io context by --server_host and
+  /// --upstream_servers
+  ///
+  /// \param io_context the io context the connections run on
+  /// \param err the error if failed, the servers are kept then
+  /// \return whether the servers are configured
+  static bool ConfigureUpstreams(asio::io_context& io_context, std::string* err);
+
  public:
   /// The state of service
   enum state {
@@ -126,6 +141,18 @@ class CliConnection : public gurl_base::RefCountedThreadSafe<CliConnection>,
     return "unknown";
   }
 
+  /// Convert the state of service into the gauge of statistics
+  static Stats::Gauge state_to_gauge(enum state state) {
+    switch (state) {
+      case state_error:
+        return Stats::kConnectionsInError;
+      case state_stream:
+        return Stats::kConnectionsInStream;
+      default:
+        return Stats::kConnectionsInHandshake;
+    }
+  }
+
   /// Construct the service with io context and socket
   ///
   /// \param io_context the io context associated with the service
@@ -165,6 +192,11 @@ class CliConnection : public gurl_base::RefCountedThreadSafe<CliConnection>,
   void close();
 
  private:
+  /// release the buffers of an idle connection
+  ///
+  /// \return the bytes released
+  size_t ReleaseIdleMemory();
+
   /// flag to mark connection is closed
   bool closed_ = true;
 
@@ -174,7 +206,23 @@ class CliConnection : public gurl_base::RefCountedThreadSafe<CliConnection>,
 #ifdef HAVE_QUICHE
  private:
   bool http2_in_recv_callback_ = false;
+  /// the input being processed, shared by the DATA payloads within
+  std::shared_ptr<IOBuf> http2_input_buf_;
+  /// queue the DATA payloads, the paddings are stripped
+  void QueueDataForStream(absl::string_view data);
+  void QueueHttp2Data(std::shared_ptr<IOBuf> buf);
+  /// mark the payloads written to the local socket consumed, see Http2WindowTuner
+  void OnHttp2DataWritten(size_t bytes);
+  /// sizes the receive window of the stream
+  Http2WindowTuner window_tuner_{H2_STREAM_WINDOW_SIZE, H2_STREAM_MAX_WINDOW_SIZE};
+  /// the payloads queued in downstream_ but not yet consumed
+  size_t http2_buffered_bytes_ = 0;
   void SendIfNotProcessing();
+  /// coalesce the small frames queued in upstream_ up to a full TLS record, so they
+  /// are written by one SSL_write (and one syscall)
+  void CoalesceHttp2Frames();
+  /// queue the serialized DATA frame by reference, see DataFrameSource::Send
+  void OnReadyToSendDataFrame(std::shared_ptr<IOBuf> frame);
   bool processing_responses_ = false;
   StreamId stream_id_ = 0;
   DataFrameSource* data_frame_ = nullptr;
@@ -219,7 +267,7 @@ class CliConnection : public gurl_base::RefCountedThreadSafe<CliConnection>,
   bool OnDataPaddingLength(StreamId stream_id, size_t padding_length) override;
   void OnRstStream(StreamId stream_id, http2::adapter::Http2ErrorCode error_code) override;
   void OnPriorityForStream(StreamId stream_id, StreamId parent_stream_id, int weight, bool exclusive) override {}
-  void OnPing(http2::adapter::Http2PingId ping_id, bool is_ack) override {}
+  void OnPing(http2::adapter::Http2PingId ping_id, bool is_ack) override;
   void OnPushPromiseForStream(StreamId stream_id, StreamId promised_stream_id) override {}
   bool OnGoAway(StreamId last_accepted_stream_id,
                 http2::adapter::Http2ErrorCode error_code,
@@ -257,7 +305,16 @@ class CliConnection : public gurl_base::RefCountedThreadSafe<CliConnection>,
   state CurrentState() const { return state_; }
   /// Set the state machine to the given state
   /// \param nextState the state the service would be set to
-  void SetState(state nextState) { state_ = nextState; }
+  void SetState(state nextState) {
+    if (!closed_) {
+      if (state_reported_) {
+        stats().Add(state_to_gauge(state_), -1);
+      }
+      stats().Add(state_to_gauge(nextState), 1);
+      state_reported_ = true;
+    }
+    state_ = nextState;
+  }
 
   /// Start to read socks5 method select/socks4 handshake/http handshake request
   void ReadMethodSelect();
@@ -327,6 +384,8 @@ class CliConnection : public gurl_base::RefCountedThreadSafe<CliConnection>,
   void ProcessSentData(asio::error_code error, size_t bytes_transferred);
   /// state machine
   state state_;
+  /// if the state is counted in statistics
+  bool state_reported_ = false;
 
  private:
   /// copy of handshake request
@@ -351,13 +410,48 @@ class CliConnection : public gurl_base::RefCountedThreadSafe<CliConnection>,
   bool http_is_connect_ = false;
   /// copy of connect response
   static const std::string_view http_connect_reply_;
+  static const std::string_view http_forbidden_reply_;
   /// copy of keep alive state
   bool http_is_keep_alive_ = false;
   /// copy of remaining bytes in keep alive cycle
   int64_t http_keep_alive_remaining_bytes_ = 0;
+  /// copy of head method, whose response carries no body
+  bool http_is_head_ = false;
+  /// the responses to plain (non-CONNECT) http requests are followed
+  bool http_track_responses_ = false;
+  /// follows the responses to the requests sent to the current origin
+  HttpResponseTracker http_responses_;
+  /// the keep-alive request to another origin, held until the responses
+  /// from the current origin are delivered
+  std::shared_ptr<IOBuf> http_rerouted_request_;
+
+  /// the connection is the control connection of socks5 udp associate,
+  /// the datagrams are relayed through a tunnel to kUdpOverTcpHost
+  bool udp_associate_ = false;
+  /// the udp socket the client sends datagrams to
+  std::unique_ptr<asio::ip::udp::socket> udp_socket_;
+  /// the client sending datagrams, locked by the first datagram accepted
+  asio::ip::udp::endpoint udp_client_endpoint_;
+  bool udp_client_locked_ = false;
+  /// the port the client declared to send datagrams from, 0 if unknown
+  uint16_t udp_client_port_ = 0U;
+  /// decodes the datagrams framed by the server
+  UdpOverTcpDecoder udp_frames_;
 
   /// copy of upstream request
   std::unique_ptr<ss::request> ss_request_;
+  /// the target is connected directly instead of by the remote server
+  bool direct_ = false;
+  /// the remote server of the tunnel, null if the UpstreamPool is not configured
+  std::shared_ptr<UpstreamServer> server_;
+  /// the remote servers tried for the tunnel
+  int connect_attempts_ = 0;
+  /// when the connect to the remote server started
+  uint64_t upstream_start_time_ = 0;
+  /// the time to connect and handshake with the remote server, excluding the name resolution
+  uint64_t upstream_latency_ = 0;
+  /// whether the tunnel is reported to the remote server as accepted or failed
+  bool upstream_reported_ = false;
   /// copy of padding support
   bool padding_support_ = false;
   int num_padding_send_ = 0;
@@ -405,9 +499,48 @@ class CliConnection : public gurl_base::RefCountedThreadSafe<CliConnection>,
   void OnCmdConnect(const asio::ip::tcp::endpoint& endpoint);
   void OnCmdConnect(const std::string& domain_name, uint16_t port);
 
+  /// match the target against the route rules, before replying to the request
+  ///
+  /// \param endpoint the target
+  /// \return false if the target is rejected, otherwise direct_ is set up for it
+  bool MatchRoute(const asio::ip::tcp::endpoint& endpoint);
+  /// \param domain_name the target, which might be an address literal
+  bool MatchRoute(const std::string& domain_name);
+
+  /// apply the action of the route rules to the request
+  ///
+  /// \param action the action for the target
+  /// \return false if the request is rejected
+  bool ApplyRoute(RouteRules::Action action);
+
+  /// reply 403 to the http request rejected by the route rules and close
+  void WriteHttpForbidden();
+
   /// handle with connnect event (downstream)
   void OnConnect();
 
+  /// connect to the target directly or to the remote server
+  void ConnectUpstream();
+
+  /// connect to another remote server after a failed connect
+  ///
+  /// \return whether another remote server is tried
+  bool FailoverUpstream();
+
+  /// switch the tunnel to the remote server, counted as active on it
+  void SwitchServer(std::shared_ptr<UpstreamServer> server);
+
+  /// the remote server accepted the tunnel, e.g. replied to the CONNECT request
+  void OnUpstreamAccepted();
+
+  /// the tunnel failed before accepted by the remote server, e.g. refused or
+  /// closed early
+  void OnUpstreamFailed();
+
+  /// the credentials of the remote server
+  std::string upstream_username() const;
+  std::string upstream_password() const;
+
   /// handle the read data from stream read event (downstream)
   void OnStreamRead(std::shared_ptr<IOBuf> buf);
 
@@ -429,6 +562,34 @@ class CliConnection : public gurl_base::RefCountedThreadSafe<CliConnection>,
   /// write the given data to upstream
   void OnUpstreamWrite(std::shared_ptr<IOBuf> buf);
 
+  /// schedule the switch to the origin of the held keep-alive request once
+  /// the responses from the current origin are delivered
+  void MaybeRerouteHttpRequest();
+
+  /// tear down the tunnel to the current origin and connect to the origin of
+  /// the held keep-alive request
+  ///
+  /// Every switch pays a new connect (and tls handshake, and http2 session
+  /// setup) to the upstream. The tunnels are not kept per origin: the tunnel
+  /// state is spread over this connection (channel, ciphers, http2 adapter,
+  /// padding) and the callbacks of a parked channel would still land here.
+  /// Switches are counted in Stats::kHttpReroutes to tell if a per-origin
+  /// tunnel cache is worth the split.
+  void RerouteHttpRequest();
+
+  /// open the udp socket of socks5 udp associate
+  /// \param bound_endpoint the endpoint to reply the client with
+  asio::error_code OpenUdpAssociate(const socks5::request* request, asio::ip::tcp::endpoint* bound_endpoint);
+
+  /// wait for the datagrams from the client (udp associate)
+  void ReadUdpAssociate();
+
+  /// frame the datagrams from the client and send them upstream
+  void OnUdpAssociateRead();
+
+  /// send the datagrams framed by the server to the client
+  size_t WriteUdpAssociate(std::shared_ptr<IOBuf> buf, asio::error_code& ec);
+
   /// the queue to write upstream
   IoQueue upstream_;
   /// the flag to mark current write
@@ -10,16 +10,13 @@
 
 namespace net::cli {
 
-std::atomic<uint64_t> total_rx_bytes;
-std::atomic<uint64_t> total_tx_bytes;
-
-std::atomic<uint64_t> total_rx_times;
-std::atomic<uint64_t> total_tx_times;
-
-std::atomic<uint64_t> total_rx_yields;
-std::atomic<uint64_t> total_tx_yields;
+Stats& stats() {
+  static Stats* stats = new Stats("cli");
+  return *stats;
+}
 
 }  // namespace net::cli
+
 static std::string HumanReadableByteCountBinStr(uint64_t bytes) {
   std::stringstream ss;
 
@@ -28,14 +25,19 @@ static std::string HumanReadableByteCountBinStr(uint64_t bytes) {
 }
 
 void PrintCliStats() {
-  LOG(ERROR) << "Cli Connection Stats: Sent: " << HumanReadableByteCountBinStr(net::cli::total_rx_bytes);
-  LOG(ERROR) << "Cli Connection Stats: Received: " << HumanReadableByteCountBinStr(net::cli::total_tx_bytes);
-  LOG(ERROR) << "Cli Connection Stats: Sent Times: " << net::cli::total_rx_times;
-  LOG(ERROR) << "Cli Connection Stats: Received Times: " << net::cli::total_tx_times;
+  using net::Stats;
+  Stats::Snapshot s = net::cli::stats().GetSnapshot();
+  LOG(ERROR) << "Cli Connection Stats: Sent: " << HumanReadableByteCountBinStr(s[Stats::kRxBytes]);
+  LOG(ERROR) << "Cli Connection Stats: Received: " << HumanReadableByteCountBinStr(s[Stats::kTxBytes]);
+  LOG(ERROR) << "Cli Connection Stats: Sent Times: " << s[Stats::kRxTimes];
+  LOG(ERROR) << "Cli Connection Stats: Received Times: " << s[Stats::kTxTimes];
   LOG(ERROR) << "Cli Connection Stats: Sent Average: "
-             << HumanReadableByteCountBinStr(net::cli::total_rx_bytes / (net::cli::total_rx_times + 1));
+             << HumanReadableByteCountBinStr(s[Stats::kRxBytes] / (s[Stats::kRxTimes] + 1));
   LOG(ERROR) << "Cli Connection Stats: Received Average: "
-             << HumanReadableByteCountBinStr(net::cli::total_tx_bytes / (net::cli::total_tx_times + 1));
-  LOG(ERROR) << "Cli Connection Stats: Sent Yield Times: " << net::cli::total_rx_yields;
-  LOG(ERROR) << "Cli Connection Stats: Received Yield Times: " << net::cli::total_tx_yields;
+             << HumanReadableByteCountBinStr(s[Stats::kTxBytes] / (s[Stats::kTxTimes] + 1));
+  LOG(ERROR) << "Cli Connection Stats: Sent Yield Times: " << s[Stats::kRxYields];
+  LOG(ERROR) << "Cli Connection Stats: Received Yield Times: " << s[Stats::kTxYields];
+  LOG(ERROR) << "Cli Connection Stats: Connections: " << s[Stats::kConnectionsOpened]
+             << " Closed: " << s[Stats::kConnectionsClosed] << " Connect Errors: " << s[Stats::kConnectErrors];
+  net::PrintStatsHistograms("Cli Connection Stats", s);
 }
@@ -4,23 +4,24 @@
 #ifndef H_CLI_CONNECTION_STATS
 #define H_CLI_CONNECTION_STATS
 
-#include <atomic>
 #include <cstdint>
 
+#include "net/stats.hpp"
+
 namespace net::cli {
 
+/// statistics of all cli connections
+Stats& stats();
+
 /// statistics of total received bytes (non-encoded)
-extern std::atomic<uint64_t> total_rx_bytes;
+inline uint64_t total_rx_bytes() {
+  return stats().Get(Stats::kRxBytes);
+}
+
 /// statistics of total sent bytes (non-encoded)
-extern std::atomic<uint64_t> total_tx_bytes;
-/// statistics of total received times (non-encoded)
-extern std::atomic<uint64_t> total_rx_times;
-/// statistics of total sent times (non-encoded)
-extern std::atomic<uint64_t> total_tx_times;
-/// statistics of total yield times (rx) (non-encoded)
-extern std::atomic<uint64_t> total_rx_yields;
-/// statistics of total yield times (tx) (non-encoded)
-extern std::atomic<uint64_t> total_tx_yields;
+inline uint64_t total_tx_bytes() {
+  return stats().Get(Stats::kTxBytes);
+}
 
 }  // namespace net::cli
 
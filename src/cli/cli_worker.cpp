@@ -3,6 +3,7 @@
 #include "cli/cli_worker.hpp"
 
 #include <absl/flags/flag.h>
+#include <algorithm>
 #include <absl/strings/str_cat.h>
 #include <absl/strings/str_join.h>
 #include "third_party/boringssl/src/include/openssl/crypto.h"
@@ -15,8 +16,13 @@
 #endif
 
 #include "cli/cli_server.hpp"
+#include "core/utils.hpp"
+#include "net/cipher.hpp"
+#include "net/route_rules.hpp"
+#include "net/stats.hpp"
 
 using namespace std::string_literals;
+using namespace std::string_view_literals;
 
 using namespace net::cli;
 
@@ -81,6 +87,7 @@ void Worker::Start(absl::AnyInvocable<void(asio::error_code)>&& callback) {
 #endif
 
     // overwrite cached entry
+    config_snapshot_ = config::SnapshotConfig();
     cached_server_host_ = absl::GetFlag(FLAGS_server_host);
     cached_server_sni_ = absl::GetFlag(FLAGS_server_sni);
     cached_server_port_ = absl::GetFlag(FLAGS_server_port);
@@ -135,6 +142,92 @@ void Worker::Stop(absl::AnyInvocable<void()>&& callback) {
   });
 }
 
+void Worker::Shutdown(absl::AnyInvocable<void()>&& callback) {
+  DCHECK(!stop_callback_);
+  stop_callback_ = std::move(callback);
+  /// shutdown in the worker thread
+  asio::post(io_context_, [this]() {
+    resolver_.Cancel();
+
+    if (private_->cli_server) {
+      LOG(INFO) << "worker: tcp server waits for the remaining connections";
+      private_->cli_server->shutdown();
+    }
+
+    work_guard_.reset();
+  });
+}
+
+void Worker::Reload(absl::AnyInvocable<void(asio::error_code)>&& callback) {
+  DCHECK(!reload_callback_);
+  reload_callback_ = std::move(callback);
+  reload_start_time_ = GetMonotonicTime();
+
+  /// reload in the worker thread
+  asio::post(io_context_, [this]() {
+    if (!private_->cli_server) {
+      on_reload_done(asio::error::not_connected);
+      return;
+    }
+    std::vector<std::string> changed = config::DiffConfig(config_snapshot_);
+    if (changed.empty()) {
+      LOG(INFO) << "worker: config unchanged";
+      on_reload_done({});
+      return;
+    }
+    if (config::ConfigChangesRequireRestart(changed)) {
+      LOG(INFO) << "worker: config changes require restart: " << absl::StrJoin(changed, ",");
+      on_reload_done(asio::error::operation_not_supported);
+      return;
+    }
+    LOG(INFO) << "worker: reloading config changes: " << absl::StrJoin(changed, ",");
+
+    // tls material is read from files
+    if (CIPHER_METHOD_IS_TLS(absl::GetFlag(FLAGS_method).method) && !config::ReadTLSConfigFile()) {
+      on_reload_done(asio::error::invalid_argument);
+      return;
+    }
+
+    bool server_changed = false;
+    for (std::string_view name : {"server_host"sv, "server_sni"sv, "server_port"sv, "doh_url"sv, "dot_host"sv}) {
+      server_changed |= std::find(changed.begin(), changed.end(), name) != changed.end();
+    }
+    cached_server_host_ = absl::GetFlag(FLAGS_server_host);
+    cached_server_sni_ = absl::GetFlag(FLAGS_server_sni);
+    cached_server_port_ = absl::GetFlag(FLAGS_server_port);
+    remote_server_sni_ = cached_server_sni_.empty() ? cached_server_host_ : cached_server_sni_;
+
+    if (!server_changed) {
+      apply_reload();
+      return;
+    }
+
+    // the resolver settings might be changed as well
+    int ret = resolver_.Init();
+    if (ret < 0) {
+      LOG(WARNING) << "worker: resolver::Init failed";
+      on_reload_done(asio::error::connection_refused);
+      return;
+    }
+
+    std::string host_name = cached_server_host_;
+    uint16_t port = cached_server_port_;
+    asio::error_code ec;
+    auto addr = asio::ip::make_address(host_name.c_str(), ec);
+    bool host_is_ip_address = !ec;
+    if (host_is_ip_address) {
+      asio::ip::tcp::endpoint endpoint(addr, port);
+      auto results = asio::ip::tcp::resolver::results_type::create(endpoint, host_name, std::to_string(port));
+      on_reload_resolve_remote(ec, results);
+      return;
+    }
+    resolver_.AsyncResolve(host_name, port,
+                           [this](const asio::error_code& ec, asio::ip::tcp::resolver::results_type results) {
+                             on_reload_resolve_remote(ec, results);
+                           });
+  });
+}
+
 size_t Worker::currentConnections() const {
   return private_->cli_server ? private_->cli_server->num_of_connections() : 0;
 }
@@ -274,6 +367,20 @@ void Worker::on_resolve_done(asio::error_code ec) {
     return;
   }
 
+  net::SelectCipherBackend(absl::GetFlag(FLAGS_method).method);
+  std::string rules_err;
+  if (!net::RouteRules::LoadGlobal(absl::GetFlag(FLAGS_route_rules), &rules_err)) {
+    LOG(WARNING) << "worker: failed to load route rules: " << rules_err;
+  }
+  std::string upstream_err;
+  if (!CliConnection::ConfigureUpstreams(io_context_, &upstream_err)) {
+    LOG(WARNING) << "worker: failed to configure upstream servers: " << upstream_err;
+    if (auto callback = std::move(start_callback_)) {
+      callback(asio::error::invalid_argument);
+    }
+    work_guard_.reset();
+    return;
+  }
   private_->cli_server =
       std::make_unique<CliServer>(io_context_, remote_server_ips_, remote_server_sni_, cached_server_port_);
 
@@ -298,3 +405,74 @@ void Worker::on_resolve_done(asio::error_code ec) {
     callback(ec);
   }
 }
+
+void Worker::on_reload_resolve_remote(asio::error_code ec, asio::ip::tcp::resolver::results_type results) {
+  resolver_.Reset();
+
+  if (ec) {
+    LOG(WARNING) << "worker: remote resolved host: " << cached_server_host_ << " failed due to: " << ec;
+    on_reload_done(ec);
+    return;
+  }
+
+  std::vector<std::string> server_ips, server_ips_v4, server_ips_v6;
+  for (auto result : results) {
+    if (result.endpoint().address().is_unspecified()) {
+      LOG(WARNING) << "worker: unspecified remote address: " << cached_server_host_;
+      on_reload_done(asio::error::connection_refused);
+      return;
+    }
+    server_ips.push_back(result.endpoint().address().to_string());
+    if (result.endpoint().address().is_v4()) {
+      server_ips_v4.push_back(result.endpoint().address().to_string());
+    } else {
+      server_ips_v6.push_back(result.endpoint().address().to_string());
+    }
+  }
+  remote_server_ips_ = absl::StrJoin(server_ips, ";");
+  remote_server_ips_v4_ = std::move(server_ips_v4);
+  remote_server_ips_v6_ = std::move(server_ips_v6);
+  LOG(INFO) << "worker: resolved server ips: " << remote_server_ips_;
+
+  // the server might be stopped during resolving
+  if (!private_->cli_server) {
+    on_reload_done(asio::error::not_connected);
+    return;
+  }
+  apply_reload();
+}
+
+void Worker::apply_reload() {
+  asio::error_code ec;
+  private_->cli_server->reload(remote_server_ips_, remote_server_sni_, cached_server_port_, ec);
+  if (ec) {
+    on_reload_done(ec);
+    return;
+  }
+  net::SelectCipherBackend(absl::GetFlag(FLAGS_method).method);
+  std::string rules_err;
+  if (!net::RouteRules::LoadGlobal(absl::GetFlag(FLAGS_route_rules), &rules_err)) {
+    LOG(WARNING) << "worker: keeping the route rules: " << rules_err;
+  }
+  std::string upstream_err;
+  if (!CliConnection::ConfigureUpstreams(io_context_, &upstream_err)) {
+    LOG(WARNING) << "worker: keeping the upstream servers: " << upstream_err;
+  }
+  on_reload_done({});
+}
+
+void Worker::on_reload_done(asio::error_code ec) {
+  uint64_t reload_time = GetMonotonicTime() - reload_start_time_;
+  if (ec) {
+    LOG(WARNING) << "worker: config reload failed due to: " << ec;
+  } else {
+    config_snapshot_ = config::SnapshotConfig();
+    net::process_stats().Add(net::Stats::kConfigReloads);
+    net::process_stats().RecordNanoseconds(net::Stats::kConfigReloadLatency, reload_time);
+    LOG(INFO) << "worker: config reloaded in " << reload_time / 1000 << " us";
+  }
+
+  if (auto callback = std::move(reload_callback_)) {
+    callback(ec);
+  }
+}
@@ -24,6 +24,17 @@ class Worker {
 
   void Start(absl::AnyInvocable<void(asio::error_code)>&& callback);
   void Stop(absl::AnyInvocable<void()>&& callback);
+  /// stop accepting and wait for the established connections to finish
+  ///
+  /// \param callback called in the worker thread once all connections are gone
+  void Shutdown(absl::AnyInvocable<void()>&& callback);
+
+  /// apply the config changed since Start in place, the listener and the
+  /// established connections are kept
+  ///
+  /// \param callback called in the worker thread, with operation_not_supported
+  ///        if the changes require Stop and Start (e.g. the local address)
+  void Reload(absl::AnyInvocable<void(asio::error_code)>&& callback);
 
   std::vector<std::string> GetRemoteIpsV4() const;
   std::vector<std::string> GetRemoteIpsV6() const;
@@ -42,6 +53,12 @@ class Worker {
 
   void on_resolve_done(asio::error_code ec);
 
+  void on_reload_resolve_remote(asio::error_code ec, asio::ip::tcp::resolver::results_type results);
+
+  void apply_reload();
+
+  void on_reload_done(asio::error_code ec);
+
   asio::io_context io_context_;
   /// stopping the io_context from running out of work
   std::unique_ptr<asio::executor_work_guard<asio::io_context::executor_type>> work_guard_;
@@ -52,6 +69,11 @@ class Worker {
 
   absl::AnyInvocable<void(asio::error_code)> start_callback_;
   absl::AnyInvocable<void()> stop_callback_;
+  absl::AnyInvocable<void(asio::error_code)> reload_callback_;
+  uint64_t reload_start_time_ = 0;
+
+  /// the config the tcp server is running with
+  config::ConfigSnapshot config_snapshot_;
 
   // cached entry
   std::string cached_server_host_;
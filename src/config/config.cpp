@@ -4,8 +4,11 @@
 #include "config/config.hpp"
 
 #include <absl/flags/flag.h>
+#include <absl/flags/reflection.h>
 #include <absl/flags/usage.h>
 #include <absl/strings/str_cat.h>
+#include <algorithm>
+#include <iostream>
 #include <sstream>
 
 #include "config/config_impl.hpp"
@@ -43,15 +46,27 @@ bool ReadConfig() {
 
   /* optional fields */
   config_impl->Read("server_sni", &FLAGS_server_sni);
+  config_impl->Read("upstream_servers", &FLAGS_upstream_servers);
+  config_impl->Read("crypto_backend", &FLAGS_crypto_backend);
 
   config_impl->Read("fast_open", &FLAGS_tcp_fastopen);
   config_impl->Read("fast_open_connect", &FLAGS_tcp_fastopen_connect);
 
   config_impl->Read("doh_url", &FLAGS_doh_url);
   config_impl->Read("dot_host", &FLAGS_dot_host);
+  config_impl->Read("route_rules", &FLAGS_route_rules);
   config_impl->Read("connect_timeout", &FLAGS_connect_timeout);
+  config_impl->Read("idle_timeout", &FLAGS_idle_timeout);
+  config_impl->Read("idle_trim_timeout", &FLAGS_idle_trim_timeout);
+  config_impl->Read("udp_timeout", &FLAGS_udp_timeout);
+  config_impl->Read("buffer_high_watermark", &FLAGS_buffer_high_watermark);
   config_impl->Read("tcp_nodelay", &FLAGS_tcp_nodelay);
   config_impl->Read("limit_rate", &FLAGS_limit_rate);
+  config_impl->Read("limit_rate_listener", &FLAGS_limit_rate_listener);
+  config_impl->Read("limit_rate_global", &FLAGS_limit_rate_global);
+  config_impl->Read("metrics_host", &FLAGS_metrics_host);
+  config_impl->Read("metrics_port", &FLAGS_metrics_port);
+  config_impl->Read("access_log", &FLAGS_access_log);
 
   config_impl->Read("tcp_keep_alive", &FLAGS_tcp_keep_alive);
   config_impl->Read("tcp_keep_alive_cnt", &FLAGS_tcp_keep_alive_cnt);
@@ -70,6 +85,9 @@ bool ReadConfig() {
   if (pType_IsServer()) {
     config_impl->Read("private_key_file", &FLAGS_private_key_file);
     config_impl->Read("private_key_password", &FLAGS_private_key_password, true);
+    config_impl->Read("sni_certificates", &FLAGS_sni_certificates);
+    config_impl->Read("replay_filter_capacity", &FLAGS_replay_filter_capacity);
+    config_impl->Read("replay_filter_fp_rate", &FLAGS_replay_filter_fp_rate);
   }
   if (pType_IsClient()) {
     config_impl->Read("insecure_mode", &FLAGS_insecure_mode);
@@ -93,6 +111,8 @@ bool ReadConfig() {
 
   /* correct options */
   absl::SetFlag(&FLAGS_connect_timeout, std::max(0, absl::GetFlag(FLAGS_connect_timeout)));
+  absl::SetFlag(&FLAGS_udp_timeout, std::max(1, absl::GetFlag(FLAGS_udp_timeout)));
+  absl::SetFlag(&FLAGS_buffer_high_watermark, std::max(64, absl::GetFlag(FLAGS_buffer_high_watermark)));
 
   absl::SetFlag(&FLAGS_tcp_keep_alive_cnt, std::max(0, absl::GetFlag(FLAGS_tcp_keep_alive_cnt)));
   absl::SetFlag(&FLAGS_tcp_keep_alive_idle_timeout, std::max(0, absl::GetFlag(FLAGS_tcp_keep_alive_idle_timeout)));
@@ -142,6 +162,7 @@ bool SaveConfig() {
   if (pType_IsServer()) {
     all_fields_written &= config_impl->Write("private_key_file", FLAGS_private_key_file);
     all_fields_written &= config_impl->Write("private_key_password", FLAGS_private_key_password);
+    all_fields_written &= config_impl->Write("sni_certificates", FLAGS_sni_certificates);
   }
   if (pType_IsClient()) {
     all_fields_written &= config_impl->Write("insecure_mode", FLAGS_insecure_mode);
@@ -158,6 +179,64 @@ bool SaveConfig() {
   return all_fields_written;
 }
 
+ConfigSnapshot SnapshotConfig() {
+  ConfigSnapshot snapshot;
+  for (const auto& [name, flag] : absl::GetAllFlags()) {
+    snapshot.emplace(std::string(name), flag->CurrentValue());
+  }
+  return snapshot;
+}
+
+std::vector<std::string> DiffConfig(const ConfigSnapshot& snapshot) {
+  std::vector<std::string> changed;
+  for (const auto& [name, flag] : absl::GetAllFlags()) {
+    auto it = snapshot.find(name);
+    if (it == snapshot.end() || it->second != flag->CurrentValue()) {
+      changed.emplace_back(name);
+    }
+  }
+  std::sort(changed.begin(), changed.end());
+  return changed;
+}
+
+void RestoreConfig(const ConfigSnapshot& snapshot) {
+  for (const auto& [name, flag] : absl::GetAllFlags()) {
+    auto it = snapshot.find(name);
+    if (it != snapshot.end() && it->second != flag->CurrentValue()) {
+      std::string error;
+      if (!flag->ParseFrom(it->second, &error)) {
+        std::cerr << "Failed to restore flag " << name << ": " << error << std::endl;
+      }
+    }
+  }
+}
+
+bool ConfigChangesRequireRestart(const std::vector<std::string>& changed) {
+  // the listening sockets are bound to these
+  static constexpr std::string_view kClientListenFlags[] = {"local_host", "local_port", "reuse_port", "metrics_host",
+                                                            "metrics_port"};
+  static constexpr std::string_view kServerListenFlags[] = {"server_host", "server_port", "reuse_port", "metrics_host",
+                                                            "metrics_port"};
+  // the replay filter is sized once and shared by all connections, rebuilding
+  // it would also forget the salts seen so far
+  static constexpr std::string_view kServerFilterFlags[] = {"replay_filter_capacity", "replay_filter_fp_rate"};
+  for (const std::string& name : changed) {
+    if (pType_IsClient() && std::find(std::begin(kClientListenFlags), std::end(kClientListenFlags), name) !=
+                                std::end(kClientListenFlags)) {
+      return true;
+    }
+    if (pType_IsServer() && std::find(std::begin(kServerListenFlags), std::end(kServerListenFlags), name) !=
+                                std::end(kServerListenFlags)) {
+      return true;
+    }
+    if (pType_IsServer() && std::find(std::begin(kServerFilterFlags), std::end(kServerFilterFlags), name) !=
+                                std::end(kServerFilterFlags)) {
+      return true;
+    }
+  }
+  return false;
+}
+
 std::string ValidateConfig() {
   std::string err;
   std::ostringstream err_msg;
@@ -168,6 +247,7 @@ std::string ValidateConfig() {
   auto username = absl::GetFlag(FLAGS_username);
   auto password = absl::GetFlag(FLAGS_password);
   auto method = absl::GetFlag(FLAGS_method);
+  auto crypto_backend = absl::GetFlag(FLAGS_crypto_backend);
   auto local_host = absl::GetFlag(FLAGS_local_host);
   // auto local_port = absl::GetFlag(FLAGS_local_port);
   auto doh_url = absl::GetFlag(FLAGS_doh_url);
@@ -193,6 +273,10 @@ std::string ValidateConfig() {
     err_msg << ",Invalid Cipher: " << to_cipher_method_str(method);
   }
 
+  if (to_crypter_backend(crypto_backend) == CRYPTER_BACKEND_INVALID) {
+    err_msg << ",Invalid Crypto Backend: " << crypto_backend;
+  }
+
   if (method == CRYPTO_SOCKS4 || method == CRYPTO_SOCKS4A) {
     if (!username.empty() || !password.empty()) {
       err_msg << ",SOCKS4/SOCKSA doesn't support username and passsword";
@@ -462,7 +546,10 @@ void SetClientUsageMessage(std::string_view exec_path) {
   --username <username> Server user
   --password <pasword> Server password
   --method <method> Specify encrypt of method to use
+  --crypto_backend <backend> Specify the library implementing the cipher, auto to pick the fastest one at startup
   --limit_rate Limits the rate of response transmission to a client. Uint can be (none), k, m.
+  --limit_rate_listener Limits the rate of all connections per listen address. Uint can be (none), k, m.
+  --limit_rate_global Limits the rate of all connections. Uint can be (none), k, m.
   --padding_support Enable padding support
   --use_ca_bundle_crt Use builtin ca-bundle.crt instead of system CA store
   --cacert <file> Tells where to use the specified certificate file to verify the peer
@@ -485,7 +572,10 @@ void SetServerUsageMessage(std::string_view exec_path) {
   --username <username> Server user
   --password <pasword> Server password
   --method <method> Specify encrypt of method to use
+  --crypto_backend <backend> Specify the library implementing the cipher, auto to pick the fastest one at startup
   --limit_rate Limits the rate of response transmission to a client. Uint can be (none), k, m.
+  --limit_rate_listener Limits the rate of all connections per listen address. Uint can be (none), k, m.
+  --limit_rate_global Limits the rate of all connections. Uint can be (none), k, m.
   --padding_support Enable padding support
   --use_ca_bundle_crt Use builtin ca-bundle.crt instead of system CA store
   --cacert <file> Tells where to use the specified certificate file to verify the peer
@@ -493,6 +583,9 @@ void SetServerUsageMessage(std::string_view exec_path) {
   --certificate_chain_file <file> Use custom certificate chain file to verify server's certificate
   --private_key_file <file> Use custom private key file to secure connection between server and client
   --private_key_password <password> Use custom private key password to decrypt server's encrypted private key
+  --sni_certificates <list> Additional certificate and private key pairs selected by server name
+  --replay_filter_capacity <number> Reject replayed salts among the given number of last connections, 0 to disable
+  --replay_filter_fp_rate <number> False positive rate of the replay filter as one in given lookups
   --enable_post_quantum_kyber Enables post-quantum key-agreements in TLS 1.3 connections. The use_ml_kem flag controls whether ML-KEM or Kyber is used.
   --use_ml_kem Use ML-KEM in TLS 1.3. Causes TLS 1.3 connections to use the ML-KEM standard instead of the Kyber draft standard for post-quantum key-agreement. The enable_post_quantum_kyber flag must be enabled for this to have an effect.
 )"));
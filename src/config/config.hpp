@@ -6,6 +6,9 @@
 
 #include <string>
 #include <string_view>
+#include <vector>
+
+#include <absl/container/flat_hash_map.h>
 
 #include "config/config_core.hpp"
 #include "config/config_network.hpp"
@@ -22,6 +25,22 @@ void ReadConfigFileAndArguments(int argc, const char** argv);
 
 std::string ValidateConfig();
 
+/// the current values of all flags (unparsed), keyed by flag name
+using ConfigSnapshot = absl::flat_hash_map<std::string, std::string>;
+
+/// take a copy of the running config
+ConfigSnapshot SnapshotConfig();
+
+/// the names of the flags changed since the snapshot, sorted
+std::vector<std::string> DiffConfig(const ConfigSnapshot& snapshot);
+
+/// roll the flags back to the snapshot, e.g. after reading an invalid config
+void RestoreConfig(const ConfigSnapshot& snapshot);
+
+/// whether the changed flags can't be applied without listening again,
+/// e.g. the local address
+bool ConfigChangesRequireRestart(const std::vector<std::string>& changed);
+
 std::string ReadConfigFromArgument(std::string_view server_host,
                                    std::string_view server_sni,
                                    std::string_view server_port,
@@ -138,6 +138,11 @@ std::string AbslUnparseFlag(const RateFlag& flag) {
 ABSL_FLAG(std::string, server_host, "http2.github.io", "Remote server on given host");
 ABSL_FLAG(std::string, server_sni, "", "Remote server on given sni");
 ABSL_FLAG(PortFlag, server_port, PortFlag(443), "Remote server on given port");
+ABSL_FLAG(std::string,
+          upstream_servers,
+          "",
+          "More remote servers to balance the connections across, as comma separated [username:password@]host[:port] "
+          "(Client Only)");
 ABSL_FLAG(std::string, local_host, "127.0.0.1", "Local proxy server on given host (Client Only)");
 ABSL_FLAG(PortFlag, local_port, PortFlag(1080), "Local proxy server on given port (Client Only)");
 ABSL_FLAG(std::string, username, "username", "Server user");
@@ -145,9 +150,26 @@ ABSL_FLAG(std::string, password, "password", "Server password");
 static const std::string kCipherMethodHelpMessage =
     absl::StrCat("Specify encrypt of method to use, one of ", kCipherMethodsStr);
 ABSL_FLAG(CipherMethodFlag, method, CipherMethodFlag(CRYPTO_DEFAULT), kCipherMethodHelpMessage);
+static const std::string kCrypterBackendHelpMessage =
+    absl::StrCat("Specify the library implementing the cipher, one of ", kCrypterBackendsStr,
+                 " (the fastest one measured at startup)");
+ABSL_FLAG(std::string, crypto_backend, "auto", kCrypterBackendHelpMessage);
 
 ABSL_FLAG(uint32_t, parallel_max, 512, "Maximum concurrency for parallel connections");
 ABSL_FLAG(RateFlag, limit_rate, RateFlag(0), "Limit transfer speed to RATE");
+ABSL_FLAG(RateFlag,
+          limit_rate_listener,
+          RateFlag(0),
+          "Limit transfer speed of all connections per listen address to RATE");
+ABSL_FLAG(RateFlag, limit_rate_global, RateFlag(0), "Limit transfer speed of all connections to RATE");
+ABSL_FLAG(uint32_t,
+          replay_filter_capacity,
+          1000000,
+          "Reject replayed salts among the given number of last connections (Server Only), 0 to disable");
+ABSL_FLAG(uint32_t,
+          replay_filter_fp_rate,
+          1000000,
+          "False positive rate of the replay filter as one in given lookups (Server Only)");
 
 #if BUILDFLAG(IS_MAC)
 ABSL_FLAG(bool, ui_display_realtime_status, true, "Display Realtime Status in Status Bar (UI)");
@@ -16,14 +16,20 @@
 ABSL_DECLARE_FLAG(std::string, server_host);
 ABSL_DECLARE_FLAG(std::string, server_sni);
 ABSL_DECLARE_FLAG(PortFlag, server_port);
+ABSL_DECLARE_FLAG(std::string, upstream_servers);
 ABSL_DECLARE_FLAG(std::string, username);
 ABSL_DECLARE_FLAG(std::string, password);
 ABSL_DECLARE_FLAG(CipherMethodFlag, method);
+ABSL_DECLARE_FLAG(std::string, crypto_backend);
 ABSL_DECLARE_FLAG(std::string, local_host);
 ABSL_DECLARE_FLAG(PortFlag, local_port);
 
 ABSL_DECLARE_FLAG(uint32_t, parallel_max);
-ABSL_DECLARE_FLAG(RateFlag, limit_rate);  // bytes per second
+ABSL_DECLARE_FLAG(RateFlag, limit_rate);           // bytes per second
+ABSL_DECLARE_FLAG(RateFlag, limit_rate_listener);  // bytes per second
+ABSL_DECLARE_FLAG(RateFlag, limit_rate_global);    // bytes per second
+ABSL_DECLARE_FLAG(uint32_t, replay_filter_capacity);
+ABSL_DECLARE_FLAG(uint32_t, replay_filter_fp_rate);  // one in given lookups
 
 bool AbslParseFlag(absl::string_view text, PortFlag* flag, std::string* err);
 
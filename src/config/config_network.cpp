@@ -11,6 +11,16 @@ ABSL_FLAG(bool, reuse_port, true, "Reuse the listening port");
 ABSL_FLAG(bool, tcp_fastopen, false, "TCP fastopen");
 ABSL_FLAG(bool, tcp_fastopen_connect, false, "TCP fastopen connect");
 ABSL_FLAG(int32_t, connect_timeout, 0, "Connect timeout (in seconds)");
+ABSL_FLAG(int32_t, idle_timeout, 0, "Close connections without traffic in given timeout (in seconds), 0 to disable");
+ABSL_FLAG(int32_t,
+          idle_trim_timeout,
+          30,
+          "Release buffers of connections without traffic in given timeout (in seconds), 0 to disable");
+ABSL_FLAG(int32_t, udp_timeout, 300, "Forget udp peers without outgoing datagrams in given timeout (in seconds)");
+ABSL_FLAG(int32_t,
+          buffer_high_watermark,
+          4096,
+          "Pause reading from one side once the data queued for the other side reaches the size (in KiB)");
 
 ABSL_FLAG(bool, tcp_nodelay, true, "TCP_NODELAY option");
 
@@ -26,3 +36,13 @@ ABSL_FLAG(bool, redir_mode, false, "Enable TCP Redir mode support (linux only)")
 
 ABSL_FLAG(std::string, doh_url, "", "Resolve host names over DoH");
 ABSL_FLAG(std::string, dot_host, "", "Resolve host names over DoT");
+
+ABSL_FLAG(std::string,
+          route_rules,
+          "",
+          "Route the requests by the rules file (proxy, direct or reject by domain suffix or address prefix)");
+
+ABSL_FLAG(std::string, metrics_host, "127.0.0.1", "Serve statistics (prometheus text format) on given host");
+ABSL_FLAG(PortFlag, metrics_port, PortFlag(0), "Serve statistics (prometheus text format) on given port, 0 to disable");
+
+ABSL_FLAG(bool, access_log, false, "Log a record of each connection once it is closed");
@@ -7,6 +7,8 @@
 #include <absl/flags/declare.h>
 #include <string>
 
+#include "config/config_export.hpp"
+
 ABSL_DECLARE_FLAG(bool, ipv6_mode);
 
 ABSL_DECLARE_FLAG(bool, reuse_port);
@@ -16,6 +18,10 @@ ABSL_DECLARE_FLAG(bool, tcp_fastopen_connect);
 // and proxy_write_timeout because it is a tcp tunnel.
 // TODO rename connect_timeout to proxy_connect_timeout
 ABSL_DECLARE_FLAG(int32_t, connect_timeout);
+ABSL_DECLARE_FLAG(int32_t, idle_timeout);
+ABSL_DECLARE_FLAG(int32_t, idle_trim_timeout);
+ABSL_DECLARE_FLAG(int32_t, udp_timeout);
+ABSL_DECLARE_FLAG(int32_t, buffer_high_watermark);
 ABSL_DECLARE_FLAG(bool, tcp_nodelay);
 
 ABSL_DECLARE_FLAG(bool, tcp_keep_alive);
@@ -27,4 +33,11 @@ ABSL_DECLARE_FLAG(bool, redir_mode);
 
 ABSL_DECLARE_FLAG(std::string, doh_url);
 ABSL_DECLARE_FLAG(std::string, dot_host);
+
+ABSL_DECLARE_FLAG(std::string, route_rules);
+
+ABSL_DECLARE_FLAG(std::string, metrics_host);
+ABSL_DECLARE_FLAG(PortFlag, metrics_port);
+
+ABSL_DECLARE_FLAG(bool, access_log);
 #endif  // H_CONFIG_CONFIG_NETWORK
@@ -10,7 +10,9 @@
 #include <base/rand_util.h>
 #include <gmock/gmock.h>
 #include <cstdlib>
+#include "config/config.hpp"
 #include "config/config_impl.hpp"
+#include "config/config_tls.hpp"
 #include "core/utils_fs.hpp"
 
 using namespace yass;
@@ -259,3 +261,35 @@ TEST_F(ConfigTest, RWString) {
   EXPECT_FALSE(config_impl->HasKey<std::string>(test_key));
   ASSERT_TRUE(config_impl->Close());
 }
+
+TEST(ConfigTlsTest, ParseSniCertificates) {
+  std::vector<std::tuple<std::string, std::string, std::string>> entries;
+  ASSERT_TRUE(config::ParseSniCertificates("", &entries));
+  EXPECT_TRUE(entries.empty());
+
+  ASSERT_TRUE(config::ParseSniCertificates("a.example.com=a.crt;a.key, *.example.org=/etc/b.crt;/etc/b.key", &entries));
+  ASSERT_EQ(entries.size(), 2u);
+  EXPECT_EQ(entries[0], std::make_tuple("a.example.com", "a.crt", "a.key"));
+  EXPECT_EQ(entries[1], std::make_tuple("*.example.org", "/etc/b.crt", "/etc/b.key"));
+
+  EXPECT_FALSE(config::ParseSniCertificates("a.example.com=a.crt", &entries));
+  EXPECT_FALSE(config::ParseSniCertificates("=a.crt;a.key", &entries));
+  EXPECT_FALSE(config::ParseSniCertificates("a.example.com", &entries));
+}
+
+TEST_F(ConfigTest, DiffAndRestoreConfig) {
+  config::ConfigSnapshot snapshot = config::SnapshotConfig();
+  EXPECT_TRUE(config::DiffConfig(snapshot).empty());
+
+  std::string test_string = absl::GetFlag(FLAGS_test_string);
+  uint32_t test_unsigned_val = absl::GetFlag(FLAGS_test_unsigned_val);
+  absl::SetFlag(&FLAGS_test_string, test_string + "changed");
+  absl::SetFlag(&FLAGS_test_unsigned_val, test_unsigned_val + 1);
+  EXPECT_THAT(config::DiffConfig(snapshot), ::testing::ElementsAre("test_string", "test_unsigned_val"));
+  EXPECT_FALSE(config::ConfigChangesRequireRestart(config::DiffConfig(snapshot)));
+
+  config::RestoreConfig(snapshot);
+  EXPECT_TRUE(config::DiffConfig(snapshot).empty());
+  EXPECT_EQ(absl::GetFlag(FLAGS_test_string), test_string);
+  EXPECT_EQ(absl::GetFlag(FLAGS_test_unsigned_val), test_unsigned_val);
+}
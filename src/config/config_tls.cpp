@@ -4,11 +4,14 @@
 #include "config/config.hpp"
 
 #include <absl/flags/flag.h>
+#include <absl/strings/str_split.h>
+#include <absl/strings/strip.h>
 #include <iostream>
 #include "core/utils.hpp"
 
 std::string g_certificate_chain_content;
 std::string g_private_key_content;
+std::vector<SniCertificate> g_sni_certificates;
 
 ABSL_FLAG(std::string, certificate_chain_file, "", "Use custom certificate chain file to verify server's certificate");
 ABSL_FLAG(std::string,
@@ -19,6 +22,11 @@ ABSL_FLAG(std::string,
           private_key_password,
           "",
           "Use custom private key password to decrypt server's encrypted private key");
+ABSL_FLAG(std::string,
+          sni_certificates,
+          "",
+          "Additional certificate and private key pairs selected by server name (Server Only), "
+          "in form of \"name=cert_file;key_file,*.example.com=cert_file2;key_file2\"");
 ABSL_FLAG(bool,
           insecure_mode,
           false,
@@ -47,6 +55,22 @@ ABSL_FLAG(bool,
           "for this to have an effect.");
 
 namespace config {
+bool ParseSniCertificates(std::string_view value,
+                          std::vector<std::tuple<std::string, std::string, std::string>>* entries) {
+  entries->clear();
+  for (std::string_view entry : absl::StrSplit(value, ',', absl::SkipWhitespace())) {
+    entry = absl::StripAsciiWhitespace(entry);
+    std::pair<std::string_view, std::string_view> name_and_files = absl::StrSplit(entry, absl::MaxSplits('=', 1));
+    std::pair<std::string_view, std::string_view> files =
+        absl::StrSplit(name_and_files.second, absl::MaxSplits(';', 1));
+    if (name_and_files.first.empty() || files.first.empty() || files.second.empty()) {
+      return false;
+    }
+    entries->emplace_back(name_and_files.first, files.first, files.second);
+  }
+  return true;
+}
+
 bool ReadTLSConfigFile() {
   do {
     static constexpr const size_t kBufferSize = 256 * 1024;
@@ -85,6 +109,31 @@ bool ReadTLSConfigFile() {
       g_certificate_chain_content = certificate_chain;
       std::cerr << "Using certificate chain file: " << certificate_chain_path << std::endl;
     }
+    if (is_server) {
+      std::vector<std::tuple<std::string, std::string, std::string>> entries;
+      if (!ParseSniCertificates(absl::GetFlag(FLAGS_sni_certificates), &entries)) {
+        std::cerr << "invalid sni certificates: " << absl::GetFlag(FLAGS_sni_certificates) << std::endl;
+        return false;
+      }
+      g_sni_certificates.clear();
+      for (const auto& [server_name, sni_certificate_path, sni_private_key_path] : entries) {
+        SniCertificate sni_certificate;
+        sni_certificate.server_name = server_name;
+        for (auto [path, content] : {std::make_pair(&sni_certificate_path, &sni_certificate.certificate_chain_content),
+                                     std::make_pair(&sni_private_key_path, &sni_certificate.private_key_content)}) {
+          content->resize(kBufferSize);
+          ret = ReadFileToBuffer(*path, as_writable_bytes(make_span(*content)));
+          if (ret <= 0) {
+            std::cerr << "sni file " << *path << " failed to read" << std::endl;
+            return false;
+          }
+          content->resize(ret);
+        }
+        std::cerr << "Using certificate chain file: " << sni_certificate_path << " for server name: " << server_name
+                  << std::endl;
+        g_sni_certificates.push_back(std::move(sni_certificate));
+      }
+    }
   } while (false);
   return true;
 }
@@ -6,12 +6,25 @@
 
 #include <absl/flags/declare.h>
 #include <string>
+#include <string_view>
+#include <tuple>
+#include <vector>
 
 extern std::string g_certificate_chain_content;
 extern std::string g_private_key_content;
+
+/// an additional certificate/key pair selected by the client's server name
+struct SniCertificate {
+  /// the server name to match, "*.example.com" matches any direct subdomain
+  std::string server_name;
+  std::string certificate_chain_content;
+  std::string private_key_content;
+};
+extern std::vector<SniCertificate> g_sni_certificates;
 ABSL_DECLARE_FLAG(std::string, certificate_chain_file);
 ABSL_DECLARE_FLAG(std::string, private_key_file);
 ABSL_DECLARE_FLAG(std::string, private_key_password);
+ABSL_DECLARE_FLAG(std::string, sni_certificates);
 ABSL_DECLARE_FLAG(bool, insecure_mode);
 ABSL_DECLARE_FLAG(std::string, cacert);
 ABSL_DECLARE_FLAG(std::string, capath);
@@ -21,6 +34,14 @@ ABSL_DECLARE_FLAG(bool, use_ml_kem);
 
 namespace config {
 bool ReadTLSConfigFile();
+
+/// Parse the sni certificates list
+///
+/// \param value the list in form of "name=cert_file;key_file,name2=cert_file2;key_file2"
+/// \param entries the parsed (server name, certificate chain file, private key file) tuples
+/// \return false if any entry is malformed
+bool ParseSniCertificates(std::string_view value,
+                          std::vector<std::tuple<std::string, std::string, std::string>>* entries);
 }  // namespace config
 
 #endif  // H_CONFIG_CONFIG_TLS
@@ -0,0 +1,145 @@
+// SPDX-License-Identifier: GPL-2.0
+/* Copyright (c) 2024 Chilledheart  */
+
+#include "crypto/aes_stream_evp.hpp"
+
+#ifdef HAVE_MBEDTLS
+
+#include <algorithm>
+#include <cstring>
+
+#include "core/logging.hpp"
+
+namespace crypto {
+
+namespace {
+
+/// the blocks of the CFB key stream generated at a time
+constexpr size_t kBatchBlocks = 64;
+
+const EVP_CIPHER* GetEcbCipher(size_t key_len) {
+  switch (key_len) {
+    case 16:
+      return EVP_aes_128_ecb();
+    case 24:
+      return EVP_aes_192_ecb();
+    case 32:
+      return EVP_aes_256_ecb();
+    default:
+      return nullptr;
+  }
+}
+
+}  // namespace
+
+// static
+bool AesStreamEvp::IsSupported(cipher_method method) {
+  return GetKeySize(method) != 0;
+}
+
+// static
+size_t AesStreamEvp::GetKeySize(cipher_method method) {
+  switch (method) {
+    case CRYPTO_AES_128_CFB:
+    case CRYPTO_AES_128_CTR:
+      return 16;
+    case CRYPTO_AES_192_CFB:
+    case CRYPTO_AES_192_CTR:
+      return 24;
+    case CRYPTO_AES_256_CFB:
+    case CRYPTO_AES_256_CTR:
+      return 32;
+    default:
+      return 0;
+  }
+}
+
+AesStreamEvp::AesStreamEvp(cipher_method method, bool enc)
+    : ctr_(method == CRYPTO_AES_128_CTR || method == CRYPTO_AES_192_CTR || method == CRYPTO_AES_256_CTR),
+      enc_(enc) {
+  DCHECK(IsSupported(method)) << "Unsupported cipher: " << to_cipher_method_str(method);
+  memset(&key_, 0, sizeof(key_));
+  memset(ivec_, 0, sizeof(ivec_));
+  memset(ecount_, 0, sizeof(ecount_));
+}
+
+AesStreamEvp::~AesStreamEvp() = default;
+
+bool AesStreamEvp::Init(const uint8_t* key, size_t key_len, const uint8_t* iv, size_t iv_len) {
+  if (iv_len != AES_BLOCK_SIZE) {
+    return false;
+  }
+  // both of the modes use the block encryption only
+  if (AES_set_encrypt_key(key, key_len * 8, &key_) != 0) {
+    return false;
+  }
+  if (!ctr_ && !enc_) {
+    const EVP_CIPHER* cipher = GetEcbCipher(key_len);
+    if (cipher == nullptr || !EVP_EncryptInit_ex(ecb_.get(), cipher, nullptr, key, nullptr) ||
+        !EVP_CIPHER_CTX_set_padding(ecb_.get(), 0)) {
+      return false;
+    }
+  }
+  memcpy(ivec_, iv, AES_BLOCK_SIZE);
+  memset(ecount_, 0, sizeof(ecount_));
+  num_ = 0;
+  return true;
+}
+
+void AesStreamEvp::Update(const uint8_t* in, size_t len, uint8_t* out) {
+  if (ctr_) {
+    AES_ctr128_encrypt(in, out, len, &key_, ivec_, ecount_, &num_);
+    return;
+  }
+  if (enc_) {
+    int num = num_;
+    AES_cfb128_encrypt(in, out, len, &key_, ivec_, &num, AES_ENCRYPT);
+    num_ = num;
+    return;
+  }
+  DecryptCfb(in, len, out);
+}
+
+void AesStreamEvp::DecryptCfb(const uint8_t* in, size_t len, uint8_t* out) {
+  // the rest of the key stream block, the feedback takes the ciphertext
+  while (num_ && len) {
+    uint8_t c = *in++;
+    *out++ = ivec_[num_] ^ c;
+    ivec_[num_] = c;
+    num_ = (num_ + 1) % AES_BLOCK_SIZE;
+    --len;
+  }
+
+  // the key stream of the full blocks is the encrypted feedback followed by
+  // the encrypted ciphertext blocks except the last one
+  uint8_t blocks[kBatchBlocks * AES_BLOCK_SIZE];
+  while (len >= AES_BLOCK_SIZE) {
+    size_t n = std::min(len / AES_BLOCK_SIZE, kBatchBlocks) * AES_BLOCK_SIZE;
+    memcpy(blocks, ivec_, AES_BLOCK_SIZE);
+    memcpy(blocks + AES_BLOCK_SIZE, in, n - AES_BLOCK_SIZE);
+    memcpy(ivec_, in + n - AES_BLOCK_SIZE, AES_BLOCK_SIZE);
+    int outl = 0;
+    bool ok = EVP_EncryptUpdate(ecb_.get(), blocks, &outl, blocks, static_cast<int>(n));
+    DCHECK(ok && static_cast<size_t>(outl) == n);
+    for (size_t i = 0; i < n; ++i) {
+      out[i] = in[i] ^ blocks[i];
+    }
+    in += n;
+    out += n;
+    len -= n;
+  }
+
+  // the partial block
+  if (len) {
+    AES_encrypt(ivec_, ivec_, &key_);
+    while (len--) {
+      uint8_t c = *in++;
+      *out++ = ivec_[num_] ^ c;
+      ivec_[num_++] = c;
+    }
+  }
+}
+
+}  // namespace crypto
+
+#endif  // HAVE_MBEDTLS
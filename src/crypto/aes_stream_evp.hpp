@@ -0,0 +1,69 @@
+// SPDX-License-Identifier: GPL-2.0
+/* Copyright (c) 2024 Chilledheart  */
+
+#ifndef H_CRYPTO_AES_STREAM_EVP
+#define H_CRYPTO_AES_STREAM_EVP
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "crypto/crypter_export.hpp"
+
+// the stream methods are defined along with mbedtls (see CIPHER_METHOD_MAP_MBEDTLS)
+#ifdef HAVE_MBEDTLS
+
+#include "third_party/boringssl/src/include/openssl/aes.h"
+#include "third_party/boringssl/src/include/openssl/cipher.h"
+
+namespace crypto {
+
+/// AES in CFB128 or CTR mode with the block functions of BoringSSL, which
+/// use AES-NI or the ARMv8 crypto extensions when available.
+///
+/// Like mbedtls_cipher_update, the state (the feedback or the counter and the
+/// offset into the key stream block) is kept between the calls, so the
+/// packets of a connection form one continuous stream.
+///
+/// The CTR key stream is generated several blocks at a time. CFB encryption
+/// is serial by nature, but CFB decryption only needs the ciphertext to
+/// generate the key stream, so it is generated in batches too.
+class AesStreamEvp {
+ public:
+  /// whether the method is AES in CFB128 or CTR mode
+  static bool IsSupported(cipher_method method);
+
+  /// the key size (in bytes) of the method
+  static size_t GetKeySize(cipher_method method);
+
+  AesStreamEvp(cipher_method method, bool enc);
+  ~AesStreamEvp();
+
+  /// set the key and the initial vector (16 bytes), which resets the stream
+  bool Init(const uint8_t* key, size_t key_len, const uint8_t* iv, size_t iv_len);
+
+  /// encrypt or decrypt the bytes, |in| and |out| may be the same buffer
+  void Update(const uint8_t* in, size_t len, uint8_t* out);
+
+ private:
+  void DecryptCfb(const uint8_t* in, size_t len, uint8_t* out);
+
+  const bool ctr_;
+  const bool enc_;
+
+  AES_KEY key_;
+  /// the counter (CTR) or the feedback (CFB) block
+  uint8_t ivec_[AES_BLOCK_SIZE];
+  /// the key stream block (CTR)
+  uint8_t ecount_[AES_BLOCK_SIZE];
+  /// the offset into the key stream block
+  unsigned int num_ = 0;
+
+  /// used to generate the CFB key stream in batches
+  bssl::ScopedEVP_CIPHER_CTX ecb_;
+};
+
+}  // namespace crypto
+
+#endif  // HAVE_MBEDTLS
+
+#endif  // H_CRYPTO_AES_STREAM_EVP
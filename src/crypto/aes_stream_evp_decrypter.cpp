@@ -0,0 +1,45 @@
+// SPDX-License-Identifier: GPL-2.0
+/* Copyright (c) 2024 Chilledheart  */
+#include "crypto/aes_stream_evp_decrypter.hpp"
+
+#include "core/logging.hpp"
+
+#ifdef HAVE_MBEDTLS
+
+namespace crypto {
+
+AesStreamEvpDecrypter::AesStreamEvpDecrypter(cipher_method method)
+    : AeadBaseDecrypter(AesStreamEvp::GetKeySize(method), 0, AES_BLOCK_SIZE), method_(method), stream_(method, false) {}
+
+AesStreamEvpDecrypter::~AesStreamEvpDecrypter() = default;
+
+bool AesStreamEvpDecrypter::SetKey(const char* key, size_t key_len) {
+  if (!AeadBaseDecrypter::SetKey(key, key_len)) {
+    return false;
+  }
+  return stream_.Init(key_, key_size_, iv_, nonce_size_);
+}
+
+bool AesStreamEvpDecrypter::DecryptPacket(uint64_t packet_number,
+                                          const char* associated_data,
+                                          size_t associated_data_len,
+                                          const char* ciphertext,
+                                          size_t ciphertext_len,
+                                          char* output,
+                                          size_t* output_length,
+                                          size_t max_output_length) {
+  if (have_preliminary_key_) {
+    LOG(ERROR) << "Unable to decrypt while key diversification is pending";
+    return false;
+  }
+  if (max_output_length < ciphertext_len) {
+    return false;
+  }
+  stream_.Update(reinterpret_cast<const uint8_t*>(ciphertext), ciphertext_len, reinterpret_cast<uint8_t*>(output));
+  *output_length = ciphertext_len;
+  return true;
+}
+
+}  // namespace crypto
+
+#endif  // HAVE_MBEDTLS
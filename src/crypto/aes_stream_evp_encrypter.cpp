@@ -0,0 +1,39 @@
+// SPDX-License-Identifier: GPL-2.0
+/* Copyright (c) 2024 Chilledheart  */
+#include "crypto/aes_stream_evp_encrypter.hpp"
+
+#ifdef HAVE_MBEDTLS
+
+namespace crypto {
+
+AesStreamEvpEncrypter::AesStreamEvpEncrypter(cipher_method method)
+    : AeadBaseEncrypter(AesStreamEvp::GetKeySize(method), 0, AES_BLOCK_SIZE), method_(method), stream_(method, true) {}
+
+AesStreamEvpEncrypter::~AesStreamEvpEncrypter() = default;
+
+bool AesStreamEvpEncrypter::SetKey(const char* key, size_t key_len) {
+  if (!AeadBaseEncrypter::SetKey(key, key_len)) {
+    return false;
+  }
+  return stream_.Init(key_, key_size_, iv_, nonce_size_);
+}
+
+bool AesStreamEvpEncrypter::EncryptPacket(uint64_t packet_number,
+                                          const char* associated_data,
+                                          size_t associated_data_len,
+                                          const char* plaintext,
+                                          size_t plaintext_len,
+                                          char* output,
+                                          size_t* output_length,
+                                          size_t max_output_length) {
+  if (max_output_length < plaintext_len) {
+    return false;
+  }
+  stream_.Update(reinterpret_cast<const uint8_t*>(plaintext), plaintext_len, reinterpret_cast<uint8_t*>(output));
+  *output_length = plaintext_len;
+  return true;
+}
+
+}  // namespace crypto
+
+#endif  // HAVE_MBEDTLS
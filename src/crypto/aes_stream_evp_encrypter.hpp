@@ -0,0 +1,44 @@
+// SPDX-License-Identifier: GPL-2.0
+/* Copyright (c) 2024 Chilledheart  */
+
+#ifndef H_CRYPTO_AES_STREAM_EVP_ENCRYPTER
+#define H_CRYPTO_AES_STREAM_EVP_ENCRYPTER
+
+#include "crypto/aead_base_encrypter.hpp"
+#include "crypto/aes_stream_evp.hpp"
+#include "crypto/crypter_export.hpp"
+
+#ifdef HAVE_MBEDTLS
+
+namespace crypto {
+
+/// the stream methods of AES implemented by BoringSSL, the same wire format
+/// as AeadMbedtlsEncrypter
+class AesStreamEvpEncrypter : public AeadBaseEncrypter {
+ public:
+  explicit AesStreamEvpEncrypter(cipher_method method);
+  ~AesStreamEvpEncrypter() override;
+
+  uint32_t cipher_id() const override { return method_; }
+
+  bool SetKey(const char* key, size_t key_len) override;
+
+  bool EncryptPacket(uint64_t packet_number,
+                     const char* associated_data,
+                     size_t associated_data_len,
+                     const char* plaintext,
+                     size_t plaintext_len,
+                     char* output,
+                     size_t* output_length,
+                     size_t max_output_length) override;
+
+ private:
+  cipher_method method_;
+  AesStreamEvp stream_;
+};
+
+}  // namespace crypto
+
+#endif  // HAVE_MBEDTLS
+
+#endif  // H_CRYPTO_AES_STREAM_EVP_ENCRYPTER
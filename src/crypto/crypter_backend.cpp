@@ -0,0 +1,156 @@
+// SPDX-License-Identifier: GPL-2.0
+/* Copyright (c) 2024 Chilledheart  */
+
+#include "crypto/crypter_backend.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <memory>
+
+#include "core/logging.hpp"
+#include "core/utils.hpp"
+#include "crypto/encrypter.hpp"
+
+namespace crypto {
+
+namespace {
+
+/// all of the cipher suites implemented by the crypters are below
+constexpr uint32_t kMaxCipherSuite = 0x40U;
+
+/// the size of the packets encrypted by the benchmark, see SOCKET_BUF_SIZE
+constexpr size_t kBenchmarkPacketSize = 16384;
+
+/// the time spent by the benchmark per backend (in nanoseconds)
+constexpr uint64_t kBenchmarkDuration = 20 * 1000 * 1000;
+
+/// the backend selected per cipher suite, CRYPTER_BACKEND_INVALID if none
+std::atomic<uint32_t> g_selected_backends[kMaxCipherSuite];
+
+/// the fastest backend measured per cipher suite, CRYPTER_BACKEND_INVALID if
+/// not measured yet
+std::atomic<uint32_t> g_fastest_backends[kMaxCipherSuite];
+
+}  // namespace
+
+std::vector<crypter_backend> GetCrypterBackends(uint32_t cipher_suite) {
+  switch (cipher_suite) {
+#define XX(num, name, string) case CRYPTO_##name:
+    CIPHER_METHOD_MAP_SODIUM(XX)
+    CIPHER_METHOD_MAP_BORINGSSL(XX)
+#undef XX
+      return {CRYPTER_BACKEND_BORINGSSL};
+#ifdef HAVE_MBEDTLS
+    case CRYPTO_AES_128_CFB:
+    case CRYPTO_AES_192_CFB:
+    case CRYPTO_AES_256_CFB:
+    case CRYPTO_AES_128_CTR:
+    case CRYPTO_AES_192_CTR:
+    case CRYPTO_AES_256_CTR:
+      return {CRYPTER_BACKEND_BORINGSSL, CRYPTER_BACKEND_MBEDTLS};
+    case CRYPTO_CAMELLIA_128_CFB:
+    case CRYPTO_CAMELLIA_192_CFB:
+    case CRYPTO_CAMELLIA_256_CFB:
+      return {CRYPTER_BACKEND_MBEDTLS};
+#endif
+    default:
+      return {};
+  }
+}
+
+bool HasCrypterBackend(uint32_t cipher_suite, crypter_backend backend) {
+  auto backends = GetCrypterBackends(cipher_suite);
+  return std::find(backends.begin(), backends.end(), backend) != backends.end();
+}
+
+crypter_backend GetCrypterBackend(uint32_t cipher_suite) {
+  if (cipher_suite < kMaxCipherSuite) {
+    auto backend = static_cast<crypter_backend>(g_selected_backends[cipher_suite].load(std::memory_order_relaxed));
+    if (backend != CRYPTER_BACKEND_INVALID) {
+      return backend;
+    }
+  }
+  auto backends = GetCrypterBackends(cipher_suite);
+  return backends.empty() ? CRYPTER_BACKEND_INVALID : backends.front();
+}
+
+uint64_t BenchmarkCrypterBackend(uint32_t cipher_suite, crypter_backend backend) {
+  if (!HasCrypterBackend(cipher_suite, backend)) {
+    return 0;
+  }
+  std::unique_ptr<Encrypter> encrypter = Encrypter::CreateFromCipherSuite(cipher_suite, backend);
+  const char zeros[MAX_KEY_LENGTH] = {};
+  if (!encrypter->SetIV(zeros, encrypter->GetIVSize()) || !encrypter->SetKey(zeros, encrypter->GetKeySize())) {
+    return 0;
+  }
+
+  auto plaintext = std::make_unique<char[]>(kBenchmarkPacketSize);
+  size_t max_output_length = encrypter->GetCiphertextSize(kBenchmarkPacketSize);
+  auto ciphertext = std::make_unique<char[]>(max_output_length);
+  memset(plaintext.get(), 0, kBenchmarkPacketSize);
+
+  uint64_t bytes = 0;
+  uint64_t packet_number = 0;
+  uint64_t start = GetMonotonicTime();
+  uint64_t elapsed;
+  do {
+    size_t output_length;
+    if (!encrypter->EncryptPacket(packet_number++, nullptr, 0U, plaintext.get(), kBenchmarkPacketSize,
+                                  ciphertext.get(), &output_length, max_output_length)) {
+      return 0;
+    }
+    bytes += kBenchmarkPacketSize;
+    elapsed = GetMonotonicTime() - start;
+  } while (elapsed < kBenchmarkDuration);
+
+  return bytes * 1000 * 1000 * 1000 / std::max<uint64_t>(elapsed, 1);
+}
+
+crypter_backend SelectCrypterBackend(uint32_t cipher_suite, crypter_backend pinned) {
+  auto backends = GetCrypterBackends(cipher_suite);
+  if (backends.empty() || cipher_suite >= kMaxCipherSuite) {
+    return CRYPTER_BACKEND_INVALID;
+  }
+  auto method_str = to_cipher_method_str(static_cast<cipher_method>(cipher_suite));
+
+  crypter_backend backend = CRYPTER_BACKEND_INVALID;
+  if (pinned != CRYPTER_BACKEND_AUTO) {
+    if (std::find(backends.begin(), backends.end(), pinned) != backends.end()) {
+      backend = pinned;
+    } else {
+      LOG(WARNING) << "crypto: backend " << to_crypter_backend_str(pinned) << " doesn't implement " << method_str
+                   << ", ignored";
+    }
+  }
+
+  if (backend == CRYPTER_BACKEND_INVALID && backends.size() == 1) {
+    backend = backends.front();
+  }
+
+  if (backend == CRYPTER_BACKEND_INVALID) {
+    backend = static_cast<crypter_backend>(g_fastest_backends[cipher_suite].load(std::memory_order_relaxed));
+  }
+
+  if (backend == CRYPTER_BACKEND_INVALID) {
+    uint64_t fastest_rate = 0;
+    backend = backends.front();
+    for (crypter_backend candidate : backends) {
+      uint64_t rate = BenchmarkCrypterBackend(cipher_suite, candidate);
+      LOG(INFO) << "crypto: " << method_str << " by " << to_crypter_backend_str(candidate) << ": "
+                << static_cast<double>(rate) / 1000 / 1000 / 1000 << " GB/s";
+      if (rate > fastest_rate) {
+        fastest_rate = rate;
+        backend = candidate;
+      }
+    }
+    g_fastest_backends[cipher_suite].store(backend, std::memory_order_relaxed);
+  }
+
+  if (g_selected_backends[cipher_suite].exchange(backend, std::memory_order_relaxed) != backend) {
+    LOG(INFO) << "crypto: " << method_str << " is implemented by " << to_crypter_backend_str(backend);
+  }
+  return backend;
+}
+
+}  // namespace crypto
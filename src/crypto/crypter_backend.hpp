@@ -0,0 +1,45 @@
+// SPDX-License-Identifier: GPL-2.0
+/* Copyright (c) 2024 Chilledheart  */
+
+#ifndef H_CRYPTO_CRYPTER_BACKEND
+#define H_CRYPTO_CRYPTER_BACKEND
+
+#include <stdint.h>
+#include <vector>
+
+#include "crypto/crypter_export.hpp"
+
+namespace crypto {
+
+/// the backends compiled in implementing the cipher suite, in the order of
+/// preference, empty if the cipher suite is not implemented by any backend
+std::vector<crypter_backend> GetCrypterBackends(uint32_t cipher_suite);
+
+/// whether the backend compiled in implements the cipher suite
+bool HasCrypterBackend(uint32_t cipher_suite, crypter_backend backend);
+
+/// the backend used by Encrypter::CreateFromCipherSuite and
+/// Decrypter::CreateFromCipherSuite, the preferred one unless selected by
+/// SelectCrypterBackend
+crypter_backend GetCrypterBackend(uint32_t cipher_suite);
+
+/// encrypt the packets of the cipher suite with the backend for a while
+///
+/// \return the throughput measured in bytes per second, 0 on failure
+uint64_t BenchmarkCrypterBackend(uint32_t cipher_suite, crypter_backend backend);
+
+/// select the backend of the cipher suite used by the crypters created later
+///
+/// \param cipher_suite the cipher suite
+/// \param pinned the backend requested, CRYPTER_BACKEND_AUTO to use the
+///        fastest one measured by BenchmarkCrypterBackend
+/// \return the backend selected
+///
+/// The backend pinned is ignored (with a warning) if it doesn't implement the
+/// cipher suite. The benchmark only runs once per cipher suite and only if
+/// more than one backends implement it.
+crypter_backend SelectCrypterBackend(uint32_t cipher_suite, crypter_backend pinned);
+
+}  // namespace crypto
+
+#endif  // H_CRYPTO_CRYPTER_BACKEND
@@ -0,0 +1,62 @@
+// SPDX-License-Identifier: GPL-2.0
+/* Copyright (c) 2024 Chilledheart  */
+
+#include <gtest/gtest-message.h>
+#include <gtest/gtest.h>
+
+#include <algorithm>
+
+#include "crypto/crypter_backend.hpp"
+#include "crypto/decrypter.hpp"
+#include "crypto/encrypter.hpp"
+
+using namespace crypto;
+
+TEST(CrypterBackendTest, Names) {
+#define XX(num, name, string)                                       \
+  EXPECT_EQ(CRYPTER_BACKEND_##name, to_crypter_backend(string));    \
+  EXPECT_EQ(string, to_crypter_backend_str(CRYPTER_BACKEND_##name));
+  CRYPTER_BACKEND_VALID_MAP(XX)
+#undef XX
+  EXPECT_EQ(CRYPTER_BACKEND_INVALID, to_crypter_backend("openssl"));
+  EXPECT_EQ(CRYPTER_BACKEND_INVALID, to_crypter_backend(""));
+}
+
+TEST(CrypterBackendTest, Backends) {
+  EXPECT_TRUE(HasCrypterBackend(CRYPTO_AES256GCMSHA256_EVP, CRYPTER_BACKEND_BORINGSSL));
+  EXPECT_TRUE(HasCrypterBackend(CRYPTO_CHACHA20POLY1305IETF, CRYPTER_BACKEND_BORINGSSL));
+  EXPECT_FALSE(HasCrypterBackend(CRYPTO_AES256GCMSHA256_EVP, CRYPTER_BACKEND_AUTO));
+#ifdef HAVE_MBEDTLS
+  EXPECT_TRUE(HasCrypterBackend(CRYPTO_AES_128_CFB, CRYPTER_BACKEND_BORINGSSL));
+  EXPECT_TRUE(HasCrypterBackend(CRYPTO_AES_128_CFB, CRYPTER_BACKEND_MBEDTLS));
+  EXPECT_FALSE(HasCrypterBackend(CRYPTO_CAMELLIA_128_CFB, CRYPTER_BACKEND_BORINGSSL));
+#endif
+  EXPECT_TRUE(GetCrypterBackends(CRYPTO_HTTPS).empty());
+  EXPECT_EQ(CRYPTER_BACKEND_INVALID, GetCrypterBackend(CRYPTO_HTTPS));
+  EXPECT_EQ(CRYPTER_BACKEND_INVALID, SelectCrypterBackend(CRYPTO_HTTPS, CRYPTER_BACKEND_AUTO));
+}
+
+TEST(CrypterBackendTest, Select) {
+#define XX(num, name, string)                                                                   \
+  {                                                                                             \
+    auto backends = GetCrypterBackends(CRYPTO_##name);                                          \
+    ASSERT_FALSE(backends.empty()) << string;                                                   \
+    for (crypter_backend backend : backends) {                                                  \
+      EXPECT_EQ(backend, SelectCrypterBackend(CRYPTO_##name, backend)) << string;               \
+      EXPECT_EQ(backend, GetCrypterBackend(CRYPTO_##name)) << string;                           \
+      EXPECT_NE(nullptr, Encrypter::CreateFromCipherSuite(CRYPTO_##name)) << string;            \
+      EXPECT_NE(nullptr, Decrypter::CreateFromCipherSuite(CRYPTO_##name)) << string;            \
+    }                                                                                           \
+    crypter_backend backend = SelectCrypterBackend(CRYPTO_##name, CRYPTER_BACKEND_AUTO);        \
+    EXPECT_NE(backends.end(), std::find(backends.begin(), backends.end(), backend)) << string; \
+    /* the backend not implementing the cipher suite is ignored */                              \
+    EXPECT_EQ(backend, SelectCrypterBackend(CRYPTO_##name, CRYPTER_BACKEND_INVALID)) << string; \
+  }
+  CIPHER_METHOD_OLD_MAP(XX)
+#undef XX
+}
+
+TEST(CrypterBackendTest, Benchmark) {
+  EXPECT_GT(BenchmarkCrypterBackend(CRYPTO_CHACHA20POLY1305IETF_EVP, CRYPTER_BACKEND_BORINGSSL), 0u);
+  EXPECT_EQ(0u, BenchmarkCrypterBackend(CRYPTO_CHACHA20POLY1305IETF_EVP, CRYPTER_BACKEND_MBEDTLS));
+}
@@ -58,3 +58,33 @@ static constexpr const char kCipherMethodsStrImpl[] = CIPHER_METHOD_VALID_MAP(XX
 #undef XX
     ;
 constexpr const std::string_view kCipherMethodsStr(kCipherMethodsStrImpl, std::size(kCipherMethodsStrImpl) - 3);
+
+enum crypter_backend to_crypter_backend(const std::string_view& backend) {
+#define XX(num, name, string)     \
+  if (backend == string) {        \
+    return CRYPTER_BACKEND_##name; \
+  }
+  CRYPTER_BACKEND_VALID_MAP(XX)
+#undef XX
+  return CRYPTER_BACKEND_INVALID;
+}
+
+std::string_view to_crypter_backend_str(enum crypter_backend backend) {
+  switch (backend) {
+#define XX(num, name, string)                 \
+  case num: {                                 \
+    constexpr std::string_view _ret = string; \
+    return _ret;                              \
+  }
+    CRYPTER_BACKEND_MAP(XX)
+#undef XX
+    default:
+      return "invalid";
+  }
+}
+
+#define XX(num, name, string) string ", "
+static constexpr const char kCrypterBackendsStrImpl[] = CRYPTER_BACKEND_VALID_MAP(XX)
+#undef XX
+    ;
+constexpr const std::string_view kCrypterBackendsStr(kCrypterBackendsStrImpl, std::size(kCrypterBackendsStrImpl) - 3);
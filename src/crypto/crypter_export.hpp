@@ -140,4 +140,25 @@ extern const std::string_view kCipherMethodsStr;
 CIPHER_METHOD_MAP(XX)
 #undef XX
 
+/// the libraries implementing the ciphers, see crypto::SelectCrypterBackend
+#define CRYPTER_BACKEND_VALID_MAP(XX) \
+  XX(0x1U, AUTO, "auto")              \
+  XX(0x2U, BORINGSSL, "boringssl")    \
+  XX(0x3U, MBEDTLS, "mbedtls")
+
+#define CRYPTER_BACKEND_MAP(XX) \
+  XX(0x0U, INVALID, "invalid")  \
+  CRYPTER_BACKEND_VALID_MAP(XX)
+
+enum crypter_backend : uint32_t {
+#define XX(num, name, string) CRYPTER_BACKEND_##name = num,
+  CRYPTER_BACKEND_MAP(XX)
+#undef XX
+};
+
+enum crypter_backend to_crypter_backend(const std::string_view& backend);
+std::string_view to_crypter_backend_str(enum crypter_backend backend);
+
+extern const std::string_view kCrypterBackendsStr;
+
 #endif  // H_CRYPTO_CRYPTER_EXPORT
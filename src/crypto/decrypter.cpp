@@ -3,6 +3,9 @@
 
 #include "crypto/decrypter.hpp"
 
+#include <absl/base/attributes.h>
+#include "core/logging.hpp"
+
 #include "crypto/aes_128_gcm_12_evp_decrypter.hpp"
 #include "crypto/aes_128_gcm_evp_decrypter.hpp"
 #include "crypto/aes_192_gcm_evp_decrypter.hpp"
@@ -10,11 +13,13 @@
 #include "crypto/aes_256_gcm_sodium_decrypter.hpp"
 #include "crypto/chacha20_poly1305_evp_decrypter.hpp"
 #include "crypto/chacha20_poly1305_sodium_decrypter.hpp"
+#include "crypto/crypter_backend.hpp"
 #include "crypto/crypter_export.hpp"
 #include "crypto/xchacha20_poly1305_evp_decrypter.hpp"
 #include "crypto/xchacha20_poly1305_sodium_decrypter.hpp"
 
 #include "crypto/aead_mbedtls_decrypter.hpp"
+#include "crypto/aes_stream_evp_decrypter.hpp"
 #include "crypto/mbedtls_common.hpp"
 
 namespace crypto {
@@ -22,6 +27,13 @@ namespace crypto {
 Decrypter::~Decrypter() = default;
 
 std::unique_ptr<Decrypter> Decrypter::CreateFromCipherSuite(uint32_t cipher_suite) {
+  return CreateFromCipherSuite(cipher_suite, GetCrypterBackend(cipher_suite));
+}
+
+std::unique_ptr<Decrypter> Decrypter::CreateFromCipherSuite(uint32_t cipher_suite, crypter_backend backend) {
+  DCHECK(HasCrypterBackend(cipher_suite, backend))
+      << "Unsupported backend " << to_crypter_backend_str(backend) << " for "
+      << to_cipher_method_str(static_cast<cipher_method>(cipher_suite));
   switch (cipher_suite) {
     case CRYPTO_AES256GCMSHA256:
       return std::make_unique<Aes256GcmSodiumDecrypter>();
@@ -52,6 +64,10 @@ std::unique_ptr<Decrypter> Decrypter::CreateFromCipherSuite(uint32_t cipher_suit
     case CRYPTO_AES_128_CTR:
     case CRYPTO_AES_192_CTR:
     case CRYPTO_AES_256_CTR:
+      if (backend == CRYPTER_BACKEND_BORINGSSL) {
+        return std::make_unique<AesStreamEvpDecrypter>(static_cast<cipher_method>(cipher_suite));
+      }
+      ABSL_FALLTHROUGH_INTENDED;
 #if 0
     case CRYPTO_BF_CFB:
 #endif
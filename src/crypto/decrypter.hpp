@@ -5,6 +5,7 @@
 #define H_CRYPTO_DECRYPTER
 
 #include "crypto/crypter.hpp"
+#include "crypto/crypter_export.hpp"
 
 #include <stddef.h>
 #include <stdint.h>
@@ -17,8 +18,14 @@ class Decrypter : public Crypter {
  public:
   virtual ~Decrypter();
 
+  // Creates the decrypter of |cipher_suite| implemented by the backend selected
+  // by SelectCrypterBackend().
   static std::unique_ptr<Decrypter> CreateFromCipherSuite(uint32_t cipher_suite);
 
+  // Creates the decrypter of |cipher_suite| implemented by |backend|, which must
+  // be one of GetCrypterBackends(|cipher_suite|).
+  static std::unique_ptr<Decrypter> CreateFromCipherSuite(uint32_t cipher_suite, crypter_backend backend);
+
   // Sets the encryption key. Returns true on success, false on failure.
   // |DecryptPacket| may not be called until |SetDiversificationNonce| is
   // called and the preliminary keying material will be combined with that
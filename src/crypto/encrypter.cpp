@@ -2,6 +2,8 @@
 /* Copyright (c) 2019-2023 Chilledheart  */
 
 #include "crypto/encrypter.hpp"
+
+#include <absl/base/attributes.h>
 #include "core/logging.hpp"
 
 #include "crypto/aes_128_gcm_12_evp_encrypter.hpp"
@@ -11,11 +13,13 @@
 #include "crypto/aes_256_gcm_sodium_encrypter.hpp"
 #include "crypto/chacha20_poly1305_evp_encrypter.hpp"
 #include "crypto/chacha20_poly1305_sodium_encrypter.hpp"
+#include "crypto/crypter_backend.hpp"
 #include "crypto/crypter_export.hpp"
 #include "crypto/xchacha20_poly1305_evp_encrypter.hpp"
 #include "crypto/xchacha20_poly1305_sodium_encrypter.hpp"
 
 #include "crypto/aead_mbedtls_encrypter.hpp"
+#include "crypto/aes_stream_evp_encrypter.hpp"
 #include "crypto/mbedtls_common.hpp"
 
 namespace crypto {
@@ -23,6 +27,13 @@ namespace crypto {
 Encrypter::~Encrypter() = default;
 
 std::unique_ptr<Encrypter> Encrypter::CreateFromCipherSuite(uint32_t cipher_suite) {
+  return CreateFromCipherSuite(cipher_suite, GetCrypterBackend(cipher_suite));
+}
+
+std::unique_ptr<Encrypter> Encrypter::CreateFromCipherSuite(uint32_t cipher_suite, crypter_backend backend) {
+  DCHECK(HasCrypterBackend(cipher_suite, backend))
+      << "Unsupported backend " << to_crypter_backend_str(backend) << " for "
+      << to_cipher_method_str(static_cast<cipher_method>(cipher_suite));
   switch (cipher_suite) {
     case CRYPTO_AES256GCMSHA256:
       return std::make_unique<Aes256GcmSodiumEncrypter>();
@@ -53,6 +64,10 @@ std::unique_ptr<Encrypter> Encrypter::CreateFromCipherSuite(uint32_t cipher_suit
     case CRYPTO_AES_128_CTR:
     case CRYPTO_AES_192_CTR:
     case CRYPTO_AES_256_CTR:
+      if (backend == CRYPTER_BACKEND_BORINGSSL) {
+        return std::make_unique<AesStreamEvpEncrypter>(static_cast<cipher_method>(cipher_suite));
+      }
+      ABSL_FALLTHROUGH_INTENDED;
 #if 0
     case CRYPTO_BF_CFB:
 #endif
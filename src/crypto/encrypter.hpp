@@ -5,6 +5,7 @@
 #define H_CRYPTO_ENCRYPTER
 
 #include "crypto/crypter.hpp"
+#include "crypto/crypter_export.hpp"
 
 #include <stddef.h>
 #include <stdint.h>
@@ -17,8 +18,14 @@ class Encrypter : public Crypter {
  public:
   virtual ~Encrypter();
 
+  // Creates the encrypter of |cipher_suite| implemented by the backend selected
+  // by SelectCrypterBackend().
   static std::unique_ptr<Encrypter> CreateFromCipherSuite(uint32_t cipher_suite);
 
+  // Creates the encrypter of |cipher_suite| implemented by |backend|, which must
+  // be one of GetCrypterBackends(|cipher_suite|).
+  static std::unique_ptr<Encrypter> CreateFromCipherSuite(uint32_t cipher_suite, crypter_backend backend);
+
   // Writes encrypted |plaintext| and a MAC over |plaintext| and
   // |associated_data| into output. Sets |output_length| to the number of
   // bytes written. Returns true on success or false if there was an error.
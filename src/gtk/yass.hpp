@@ -43,15 +43,18 @@ class YASSApp {
 
   void OnStart(bool quiet = false);
   void OnStop(bool quiet = false);
+  /// apply the saved settings to the running worker, restarting it if needed
+  void OnReload();
 
   std::string GetStatus() const;
-  enum YASSState { STARTED, STARTING, START_FAILED, STOPPING, STOPPED, MAX_STATE };
+  enum YASSState { STARTED, STARTING, START_FAILED, STOPPING, STOPPED, RESTARTING, MAX_STATE };
   YASSState GetState() const { return state_; }
 
  private:
   void OnStarted();
   void OnStartFailed(const std::string& error_msg);
   void OnStopped();
+  void OnRestart();
 
   absl::Mutex dispatch_mutex_;
   std::queue<std::pair<YASSState, std::string>> dispatch_queue_;
@@ -62,6 +65,7 @@ class YASSApp {
 
  private:
   YASSState state_ = STOPPED;
+  bool restart_pending_ = false;
 
   friend class YASSWindow;
   YASSWindow* main_window_ = nullptr;
@@ -367,6 +367,26 @@ void YASSApp::OnStop(bool quiet) {
   worker_.Stop(std::move(callback));
 }
 
+void YASSApp::OnReload() {
+  if (state_ != STARTED) {
+    return;
+  }
+  worker_.Reload([this](asio::error_code ec) {
+    if (ec != asio::error::operation_not_supported) {
+      if (ec) {
+        LOG(WARNING) << "Failed to reload config due to: " << ec;
+      }
+      return;
+    }
+    {
+      absl::MutexLock lk(&dispatch_mutex_);
+      dispatch_queue_.emplace(RESTARTING, std::string());
+    }
+
+    dispatcher_.Emit();
+  });
+}
+
 void YASSApp::OnStarted() {
   state_ = STARTED;
   config::SaveConfig();
@@ -383,6 +403,18 @@ void YASSApp::OnStartFailed(const std::string& error_msg) {
 void YASSApp::OnStopped() {
   state_ = STOPPED;
   main_window_->Stopped();
+  if (restart_pending_) {
+    restart_pending_ = false;
+    main_window_->OnStartButtonClicked();
+  }
+}
+
+void YASSApp::OnRestart() {
+  if (state_ != STARTED) {
+    return;
+  }
+  restart_pending_ = true;
+  main_window_->OnStopButtonClicked();
 }
 
 void YASSApp::OnDispatch() {
@@ -398,6 +430,8 @@ void YASSApp::OnDispatch() {
     OnStartFailed(event.second);
   else if (event.first == STOPPED)
     OnStopped();
+  else if (event.first == RESTARTING)
+    OnRestart();
 }
 
 std::string YASSApp::SaveConfig() {
@@ -302,6 +302,9 @@ void YASSWindow::OnOption() {
     auto response_callback = [](GtkDialog* self, gint response_id, gpointer pointer) {
       YASSWindow* window = (YASSWindow*)pointer;
       window->OnOptionDialogClose();
+      if (response_id == GTK_RESPONSE_ACCEPT) {
+        mApp->OnReload();
+      }
     };
 
     g_signal_connect(dialog->impl_, "response", G_CALLBACK(*response_callback), this);
@@ -385,8 +388,8 @@ std::string YASSWindow::GetStatusMessage() {
   uint64_t sync_time = GetMonotonicTime();
   uint64_t delta_time = sync_time - last_sync_time_;
   if (delta_time > NS_PER_SECOND) {
-    uint64_t rx_bytes = net::cli::total_rx_bytes;
-    uint64_t tx_bytes = net::cli::total_tx_bytes;
+    uint64_t rx_bytes = net::cli::total_rx_bytes();
+    uint64_t tx_bytes = net::cli::total_tx_bytes();
     rx_rate_ = static_cast<double>(rx_bytes - last_rx_bytes_) / delta_time * NS_PER_SECOND;
     tx_rate_ = static_cast<double>(tx_bytes - last_tx_bytes_) / delta_time * NS_PER_SECOND;
     last_sync_time_ = sync_time;
@@ -0,0 +1,442 @@
+// SPDX-License-Identifier: GPL-2.0
+/* Copyright (c) 2024 Chilledheart  */
+
+#include <absl/debugging/failure_signal_handler.h>
+#include <absl/debugging/symbolize.h>
+#include <absl/flags/flag.h>
+#include <absl/strings/str_cat.h>
+#include <absl/strings/str_join.h>
+#include <base/memory/scoped_refptr.h>
+#include <build/build_config.h>
+#include <locale.h>
+#include "third_party/boringssl/src/include/openssl/crypto.h"
+
+#include <atomic>
+#include <set>
+#include <sstream>
+#include <thread>
+
+#include "cli/cli_server.hpp"
+#include "config/config.hpp"
+#include "core/logging.hpp"
+#include "core/utils.hpp"
+#include "loadgen/loadgen_tunnel.hpp"
+#include "loadgen/sink_connection.hpp"
+#include "net/asio.hpp"
+#include "net/resolver.hpp"
+#include "version.h"
+
+ABSL_FLAG(std::string,
+          target,
+          "cli",
+          "Open tunnels through a running yass_cli at local_host:local_port (cli), "
+          "or through an in-process client to yass_server at server_host:server_port (server)");
+ABSL_FLAG(std::string, proxy_protocol, "http", "Proxy protocol used to open tunnels: http or socks5");
+ABSL_FLAG(int32_t, tunnels, 64, "Concurrent tunnels");
+ABSL_FLAG(int64_t, total_tunnels, 0, "Stop after opening given number of tunnels, 0 for unlimited");
+ABSL_FLAG(int32_t, duration, 10, "Stop after given seconds, 0 for unlimited");
+ABSL_FLAG(std::string,
+          traffic_mix,
+          "echo:16k:1,upload:256k:1,download:256k:1",
+          "Requests issued in tunnels, in form of <echo|upload|download>:<bytes>[:<weight>],...");
+ABSL_FLAG(int32_t, requests_per_tunnel, 1, "Requests issued in each tunnel before it is closed");
+ABSL_FLAG(int32_t, threads, 1, "Threads to run tunnels");
+ABSL_FLAG(int32_t, report_interval, 1, "Report progress every given seconds, 0 to disable");
+ABSL_FLAG(std::string, sink_host, "127.0.0.1", "The sink server on given host");
+ABSL_FLAG(PortFlag, sink_port, PortFlag(0), "The sink server on given port, 0 to run a built-in one on loopback");
+ABSL_FLAG(bool, serve, false, "Run the sink server at sink_host:sink_port only");
+
+namespace config {
+const ProgramType pType = YASS_CLIENT_DEFAULT;
+}  // namespace config
+
+using namespace net::loadgen;
+using net::Stats;
+
+static asio::ip::tcp::resolver::results_type ResolveAddress(const std::string& domain_name, int port) {
+  asio::error_code ec;
+  auto addr = asio::ip::make_address(domain_name.c_str(), ec);
+  bool host_is_ip_address = !ec;
+  if (host_is_ip_address) {
+    asio::ip::tcp::endpoint endpoint(addr, port);
+    auto results = asio::ip::tcp::resolver::results_type::create(endpoint, domain_name, std::to_string(port));
+    return results;
+  } else {
+    asio::io_context io_context;
+    auto work_guard =
+        std::make_unique<asio::executor_work_guard<asio::io_context::executor_type>>(io_context.get_executor());
+    net::Resolver resolver(io_context);
+    if (resolver.Init() < 0) {
+      LOG(WARNING) << "Resolver: Init failure";
+      return {};
+    }
+    asio::ip::tcp::resolver::results_type results;
+    resolver.AsyncResolve(domain_name, port, [&](asio::error_code ec, asio::ip::tcp::resolver::results_type _results) {
+      work_guard.reset();
+      if (ec) {
+        LOG(WARNING) << "resolved domain name: " << domain_name << " failed due to: " << ec;
+        return;
+      }
+      results = std::move(_results);
+    });
+    io_context.run();
+
+    return results;
+  }
+}
+
+static std::string HumanReadableByteCountBinStr(uint64_t bytes) {
+  std::stringstream ss;
+
+  HumanReadableByteCountBin(&ss, bytes);
+  return ss.str();
+}
+
+namespace {
+
+std::atomic<bool> g_stopping;
+std::atomic<int64_t> g_tunnels_left;
+
+/// Keeps given number of tunnels running on its own thread until the budget is
+/// exhausted or the load generator is stopping.
+class Worker {
+ public:
+  Worker(const TunnelOptions& options, int concurrency, absl::AnyInvocable<void()> on_finished)
+      : options_(options), concurrency_(concurrency), on_finished_(std::move(on_finished)) {}
+
+  void Start() {
+    thread_ = std::thread([this]() {
+      if (!SetCurrentThreadName("loadgen_worker")) {
+        PLOG(WARNING) << "failed to set thread name";
+      }
+      asio::post(io_context_, [this]() {
+        for (int i = 0; i < concurrency_; ++i) {
+          Launch();
+        }
+        if (tunnels_.empty()) {
+          on_finished_();
+        }
+      });
+      io_context_.run();
+    });
+  }
+
+  /// abort all running tunnels
+  void Stop() {
+    asio::post(io_context_, [this]() {
+      std::set<scoped_refptr<Tunnel>> tunnels = tunnels_;
+      for (auto tunnel : tunnels) {
+        tunnel->Close();
+      }
+    });
+  }
+
+  void Join() { thread_.join(); }
+
+ private:
+  void Launch() {
+    if (g_stopping.load(std::memory_order_relaxed) || g_tunnels_left.fetch_sub(1, std::memory_order_relaxed) <= 0) {
+      return;
+    }
+    scoped_refptr<Tunnel> tunnel = gurl_base::MakeRefCounted<Tunnel>(io_context_, options_);
+    tunnels_.insert(tunnel);
+    tunnel->Start([this, tunnel]() {
+      // defer the release of tunnel out of its own callback
+      asio::post(io_context_, [this, tunnel]() {
+        tunnels_.erase(tunnel);
+        Launch();
+        if (tunnels_.empty()) {
+          on_finished_();
+        }
+      });
+    });
+  }
+
+  asio::io_context io_context_;
+  const TunnelOptions& options_;
+  const int concurrency_;
+  absl::AnyInvocable<void()> on_finished_;
+  std::set<scoped_refptr<Tunnel>> tunnels_;
+  std::thread thread_;
+};
+
+void PrintProgress(double elapsed, const Stats::Snapshot& prev, const Stats::Snapshot& s, double interval) {
+  LOG(WARNING) << "Loadgen: " << elapsed << "s tunnels: " << s[Stats::kConnectionsOpened] - s[Stats::kConnectionsClosed]
+               << " opened: " << s[Stats::kConnectionsOpened] - prev[Stats::kConnectionsOpened]
+               << " errors: " << s[Stats::kConnectErrors] - prev[Stats::kConnectErrors]
+               << " tx: " << HumanReadableByteCountBinStr((s[Stats::kTxBytes] - prev[Stats::kTxBytes]) / interval)
+               << "/s rx: " << HumanReadableByteCountBinStr((s[Stats::kRxBytes] - prev[Stats::kRxBytes]) / interval)
+               << "/s";
+}
+
+void PrintReport(double elapsed) {
+  Stats::Snapshot s = stats().GetSnapshot();
+  uint64_t requests = GetCompletedRequests();
+  LOG(WARNING) << "Loadgen Stats: Elapsed: " << elapsed << "s";
+  LOG(WARNING) << "Loadgen Stats: Tunnels: " << s[Stats::kConnectionsOpened]
+               << " Connect Errors: " << s[Stats::kConnectErrors] << " (" << s[Stats::kConnectionsOpened] / elapsed
+               << " tunnels/s)";
+  LOG(WARNING) << "Loadgen Stats: Requests: " << requests << " (" << requests / elapsed << " requests/s)";
+  LOG(WARNING) << "Loadgen Stats: Sent: " << HumanReadableByteCountBinStr(s[Stats::kTxBytes]) << " ("
+               << HumanReadableByteCountBinStr(s[Stats::kTxBytes] / elapsed) << "/s)";
+  LOG(WARNING) << "Loadgen Stats: Received: " << HumanReadableByteCountBinStr(s[Stats::kRxBytes]) << " ("
+               << HumanReadableByteCountBinStr(s[Stats::kRxBytes] / elapsed) << "/s)";
+  net::PrintStatsHistograms("Loadgen Stats", s);
+  for (const auto& [error, count] : GetErrorBreakdown()) {
+    LOG(WARNING) << "Loadgen Stats: Error: " << error << ": " << count;
+  }
+}
+
+}  // namespace
+
+int main(int argc, const char* argv[]) {
+#ifndef _WIN32
+  // setup signal handler
+  signal(SIGPIPE, SIG_IGN);
+
+  /* Block SIGPIPE in all threads, this can happen if a thread calls write on
+     a closed pipe. */
+  sigset_t sigpipe_mask;
+  sigemptyset(&sigpipe_mask);
+  sigaddset(&sigpipe_mask, SIGPIPE);
+  sigset_t saved_mask;
+  if (pthread_sigmask(SIG_BLOCK, &sigpipe_mask, &saved_mask) == -1) {
+    perror("pthread_sigmask failed");
+    return -1;
+  }
+#endif
+  SetExecutablePath(argv[0]);
+  std::string exec_path;
+  if (!GetExecutablePath(&exec_path)) {
+    return -1;
+  }
+
+#ifdef _WIN32
+  if (!EnableSecureDllLoading()) {
+    return -1;
+  }
+#endif
+
+#if BUILDFLAG(IS_POSIX) && !BUILDFLAG(IS_ANDROID) && !BUILDFLAG(IS_OHOS)
+  setlocale(LC_ALL, "");
+  setlocale(LC_NUMERIC, "C");
+#endif
+
+  absl::InitializeSymbolizer(exec_path.c_str());
+  absl::FailureSignalHandlerOptions failure_handle_options;
+  absl::InstallFailureSignalHandler(failure_handle_options);
+
+  config::SetClientUsageMessage(exec_path);
+  config::ReadConfigFileAndArguments(argc, argv);
+
+  std::string target = absl::GetFlag(FLAGS_target);
+  if (target != "cli" && target != "server") {
+    LOG(WARNING) << "Invalid target: " << target;
+    return -1;
+  }
+  if (target == "server" && !absl::GetFlag(FLAGS_serve)) {
+    std::string err = config::ValidateConfig();
+    if (!err.empty()) {
+      LOG(WARNING) << "Failed to validate config: " << err;
+      return -1;
+    }
+  }
+
+  TunnelOptions options;
+  if (!ParseProxyProtocol(absl::GetFlag(FLAGS_proxy_protocol), &options.protocol)) {
+    LOG(WARNING) << "Invalid proxy protocol: " << absl::GetFlag(FLAGS_proxy_protocol);
+    return -1;
+  }
+  std::string err;
+  if (!ParseTrafficMix(absl::GetFlag(FLAGS_traffic_mix), &options.traffic_mix, &err)) {
+    LOG(WARNING) << "Invalid traffic mix: " << err;
+    return -1;
+  }
+  options.requests_per_tunnel = std::max(absl::GetFlag(FLAGS_requests_per_tunnel), 1);
+  options.sink_host = absl::GetFlag(FLAGS_sink_host);
+  options.sink_port = absl::GetFlag(FLAGS_sink_port);
+  if (options.sink_host.size() > 255u) {
+    LOG(WARNING) << "Invalid sink host: " << options.sink_host;
+    return -1;
+  }
+  if (config::testOnlyMode) {
+    LOG(WARNING) << "Configuration Validated";
+    return 0;
+  }
+
+#ifdef _WIN32
+  int iResult = 0;
+  WSADATA wsaData = {0};
+  iResult = WSAStartup(MAKEWORD(2, 2), &wsaData);
+  CHECK_EQ(iResult, 0) << "WSAStartup failure";
+#endif
+
+  // The io context of the sink server, the in-process client and reporting
+  asio::io_context io_context;
+  auto work_guard =
+      std::make_unique<asio::executor_work_guard<asio::io_context::executor_type>>(io_context.get_executor());
+  asio::error_code ec;
+
+  std::unique_ptr<SinkServer> sink_server;
+  if (options.sink_port == 0u || absl::GetFlag(FLAGS_serve)) {
+    auto sink_addr = asio::ip::make_address(absl::GetFlag(FLAGS_serve) ? options.sink_host : "127.0.0.1", ec);
+    if (ec) {
+      LOG(WARNING) << "Invalid sink host: " << options.sink_host;
+      return -1;
+    }
+    sink_server = std::make_unique<SinkServer>(io_context);
+    sink_server->listen(asio::ip::tcp::endpoint(sink_addr, options.sink_port), std::string(), SOMAXCONN, ec);
+    if (ec) {
+      LOG(ERROR) << "sink server listen failed due to: " << ec;
+      return -1;
+    }
+    options.sink_port = sink_server->endpoint().port();
+    LOG(WARNING) << "sink server listening at " << sink_server->endpoint();
+  }
+
+  std::unique_ptr<net::cli::CliServer> cli_server;
+  if (absl::GetFlag(FLAGS_serve)) {
+    // serve only, no tunnels
+  } else if (target == "server") {
+    std::string remote_host_name = absl::GetFlag(FLAGS_server_host);
+    std::string remote_host_sni = remote_host_name;
+    if (!absl::GetFlag(FLAGS_server_sni).empty()) {
+      remote_host_sni = absl::GetFlag(FLAGS_server_sni);
+    }
+    uint16_t remote_port = absl::GetFlag(FLAGS_server_port);
+    auto results = ResolveAddress(remote_host_name, remote_port);
+    if (results.empty()) {
+      return -1;
+    }
+    std::vector<std::string> remote_ips;
+    for (auto result : results) {
+      remote_ips.push_back(result.endpoint().address().to_string());
+    }
+    std::string remote_host_ips = absl::StrJoin(remote_ips, ";");
+
+    // run the client in-process so every method supported by yass_server can be
+    // exercised with the same CliConnection code as yass_cli
+    cli_server = std::make_unique<net::cli::CliServer>(io_context, remote_host_ips, remote_host_sni, remote_port);
+    cli_server->listen(asio::ip::tcp::endpoint(asio::ip::make_address("127.0.0.1", ec), 0), std::string(), SOMAXCONN,
+                       ec);
+    if (ec) {
+      LOG(ERROR) << "in-process client listen failed due to: " << ec;
+      return -1;
+    }
+    options.proxy_endpoint = cli_server->endpoint();
+    LOG(WARNING) << "in-process client listening at " << options.proxy_endpoint << " with upstream sni: "
+                 << remote_host_sni << ":" << remote_port << " (ip " << remote_host_ips << " )";
+  } else {
+    auto results = ResolveAddress(absl::GetFlag(FLAGS_local_host), absl::GetFlag(FLAGS_local_port));
+    if (results.empty()) {
+      return -1;
+    }
+    options.proxy_endpoint = *results.begin();
+  }
+
+  std::vector<std::unique_ptr<Worker>> workers;
+  std::atomic<int> workers_left = 0;
+  asio::steady_timer duration_timer(io_context);
+  asio::steady_timer report_timer(io_context);
+  asio::signal_set signals(io_context);
+  std::function<void(asio::error_code)> report;
+
+  auto stop = [&]() {
+    if (g_stopping.exchange(true)) {
+      return;
+    }
+    for (auto& worker : workers) {
+      worker->Stop();
+    }
+  };
+  auto shutdown = [&]() {
+    stop();
+    duration_timer.cancel();
+    report_timer.cancel();
+    signals.clear();
+    if (sink_server) {
+      sink_server->stop();
+    }
+    if (cli_server) {
+      cli_server->stop();
+    }
+    work_guard.reset();
+  };
+
+  signals.add(SIGINT, ec);
+  signals.add(SIGTERM, ec);
+  signals.async_wait([&](asio::error_code ec, int signal_number) {
+    if (ec) {
+      return;
+    }
+    LOG(WARNING) << "Application exiting";
+    if (workers.empty()) {
+      shutdown();
+    } else {
+      stop();
+    }
+  });
+
+  uint64_t start_time = GetMonotonicTime();
+  if (!absl::GetFlag(FLAGS_serve)) {
+    int64_t total_tunnels = absl::GetFlag(FLAGS_total_tunnels);
+    g_tunnels_left = total_tunnels > 0 ? total_tunnels : INT64_MAX;
+
+    int threads = std::max(absl::GetFlag(FLAGS_threads), 1);
+    int concurrency = std::max(absl::GetFlag(FLAGS_tunnels), 1);
+    threads = std::min(threads, concurrency);
+    workers_left = threads;
+    for (int i = 0; i < threads; ++i) {
+      int worker_concurrency = concurrency / threads + (i < concurrency % threads ? 1 : 0);
+      workers.push_back(std::make_unique<Worker>(options, worker_concurrency, [&]() {
+        if (--workers_left == 0) {
+          asio::post(io_context, shutdown);
+        }
+      }));
+    }
+
+    if (int duration = absl::GetFlag(FLAGS_duration)) {
+      duration_timer.expires_after(std::chrono::seconds(duration));
+      duration_timer.async_wait([&](asio::error_code ec) {
+        if (!ec) {
+          stop();
+        }
+      });
+    }
+
+    if (int report_interval = absl::GetFlag(FLAGS_report_interval)) {
+      auto prev = std::make_shared<Stats::Snapshot>();
+      report = [&, prev, report_interval](asio::error_code ec) {
+        if (ec) {
+          return;
+        }
+        Stats::Snapshot s = stats().GetSnapshot();
+        PrintProgress((GetMonotonicTime() - start_time) / 1e9, *prev, s, report_interval);
+        *prev = s;
+        report_timer.expires_after(std::chrono::seconds(report_interval));
+        report_timer.async_wait(report);
+      };
+      report_timer.expires_after(std::chrono::seconds(report_interval));
+      report_timer.async_wait(report);
+    }
+
+    LOG(WARNING) << "opening " << concurrency << " concurrent tunnels to " << options.sink_host << ":"
+                 << options.sink_port << " through " << options.proxy_endpoint << " ("
+                 << absl::GetFlag(FLAGS_proxy_protocol) << ")";
+    for (auto& worker : workers) {
+      worker->Start();
+    }
+  }
+
+  io_context.run();
+
+  for (auto& worker : workers) {
+    worker->Join();
+  }
+
+  if (!workers.empty()) {
+    PrintReport(std::max((GetMonotonicTime() - start_time) / 1e9, 1e-6));
+  }
+
+  return 0;
+}
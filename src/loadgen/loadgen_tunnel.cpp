@@ -0,0 +1,473 @@
+// SPDX-License-Identifier: GPL-2.0
+/* Copyright (c) 2024 Chilledheart  */
+
+#include "loadgen/loadgen_tunnel.hpp"
+
+#include <absl/strings/ascii.h>
+#include <absl/strings/numbers.h>
+#include <absl/strings/str_cat.h>
+#include <absl/strings/str_split.h>
+#include <absl/synchronization/mutex.h>
+#include <base/rand_util.h>
+
+#include <atomic>
+
+#include "core/logging.hpp"
+#include "core/utils.hpp"
+#include "net/network.hpp"
+
+namespace net::loadgen {
+
+namespace {
+
+constexpr const size_t kTransferBufferSize = 16384;
+
+struct ErrorBreakdown {
+  absl::Mutex mutex;
+  std::map<std::string, uint64_t> errors ABSL_GUARDED_BY(mutex);
+};
+
+ErrorBreakdown& error_breakdown() {
+  static ErrorBreakdown* breakdown = new ErrorBreakdown;
+  return *breakdown;
+}
+
+std::atomic<uint64_t> g_completed_requests;
+
+// the payload of upload and echo requests, shared by all tunnels
+const std::vector<uint8_t>& send_buffer() {
+  static std::vector<uint8_t>* buffer = [] {
+    auto* buffer = new std::vector<uint8_t>(kTransferBufferSize);
+    gurl_base::RandBytes(buffer->data(), buffer->size());
+    return buffer;
+  }();
+  return *buffer;
+}
+
+bool ParseByteSize(std::string_view text, uint64_t* bytes) {
+  uint64_t multiplier = 1;
+  if (!text.empty()) {
+    switch (absl::ascii_tolower(text.back())) {
+      case 'k':
+        multiplier = 1024;
+        break;
+      case 'm':
+        multiplier = 1024 * 1024;
+        break;
+      case 'g':
+        multiplier = 1024 * 1024 * 1024;
+        break;
+      default:
+        break;
+    }
+  }
+  if (multiplier != 1) {
+    text.remove_suffix(1);
+  }
+  if (!absl::SimpleAtoi(text, bytes)) {
+    return false;
+  }
+  *bytes *= multiplier;
+  return true;
+}
+
+}  // namespace
+
+Stats& stats() {
+  static Stats* stats = new Stats("loadgen");
+  return *stats;
+}
+
+const char* PhaseName(Phase phase) {
+  switch (phase) {
+    case kPhaseConnect:
+      return "connect";
+    case kPhaseHandshake:
+      return "handshake";
+    case kPhaseTransfer:
+      return "transfer";
+    default:
+      return "unknown";
+  }
+}
+
+void RecordError(Phase phase, asio::error_code ec) {
+  std::string key = absl::StrCat(PhaseName(phase), ": ", ec.message());
+  ErrorBreakdown& breakdown = error_breakdown();
+  absl::MutexLock lk(&breakdown.mutex);
+  ++breakdown.errors[key];
+}
+
+std::map<std::string, uint64_t> GetErrorBreakdown() {
+  ErrorBreakdown& breakdown = error_breakdown();
+  absl::MutexLock lk(&breakdown.mutex);
+  return breakdown.errors;
+}
+
+uint64_t GetCompletedRequests() {
+  return g_completed_requests.load(std::memory_order_relaxed);
+}
+
+bool ParseProxyProtocol(std::string_view name, ProxyProtocol* protocol) {
+  if (name == "http") {
+    *protocol = kProxyHttp;
+    return true;
+  }
+  if (name == "socks5") {
+    *protocol = kProxySocks5;
+    return true;
+  }
+  return false;
+}
+
+bool ParseTrafficMix(std::string_view text, std::vector<TrafficMix>* mix, std::string* err) {
+  mix->clear();
+  for (std::string_view entry : absl::StrSplit(text, ',', absl::SkipWhitespace())) {
+    std::vector<std::string_view> fields = absl::StrSplit(absl::StripAsciiWhitespace(entry), ':');
+    if (fields.size() != 2 && fields.size() != 3) {
+      *err = absl::StrCat("invalid traffic mix entry: ", entry);
+      return false;
+    }
+    TrafficMix item;
+    if (fields[0] == "echo") {
+      item.mode = kSinkEcho;
+    } else if (fields[0] == "upload") {
+      item.mode = kSinkUpload;
+    } else if (fields[0] == "download") {
+      item.mode = kSinkDownload;
+    } else {
+      *err = absl::StrCat("invalid traffic mode: ", fields[0]);
+      return false;
+    }
+    if (!ParseByteSize(fields[1], &item.bytes)) {
+      *err = absl::StrCat("invalid traffic size: ", fields[1]);
+      return false;
+    }
+    item.weight = 1;
+    if (fields.size() == 3 && (!absl::SimpleAtoi(fields[2], &item.weight) || item.weight <= 0)) {
+      *err = absl::StrCat("invalid traffic weight: ", fields[2]);
+      return false;
+    }
+    mix->push_back(item);
+  }
+  if (mix->empty()) {
+    *err = "empty traffic mix";
+    return false;
+  }
+  return true;
+}
+
+Tunnel::Tunnel(asio::io_context& io_context, const TunnelOptions& options)
+    : socket_(io_context), options_(options), recv_buffer_(kTransferBufferSize) {}
+
+Tunnel::~Tunnel() = default;
+
+void Tunnel::Start(callback_t&& callback) {
+  callback_ = std::move(callback);
+  requests_left_ = options_.requests_per_tunnel;
+  connect_start_ = GetMonotonicTime();
+
+  scoped_refptr<Tunnel> self(this);
+  socket_.async_connect(options_.proxy_endpoint, [this, self](asio::error_code ec) { OnConnect(ec); });
+}
+
+void Tunnel::Close() {
+  if (closed_) {
+    return;
+  }
+  closed_ = true;
+  asio::error_code ec;
+  socket_.close(ec);
+}
+
+void Tunnel::OnConnect(asio::error_code ec) {
+  if (ec) {
+    stats().Add(Stats::kConnectErrors);
+    OnError(kPhaseConnect, ec);
+    return;
+  }
+  stats().Add(Stats::kConnectionsOpened);
+  connected_ = true;
+  handshake_start_ = GetMonotonicTime();
+  stats().RecordNanoseconds(Stats::kConnectLatency, handshake_start_ - connect_start_);
+  SetSocketTcpNoDelay(&socket_, ec);
+
+  if (options_.protocol == kProxySocks5) {
+    WriteSocks5MethodSelect();
+  } else {
+    WriteHttpRequest();
+  }
+}
+
+void Tunnel::WriteHttpRequest() {
+  std::string host = options_.sink_host;
+  if (host.find(':') != std::string::npos) {
+    host = absl::StrCat("[", host, "]");
+  }
+  std::string authority = absl::StrCat(host, ":", options_.sink_port);
+  handshake_ = absl::StrCat("CONNECT ", authority, " HTTP/1.1\r\nHost: ", authority, "\r\n\r\n");
+
+  scoped_refptr<Tunnel> self(this);
+  asio::async_write(socket_, asio::const_buffer(handshake_.data(), handshake_.size()),
+                    [this, self](asio::error_code ec, size_t bytes_transferred) {
+                      if (ec) {
+                        OnError(kPhaseHandshake, ec);
+                        return;
+                      }
+                      ReadHttpResponse();
+                    });
+}
+
+void Tunnel::ReadHttpResponse() {
+  scoped_refptr<Tunnel> self(this);
+  handshake_response_.clear();
+  asio::async_read_until(socket_, asio::dynamic_buffer(handshake_response_), "\r\n\r\n",
+                         [this, self](asio::error_code ec, size_t bytes_transferred) {
+                           if (ec) {
+                             OnError(kPhaseHandshake, ec);
+                             return;
+                           }
+                           // the sink never sends before the request, so no
+                           // bytes are expected after the response header
+                           std::string_view status_line(handshake_response_);
+                           status_line = status_line.substr(0, status_line.find("\r\n"));
+                           std::vector<std::string_view> fields = absl::StrSplit(status_line, ' ');
+                           if (fields.size() < 2 || fields[1] != "200" ||
+                               bytes_transferred != handshake_response_.size()) {
+                             OnError(kPhaseHandshake, asio::error::connection_refused);
+                             return;
+                           }
+                           OnHandshake();
+                         });
+}
+
+void Tunnel::WriteSocks5MethodSelect() {
+  // version 5, one method, no authentication required
+  handshake_ = std::string("\x05\x01\x00", 3);
+
+  scoped_refptr<Tunnel> self(this);
+  asio::async_write(socket_, asio::const_buffer(handshake_.data(), handshake_.size()),
+                    [this, self](asio::error_code ec, size_t bytes_transferred) {
+                      if (ec) {
+                        OnError(kPhaseHandshake, ec);
+                        return;
+                      }
+                      ReadSocks5MethodSelect();
+                    });
+}
+
+void Tunnel::ReadSocks5MethodSelect() {
+  scoped_refptr<Tunnel> self(this);
+  handshake_response_.resize(2);
+  asio::async_read(socket_, asio::mutable_buffer(handshake_response_.data(), handshake_response_.size()),
+                   [this, self](asio::error_code ec, size_t bytes_transferred) {
+                     if (ec) {
+                       OnError(kPhaseHandshake, ec);
+                       return;
+                     }
+                     if (handshake_response_[0] != 0x05 || handshake_response_[1] != 0x00) {
+                       OnError(kPhaseHandshake, asio::error::connection_refused);
+                       return;
+                     }
+                     WriteSocks5Request();
+                   });
+}
+
+void Tunnel::WriteSocks5Request() {
+  const std::string& host = options_.sink_host;
+  DCHECK_LE(host.size(), 255u);
+  // version 5, connect, reserved, domain name
+  handshake_ = std::string("\x05\x01\x00\x03", 4);
+  handshake_.push_back(static_cast<char>(host.size()));
+  handshake_.append(host);
+  handshake_.push_back(static_cast<char>(options_.sink_port >> 8));
+  handshake_.push_back(static_cast<char>(options_.sink_port & 0xff));
+
+  scoped_refptr<Tunnel> self(this);
+  asio::async_write(socket_, asio::const_buffer(handshake_.data(), handshake_.size()),
+                    [this, self](asio::error_code ec, size_t bytes_transferred) {
+                      if (ec) {
+                        OnError(kPhaseHandshake, ec);
+                        return;
+                      }
+                      ReadSocks5Reply();
+                    });
+}
+
+void Tunnel::ReadSocks5Reply() {
+  scoped_refptr<Tunnel> self(this);
+  // version, reply, reserved, address type and the first byte of address
+  handshake_response_.resize(5);
+  asio::async_read(
+      socket_, asio::mutable_buffer(handshake_response_.data(), handshake_response_.size()),
+      [this, self](asio::error_code ec, size_t bytes_transferred) {
+        if (ec) {
+          OnError(kPhaseHandshake, ec);
+          return;
+        }
+        if (handshake_response_[0] != 0x05 || handshake_response_[1] != 0x00) {
+          OnError(kPhaseHandshake, asio::error::connection_refused);
+          return;
+        }
+        size_t remaining;
+        switch (handshake_response_[3]) {
+          case 0x01:  // ipv4
+            remaining = 4 - 1 + 2;
+            break;
+          case 0x04:  // ipv6
+            remaining = 16 - 1 + 2;
+            break;
+          case 0x03:  // domain name
+            remaining = static_cast<uint8_t>(handshake_response_[4]) + 2;
+            break;
+          default:
+            OnError(kPhaseHandshake, asio::error::connection_refused);
+            return;
+        }
+        handshake_response_.resize(remaining);
+        asio::async_read(socket_, asio::mutable_buffer(handshake_response_.data(), handshake_response_.size()),
+                         [this, self](asio::error_code ec, size_t bytes_transferred) {
+                           if (ec) {
+                             OnError(kPhaseHandshake, ec);
+                             return;
+                           }
+                           OnHandshake();
+                         });
+      });
+}
+
+void Tunnel::OnHandshake() {
+  stats().RecordNanoseconds(Stats::kHandshakeLatency, GetMonotonicTime() - handshake_start_);
+  NextRequest();
+}
+
+void Tunnel::NextRequest() {
+  if (requests_left_-- <= 0) {
+    Done();
+    return;
+  }
+
+  // pick one request from the traffic mix by weight
+  int total_weight = 0;
+  for (const auto& mix : options_.traffic_mix) {
+    total_weight += mix.weight;
+  }
+  int pick = gurl_base::RandInt(0, total_weight - 1);
+  for (const auto& mix : options_.traffic_mix) {
+    request_ = &mix;
+    pick -= mix.weight;
+    if (pick < 0) {
+      break;
+    }
+  }
+
+  EncodeSinkRequest(request_->mode, request_->bytes, request_header_);
+  write_left_ = request_->mode == kSinkDownload ? 0 : request_->bytes;
+  read_left_ = request_->mode == kSinkDownload ? request_->bytes : 0;
+  first_byte_ = false;
+  request_start_ = GetMonotonicTime();
+
+  scoped_refptr<Tunnel> self(this);
+  asio::async_write(socket_, asio::const_buffer(request_header_, sizeof(request_header_)),
+                    [this, self](asio::error_code ec, size_t bytes_transferred) {
+                      if (ec) {
+                        OnError(kPhaseTransfer, ec);
+                        return;
+                      }
+                      stats().Add(Stats::kTxBytes, bytes_transferred);
+                      if (request_->mode == kSinkDownload) {
+                        ReadResponse();
+                      } else {
+                        WritePayload();
+                      }
+                    });
+}
+
+void Tunnel::WritePayload() {
+  if (write_left_ == 0) {
+    if (request_->mode == kSinkUpload) {
+      // wait for the acknowledgement
+      read_left_ = 1;
+    }
+    ReadResponse();
+    return;
+  }
+
+  scoped_refptr<Tunnel> self(this);
+  const std::vector<uint8_t>& buffer = send_buffer();
+  size_t length = std::min<uint64_t>(write_left_, buffer.size());
+  asio::async_write(socket_, asio::const_buffer(buffer.data(), length),
+                    [this, self](asio::error_code ec, size_t bytes_transferred) {
+                      if (ec) {
+                        OnError(kPhaseTransfer, ec);
+                        return;
+                      }
+                      stats().Add(Stats::kTxBytes, bytes_transferred);
+                      stats().Add(Stats::kTxTimes);
+                      write_left_ -= bytes_transferred;
+                      if (request_->mode == kSinkEcho) {
+                        // read the echo back before the next chunk
+                        read_left_ += bytes_transferred;
+                        ReadResponse();
+                      } else {
+                        WritePayload();
+                      }
+                    });
+}
+
+void Tunnel::ReadResponse() {
+  if (read_left_ == 0) {
+    if (write_left_ != 0) {
+      WritePayload();
+      return;
+    }
+    g_completed_requests.fetch_add(1, std::memory_order_relaxed);
+    NextRequest();
+    return;
+  }
+
+  scoped_refptr<Tunnel> self(this);
+  size_t length = std::min<uint64_t>(read_left_, recv_buffer_.size());
+  socket_.async_read_some(asio::mutable_buffer(recv_buffer_.data(), length),
+                          [this, self](asio::error_code ec, size_t bytes_transferred) {
+                            if (ec) {
+                              OnError(kPhaseTransfer, ec);
+                              return;
+                            }
+                            if (!first_byte_) {
+                              OnFirstByte();
+                            }
+                            stats().Add(Stats::kRxBytes, bytes_transferred);
+                            stats().Add(Stats::kRxTimes);
+                            read_left_ -= bytes_transferred;
+                            ReadResponse();
+                          });
+}
+
+void Tunnel::OnFirstByte() {
+  first_byte_ = true;
+  stats().RecordNanoseconds(Stats::kTtfbLatency, GetMonotonicTime() - request_start_);
+}
+
+void Tunnel::OnError(Phase phase, asio::error_code ec) {
+  if (!closed_) {
+    VLOG(1) << "Tunnel failed at " << PhaseName(phase) << " due to: " << ec;
+    RecordError(phase, ec);
+  }
+  Done();
+}
+
+void Tunnel::Done() {
+  if (connected_) {
+    connected_ = false;
+    stats().Add(Stats::kConnectionsClosed);
+  }
+  Close();
+  callback_t callback = std::move(callback_);
+  callback_ = nullptr;
+  if (callback) {
+    callback();
+  }
+}
+
+}  // namespace net::loadgen
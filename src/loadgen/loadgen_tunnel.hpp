@@ -0,0 +1,140 @@
+// SPDX-License-Identifier: GPL-2.0
+/* Copyright (c) 2024 Chilledheart  */
+
+#ifndef H_LOADGEN_TUNNEL
+#define H_LOADGEN_TUNNEL
+
+#include <absl/functional/any_invocable.h>
+#include <base/memory/ref_counted.h>
+#include <base/memory/scoped_refptr.h>
+
+#include <map>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "loadgen/sink_connection.hpp"
+#include "net/asio.hpp"
+#include "net/stats.hpp"
+
+namespace net::loadgen {
+
+/// statistics of all tunnels opened by the load generator
+///
+///    kConnectLatency: tcp connect to the proxy
+///    kHandshakeLatency: proxy handshake (CONNECT or SOCKS5 request)
+///    kTtfbLatency: from request sent to the first byte of response
+Stats& stats();
+
+/// The phase where a tunnel failed, used by the error breakdown
+enum Phase {
+  kPhaseConnect,
+  kPhaseHandshake,
+  kPhaseTransfer,
+  kPhaseMax,
+};
+
+const char* PhaseName(Phase phase);
+
+/// record a failed tunnel
+void RecordError(Phase phase, asio::error_code ec);
+
+/// the failed tunnels grouped by phase and error message
+std::map<std::string, uint64_t> GetErrorBreakdown();
+
+/// total requests completed by all tunnels
+uint64_t GetCompletedRequests();
+
+enum ProxyProtocol {
+  kProxyHttp,
+  kProxySocks5,
+};
+
+bool ParseProxyProtocol(std::string_view name, ProxyProtocol* protocol);
+
+/// One kind of request in the traffic mix, e.g. "download:64k:3"
+struct TrafficMix {
+  SinkMode mode;
+  uint64_t bytes;
+  int weight;
+};
+
+/// parse the traffic mix in form of "<echo|upload|download>:<bytes>[:<weight>],..."
+/// bytes accepts k, m and g suffixes (binary)
+///
+/// \return false if the text is malformed
+bool ParseTrafficMix(std::string_view text, std::vector<TrafficMix>* mix, std::string* err);
+
+struct TunnelOptions {
+  asio::ip::tcp::endpoint proxy_endpoint;
+  ProxyProtocol protocol = kProxyHttp;
+  /// the destination of tunnels, i.e. the sink server
+  std::string sink_host;
+  uint16_t sink_port = 0;
+  std::vector<TrafficMix> traffic_mix;
+  int requests_per_tunnel = 1;
+};
+
+/// A client-side tunnel through the proxy which issues requests to the sink
+/// server in the given traffic mix.
+class Tunnel : public gurl_base::RefCountedThreadSafe<Tunnel> {
+ public:
+  using callback_t = absl::AnyInvocable<void()>;
+
+  Tunnel(asio::io_context& io_context, const TunnelOptions& options);
+  ~Tunnel();
+
+  Tunnel(const Tunnel&) = delete;
+  Tunnel& operator=(const Tunnel&) = delete;
+
+  /// connect, handshake and issue all the requests
+  ///
+  /// \param callback called once the tunnel is closed, successfully or not
+  void Start(callback_t&& callback);
+
+  /// abort any pending operation
+  void Close();
+
+ private:
+  void OnConnect(asio::error_code ec);
+  void WriteHttpRequest();
+  void ReadHttpResponse();
+  void WriteSocks5MethodSelect();
+  void ReadSocks5MethodSelect();
+  void WriteSocks5Request();
+  void ReadSocks5Reply();
+  void OnHandshake();
+
+  void NextRequest();
+  void WritePayload();
+  void ReadResponse();
+  void OnFirstByte();
+
+  void OnError(Phase phase, asio::error_code ec);
+  void Done();
+
+  asio::ip::tcp::socket socket_;
+  const TunnelOptions& options_;
+  callback_t callback_;
+  bool connected_ = false;
+  bool closed_ = false;
+
+  uint64_t connect_start_ = 0;
+  uint64_t handshake_start_ = 0;
+  uint64_t request_start_ = 0;
+
+  std::string handshake_;
+  std::string handshake_response_;
+
+  int requests_left_ = 0;
+  const TrafficMix* request_ = nullptr;
+  uint8_t request_header_[kSinkRequestSize];
+  uint64_t write_left_ = 0;
+  uint64_t read_left_ = 0;
+  bool first_byte_ = false;
+  std::vector<uint8_t> recv_buffer_;
+};
+
+}  // namespace net::loadgen
+
+#endif  // H_LOADGEN_TUNNEL
@@ -0,0 +1,174 @@
+// SPDX-License-Identifier: GPL-2.0
+/* Copyright (c) 2024 Chilledheart  */
+
+#include "loadgen/sink_connection.hpp"
+
+#include "core/logging.hpp"
+
+namespace net::loadgen {
+
+namespace {
+
+constexpr const size_t kSinkBufferSize = 16384;
+constexpr const uint8_t kUploadAck = 'A';
+
+}  // namespace
+
+void EncodeSinkRequest(SinkMode mode, uint64_t length, uint8_t* request) {
+  request[0] = mode;
+  for (int i = 0; i < 8; ++i) {
+    request[1 + i] = static_cast<uint8_t>(length >> (56 - 8 * i));
+  }
+}
+
+SinkConnection::SinkConnection(asio::io_context& io_context,
+                               std::string_view remote_host_ips,
+                               std::string_view remote_host_sni,
+                               uint16_t remote_port,
+                               bool upstream_https_fallback,
+                               bool https_fallback,
+                               bool enable_upstream_tls,
+                               bool enable_tls,
+                               SSL_CTX* upstream_ssl_ctx,
+                               SSL_CTX* ssl_ctx)
+    : Connection(io_context,
+                 remote_host_ips,
+                 remote_host_sni,
+                 remote_port,
+                 upstream_https_fallback,
+                 https_fallback,
+                 enable_upstream_tls,
+                 enable_tls,
+                 upstream_ssl_ctx,
+                 ssl_ctx),
+      buf_(std::make_unique<uint8_t[]>(kSinkBufferSize)) {}
+
+SinkConnection::~SinkConnection() {
+  VLOG(1) << "Connection (sink) " << connection_id() << " freed memory";
+}
+
+void SinkConnection::start() {
+  ReadRequest();
+}
+
+void SinkConnection::close() {
+  if (closed_) {
+    return;
+  }
+  closed_ = true;
+  VLOG(2) << "Connection (sink) " << connection_id() << " disconnected";
+  asio::error_code ec;
+  downlink_->socket_.close(ec);
+  on_disconnect();
+}
+
+void SinkConnection::ReadRequest() {
+  scoped_refptr<SinkConnection> self(this);
+  asio::async_read(downlink_->socket_, asio::mutable_buffer(request_, sizeof(request_)),
+                   [this, self](asio::error_code ec, size_t bytes_transferred) {
+                     if (ec) {
+                       OnError(ec);
+                       return;
+                     }
+                     OnRequest();
+                   });
+}
+
+void SinkConnection::OnRequest() {
+  remaining_ = 0;
+  for (int i = 0; i < 8; ++i) {
+    remaining_ = (remaining_ << 8) | request_[1 + i];
+  }
+  switch (request_[0]) {
+    case kSinkEcho:
+      ReadEcho();
+      break;
+    case kSinkUpload:
+      ReadUpload();
+      break;
+    case kSinkDownload:
+      WriteDownload();
+      break;
+    default:
+      LOG(WARNING) << "Connection (sink) " << connection_id() << " unexpected request: " << (int)request_[0];
+      OnError(asio::error::invalid_argument);
+      break;
+  }
+}
+
+void SinkConnection::ReadEcho() {
+  if (remaining_ == 0) {
+    ReadRequest();
+    return;
+  }
+  scoped_refptr<SinkConnection> self(this);
+  size_t length = std::min<uint64_t>(remaining_, kSinkBufferSize);
+  downlink_->socket_.async_read_some(
+      asio::mutable_buffer(buf_.get(), length), [this, self](asio::error_code ec, size_t bytes_transferred) {
+        if (ec) {
+          OnError(ec);
+          return;
+        }
+        remaining_ -= bytes_transferred;
+        asio::async_write(downlink_->socket_, asio::const_buffer(buf_.get(), bytes_transferred),
+                          [this, self](asio::error_code ec, size_t bytes_transferred) {
+                            if (ec) {
+                              OnError(ec);
+                              return;
+                            }
+                            ReadEcho();
+                          });
+      });
+}
+
+void SinkConnection::ReadUpload() {
+  scoped_refptr<SinkConnection> self(this);
+  if (remaining_ == 0) {
+    asio::async_write(downlink_->socket_, asio::const_buffer(&kUploadAck, sizeof(kUploadAck)),
+                      [this, self](asio::error_code ec, size_t bytes_transferred) {
+                        if (ec) {
+                          OnError(ec);
+                          return;
+                        }
+                        ReadRequest();
+                      });
+    return;
+  }
+  size_t length = std::min<uint64_t>(remaining_, kSinkBufferSize);
+  downlink_->socket_.async_read_some(asio::mutable_buffer(buf_.get(), length),
+                                     [this, self](asio::error_code ec, size_t bytes_transferred) {
+                                       if (ec) {
+                                         OnError(ec);
+                                         return;
+                                       }
+                                       remaining_ -= bytes_transferred;
+                                       ReadUpload();
+                                     });
+}
+
+void SinkConnection::WriteDownload() {
+  if (remaining_ == 0) {
+    ReadRequest();
+    return;
+  }
+  scoped_refptr<SinkConnection> self(this);
+  size_t length = std::min<uint64_t>(remaining_, kSinkBufferSize);
+  asio::async_write(downlink_->socket_, asio::const_buffer(buf_.get(), length),
+                    [this, self](asio::error_code ec, size_t bytes_transferred) {
+                      if (ec) {
+                        OnError(ec);
+                        return;
+                      }
+                      remaining_ -= bytes_transferred;
+                      WriteDownload();
+                    });
+}
+
+void SinkConnection::OnError(asio::error_code ec) {
+  if (ec != asio::error::eof && ec != asio::error::operation_aborted && ec != asio::error::bad_descriptor) {
+    VLOG(1) << "Connection (sink) " << connection_id() << " closed due to: " << ec;
+  }
+  close();
+}
+
+}  // namespace net::loadgen
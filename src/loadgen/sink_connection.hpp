@@ -0,0 +1,87 @@
+// SPDX-License-Identifier: GPL-2.0
+/* Copyright (c) 2024 Chilledheart  */
+
+#ifndef H_LOADGEN_SINK_CONNECTION
+#define H_LOADGEN_SINK_CONNECTION
+
+#include <base/memory/ref_counted.h>
+#include <base/memory/scoped_refptr.h>
+
+#include "net/connection.hpp"
+#include "net/content_server.hpp"
+
+namespace net::loadgen {
+
+/// The requests understood by the sink server.
+///
+/// Each request is made of one byte of mode followed by the payload length in
+/// 8 bytes (big endian), and requests can be pipelined on one connection:
+///
+///    kSinkEcho: the payload follows the request and is written back
+///    kSinkUpload: the payload follows the request, one byte is written back
+///                 once the payload is received
+///    kSinkDownload: no payload follows, the sink writes the payload
+enum SinkMode : uint8_t {
+  kSinkEcho = 'E',
+  kSinkUpload = 'U',
+  kSinkDownload = 'D',
+};
+
+constexpr const size_t kSinkRequestSize = 9;
+
+/// encode a request to the sink
+void EncodeSinkRequest(SinkMode mode, uint64_t length, uint8_t* request);
+
+/// The built-in destination of the tunnels, so the load generator is runnable
+/// without any network.
+class SinkConnection : public gurl_base::RefCountedThreadSafe<SinkConnection>, public Connection {
+ public:
+  static constexpr const ConnectionFactoryType Type = CONNECTION_FACTORY_CONTENT_PROVIDER;
+  static constexpr const std::string_view Name = "sink";
+
+ public:
+  SinkConnection(asio::io_context& io_context,
+                 std::string_view remote_host_ips,
+                 std::string_view remote_host_sni,
+                 uint16_t remote_port,
+                 bool upstream_https_fallback,
+                 bool https_fallback,
+                 bool enable_upstream_tls,
+                 bool enable_tls,
+                 SSL_CTX* upstream_ssl_ctx,
+                 SSL_CTX* ssl_ctx);
+
+  ~SinkConnection() override;
+
+  SinkConnection(const SinkConnection&) = delete;
+  SinkConnection& operator=(const SinkConnection&) = delete;
+
+  SinkConnection(SinkConnection&&) = delete;
+  SinkConnection& operator=(SinkConnection&&) = delete;
+
+  /// Enter the start phase, begin to read requests
+  void start();
+
+  /// Close the socket and clean up
+  void close();
+
+ private:
+  void ReadRequest();
+  void OnRequest();
+  void ReadEcho();
+  void ReadUpload();
+  void WriteDownload();
+  void OnError(asio::error_code ec);
+
+  uint8_t request_[kSinkRequestSize];
+  uint64_t remaining_ = 0;
+  std::unique_ptr<uint8_t[]> buf_;
+  bool closed_ = false;
+};
+
+using SinkConnectionFactory = ConnectionFactory<SinkConnection>;
+using SinkServer = ContentServer<SinkConnectionFactory>;
+
+}  // namespace net::loadgen
+
+#endif  // H_LOADGEN_SINK_CONNECTION
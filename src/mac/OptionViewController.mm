@@ -2,6 +2,7 @@
 /* Copyright (c) 2022-2024 Chilledheart  */
 
 #import "mac/OptionViewController.h"
+#import "mac/YassAppDelegate.h"
 
 #include <absl/flags/flag.h>
 
@@ -38,6 +39,9 @@
   absl::SetFlag(&FLAGS_enable_post_quantum_kyber, self.enablePostQuantumKyber.state == NSControlStateValueOn);
   config::SaveConfig();
   [self dismissViewController:self];
+
+  YassAppDelegate* appDelegate = (YassAppDelegate*)NSApplication.sharedApplication.delegate;
+  [appDelegate OnReload];
 }
 
 - (IBAction)OnCancelButtonClicked:(id)sender {
@@ -13,6 +13,7 @@ enum YASSState { STOPPED, STARTED, STARTING, START_FAILED, STOPPING };
 - (NSString*)getStatus;
 - (void)OnStart;
 - (void)OnStop:(BOOL)quiet;
+- (void)OnReload;
 
 @end
 
@@ -26,10 +26,12 @@
 - (void)OnStarted;
 - (void)OnStartFailed:(std::string)error_msg;
 - (void)OnStopped;
+- (void)OnRestart;
 @end
 
 @implementation YassAppDelegate {
   enum YASSState state_;
+  BOOL restart_pending_;
   std::string error_msg_;
   Worker worker_;
 }
@@ -162,6 +164,23 @@
   worker_.Stop(std::move(callback));
 }
 
+- (void)OnReload {
+  if (state_ != STARTED) {
+    return;
+  }
+  worker_.Reload([=](asio::error_code ec) {
+    if (ec != asio::error::operation_not_supported) {
+      if (ec) {
+        LOG(WARNING) << "Failed to reload config due to: " << ec;
+      }
+      return;
+    }
+    dispatch_async(dispatch_get_main_queue(), ^{
+      [self OnRestart];
+    });
+  });
+}
+
 - (void)OnStarted {
   state_ = STARTED;
   config::SaveConfig();
@@ -187,6 +206,20 @@
   state_ = STOPPED;
   YassWindowController* windowController = [YassWindowController instance];
   [windowController Stopped];
+  if (restart_pending_) {
+    restart_pending_ = FALSE;
+    YassViewController* viewController = [YassViewController instance];
+    [viewController OnStart];
+  }
+}
+
+- (void)OnRestart {
+  if (state_ != STARTED) {
+    return;
+  }
+  restart_pending_ = TRUE;
+  YassViewController* viewController = [YassViewController instance];
+  [viewController OnStop];
 }
 
 - (std::string)SaveConfig {
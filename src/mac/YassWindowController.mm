@@ -108,8 +108,8 @@ static YassWindowController* __weak _instance;
   uint64_t sync_time = GetMonotonicTime();
   uint64_t delta_time = sync_time - last_sync_time_;
   if (delta_time > NS_PER_SECOND) {
-    uint64_t rx_bytes = net::cli::total_rx_bytes;
-    uint64_t tx_bytes = net::cli::total_tx_bytes;
+    uint64_t rx_bytes = net::cli::total_rx_bytes();
+    uint64_t tx_bytes = net::cli::total_tx_bytes();
     rx_rate_ = static_cast<double>(rx_bytes - last_rx_bytes_) / delta_time * NS_PER_SECOND;
     tx_rate_ = static_cast<double>(tx_bytes - last_tx_bytes_) / delta_time * NS_PER_SECOND;
     last_sync_time_ = sync_time;
@@ -0,0 +1,135 @@
+// SPDX-License-Identifier: GPL-2.0
+/* Copyright (c) 2024 Chilledheart  */
+
+#include "net/access_log.hpp"
+
+#include <absl/flags/flag.h>
+#include <absl/strings/str_format.h>
+#include <absl/synchronization/mutex.h>
+#include <cstdlib>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+#include "config/config_network.hpp"
+#include "core/logging.hpp"
+
+namespace net {
+
+namespace {
+
+// the records are dropped above it if the writer falls behind
+constexpr size_t kMaxPendingRecords = 4096;
+
+struct PendingRecord {
+  AccessLogRecord record;
+  // the copy of record.target, which doesn't outlive the connection
+  ss::request target;
+};
+
+class AccessLogWriter {
+ public:
+  static AccessLogWriter* GetInstance() {
+    static AccessLogWriter* writer = new AccessLogWriter;
+    return writer;
+  }
+
+  void Push(const AccessLogRecord& record) {
+    absl::MutexLock l(&mutex_);
+    if (!started_) {
+      started_ = true;
+      std::thread([this]() { Run(); }).detach();
+      atexit([]() { FlushAccessLog(); });
+    }
+    if (pending_.size() >= kMaxPendingRecords) {
+      ++dropped_;
+      return;
+    }
+    PendingRecord& pending = pending_.emplace_back();
+    pending.record = record;
+    if (record.target) {
+      pending.target = *record.target;
+    }
+  }
+
+  void Flush() {
+    absl::MutexLock l(&writer_mutex_);
+    Write();
+  }
+
+ private:
+  AccessLogWriter() = default;
+
+  bool HasPending() const ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_) { return !pending_.empty(); }
+
+  void Run() {
+    while (true) {
+      {
+        absl::MutexLock l(&mutex_);
+        mutex_.Await(absl::Condition(this, &AccessLogWriter::HasPending));
+      }
+      absl::MutexLock l(&writer_mutex_);
+      Write();
+    }
+  }
+
+  void Write() ABSL_EXCLUSIVE_LOCKS_REQUIRED(writer_mutex_) {
+    uint64_t dropped;
+    {
+      absl::MutexLock l(&mutex_);
+      writing_.swap(pending_);
+      dropped = dropped_;
+      dropped_ = 0;
+    }
+    for (const PendingRecord& pending : writing_) {
+      WriteRecord(pending);
+    }
+    writing_.clear();
+    if (dropped) {
+      LOG(WARNING) << "access: dropped " << dropped << " records";
+    }
+  }
+
+  static void WriteRecord(const PendingRecord& pending) {
+    const AccessLogRecord& record = pending.record;
+    std::ostringstream target;
+    if (!record.target) {
+      target << "-";
+    } else if (pending.target.address_type() == ss::domain) {
+      target << pending.target.domain_name() << ":" << pending.target.port();
+    } else {
+      target << pending.target.endpoint();
+    }
+    LOG(INFO) << absl::StrFormat(
+        "access: kind=%s id=%d peer=%s:%u target=%s rx=%u tx=%u handshake_us=%u ttfb_us=%u duration_us=%u "
+        "queue_peak=%u/%u reason=\"%s\"",
+        record.kind, record.connection_id, record.peer.address().to_string(), record.peer.port(), target.str(),
+        record.rx_bytes, record.tx_bytes, record.handshake_ns / 1000, record.ttfb_ns / 1000, record.duration_ns / 1000,
+        record.upstream_queue_peak, record.downstream_queue_peak,
+        record.reason ? record.reason.message() : std::string("ok"));
+  }
+
+  absl::Mutex mutex_;
+  std::vector<PendingRecord> pending_ ABSL_GUARDED_BY(mutex_);
+  uint64_t dropped_ ABSL_GUARDED_BY(mutex_) = 0;
+  bool started_ ABSL_GUARDED_BY(mutex_) = false;
+
+  // serializes the writer thread and synchronous flushes, keeping the order
+  absl::Mutex writer_mutex_;
+  std::vector<PendingRecord> writing_ ABSL_GUARDED_BY(writer_mutex_);
+};
+
+}  // namespace
+
+void LogAccess(const AccessLogRecord& record) {
+  if (!absl::GetFlag(FLAGS_access_log)) {
+    return;
+  }
+  AccessLogWriter::GetInstance()->Push(record);
+}
+
+void FlushAccessLog() {
+  AccessLogWriter::GetInstance()->Flush();
+}
+
+}  // namespace net
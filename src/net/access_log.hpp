@@ -0,0 +1,50 @@
+// SPDX-License-Identifier: GPL-2.0
+/* Copyright (c) 2024 Chilledheart  */
+
+#ifndef H_NET_ACCESS_LOG
+#define H_NET_ACCESS_LOG
+
+#include <cstdint>
+
+#include "net/asio.hpp"
+#include "net/ss_request.hpp"
+
+namespace net {
+
+/// The record of one connection, emitted once when it is closed
+struct AccessLogRecord {
+  /// the kind of connection, e.g. "client" or "server"
+  const char* kind;
+  int connection_id;
+  asio::ip::tcp::endpoint peer;
+  /// the requested host and port, nullptr if the request is not parsed yet
+  const ss::request* target;
+  /// bytes received from and sent to the peer
+  uint64_t rx_bytes;
+  uint64_t tx_bytes;
+  /// from accept to request parsed, in nanoseconds, 0 if not reached
+  uint64_t handshake_ns;
+  /// from upstream connect to the first byte from upstream, in nanoseconds, 0 if not reached
+  uint64_t ttfb_ns;
+  /// from accept to close, in nanoseconds
+  uint64_t duration_ns;
+  /// the most bytes queued to upstream and to downstream
+  uint64_t upstream_queue_peak;
+  uint64_t downstream_queue_peak;
+  /// the error which closes the connection, empty if closed normally
+  asio::error_code reason;
+};
+
+/// queue the record if --access_log is set
+///
+/// The record is copied as is, a background thread formats it in a single line
+/// of key=value pairs and logs it at INFO level, so the io thread neither
+/// formats nor takes the logging locks.
+void LogAccess(const AccessLogRecord& record);
+
+/// write out all queued records, e.g. before exiting
+void FlushAccessLog();
+
+}  // namespace net
+
+#endif  // H_NET_ACCESS_LOG
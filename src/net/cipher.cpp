@@ -9,10 +9,13 @@
 #include "third_party/boringssl/src/include/openssl/base64.h"
 #include "third_party/boringssl/src/include/openssl/md5.h"
 
+#include "config/config_core.hpp"
 #include "core/logging.hpp"
+#include "crypto/crypter_backend.hpp"
 #include "crypto/decrypter.hpp"
 #include "crypto/encrypter.hpp"
 #include "net/hkdf_sha1.hpp"
+#include "net/replay_filter.hpp"
 
 #define CHUNK_SIZE_LEN 2U
 #define CHUNK_SIZE_MASK 0x3FFFU
@@ -212,7 +215,10 @@ void cipher::process_bytes(std::shared_ptr<IOBuf> ciphertext) {
     if (chunk_->length() < key_len_) {
       return;
     }
-    decrypt_salt(chunk_.get());
+    if (!decrypt_salt(chunk_.get())) {
+      visitor_->on_protocol_error();
+      return;
+    }
 
     init_ = true;
   }
@@ -243,6 +249,15 @@ void cipher::process_bytes(std::shared_ptr<IOBuf> ciphertext) {
   chunk_->retreat(chunk_->headroom());
 }
 
+size_t cipher::trim() {
+  if (!chunk_ || !chunk_->empty()) {
+    return 0u;
+  }
+  size_t bytes = chunk_->capacity();
+  chunk_.reset();
+  return bytes;
+}
+
 void cipher::encrypt(const uint8_t* plaintext_data, size_t plaintext_size, std::shared_ptr<IOBuf> ciphertext) {
   DCHECK(ciphertext);
 
@@ -269,25 +284,33 @@ void cipher::encrypt(const uint8_t* plaintext_data, size_t plaintext_size, std::
   counter_ = counter;
 }
 
-void cipher::decrypt_salt(IOBuf* chunk) {
+bool cipher::decrypt_salt(IOBuf* chunk) {
   DCHECK(!init_);
 
 #ifdef HAVE_MBEDTLS
   if (impl_->cipher_id() >= CRYPTO_AES_128_CFB && impl_->cipher_id() <= CRYPTO_CAMELLIA_256_CFB) {
     size_t nonce_len = impl_->GetIVSize();
     VLOG(4) << "decrypt: nonce: " << nonce_len;
+    if (replay_filter_ && !replay_filter_->CheckAndInsert(chunk->data(), nonce_len)) {
+      LOG(WARNING) << "decrypt: replayed nonce detected";
+      return false;
+    }
     uint8_t nonce[MAX_NONCE_LENGTH] = {};
     memcpy(nonce, chunk->data(), nonce_len);
     chunk->trimStart(nonce_len);
     chunk->retreat(nonce_len);
     set_key_stream(nonce, nonce_len);
     DumpHex("DE-NONCE", nonce, nonce_len);
-    return;
+    return true;
   }
 #endif
 
   size_t salt_len = key_len_;
   VLOG(4) << "decrypt: salt: " << salt_len;
+  if (replay_filter_ && !replay_filter_->CheckAndInsert(chunk->data(), salt_len)) {
+    LOG(WARNING) << "decrypt: replayed salt detected";
+    return false;
+  }
 
   memcpy(salt_, chunk->data(), salt_len);
   chunk->trimStart(salt_len);
@@ -295,6 +318,7 @@ void cipher::decrypt_salt(IOBuf* chunk) {
   set_key_aead(salt_, salt_len);
 
   DumpHex("DE-SALT", salt_, salt_len);
+  return true;
 }
 
 void cipher::encrypt_salt(IOBuf* chunk) {
@@ -306,6 +330,9 @@ void cipher::encrypt_salt(IOBuf* chunk) {
     VLOG(4) << "encrypt: nonce: " << nonce_len;
     uint8_t nonce[MAX_NONCE_LENGTH] = {};
     gurl_base::RandBytes(nonce, nonce_len);
+    if (replay_filter_) {
+      replay_filter_->Insert(nonce, nonce_len);
+    }
     chunk->reserve(nonce_len, 0);
     chunk->prepend(nonce_len);
     memcpy(chunk->mutable_data(), nonce, nonce_len);
@@ -318,6 +345,10 @@ void cipher::encrypt_salt(IOBuf* chunk) {
   size_t salt_len = key_len_;
   VLOG(4) << "encrypt: salt: " << salt_len;
   gurl_base::RandBytes(salt_, key_len_);
+  // our own salts are rejected if reflected back
+  if (replay_filter_) {
+    replay_filter_->Insert(salt_, salt_len);
+  }
   chunk->reserve(salt_len, 0);
   chunk->prepend(salt_len);
   memcpy(chunk->mutable_data(), salt_, salt_len);
@@ -557,4 +588,12 @@ void cipher::set_key_aead(const uint8_t* salt, size_t salt_len) {
   DumpHex("NONCE_PREFIX", impl_->GetNoncePrefix(), impl_->GetNoncePrefixSize());
 }
 
+void SelectCipherBackend(enum cipher_method method) {
+  if (crypto::GetCrypterBackends(method).empty()) {
+    return;
+  }
+  auto pinned = to_crypter_backend(absl::GetFlag(FLAGS_crypto_backend));
+  crypto::SelectCrypterBackend(method, pinned == CRYPTER_BACKEND_INVALID ? CRYPTER_BACKEND_AUTO : pinned);
+}
+
 }  // namespace net
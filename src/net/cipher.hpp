@@ -25,6 +25,7 @@ class cipher_visitor_interface {
   virtual void on_protocol_error() = 0;
 };
 class cipher_impl;
+class ReplayFilter;
 ///
 /// The authenticated encryption used in yass program.
 ///
@@ -81,8 +82,20 @@ class cipher {
 
   void encrypt(const uint8_t* plaintext_data, size_t plaintext_size, std::shared_ptr<IOBuf> ciphertext);
 
+  /// release the staging buffer if it holds no partial frame
+  ///
+  /// \return the bytes released
+  size_t trim();
+
+  /// reject the salts (or IVs) already seen by the filter, and remember the
+  /// ones received and generated
+  ///
+  /// \param filter the filter shared by connections, nullptr to accept any
+  void set_replay_filter(ReplayFilter* filter) { replay_filter_ = filter; }
+
  private:
-  void decrypt_salt(IOBuf* chunk);
+  /// \return false if the salt is replayed
+  bool decrypt_salt(IOBuf* chunk);
 
   void encrypt_salt(IOBuf* chunk);
 
@@ -125,8 +138,15 @@ class cipher {
   std::unique_ptr<IOBuf> chunk_;
 
   cipher_visitor_interface* visitor_;
+  ReplayFilter* replay_filter_ = nullptr;
 };
 
+/// select the backend of the crypters created for the method later, pinned
+/// by the crypto_backend flag or the fastest one measured
+///
+/// nothing is done for the methods not implemented by the crypters
+void SelectCipherBackend(enum cipher_method method);
+
 }  // namespace net
 
 #endif  // H_NET_CIPHER
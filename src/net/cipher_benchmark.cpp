@@ -0,0 +1,85 @@
+// SPDX-License-Identifier: GPL-2.0
+/* Copyright (c) 2024 Chilledheart  */
+
+#include <benchmark/benchmark.h>
+
+#include "core/logging.hpp"
+#include "net/cipher.hpp"
+
+#include "benchmark_util.hpp"
+
+using namespace net;
+
+namespace {
+
+constexpr const std::string_view kPassword = "<dummy-password>";
+// frames decrypted before the decoder is re-created
+constexpr const int kFrames = 256;
+
+class CipherVisitor : public cipher_visitor_interface {
+ public:
+  bool on_received_data(std::shared_ptr<IOBuf> buf) override {
+    benchmark::DoNotOptimize(buf->data());
+    return true;
+  }
+
+  void on_protocol_error() override { CHECK(false) << "protocol error"; }
+};
+
+void BM_CipherEncrypt(benchmark::State& state, cipher_method method) {
+  const size_t size = state.range(0);
+  auto plaintext = benchmark::GenerateRandContent(size);
+  CipherVisitor visitor;
+  cipher encoder("", std::string(kPassword), method, &visitor, true);
+  std::shared_ptr<IOBuf> ciphertext = IOBuf::create(SOCKET_BUF_SIZE);
+
+  uint64_t allocations = benchmark::GetAllocationCount();
+  for (auto _ : state) {
+    ciphertext->clear();
+    encoder.encrypt(plaintext->data(), plaintext->length(), ciphertext);
+    benchmark::DoNotOptimize(ciphertext->data());
+  }
+  benchmark::ReportComponentCounters(state, allocations, size);
+}
+
+void BM_CipherProcessBytes(benchmark::State& state, cipher_method method) {
+  const size_t size = state.range(0);
+  auto plaintext = benchmark::GenerateRandContent(size);
+  CipherVisitor visitor;
+
+  // the frames are encrypted ahead, the first one carries the salt
+  std::vector<std::shared_ptr<IOBuf>> frames;
+  {
+    cipher encoder("", std::string(kPassword), method, &visitor, true);
+    for (int i = 0; i < kFrames; ++i) {
+      std::shared_ptr<IOBuf> frame = IOBuf::create(SOCKET_BUF_SIZE);
+      encoder.encrypt(plaintext->data(), plaintext->length(), frame);
+      frames.push_back(frame);
+    }
+  }
+
+  auto decoder = std::make_unique<cipher>("", std::string(kPassword), method, &visitor, false);
+  uint64_t allocations = benchmark::GetAllocationCount();
+  int i = 0;
+  for (auto _ : state) {
+    if (i == kFrames) {
+      // the allocations made by the new decoder are not accounted
+      state.PauseTiming();
+      uint64_t before = benchmark::GetAllocationCount();
+      decoder = std::make_unique<cipher>("", std::string(kPassword), method, &visitor, false);
+      allocations += benchmark::GetAllocationCount() - before;
+      i = 0;
+      state.ResumeTiming();
+    }
+    decoder->process_bytes(frames[i++]);
+  }
+  benchmark::ReportComponentCounters(state, allocations, size);
+}
+
+}  // namespace
+
+#define XX(num, name, string)                                                                                  \
+  BENCHMARK_CAPTURE(BM_CipherEncrypt, name, CRYPTO_##name)->Arg(64)->Arg(1024)->Arg(4096)->Arg(16 * 1024 - 1); \
+  BENCHMARK_CAPTURE(BM_CipherProcessBytes, name, CRYPTO_##name)->Arg(64)->Arg(1024)->Arg(4096)->Arg(16 * 1024 - 1);
+CIPHER_METHOD_OLD_MAP(XX)
+#undef XX
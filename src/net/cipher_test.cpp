@@ -7,6 +7,7 @@
 #include <absl/flags/flag.h>
 #include <base/rand_util.h>
 #include <gmock/gmock.h>
+#include "crypto/crypter_backend.hpp"
 #include "net/cipher.hpp"
 
 #include "test_util.hpp"
@@ -61,6 +62,36 @@ class CipherTest : public ::testing::TestWithParam<size_t>, public cipher_visito
     ASSERT_EQ(::testing::Bytes(send_buf->data(), size), ::testing::Bytes(recv_buf_->data(), size));
   }
 
+#ifdef HAVE_MBEDTLS
+  /// the data encrypted by a backend (in several calls) is decrypted by the other
+  void EncodeAndDecodeAcrossBackends(cipher_method crypto_method, size_t size) {
+    const crypter_backend backends[] = {CRYPTER_BACKEND_BORINGSSL, CRYPTER_BACKEND_MBEDTLS};
+    for (crypter_backend encoder_backend : backends) {
+      for (crypter_backend decoder_backend : backends) {
+        crypto::SelectCrypterBackend(crypto_method, encoder_backend);
+        auto encoder = std::make_unique<cipher>("", "<dummy-password>", crypto_method, this, true);
+        crypto::SelectCrypterBackend(crypto_method, decoder_backend);
+        auto decoder = std::make_unique<cipher>("", "<dummy-password>", crypto_method, this, false);
+
+        auto send_buf = GenerateRandContent(size);
+        std::shared_ptr<IOBuf> cipherbuf = IOBuf::create(size + 100);
+        size_t first = size / 3, second = size / 3 + 1;
+        encoder->encrypt(send_buf->data(), first, cipherbuf);
+        encoder->encrypt(send_buf->data() + first, second, cipherbuf);
+        encoder->encrypt(send_buf->data() + first + second, size - first - second, cipherbuf);
+        recv_buf_.reset();
+        decoder->process_bytes(cipherbuf);
+        ASSERT_EQ(ec_, asio::error_code());
+
+        ASSERT_EQ(send_buf->length(), recv_buf_->length());
+        ASSERT_EQ(::testing::Bytes(send_buf->data(), size), ::testing::Bytes(recv_buf_->data(), size))
+            << to_crypter_backend_str(encoder_backend) << " -> " << to_crypter_backend_str(decoder_backend);
+      }
+    }
+    crypto::SelectCrypterBackend(crypto_method, crypto::GetCrypterBackends(crypto_method).front());
+  }
+#endif
+
   asio::error_code ec_;
   std::shared_ptr<IOBuf> recv_buf_;
 };
@@ -73,6 +104,21 @@ class CipherTest : public ::testing::TestWithParam<size_t>, public cipher_visito
 CIPHER_METHOD_OLD_MAP(XX)
 #undef XX
 
+#ifdef HAVE_MBEDTLS
+#define XX(num, name, string)                                 \
+  TEST_P(CipherTest, name##AcrossBackends) {                  \
+    EncodeAndDecodeAcrossBackends(CRYPTO_##name, GetParam()); \
+  }
+
+XX(0x22U, AES_128_CFB, "aes-128-cfb")
+XX(0x23U, AES_192_CFB, "aes-192-cfb")
+XX(0x24U, AES_256_CFB, "aes-256-cfb")
+XX(0x25U, AES_128_CTR, "aes-128-ctr")
+XX(0x26U, AES_192_CTR, "aes-192-ctr")
+XX(0x27U, AES_256_CTR, "aes-256-ctr")
+#undef XX
+#endif
+
 INSTANTIATE_TEST_SUITE_P(SizedCipherTest,
                          CipherTest,
                          ::testing::Values(16, 256, 512, 1024, 2048, 4096, 16 * 1024 - 1),
@@ -13,10 +13,17 @@
 
 #include "config/config.hpp"
 #include "core/logging.hpp"
+#include "core/utils.hpp"
+#include "net/access_log.hpp"
 #include "net/asio.hpp"
+#include "net/fair_scheduler.hpp"
+#include "net/io_queue.hpp"
 #include "net/network.hpp"
 #include "net/protocol.hpp"
+#include "net/rate_limiter.hpp"
 #include "net/ssl_server_socket.hpp"
+#include "net/stats.hpp"
+#include "net/timer_wheel.hpp"
 
 #include <absl/functional/any_invocable.h>
 
@@ -27,12 +34,42 @@ class Downlink {
   using io_handle_t = absl::AnyInvocable<void(asio::error_code, std::size_t)>;
   using handle_t = absl::AnyInvocable<void(asio::error_code)>;
 
-  Downlink(asio::io_context& io_context) : io_context_(io_context), socket_(io_context_) {}
+  Downlink(asio::io_context& io_context)
+      : io_context_(io_context), socket_(io_context_), timer_wheel_(&TimerWheel::Get(io_context)) {}
 
   virtual ~Downlink() {}
 
   void on_accept(asio::ip::tcp::socket&& socket) { socket_ = std::move(socket); }
 
+  /// set the rate limiter charged by reads (upload direction)
+  void set_rate_limiter(std::shared_ptr<RateLimiter> rate_limiter) { rate_limiter_ = std::move(rate_limiter); }
+
+  /// wait read routine, delayed by the rate limiter if throttled
+  void async_read_some(handle_t&& cb) {
+    if (rate_limiter_) {
+      if (uint64_t delay = rate_limiter_->upload()->Delay(GetMonotonicTime())) {
+        process_stats().Add(Stats::kRateLimitStalls);
+        timer_wheel_->ScheduleNanoseconds(
+            &read_delay_timer_, delay, [this, cb = std::move(cb)]() mutable { async_read_some(std::move(cb)); });
+        return;
+      }
+    }
+    s_async_read_some(std::move(cb));
+  }
+
+  size_t read_some(std::shared_ptr<IOBuf> buf, asio::error_code& ec) {
+    size_t read = s_read_some(buf, ec);
+    if (read && rate_limiter_) {
+      rate_limiter_->upload()->Consume(read, GetMonotonicTime());
+    }
+    return read;
+  }
+
+  void close(asio::error_code& ec) {
+    read_delay_timer_.cancel();
+    s_close(ec);
+  }
+
  public:
   virtual void handshake(handle_t&& cb) { cb(asio::error_code()); }
 
@@ -44,9 +81,11 @@ class Downlink {
     return false;
   }
 
-  virtual void async_read_some(handle_t&& cb) { socket_.async_wait(asio::ip::tcp::socket::wait_read, std::move(cb)); }
+  virtual void s_async_read_some(handle_t&& cb) {
+    socket_.async_wait(asio::ip::tcp::socket::wait_read, std::move(cb));
+  }
 
-  virtual size_t read_some(std::shared_ptr<IOBuf> buf, asio::error_code& ec) {
+  virtual size_t s_read_some(std::shared_ptr<IOBuf> buf, asio::error_code& ec) {
     return socket_.read_some(tail_buffer(*buf), ec);
   }
 
@@ -68,12 +107,21 @@ class Downlink {
 
   virtual bool https_fallback() const { return false; }
 
-  virtual void close(asio::error_code& ec) { socket_.close(ec); }
+  /// the underlying ssl object, null if the downlink is not using tls
+  virtual SSL* native_ssl_handle() { return nullptr; }
+
+  virtual void s_close(asio::error_code& ec) { socket_.close(ec); }
 
  public:
   asio::io_context& io_context_;
   asio::ip::tcp::socket socket_;
   handle_t handshake_callback_;  // FIXME handle it gracefully
+
+ private:
+  /// the timer wheel of the io context, cached to skip the service lookup
+  TimerWheel* timer_wheel_;
+  std::shared_ptr<RateLimiter> rate_limiter_;
+  WheelTimer read_delay_timer_;
 };
 
 class SSLDownlink : public Downlink {
@@ -123,9 +171,9 @@ class SSLDownlink : public Downlink {
     return false;
   }
 
-  void async_read_some(handle_t&& cb) override { ssl_socket_->WaitRead(std::move(cb)); }
+  void s_async_read_some(handle_t&& cb) override { ssl_socket_->WaitRead(std::move(cb)); }
 
-  size_t read_some(std::shared_ptr<IOBuf> buf, asio::error_code& ec) override { return ssl_socket_->Read(buf, ec); }
+  size_t s_read_some(std::shared_ptr<IOBuf> buf, asio::error_code& ec) override { return ssl_socket_->Read(buf, ec); }
 
   void async_write_some(handle_t&& cb) override { ssl_socket_->WaitWrite(std::move(cb)); }
 
@@ -142,7 +190,9 @@ class SSLDownlink : public Downlink {
 
   bool https_fallback() const override { return https_fallback_; }
 
-  void close(asio::error_code& ec) override { ssl_socket_->Disconnect(); }
+  SSL* native_ssl_handle() override { return ssl_socket_->native_handle(); }
+
+  void s_close(asio::error_code& ec) override { ssl_socket_->Disconnect(); }
 
  private:
   bool https_fallback_;
@@ -154,10 +204,13 @@ class Connection {
   using handle_t = Downlink::handle_t;
 
  public:
+  /// per-connection data attached to the downlink's ssl object (via ex_data),
+  /// so the callbacks installed on the shared SSL_CTX never need to be touched
   struct tlsext_ctx_t {
     void* server;
     int connection_id;
     int listen_ctx_num;
+    Connection* connection;
   };
 
  public:
@@ -184,6 +237,7 @@ class Connection {
              SSL_CTX* upstream_ssl_ctx,
              SSL_CTX* ssl_ctx)
       : io_context_(&io_context),
+        timer_wheel_(&TimerWheel::Get(io_context)),
         remote_host_ips_(remote_host_ips),
         remote_host_sni_(remote_host_sni),
         remote_port_(remote_port),
@@ -191,6 +245,10 @@ class Connection {
         enable_upstream_tls_(enable_upstream_tls),
         enable_tls_(enable_tls),
         upstream_ssl_ctx_(upstream_ssl_ctx) {
+    // keep the context alive across config reloads, the upstream is connected later
+    if (upstream_ssl_ctx) {
+      SSL_CTX_up_ref(upstream_ssl_ctx);
+    }
     DCHECK_LE(remote_host_sni_.size(), (unsigned int)TLSEXT_MAXLEN_host_name);
     if (enable_tls) {
       DCHECK(ssl_ctx);
@@ -211,6 +269,14 @@ class Connection {
 
   void set_https_fallback(bool https_fallback) { downlink_->set_https_fallback(https_fallback); }
 
+  /// set the rate limiter of this connection, shared by downlink and upstream
+  ///
+  /// \param rate_limiter the rate limiter on the connection level
+  void set_rate_limiter(std::shared_ptr<RateLimiter> rate_limiter) {
+    rate_limiter_ = rate_limiter;
+    downlink_->set_rate_limiter(std::move(rate_limiter));
+  }
+
  public:
   /// Construct the connection with socket
   ///
@@ -231,7 +297,11 @@ class Connection {
     peer_endpoint_ = peer_endpoint;
     connection_id_ = connection_id;
     tlsext_ctx_.reset(tlsext_ctx);
+    if (tlsext_ctx_) {
+      tlsext_ctx_->connection = this;
+    }
     ssl_socket_data_index_ = ssl_socket_data_index;
+    accept_time_ = GetMonotonicTime();
   }
 
   /// set callback
@@ -265,13 +335,106 @@ class Connection {
 
   int ssl_socket_data_index() const { return ssl_socket_data_index_; }
 
+  /// the downlink's ssl object, null if the downlink is not using tls
+  SSL* downlink_ssl_handle() { return downlink_->native_ssl_handle(); }
+
  protected:
   /// the peek current io
   bool DoPeek() { return downlink_->do_peek(); }
 
+  enum IdleEvent {
+    /// no traffic within idle_trim_timeout, release the buffers
+    kIdleTrim,
+    /// no traffic within idle_timeout, close the connection
+    kIdleTimeout,
+  };
+
+  /// arm the idle timer, checked lazily so the data path never touches it
+  ///
+  /// The byte counters are sampled every period (the smaller one of
+  /// idle_trim_timeout and idle_timeout), so an event is raised up to one
+  /// period later than its timeout.
+  ///
+  /// \param on_idle invoked when no bytes are transferred with the client within the timeouts
+  void StartIdleTimer(absl::AnyInvocable<void(IdleEvent)>&& on_idle) {
+    int32_t trim_timeout = absl::GetFlag(FLAGS_idle_trim_timeout);
+    int32_t idle_timeout = absl::GetFlag(FLAGS_idle_timeout);
+    int32_t period = trim_timeout > 0 && idle_timeout > 0 ? std::min(trim_timeout, idle_timeout)
+                                                           : std::max(trim_timeout, idle_timeout);
+    if (period <= 0) {
+      return;
+    }
+    idle_bytes_transferred_ = rbytes_transferred_ + wbytes_transferred_;
+    idle_since_ = GetMonotonicTime();
+    idle_trimmed_ = false;
+    ArmIdleTimer(period, std::move(on_idle));
+  }
+
+  /// cancel the idle timer and drop its callback
+  void StopIdleTimer() { idle_timer_.cancel(); }
+
+  /// emit the access log record of the connection, called once at close
+  ///
+  /// \param kind the kind of connection
+  /// \param target the requested host and port, nullptr if not parsed yet
+  /// \param upstream the queue to upstream
+  /// \param downstream the queue to downstream
+  void LogAccessRecord(const char* kind,
+                       const ss::request* target,
+                       const IoQueue& upstream,
+                       const IoQueue& downstream) {
+    LogAccess({kind, connection_id_, peer_endpoint_, target, rbytes_transferred_, wbytes_transferred_, handshake_ns_,
+               ttfb_ns_, GetMonotonicTime() - accept_time_, upstream.peak_byte_length(), downstream.peak_byte_length(),
+               close_reason_});
+  }
+
+  /// apply --buffer_high_watermark to the queues and report their bytes to the stats
+  ///
+  /// The reading from the other side is paused above the watermark.
+  ///
+  /// \param upstream the queue to upstream
+  /// \param downstream the queue to downstream
+  /// \param stats the stats of the connection
+  static void SetupQueues(IoQueue* upstream, IoQueue* downstream, Stats* stats) {
+    size_t watermark = static_cast<size_t>(absl::GetFlag(FLAGS_buffer_high_watermark)) * 1024;
+    upstream->set_watermark(watermark);
+    upstream->set_stats(stats, Stats::kUpstreamQueuedBytes, Stats::kUpstreamQueuedBytesMax);
+    downstream->set_watermark(watermark);
+    downstream->set_stats(stats, Stats::kDownstreamQueuedBytes, Stats::kDownstreamQueuedBytesMax);
+  }
+
+ private:
+  void ArmIdleTimer(int32_t period, absl::AnyInvocable<void(IdleEvent)>&& on_idle) {
+    timer_wheel_->Schedule(
+        &idle_timer_, std::chrono::seconds(period), [this, period, on_idle = std::move(on_idle)]() mutable {
+          uint64_t now = GetMonotonicTime();
+          size_t bytes_transferred = rbytes_transferred_ + wbytes_transferred_;
+          if (bytes_transferred != idle_bytes_transferred_) {
+            idle_bytes_transferred_ = bytes_transferred;
+            idle_since_ = now;
+            idle_trimmed_ = false;
+          } else {
+            uint64_t idle_seconds = (now - idle_since_) / NS_PER_SECOND;
+            int32_t idle_timeout = absl::GetFlag(FLAGS_idle_timeout);
+            if (idle_timeout > 0 && idle_seconds >= static_cast<uint64_t>(idle_timeout)) {
+              on_idle(kIdleTimeout);
+              return;
+            }
+            int32_t trim_timeout = absl::GetFlag(FLAGS_idle_trim_timeout);
+            if (trim_timeout > 0 && !idle_trimmed_ && idle_seconds >= static_cast<uint64_t>(trim_timeout)) {
+              idle_trimmed_ = true;
+              on_idle(kIdleTrim);
+            }
+          }
+          ArmIdleTimer(period, std::move(on_idle));
+        });
+  }
+
  protected:
   /// the io context associated with
   asio::io_context* io_context_;
+  /// the timer wheel of the io context, cached to skip the service lookup
+  TimerWheel* timer_wheel_;
   /// the upstream ip to be established with
   std::string remote_host_ips_;
   /// the upstream sni to be established with
@@ -296,15 +459,40 @@ class Connection {
   bool enable_upstream_tls_;
   bool enable_tls_;
   std::string upstream_certificate_;
-  SSL_CTX* upstream_ssl_ctx_;
+  bssl::UniquePtr<SSL_CTX> upstream_ssl_ctx_;
 
   std::unique_ptr<Downlink> downlink_;
+  /// the rate limiter on the connection level, nullptr if not limited
+  std::shared_ptr<RateLimiter> rate_limiter_;
+  /// the relay loops (client to remote, and back) sharing the io context fairly, see FairScheduler
+  ScheduledFlow upload_flow_;
+  ScheduledFlow download_flow_;
 
  protected:
   /// statistics of read bytes
   size_t rbytes_transferred_ = 0;
   /// statistics of written bytes
   size_t wbytes_transferred_ = 0;
+  /// the monotonic time when the connection is accepted
+  uint64_t accept_time_ = 0;
+  /// the monotonic time when the upstream connect is issued, reset after the first byte from upstream
+  uint64_t upstream_connect_time_ = 0;
+  /// the time from accept to request parsed, in nanoseconds
+  uint64_t handshake_ns_ = 0;
+  /// the time from upstream connect to the first byte from upstream, in nanoseconds
+  uint64_t ttfb_ns_ = 0;
+  /// the error which closes the connection
+  asio::error_code close_reason_;
+
+ private:
+  /// the idle timer
+  WheelTimer idle_timer_;
+  /// bytes transferred when the idle timer is sampled
+  size_t idle_bytes_transferred_ = 0;
+  /// the monotonic time since when no bytes are transferred
+  uint64_t idle_since_ = 0;
+  /// if the buffers are released in this idle period
+  bool idle_trimmed_ = false;
 
  private:
   /// the callback invoked when disconnect event happens
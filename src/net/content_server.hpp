@@ -6,6 +6,7 @@
 
 #include <absl/container/flat_hash_map.h>
 #include <absl/flags/flag.h>
+#include <absl/strings/match.h>
 #include <absl/strings/str_format.h>
 #include <algorithm>
 #include <array>
@@ -25,6 +26,7 @@
 #include "net/connection.hpp"
 #include "net/network.hpp"
 #include "net/protocol.hpp"
+#include "net/rate_limiter.hpp"
 #include "net/ssl_socket.hpp"
 #include "net/x509_util.hpp"
 
@@ -74,6 +76,12 @@ class ContentServer {
     enable_tls_ &= T::Type == CONNECTION_FACTORY_SERVER;
     DCHECK_LE(remote_host_sni_.size(), (unsigned int)TLSEXT_MAXLEN_host_name);
 
+    uint64_t global_rate = absl::GetFlag(FLAGS_limit_rate_global).rate;
+    RateLimiter::Global()->download()->set_rate(global_rate);
+    RateLimiter::Global()->upload()->set_rate(global_rate);
+    rate_limited_ =
+        global_rate || absl::GetFlag(FLAGS_limit_rate_listener).rate || absl::GetFlag(FLAGS_limit_rate).rate;
+
     VLOG(1) << "ContentServer (" << T::Name << ") allocated memory";
   }
 
@@ -142,18 +150,23 @@ class ContentServer {
     if (ec) {
       return;
     }
-    if (enable_upstream_tls_) {
+    // ssl contexts are set up once and shared (read-only) by all listeners and connections
+    if (enable_upstream_tls_ && !upstream_ssl_ctx_) {
       setup_upstream_ssl_ctx(ec);
       if (ec) {
         return;
       }
     }
-    if (enable_tls_) {
+    if (enable_tls_ && !ssl_ctx_) {
       setup_ssl_ctx(ec);
       if (ec) {
         return;
       }
     }
+    if (rate_limited_) {
+      uint64_t listener_rate = absl::GetFlag(FLAGS_limit_rate_listener).rate;
+      ctx.rate_limiter = std::make_shared<RateLimiter>(RateLimiter::Global(), listener_rate, listener_rate);
+    }
     LOG(INFO) << "Listening (" << T::Name << ") on " << ctx.endpoint;
     int listen_ctx_num = next_listen_ctx_++;
     asio::post(io_context_, [this, listen_ctx_num]() { accept(listen_ctx_num); });
@@ -219,6 +232,76 @@ class ContentServer {
     });
   }
 
+  /// apply the reloaded config in place, called in the io thread
+  ///
+  /// Listeners and established connections are kept. The upstream address,
+  /// method and tls material apply to new connections only (the ssl contexts
+  /// in use are kept alive by their connections), while the rate limits apply
+  /// to the global and listener levels immediately.
+  ///
+  /// \param remote_host_ips the resolved upstream addresses
+  /// \param remote_host_sni the upstream server name
+  /// \param remote_port the upstream port
+  /// \param ec the error of rebuilding ssl contexts, the running ones are kept on error
+  void reload(std::string_view remote_host_ips,
+              std::string_view remote_host_sni,
+              uint16_t remote_port,
+              asio::error_code& ec) {
+    DCHECK_LE(remote_host_sni.size(), (unsigned int)TLSEXT_MAXLEN_host_name);
+
+    auto method = absl::GetFlag(FLAGS_method).method;
+    bool upstream_https_fallback =
+        CIPHER_METHOD_IS_HTTPS_FALLBACK(method) && T::Type == CONNECTION_FACTORY_CLIENT;
+    bool https_fallback = CIPHER_METHOD_IS_HTTPS_FALLBACK(method) && T::Type == CONNECTION_FACTORY_SERVER;
+    bool enable_upstream_tls = CIPHER_METHOD_IS_TLS(method) && T::Type == CONNECTION_FACTORY_CLIENT;
+    bool enable_tls = CIPHER_METHOD_IS_TLS(method) && T::Type == CONNECTION_FACTORY_SERVER;
+
+    // rebuild ssl contexts first, nothing is changed if the tls material is rejected
+    bssl::UniquePtr<SSL_CTX> upstream_ssl_ctx = std::move(upstream_ssl_ctx_);
+    bssl::UniquePtr<SSL_CTX> ssl_ctx = std::move(ssl_ctx_);
+    std::vector<SniCertificateCtx> sni_certificates = std::move(sni_certificates_);
+    sni_certificates_.clear();
+    if (enable_upstream_tls) {
+      setup_upstream_ssl_ctx(ec);
+    }
+    if (!ec && enable_tls) {
+      setup_ssl_ctx(ec);
+    }
+    if (ec) {
+      LOG(WARNING) << "ContentServer (" << T::Name << ") reload: failed to set up ssl contexts: " << ec;
+      upstream_ssl_ctx_ = std::move(upstream_ssl_ctx);
+      ssl_ctx_ = std::move(ssl_ctx);
+      sni_certificates_ = std::move(sni_certificates);
+      return;
+    }
+
+    remote_host_ips_ = remote_host_ips;
+    remote_host_sni_ = remote_host_sni;
+    remote_port_ = remote_port;
+    upstream_https_fallback_ = upstream_https_fallback;
+    https_fallback_ = https_fallback;
+    enable_upstream_tls_ = enable_upstream_tls;
+    enable_tls_ = enable_tls;
+
+    uint64_t global_rate = absl::GetFlag(FLAGS_limit_rate_global).rate;
+    RateLimiter::Global()->download()->set_rate(global_rate);
+    RateLimiter::Global()->upload()->set_rate(global_rate);
+    uint64_t listener_rate = absl::GetFlag(FLAGS_limit_rate_listener).rate;
+    rate_limited_ = global_rate || listener_rate || absl::GetFlag(FLAGS_limit_rate).rate;
+    for (int i = 0; i < next_listen_ctx_; ++i) {
+      ListenCtx& ctx = listen_ctxs_[i];
+      if (ctx.rate_limiter) {
+        ctx.rate_limiter->download()->set_rate(listener_rate);
+        ctx.rate_limiter->upload()->set_rate(listener_rate);
+      } else if (rate_limited_) {
+        ctx.rate_limiter = std::make_shared<RateLimiter>(RateLimiter::Global(), listener_rate, listener_rate);
+      }
+    }
+
+    LOG(INFO) << "ContentServer (" << T::Name << ") reloaded with " << connection_map_.size()
+              << " connections alive";
+  }
+
   size_t num_of_connections() const { return opened_connections_; }
 
  private:
@@ -243,9 +326,7 @@ class ContentServer {
           }
           tlsext_ctx_t* tlsext_ctx = nullptr;
           if (enable_tls_) {
-            tlsext_ctx = new tlsext_ctx_t{this, next_connection_id_, listen_ctx_num};
-            setup_ssl_ctx_alpn_cb(tlsext_ctx);
-            setup_ssl_ctx_tlsext_cb(tlsext_ctx);
+            tlsext_ctx = new tlsext_ctx_t{this, next_connection_id_, listen_ctx_num, nullptr};
           }
           scoped_refptr<ConnectionType> conn =
               T::Create(io_context_, remote_host_ips_, remote_host_sni_, remote_port_, upstream_https_fallback_,
@@ -279,6 +360,16 @@ class ContentServer {
     SetSocketTcpNoDelay(&socket, ec);
     conn->on_accept(std::move(socket), ctx.endpoint, ctx.peer_endpoint, connection_id, tlsext_ctx,
                     ssl_socket_data_index_);
+    if (tlsext_ctx) {
+      SSL* ssl = conn->downlink_ssl_handle();
+      DCHECK(ssl);
+      SSL_set_ex_data(ssl, GetTlsextDataIndex(), tlsext_ctx);
+    }
+    if (ctx.rate_limiter) {
+      uint64_t rate = absl::GetFlag(FLAGS_limit_rate).rate;
+      // only used from the io context of the connection
+      conn->set_rate_limiter(std::make_shared<RateLimiter>(ctx.rate_limiter, rate, rate, /*shared=*/false));
+    }
     conn->set_disconnect_cb([this, conn]() mutable { on_disconnect(conn); });
     connection_map_.insert(std::make_pair(connection_id, conn));
     ++opened_connections_;
@@ -321,6 +412,13 @@ class ContentServer {
     }
   }
 
+  /// an additional certificate/key pair selected by SNI
+  struct SniCertificateCtx {
+    std::string server_name;
+    bssl::UniquePtr<X509> cert;
+    bssl::UniquePtr<EVP_PKEY> pkey;
+  };
+
   void setup_ssl_ctx(asio::error_code& ec) {
     ssl_ctx_.reset(::SSL_CTX_new(::TLS_server_method()));
     SSL_CTX* ctx = ssl_ctx_.get();
@@ -335,35 +433,18 @@ class ContentServer {
     SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_SERVER);
 
     // Load Certificate Chain Files
-    if (private_key_.empty()) {
+    if (private_key_.empty() || certificate_from_config_) {
       private_key_ = g_private_key_content;
       certificate_ = g_certificate_chain_content;
+      certificate_from_config_ = true;
     }
 
     // Load Certificates (if set)
     if (!private_key_.empty()) {
-      CHECK(!certificate_.empty()) << "certificate buffer is not provided";
-
-      bssl::UniquePtr<BIO> bio(BIO_new_mem_buf(certificate_.data(), certificate_.size()));
-
-      static pem_password_cb* callback = [](char* buf, int size, int rwflag, void* userdata) -> int {
-        std::string password = absl::GetFlag(FLAGS_private_key_password);
-        /* not enough buffer size */
-        if (size < (int)password.size()) {
-          return -1;
-        }
-        /* empty password */
-        if (password.empty()) {
-          return 0;
-        }
-        memcpy(buf, password.c_str(), password.size());
-        return password.size();
-      };
-      static void* cb_userdata = nullptr;
-      bssl::UniquePtr<X509> cert(PEM_read_bio_X509_AUX(bio.get(), nullptr, callback, cb_userdata));
-      if (!cert) {
-        print_openssl_error();
-        ec = asio::error::bad_descriptor;
+      bssl::UniquePtr<X509> cert;
+      bssl::UniquePtr<EVP_PKEY> pkey;
+      load_certificate_and_key(certificate_, private_key_, &cert, &pkey, ec);
+      if (ec) {
         return;
       }
 
@@ -374,10 +455,7 @@ class ContentServer {
         ec = asio::error::bad_descriptor;
         return;
       }
-
       VLOG(1) << "Using certificate (in-memory)";
-      bio.reset(BIO_new_mem_buf(private_key_.data(), private_key_.size()));
-      bssl::UniquePtr<EVP_PKEY> pkey(PEM_read_bio_PrivateKey(bio.get(), nullptr, callback, cb_userdata));
 
       if (SSL_CTX_use_PrivateKey(ctx, pkey.get()) != 1) {
         print_openssl_error();
@@ -386,6 +464,22 @@ class ContentServer {
       }
       VLOG(1) << "Using privated key (in-memory)";
     }
+
+    // Load Additional Certificates selected by SNI
+    sni_certificates_.clear();
+    for (const SniCertificate& sni_certificate : g_sni_certificates) {
+      SniCertificateCtx sni_ctx;
+      sni_ctx.server_name = sni_certificate.server_name;
+      load_certificate_and_key(sni_certificate.certificate_chain_content, sni_certificate.private_key_content,
+                               &sni_ctx.cert, &sni_ctx.pkey, ec);
+      if (ec) {
+        LOG(WARNING) << "Failed to load certificate for server name: " << sni_certificate.server_name;
+        return;
+      }
+      VLOG(1) << "Using certificate (in-memory) for server name: " << sni_ctx.server_name;
+      sni_certificates_.push_back(std::move(sni_ctx));
+    }
+
     SSL_CTX_set_early_data_enabled(ctx, absl::GetFlag(FLAGS_tls13_early_data));
 
     CHECK(SSL_CTX_set_min_proto_version(ctx, TLS1_2_VERSION));
@@ -440,12 +534,66 @@ class ContentServer {
     SSL_CTX_set0_buffer_pool(ctx, x509_util::GetBufferPool());
 
     load_ca_to_ssl_ctx(ctx);
+
+    // The callbacks are installed once, per-connection data is looked up from
+    // the ssl object (see GetTlsextDataIndex), so the context is never mutated
+    // after set up.
+    SSL_CTX_set_alpn_select_cb(ctx, &ContentServer::on_alpn_select, this);
+    SSL_CTX_set_tlsext_servername_callback(ctx, &ContentServer::on_tlsext);
+    SSL_CTX_set_tlsext_servername_arg(ctx, this);
+    VLOG(1) << "Alpn support (server) enabled";
   }
 
-  void setup_ssl_ctx_alpn_cb(tlsext_ctx_t* tlsext_ctx) {
-    SSL_CTX* ctx = ssl_ctx_.get();
-    SSL_CTX_set_alpn_select_cb(ctx, &ContentServer::on_alpn_select, tlsext_ctx);
-    VLOG(1) << "Alpn support (server) enabled for connection " << next_connection_id_;
+  static void load_certificate_and_key(std::string_view certificate,
+                                       std::string_view private_key,
+                                       bssl::UniquePtr<X509>* cert,
+                                       bssl::UniquePtr<EVP_PKEY>* pkey,
+                                       asio::error_code& ec) {
+    CHECK(!certificate.empty()) << "certificate buffer is not provided";
+
+    static pem_password_cb* callback = [](char* buf, int size, int rwflag, void* userdata) -> int {
+      std::string password = absl::GetFlag(FLAGS_private_key_password);
+      /* not enough buffer size */
+      if (size < (int)password.size()) {
+        return -1;
+      }
+      /* empty password */
+      if (password.empty()) {
+        return 0;
+      }
+      memcpy(buf, password.c_str(), password.size());
+      return password.size();
+    };
+    static void* cb_userdata = nullptr;
+
+    bssl::UniquePtr<BIO> bio(BIO_new_mem_buf(certificate.data(), certificate.size()));
+    cert->reset(PEM_read_bio_X509_AUX(bio.get(), nullptr, callback, cb_userdata));
+    if (!*cert) {
+      print_openssl_error();
+      ec = asio::error::bad_descriptor;
+      return;
+    }
+
+    bio.reset(BIO_new_mem_buf(private_key.data(), private_key.size()));
+    pkey->reset(PEM_read_bio_PrivateKey(bio.get(), nullptr, callback, cb_userdata));
+    if (!*pkey) {
+      print_openssl_error();
+      ec = asio::error::bad_descriptor;
+      return;
+    }
+  }
+
+  /// the index of tlsext_ctx_t attached to each accepted ssl object
+  static int GetTlsextDataIndex() {
+    static const int index = SSL_get_ex_new_index(0, nullptr, nullptr, nullptr, nullptr);
+    return index;
+  }
+
+  static tlsext_ctx_t* GetTlsextCtxFromSSL(const SSL* ssl) {
+    DCHECK(ssl);
+    auto tlsext_ctx = static_cast<tlsext_ctx_t*>(SSL_get_ex_data(ssl, GetTlsextDataIndex()));
+    DCHECK(tlsext_ctx);
+    return tlsext_ctx;
   }
 
   static int on_alpn_select(SSL* ssl,
@@ -454,8 +602,8 @@ class ContentServer {
                             const unsigned char* in,
                             unsigned int inlen,
                             void* arg) {
-    auto tlsext_ctx = reinterpret_cast<tlsext_ctx_t*>(arg);
-    auto server = reinterpret_cast<ContentServer*>(tlsext_ctx->server);
+    auto server = reinterpret_cast<ContentServer*>(arg);
+    tlsext_ctx_t* tlsext_ctx = GetTlsextCtxFromSSL(ssl);
     int connection_id = tlsext_ctx->connection_id;
     while (inlen) {
       if (in[0] + 1u > inlen) {
@@ -464,7 +612,7 @@ class ContentServer {
       auto alpn = std::string_view(reinterpret_cast<const char*>(in + 1), in[0]);
       if (!server->https_fallback_ && NextProtoFromString(alpn) == kProtoHTTP2) {
         VLOG(1) << "Connection (" << T::Name << ") " << connection_id << " Alpn support (server) chosen: " << alpn;
-        server->set_https_fallback(connection_id, false);
+        tlsext_ctx->connection->set_https_fallback(false);
         *out = in + 1;
         *outlen = in[0];
 
@@ -476,7 +624,7 @@ class ContentServer {
       }
       if (NextProtoFromString(alpn) == kProtoHTTP11) {
         VLOG(1) << "Connection (" << T::Name << ") " << connection_id << " Alpn support (server) chosen: " << alpn;
-        server->set_https_fallback(connection_id, true);
+        tlsext_ctx->connection->set_https_fallback(true);
         *out = in + 1;
         *outlen = in[0];
         return SSL_TLSEXT_ERR_OK;
@@ -491,18 +639,9 @@ class ContentServer {
     return SSL_TLSEXT_ERR_ALERT_FATAL;
   }
 
-  void setup_ssl_ctx_tlsext_cb(tlsext_ctx_t* tlsext_ctx) {
-    SSL_CTX* ctx = ssl_ctx_.get();
-    SSL_CTX_set_tlsext_servername_callback(ctx, &ContentServer::on_tlsext);
-    SSL_CTX_set_tlsext_servername_arg(ctx, tlsext_ctx);
-
-    VLOG(1) << "TLSEXT: Servername (server) enabled for connection " << next_connection_id_
-            << " server_name: " << listen_ctxs_[tlsext_ctx->listen_ctx_num].server_name;
-  }
-
   static int on_tlsext(SSL* ssl, int* al, void* arg) {
-    auto tlsext_ctx = reinterpret_cast<tlsext_ctx_t*>(arg);
-    auto server = reinterpret_cast<ContentServer*>(tlsext_ctx->server);
+    auto server = reinterpret_cast<ContentServer*>(arg);
+    tlsext_ctx_t* tlsext_ctx = GetTlsextCtxFromSSL(ssl);
     int connection_id = tlsext_ctx->connection_id;
     int listen_ctx_num = tlsext_ctx->listen_ctx_num;
     std::string_view expected_server_name = server->listen_ctxs_[listen_ctx_num].server_name;
@@ -518,19 +657,42 @@ class ContentServer {
       return SSL_TLSEXT_ERR_OK;
     }
 
+    // Serve with the additional certificate if matched
+    if (const SniCertificateCtx* sni_ctx = server->find_sni_certificate(server_name)) {
+      if (SSL_use_certificate(ssl, sni_ctx->cert.get()) != 1 || SSL_use_PrivateKey(ssl, sni_ctx->pkey.get()) != 1) {
+        print_openssl_error();
+        return SSL_TLSEXT_ERR_ALERT_FATAL;
+      }
+      VLOG(2) << "Connection (" << T::Name << ") " << connection_id << " TLSEXT: Servername " << server_name
+              << " selected certificate for " << sni_ctx->server_name;
+      return SSL_TLSEXT_ERR_OK;
+    }
+
     VLOG(1) << "Connection (" << T::Name << ") " << connection_id << " TLSEXT: Servername mismatch "
             << "(got " << server_name << "; want " << expected_server_name << ").";
     return SSL_TLSEXT_ERR_ALERT_FATAL;
   }
 
-  void set_https_fallback(int connection_id, bool https_fallback) {
-    auto iter = connection_map_.find(connection_id);
-    if (iter != connection_map_.end()) {
-      iter->second->set_https_fallback(https_fallback);
-    } else {
-      VLOG(1) << "Connection (" << T::Name << ") " << connection_id << " Set Https Fallback fatal error:"
-              << " invalid connection id";
+  /// find the additional certificate by server name, exact matches take
+  /// precedence over wildcard ones
+  const SniCertificateCtx* find_sni_certificate(std::string_view server_name) const {
+    if (server_name.empty()) {
+      return nullptr;
+    }
+    const SniCertificateCtx* wildcard_match = nullptr;
+    size_t dot = server_name.find('.');
+    std::string_view parent = dot == std::string_view::npos ? std::string_view() : server_name.substr(dot);
+    for (const SniCertificateCtx& sni_ctx : sni_certificates_) {
+      std::string_view name = sni_ctx.server_name;
+      if (absl::EqualsIgnoreCase(name, server_name)) {
+        return &sni_ctx;
+      }
+      if (!wildcard_match && !parent.empty() && absl::StartsWith(name, "*.") &&
+          absl::EqualsIgnoreCase(name.substr(1), parent)) {
+        wildcard_match = &sni_ctx;
+      }
     }
+    return wildcard_match;
   }
 
   void setup_upstream_ssl_ctx(asio::error_code& ec) {
@@ -561,8 +723,9 @@ class ContentServer {
       return;
     }
 
-    if (upstream_certificate_.empty()) {
+    if (upstream_certificate_.empty() || upstream_certificate_from_config_) {
       upstream_certificate_ = g_certificate_chain_content;
+      upstream_certificate_from_config_ = true;
     }
 
     const auto& cert = upstream_certificate_;
@@ -645,19 +808,31 @@ class ContentServer {
   bool enable_upstream_tls_;
   bool enable_tls_;
   std::string upstream_certificate_;
+  /// the upstream certificate is loaded from config and follows reloads
+  bool upstream_certificate_from_config_ = false;
   bssl::UniquePtr<SSL_CTX> upstream_ssl_ctx_;
 
   std::string certificate_;
   std::string private_key_;
+  /// the certificate and private key are loaded from config and follow reloads
+  bool certificate_from_config_ = false;
   bssl::UniquePtr<SSL_CTX> ssl_ctx_;
 
+  /// additional certificates selected by SNI, immutable after setup_ssl_ctx
+  std::vector<SniCertificateCtx> sni_certificates_;
+
   ContentServer::Delegate* delegate_;
 
+  /// if any level of rate limiter is enabled
+  bool rate_limited_;
+
   struct ListenCtx {
     std::string server_name;
     asio::ip::tcp::endpoint endpoint;
     asio::ip::tcp::endpoint peer_endpoint;
     std::unique_ptr<asio::ip::tcp::acceptor> acceptor;
+    /// the rate limiter shared by connections accepted on this listener
+    std::shared_ptr<RateLimiter> rate_limiter;
   };
   std::array<ListenCtx, MAX_LISTEN_ADDRESSES> listen_ctxs_;
   int next_listen_ctx_ = 0;
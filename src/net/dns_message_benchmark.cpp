@@ -0,0 +1,43 @@
+// SPDX-License-Identifier: GPL-2.0
+/* Copyright (c) 2024 Chilledheart  */
+
+#include <benchmark/benchmark.h>
+
+#include "core/logging.hpp"
+#include "net/dns_message_response_parser.hpp"
+
+#include "benchmark_util.hpp"
+
+using namespace net;
+using namespace net::dns_message;
+
+namespace {
+
+// www.baidu.com: two CNAME records and two A records
+constexpr const uint8_t kResponseBytes[] = {
+    0x9e, 0x98, 0x81, 0x80, 0x00, 0x01, 0x00, 0x04, 0x00, 0x00, 0x00, 0x01, 0x03, 0x77, 0x77, 0x77, 0x05, 0x62, 0x61,
+    0x69, 0x64, 0x75, 0x03, 0x63, 0x6f, 0x6d, 0x00, 0x00, 0x01, 0x00, 0x01, 0xc0, 0x0c, 0x00, 0x05, 0x00, 0x01, 0x00,
+    0x00, 0x04, 0xab, 0x00, 0x0f, 0x03, 0x77, 0x77, 0x77, 0x01, 0x61, 0x06, 0x73, 0x68, 0x69, 0x66, 0x65, 0x6e, 0xc0,
+    0x16, 0xc0, 0x2b, 0x00, 0x05, 0x00, 0x01, 0x00, 0x00, 0x00, 0x19, 0x00, 0x0e, 0x03, 0x77, 0x77, 0x77, 0x07, 0x77,
+    0x73, 0x68, 0x69, 0x66, 0x65, 0x6e, 0xc0, 0x16, 0xc0, 0x46, 0x00, 0x01, 0x00, 0x01, 0x00, 0x00, 0x01, 0x27, 0x00,
+    0x04, 0x67, 0xeb, 0x2f, 0x67, 0xc0, 0x46, 0x00, 0x01, 0x00, 0x01, 0x00, 0x00, 0x01, 0x27, 0x00, 0x04, 0x67, 0xeb,
+    0x2e, 0x28, 0x00, 0x00, 0x29, 0x04, 0xd0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00};
+
+void BM_DnsResponseParser(benchmark::State& state) {
+  response_parser parser;
+  uint64_t allocations = benchmark::GetAllocationCount();
+  for (auto _ : state) {
+    response response;
+    parser.reset();
+    response_parser::result_type result;
+    std::tie(result, std::ignore) =
+        parser.parse(response, std::begin(kResponseBytes), std::begin(kResponseBytes), std::end(kResponseBytes));
+    CHECK_EQ(result, response_parser::good);
+    benchmark::DoNotOptimize(response);
+  }
+  benchmark::ReportComponentCounters(state, allocations, sizeof(kResponseBytes));
+}
+
+}  // namespace
+
+BENCHMARK(BM_DnsResponseParser);
@@ -11,6 +11,7 @@
 #include <string>
 #include "net/asio.hpp"
 #include "net/doh_request.hpp"
+#include "net/timer_wheel.hpp"
 
 namespace net {
 
@@ -50,7 +51,7 @@ class DoHResolver : public gurl_base::RefCountedThreadSafe<DoHResolver> {
   int doh_port_;
   std::string doh_path_;
   int timeout_ms_ = 0;
-  asio::steady_timer resolve_timer_;
+  WheelTimer resolve_timer_;
 
   bool done_ = true;
   std::deque<asio::ip::tcp::endpoint> endpoints_;
@@ -21,7 +21,7 @@ static constexpr const int kDoTPort = 853;
 using namespace dns_message;
 
 DoTResolver::DoTResolver(asio::io_context& io_context)
-    : io_context_(io_context), resolver_(io_context), resolve_timer_(io_context) {}
+    : io_context_(io_context), resolver_(io_context) {}
 
 DoTResolver::~DoTResolver() {
   Destroy();
@@ -130,11 +130,7 @@ void DoTResolver::AsyncResolve(const std::string& host, int port, AsyncResolveCa
   scoped_refptr<DoTResolver> self(this);
 
   done_ = false;
-  resolve_timer_.expires_after(std::chrono::milliseconds(timeout_ms_));
-  resolve_timer_.async_wait([this, self](asio::error_code ec) {
-    if (ec == asio::error::operation_aborted) {
-      return;
-    }
+  TimerWheel::Get(io_context_).Schedule(&resolve_timer_, std::chrono::milliseconds(timeout_ms_), [this, self]() {
     if (done_) {
       return;
     }
@@ -11,6 +11,7 @@
 #include <string>
 #include "net/asio.hpp"
 #include "net/dot_request.hpp"
+#include "net/timer_wheel.hpp"
 
 namespace net {
 
@@ -47,7 +48,7 @@ class DoTResolver : public gurl_base::RefCountedThreadSafe<DoTResolver> {
   bool init_ = false;
   std::string dot_host_;
   int timeout_ms_ = 0;
-  asio::steady_timer resolve_timer_;
+  WheelTimer resolve_timer_;
 
   bool done_ = true;
   std::deque<asio::ip::tcp::endpoint> endpoints_;
@@ -0,0 +1,107 @@
+// SPDX-License-Identifier: GPL-2.0
+/* Copyright (c) 2024 Chilledheart  */
+
+#include "net/fair_scheduler.hpp"
+
+#include <algorithm>
+
+#include "core/logging.hpp"
+
+namespace net {
+
+void ScheduledFlow::cancel() {
+  if (scheduler_) {
+    scheduler_->Unlink(this);
+    callback_ = nullptr;
+  }
+}
+
+asio::execution_context::id FairScheduler::id;
+
+FairScheduler::FairScheduler(asio::io_context& io_context)
+    : asio::execution_context::service(io_context), io_context_(io_context) {}
+
+FairScheduler::~FairScheduler() {
+  DCHECK_EQ(size_, 0u);
+}
+
+bool FairScheduler::Charge(ScheduledFlow* flow, size_t bytes) {
+  if (flow->refill_round_ != round_) {
+    // the overdraft of the last round is paid back, the credit is not carried over
+    flow->deficit_ = std::min<int64_t>(flow->deficit_, 0) + static_cast<int64_t>(kQuantum) * flow->weight_;
+    flow->refill_round_ = round_;
+  }
+  flow->deficit_ -= static_cast<int64_t>(bytes);
+  return flow->deficit_ <= 0;
+}
+
+void FairScheduler::Yield(ScheduledFlow* flow, ScheduledFlow::callback_t&& callback) {
+  DCHECK(callback);
+  DCHECK(!flow->queued());
+  flow->scheduler_ = this;
+  flow->prev_ = tail_;
+  flow->next_ = nullptr;
+  flow->callback_ = std::move(callback);
+  flow->queued_round_ = round_;
+  if (tail_) {
+    tail_->next_ = flow;
+  } else {
+    head_ = flow;
+  }
+  tail_ = flow;
+  ++size_;
+  PostTurn();
+}
+
+void FairScheduler::shutdown() {
+  while (head_) {
+    ScheduledFlow* flow = head_;
+    Unlink(flow);
+    // the callback might own the flow
+    auto callback = std::move(flow->callback_);
+  }
+  DCHECK_EQ(size_, 0u);
+}
+
+void FairScheduler::Unlink(ScheduledFlow* flow) {
+  DCHECK_EQ(flow->scheduler_, this);
+  if (flow->prev_) {
+    flow->prev_->next_ = flow->next_;
+  } else {
+    head_ = flow->next_;
+  }
+  if (flow->next_) {
+    flow->next_->prev_ = flow->prev_;
+  } else {
+    tail_ = flow->prev_;
+  }
+  flow->scheduler_ = nullptr;
+  flow->prev_ = flow->next_ = nullptr;
+  --size_;
+}
+
+void FairScheduler::PostTurn() {
+  if (posted_) {
+    return;
+  }
+  posted_ = true;
+  asio::post(io_context_, [this]() { RunTurn(); });
+}
+
+void FairScheduler::RunTurn() {
+  posted_ = false;
+  uint64_t round = round_++;
+  // the flows queued in this turn wait for the next one
+  while (head_ && head_->queued_round_ <= round) {
+    ScheduledFlow* flow = head_;
+    Unlink(flow);
+    // the callback might queue or destroy the flow
+    auto callback = std::move(flow->callback_);
+    callback();
+  }
+  if (head_) {
+    PostTurn();
+  }
+}
+
+}  // namespace net
@@ -0,0 +1,124 @@
+// SPDX-License-Identifier: GPL-2.0
+/* Copyright (c) 2024 Chilledheart  */
+
+#ifndef H_NET_FAIR_SCHEDULER
+#define H_NET_FAIR_SCHEDULER
+
+#include <cstddef>
+#include <cstdint>
+
+#include <absl/functional/any_invocable.h>
+
+#include "net/asio.hpp"
+
+namespace net {
+
+class FairScheduler;
+
+/// A flow scheduled by the FairScheduler of an io context, usually one
+/// direction of a connection.
+///
+/// The flow is intrusive, queueing and cancelling it never allocates. It is
+/// cancelled when destroyed, and it must be used from the thread running the
+/// io context only.
+class ScheduledFlow {
+ public:
+  using callback_t = absl::AnyInvocable<void()>;
+
+  /// \param weight the share of the flow relative to the others
+  explicit ScheduledFlow(uint32_t weight = 1) : weight_(weight ? weight : 1) {}
+  ~ScheduledFlow() { cancel(); }
+
+  ScheduledFlow(const ScheduledFlow&) = delete;
+  ScheduledFlow& operator=(const ScheduledFlow&) = delete;
+
+  uint32_t weight() const { return weight_; }
+  void set_weight(uint32_t weight) { weight_ = weight ? weight : 1; }
+
+  /// whether the flow is waiting for its turn
+  bool queued() const { return scheduler_ != nullptr; }
+
+  /// leave the run queue and drop the callback, do nothing if not queued
+  void cancel();
+
+ private:
+  friend class FairScheduler;
+
+  FairScheduler* scheduler_ = nullptr;
+  ScheduledFlow* prev_ = nullptr;
+  ScheduledFlow* next_ = nullptr;
+  callback_t callback_;
+
+  uint32_t weight_;
+  /// the bytes the flow might still relay in this round
+  int64_t deficit_ = 0;
+  /// the round the deficit is refilled in
+  uint64_t refill_round_ = 0;
+  /// the round the flow is queued in
+  uint64_t queued_round_ = 0;
+};
+
+/// A deficit round robin scheduler of the relay loops, one per io context.
+///
+/// A relay loop charges the bytes it relays to its flow, and once the flow's
+/// quantum (kQuantum bytes times its weight) is used up for the round, it
+/// yields to the run queue instead of reading more. Each turn of the
+/// scheduler starts a new round and resumes the flows queued before it, in
+/// order, and the other handlers of the io context run between the turns.
+///
+/// A flow woken up by the socket keeps the deficit of the round, so bulk
+/// transfers get their weighted share of each round whatever wakes them up,
+/// while a small interactive flow never waits behind more than a round.
+class FairScheduler : public asio::execution_context::service {
+ public:
+  static asio::execution_context::id id;
+
+  /// the bytes a flow of weight 1 relays in a round
+  static constexpr size_t kQuantum = 64 * 1024;
+
+  explicit FairScheduler(asio::io_context& io_context);
+  ~FairScheduler() override;
+
+  /// the scheduler associated with the io context
+  static FairScheduler& Get(asio::io_context& io_context) { return asio::use_service<FairScheduler>(io_context); }
+
+  /// charge the bytes relayed by the flow
+  ///
+  /// \param flow the flow relaying
+  /// \param bytes the bytes relayed
+  /// \return whether the quantum of the round is used up and the flow should yield
+  bool Charge(ScheduledFlow* flow, size_t bytes);
+
+  /// queue the flow to run the callback on its next turn
+  ///
+  /// \param flow the flow to queue, it must not be queued already
+  /// \param callback the callback invoked on the io context
+  void Yield(ScheduledFlow* flow, ScheduledFlow::callback_t&& callback);
+
+  /// the number of queued flows
+  size_t size() const { return size_; }
+
+  /// the current round
+  uint64_t round() const { return round_; }
+
+ private:
+  friend class ScheduledFlow;
+
+  void shutdown() override;
+
+  void Unlink(ScheduledFlow* flow);
+  void PostTurn();
+  void RunTurn();
+
+  asio::io_context& io_context_;
+  bool posted_ = false;
+  /// rounds start from 1, so a new flow is refilled on its first charge
+  uint64_t round_ = 1;
+  size_t size_ = 0;
+  ScheduledFlow* head_ = nullptr;
+  ScheduledFlow* tail_ = nullptr;
+};
+
+}  // namespace net
+
+#endif  // H_NET_FAIR_SCHEDULER
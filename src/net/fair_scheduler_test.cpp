@@ -0,0 +1,88 @@
+// SPDX-License-Identifier: GPL-2.0
+/* Copyright (c) 2024 Chilledheart  */
+
+#include <gtest/gtest-message.h>
+#include <gtest/gtest.h>
+
+#include <functional>
+#include <string>
+
+#include "net/fair_scheduler.hpp"
+
+using namespace net;
+
+TEST(FairSchedulerTest, Quantum) {
+  asio::io_context io_context;
+  FairScheduler& scheduler = FairScheduler::Get(io_context);
+  EXPECT_EQ(&scheduler, &FairScheduler::Get(io_context));
+
+  ScheduledFlow flow, heavy(2);
+  EXPECT_FALSE(scheduler.Charge(&flow, FairScheduler::kQuantum - 1));
+  EXPECT_TRUE(scheduler.Charge(&flow, 1));
+  EXPECT_FALSE(scheduler.Charge(&heavy, FairScheduler::kQuantum));
+  EXPECT_TRUE(scheduler.Charge(&heavy, FairScheduler::kQuantum + 100));
+
+  // refilled in the next round, the overdraft is paid back
+  bool resumed = false;
+  scheduler.Yield(&heavy, [&]() {
+    resumed = true;
+    EXPECT_FALSE(scheduler.Charge(&heavy, 2 * FairScheduler::kQuantum - 101));
+    EXPECT_TRUE(scheduler.Charge(&heavy, 1));
+    EXPECT_FALSE(scheduler.Charge(&flow, FairScheduler::kQuantum - 1));
+  });
+  EXPECT_TRUE(heavy.queued());
+  EXPECT_EQ(1u, scheduler.size());
+  io_context.run();
+  EXPECT_TRUE(resumed);
+  EXPECT_FALSE(heavy.queued());
+  EXPECT_EQ(0u, scheduler.size());
+}
+
+TEST(FairSchedulerTest, RoundRobin) {
+  asio::io_context io_context;
+  FairScheduler& scheduler = FairScheduler::Get(io_context);
+
+  std::string order;
+  ScheduledFlow flows[3];
+  int turns[3] = {3, 2, 1};
+  std::function<void(int)> run = [&](int i) {
+    order.push_back('a' + i);
+    scheduler.Charge(&flows[i], FairScheduler::kQuantum);
+    if (--turns[i]) {
+      scheduler.Yield(&flows[i], [&run, i]() { run(i); });
+    }
+  };
+  for (int i = 0; i < 3; ++i) {
+    scheduler.Yield(&flows[i], [&run, i]() { run(i); });
+  }
+  // the other handlers run between the turns
+  asio::post(io_context, [&]() { order.push_back('.'); });
+  io_context.run();
+
+  EXPECT_EQ("abc.aba", order);
+  EXPECT_EQ(0u, scheduler.size());
+}
+
+TEST(FairSchedulerTest, Cancel) {
+  asio::io_context io_context;
+  FairScheduler& scheduler = FairScheduler::Get(io_context);
+
+  std::string order;
+  ScheduledFlow first, second, third;
+  {
+    ScheduledFlow destroyed;
+    scheduler.Yield(&destroyed, [&]() { order.push_back('x'); });
+    scheduler.Yield(&first, [&]() {
+      order.push_back('a');
+      third.cancel();
+    });
+    scheduler.Yield(&second, [&]() { order.push_back('b'); });
+    scheduler.Yield(&third, [&]() { order.push_back('c'); });
+  }
+  EXPECT_EQ(3u, scheduler.size());
+  io_context.run();
+
+  EXPECT_EQ("ab", order);
+  EXPECT_FALSE(third.queued());
+  EXPECT_EQ(0u, scheduler.size());
+}
@@ -0,0 +1,61 @@
+// SPDX-License-Identifier: GPL-2.0
+/* Copyright (c) 2024 Chilledheart  */
+
+#include "net/http2_window_tuner.hpp"
+
+#include <algorithm>
+
+#include "core/logging.hpp"
+
+namespace net {
+
+Http2WindowTuner::Http2WindowTuner(size_t initial_window, size_t max_window)
+    : max_window_(std::max(initial_window, max_window)), window_(initial_window) {}
+
+void Http2WindowTuner::OnPingSent(uint64_t now) {
+  ping_sent_ = now;
+}
+
+uint64_t Http2WindowTuner::OnPingAck(uint64_t now) {
+  if (!ping_sent_) {
+    return 0;
+  }
+  // never report 0 as it means unknown
+  uint64_t rtt = std::max<uint64_t>(now - ping_sent_, 1);
+  ping_sent_ = 0;
+  last_rtt_sample_ = now;
+  min_rtt_ = min_rtt_ ? std::min(min_rtt_, rtt) : rtt;
+  return rtt;
+}
+
+bool Http2WindowTuner::WantsRttProbe(uint64_t now) const {
+  if (ping_sent_) {
+    return false;
+  }
+  return !min_rtt_ || now - last_rtt_sample_ >= kRttProbeInterval;
+}
+
+size_t Http2WindowTuner::OnDataConsumed(size_t bytes, uint64_t now, bool backlogged) {
+  if (!epoch_start_) {
+    epoch_start_ = now;
+  }
+  consumed_ += bytes;
+  // the peer gets a WINDOW_UPDATE after half of the window is consumed
+  if (consumed_ < window_ / 2) {
+    return 0;
+  }
+  uint64_t elapsed = now - epoch_start_;
+  consumed_ = 0;
+  epoch_start_ = now;
+
+  if (backlogged || !min_rtt_ || window_ >= max_window_ || elapsed >= 2 * min_rtt_) {
+    return 0;
+  }
+  size_t window = std::min(window_ * 2, max_window_);
+  size_t increment = window - window_;
+  VLOG(2) << "http2: stream window grown to " << window << " bytes (rtt: " << min_rtt_ / 1000 << " us)";
+  window_ = window;
+  return increment;
+}
+
+}  // namespace net
@@ -0,0 +1,79 @@
+// SPDX-License-Identifier: GPL-2.0
+/* Copyright (c) 2024 Chilledheart  */
+
+#ifndef H_NET_HTTP2_WINDOW_TUNER
+#define H_NET_HTTP2_WINDOW_TUNER
+
+#include <cstddef>
+#include <cstdint>
+
+namespace net {
+
+/// Sizes the receive window of a http2 stream after the bandwidth-delay
+/// product of the path, like the flow control auto-tuning of quic.
+///
+/// The window starts small and is doubled (up to the maximum) when the
+/// consumer drains half of it within two round trips, which means the peer is
+/// likely blocked by the window rather than by the path. The round trip time
+/// is measured by PING frames.
+///
+/// The bytes are counted as consumed when they are written to the local
+/// socket, so a slow consumer never grows the window and the bytes buffered
+/// for it are bounded by the window.
+class Http2WindowTuner {
+ public:
+  /// the opaque data of the PING frames sent to measure the round trip time
+  static constexpr uint64_t kPingId = 0x79617373u;
+
+  /// a round trip time sample older than this is refreshed (in nanoseconds)
+  static constexpr uint64_t kRttProbeInterval = 10ull * 1000 * 1000 * 1000;
+
+  /// \param initial_window the window advertised by SETTINGS
+  /// \param max_window the window is never grown beyond this
+  Http2WindowTuner(size_t initial_window, size_t max_window);
+
+  /// the current receive window
+  size_t window() const { return window_; }
+
+  /// the smallest round trip time measured (in nanoseconds), 0 if unknown
+  uint64_t min_rtt() const { return min_rtt_; }
+
+  /// a PING frame with kPingId is sent
+  ///
+  /// \param now the monotonic time in nanoseconds
+  void OnPingSent(uint64_t now);
+
+  /// the ack of the PING frame is received
+  ///
+  /// \param now the monotonic time in nanoseconds
+  /// \return the round trip time measured, 0 if no PING is outstanding
+  uint64_t OnPingAck(uint64_t now);
+
+  /// whether a PING frame should be sent to (re)measure the round trip time
+  bool WantsRttProbe(uint64_t now) const;
+
+  /// the bytes are consumed by the local socket
+  ///
+  /// \param bytes the bytes consumed
+  /// \param now the monotonic time in nanoseconds
+  /// \param backlogged whether the local write queue is backed up
+  /// \return the increment of the window to be sent in WINDOW_UPDATE, 0 if unchanged
+  size_t OnDataConsumed(size_t bytes, uint64_t now, bool backlogged);
+
+ private:
+  const size_t max_window_;
+  size_t window_;
+
+  uint64_t min_rtt_ = 0;
+  uint64_t last_rtt_sample_ = 0;
+  /// the time the outstanding PING is sent, 0 if none
+  uint64_t ping_sent_ = 0;
+
+  /// the bytes consumed since the beginning of the epoch
+  size_t consumed_ = 0;
+  uint64_t epoch_start_ = 0;
+};
+
+}  // namespace net
+
+#endif  // H_NET_HTTP2_WINDOW_TUNER
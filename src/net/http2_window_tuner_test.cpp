@@ -0,0 +1,70 @@
+// SPDX-License-Identifier: GPL-2.0
+/* Copyright (c) 2024 Chilledheart  */
+
+#include <gtest/gtest-message.h>
+#include <gtest/gtest.h>
+
+#include "net/http2_window_tuner.hpp"
+
+using namespace net;
+
+namespace {
+constexpr uint64_t kMs = 1000 * 1000;
+constexpr size_t kMiB = 1024 * 1024;
+}  // namespace
+
+TEST(Http2WindowTunerTest, MeasureRtt) {
+  Http2WindowTuner tuner(kMiB, 4 * kMiB);
+  uint64_t now = 1000 * kMs;
+  EXPECT_EQ(0u, tuner.OnPingAck(now));
+  EXPECT_TRUE(tuner.WantsRttProbe(now));
+  tuner.OnPingSent(now);
+  EXPECT_FALSE(tuner.WantsRttProbe(now));
+  EXPECT_EQ(50 * kMs, tuner.OnPingAck(now + 50 * kMs));
+  EXPECT_EQ(50 * kMs, tuner.min_rtt());
+  EXPECT_FALSE(tuner.WantsRttProbe(now + 50 * kMs));
+
+  // the smallest sample is kept
+  now += Http2WindowTuner::kRttProbeInterval + 50 * kMs;
+  EXPECT_TRUE(tuner.WantsRttProbe(now));
+  tuner.OnPingSent(now);
+  EXPECT_EQ(80 * kMs, tuner.OnPingAck(now + 80 * kMs));
+  EXPECT_EQ(50 * kMs, tuner.min_rtt());
+}
+
+TEST(Http2WindowTunerTest, GrowWhenWindowLimited) {
+  Http2WindowTuner tuner(kMiB, 4 * kMiB);
+  uint64_t now = 1000 * kMs;
+  // nothing grows without the round trip time
+  EXPECT_EQ(0u, tuner.OnDataConsumed(kMiB, now, false));
+  tuner.OnPingSent(now);
+  tuner.OnPingAck(now + 50 * kMs);
+  now += 50 * kMs;
+
+  // half of the window consumed within two round trips
+  EXPECT_EQ(0u, tuner.OnDataConsumed(kMiB / 4, now, false));
+  EXPECT_EQ(kMiB, tuner.OnDataConsumed(kMiB / 4, now + 40 * kMs, false));
+  EXPECT_EQ(2 * kMiB, tuner.window());
+  now += 40 * kMs;
+  EXPECT_EQ(2 * kMiB, tuner.OnDataConsumed(kMiB, now + 60 * kMs, false));
+  now += 60 * kMs;
+  // never beyond the maximum
+  EXPECT_EQ(0u, tuner.OnDataConsumed(2 * kMiB, now + 60 * kMs, false));
+  EXPECT_EQ(4 * kMiB, tuner.window());
+}
+
+TEST(Http2WindowTunerTest, KeepWhenSlowOrBacklogged) {
+  Http2WindowTuner tuner(kMiB, 4 * kMiB);
+  uint64_t now = 1000 * kMs;
+  tuner.OnPingSent(now);
+  tuner.OnPingAck(now + 50 * kMs);
+  now += 50 * kMs;
+
+  // the consumer is slower than the window
+  EXPECT_EQ(0u, tuner.OnDataConsumed(1, now, false));
+  EXPECT_EQ(0u, tuner.OnDataConsumed(kMiB / 2, now + 200 * kMs, false));
+  now += 200 * kMs;
+  // the local write queue is backed up
+  EXPECT_EQ(0u, tuner.OnDataConsumed(kMiB / 2, now + 10 * kMs, true));
+  EXPECT_EQ(kMiB, tuner.window());
+}
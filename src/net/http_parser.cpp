@@ -4,7 +4,6 @@
 #include "net/http_parser.hpp"
 #include "core/logging.hpp"
 #include "core/utils.hpp"
-#include "url/gurl.h"
 
 #include <absl/strings/ascii.h>
 #include <absl/strings/str_cat.h>
@@ -26,55 +25,84 @@ namespace net {
 
 constexpr const std::string_view kHttpVersionPrefix = "HTTP/";
 
+// Convert absoluteURI to relativeURI (path and query)
+// https://www.w3.org/Protocols/rfc2616/rfc2616-sec5.html#sec5.1.2
+//
+// returns the relativeURI without leading slash if needs_slash is set
+static std::string_view ToRelativeUri(std::string_view uri, bool* needs_slash) {
+  *needs_slash = false;
+  size_t scheme_end = uri.find("://"sv);
+  if (uri.empty() || uri[0] == '/' || scheme_end == std::string_view::npos) {
+    return uri;
+  }
+  std::string_view path_query = uri.substr(scheme_end + "://"sv.size());
+  path_query.remove_prefix(std::min(path_query.find_first_of("/?#"sv), path_query.size()));
+  path_query = path_query.substr(0, path_query.find('#'));
+  *needs_slash = path_query.empty() || path_query[0] != '/';
+  return path_query;
+}
+
+static bool IsHopByHopHeader(std::string_view key, const HttpHeaderLines* additional_headers) {
+  if (CompareCaseInsensitiveASCII(key, "Proxy-Connection"sv) == 0) {
+    return true;
+  }
+  if (CompareCaseInsensitiveASCII(key, "Proxy-Authorization"sv) == 0) {
+    return true;
+  }
+  if (additional_headers) {
+    for (const auto& [additional_key, additional_value] : *additional_headers) {
+      if (CompareCaseInsensitiveASCII(key, additional_key) == 0) {
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
 // Convert plain http proxy header to http request header
 //
 // reforge HTTP Request Header and pretend it to buf
 // including removal of Proxy-Connection header
+//
+// the header lines keep the order of appearance and the output is allocated once
 static void ReforgeHttpRequestImpl(std::string* header,
-                                   const std::string& version,
-                                   const char* method_str,
-                                   const absl::flat_hash_map<std::string, std::string>* additional_headers,
-                                   const std::string& uri,
-                                   const absl::flat_hash_map<std::string, std::string>& headers) {
-  std::ostringstream ss;
-  std::string canon_uri(uri);
-
-  // https://www.w3.org/Protocols/rfc2616/rfc2616-sec5.html#sec5.1.2
-  GURL url(uri);
-  // convert absoluteURI to relativeURI
-  if (url.is_valid() && url.has_host()) {
-    if (url.has_query()) {
-      canon_uri = absl::StrCat(url.path(), "?", url.query());
-    } else {
-      canon_uri = url.path();
+                                   std::string_view version,
+                                   std::string_view method,
+                                   const HttpHeaderLines* additional_headers,
+                                   std::string_view uri,
+                                   const HttpHeaderLines& headers) {
+  bool needs_slash;
+  std::string_view canon_uri = ToRelativeUri(uri, &needs_slash);
+
+  constexpr size_t kSeparatorSize = ": "sv.size() + "\r\n"sv.size();
+  size_t size = method.size() + 1 + needs_slash + canon_uri.size() + 1 + version.size() + "\r\n"sv.size();
+  for (const auto& [key, value] : headers) {
+    if (!IsHopByHopHeader(key, additional_headers)) {
+      size += key.size() + value.size() + kSeparatorSize;
     }
   }
-
-  ss << method_str << " "  // NOLINT(google-*)
-     << canon_uri << " " << version << "\r\n";
-  for (auto [key, value] : headers) {
-    if (CompareCaseInsensitiveASCII(key, "Proxy-Connection"sv) == 0) {
-      continue;
-    }
-    if (CompareCaseInsensitiveASCII(key, "Proxy-Authorization"sv) == 0) {
-      continue;
+  if (additional_headers) {
+    for (const auto& [key, value] : *additional_headers) {
+      size += key.size() + value.size() + kSeparatorSize;
     }
-    if (additional_headers) {
-      auto has_key = [&](const std::pair<std::string, std::string>& rhs) { return rhs.first == key; };
-      if (std::find_if(additional_headers->begin(), additional_headers->end(), has_key) != additional_headers->end()) {
-        continue;
-      }
+  }
+  size += "\r\n"sv.size();
+
+  header->clear();
+  header->reserve(size);
+  absl::StrAppend(header, method, " ", needs_slash ? "/" : "", canon_uri, " ", version, "\r\n");
+  for (const auto& [key, value] : headers) {
+    if (!IsHopByHopHeader(key, additional_headers)) {
+      absl::StrAppend(header, key, ": ", value, "\r\n");
     }
-    ss << key << ": " << value << "\r\n";
   }
   if (additional_headers) {
-    for (auto [key, value] : *additional_headers) {
-      ss << key << ": " << value << "\r\n";
+    for (const auto& [key, value] : *additional_headers) {
+      absl::StrAppend(header, key, ": ", value, "\r\n");
     }
   }
-  ss << "\r\n";
-
-  *header = ss.str();
+  header->append("\r\n");
+  DCHECK_EQ(header->size(), size);
 }
 
 #ifdef HAVE_BALSA_HTTP_PARSER
@@ -221,14 +249,18 @@ HttpRequestParser::HttpRequestParser(bool is_request) {
 }
 
 int HttpRequestParser::Parse(span<const uint8_t> buf, bool* ok) {
+  if (message_done_) {
+    framer_.Reset();
+    http_headers_.clear();
+    message_done_ = false;
+  }
   int processed = framer_.ProcessInput(reinterpret_cast<const char*>(buf.data()), buf.size());
   *ok = status_ == ParserStatus::Ok;
   return processed;
 }
 
-void HttpRequestParser::ReforgeHttpRequest(std::string* header,
-                                           const absl::flat_hash_map<std::string, std::string>* additional_headers) {
-  ReforgeHttpRequestImpl(header, version_input_, method_.c_str(), additional_headers, http_url_, http_headers_);
+void HttpRequestParser::ReforgeHttpRequest(std::string* header, const HttpHeaderLines* additional_headers) {
+  ReforgeHttpRequestImpl(header, version_input_, method_, additional_headers, http_url_, http_headers_);
 }
 
 void HttpRequestParser::OnRawBodyInput(std::string_view /*input*/) {}
@@ -242,7 +274,7 @@ void HttpRequestParser::ProcessHeaders(const quiche::BalsaHeaders& headers) {
   for (const std::pair<std::string_view, std::string_view>& key_value : headers.lines()) {
     std::string_view key = key_value.first;
     std::string_view value = key_value.second;
-    http_headers_[std::string(key)] = std::string(value);
+    http_headers_.emplace_back(key, value);
     if (CompareCaseInsensitiveASCII(key, "Cookie"sv) == 0) {
       value = "(masked)";
     }
@@ -297,16 +329,16 @@ void HttpRequestParser::OnRequestFirstLineInput(std::string_view /*line_input*/,
   }
   const bool is_connect = CompareCaseInsensitiveASCII(method_input, "CONNECT"sv) == 0;
   http_is_connect_ = is_connect;
-  method_ = std::string(method_input);
+  method_ = method_input;
   if (!isUrlValid(request_uri, is_connect)) {
     status_ = ParserStatus::Error;
     error_message_ = "HPE_INVALID_URL";
     return;
   }
-  http_url_ = std::string(request_uri);
-  version_input_ = std::string(version_input);
+  http_url_ = request_uri;
+  version_input_ = version_input;
   if (is_connect) {
-    std::string authority = http_url_;
+    std::string authority = std::string(http_url_);
     std::string hostname;
     uint16_t portnum;
     if (!SplitHostPortWithDefaultPort<80>(&hostname, &portnum, authority)) {
@@ -381,7 +413,8 @@ void HttpRequestParser::MessageDone() {
   if (status_ == ParserStatus::Error) {
     return;
   }
-  framer_.Reset();
+  // defer framer_.Reset() which clears the header buffer referred by the views
+  message_done_ = true;
   first_byte_processed_ = false;
   headers_done_ = false;
 }
@@ -458,11 +491,11 @@ int HttpRequestParser::Parse(span<const uint8_t> buf, bool* ok) {
   return nparsed;
 }
 
-void HttpRequestParser::ReforgeHttpRequest(std::string* header,
-                                           const absl::flat_hash_map<std::string, std::string>* additional_headers) {
-  auto version_input = absl::StrCat("HTTP/", parser_->http_major, ".", parser_->http_minor);
-  ReforgeHttpRequestImpl(header, version_input, http_method_str((http_method)parser_->method), additional_headers,
-                         http_url_, http_headers_);
+void HttpRequestParser::ReforgeHttpRequest(std::string* header, const HttpHeaderLines* additional_headers) {
+  char version_input[] = {'H', 'T', 'T', 'P', '/', static_cast<char>('0' + parser_->http_major % 10), '.',
+                          static_cast<char>('0' + parser_->http_minor % 10)};
+  ReforgeHttpRequestImpl(header, std::string_view(version_input, sizeof(version_input)),
+                         http_method_str((http_method)parser_->method), additional_headers, http_url_, http_headers_);
 }
 
 const char* HttpRequestParser::ErrorMessage() const {
@@ -507,7 +540,7 @@ static int OnHttpRequestParseUrl(const char* buf, size_t len, std::string* host,
 
 int HttpRequestParser::OnReadHttpRequestURL(http_parser* p, const char* buf, size_t len) {
   HttpRequestParser* self = reinterpret_cast<HttpRequestParser*>(p->data);
-  self->http_url_ = std::string(buf, len);
+  self->http_url_ = std::string_view(buf, len);
   if (p->method == HTTP_CONNECT) {
     if (0 != OnHttpRequestParseUrl(buf, len, &self->http_host_, &self->http_port_, 1)) {
       return 1;
@@ -520,14 +553,13 @@ int HttpRequestParser::OnReadHttpRequestURL(http_parser* p, const char* buf, siz
 
 int HttpRequestParser::OnReadHttpRequestHeaderField(http_parser* parser, const char* buf, size_t len) {
   HttpRequestParser* self = reinterpret_cast<HttpRequestParser*>(parser->data);
-  self->http_field_ = std::string(buf, len);
+  self->http_field_ = std::string_view(buf, len);
   return 0;
 }
 
 int HttpRequestParser::OnReadHttpRequestHeaderValue(http_parser* parser, const char* buf, size_t len) {
   HttpRequestParser* self = reinterpret_cast<HttpRequestParser*>(parser->data);
-  self->http_value_ = std::string(buf, len);
-  self->http_headers_[self->http_field_] = self->http_value_;
+  self->http_headers_.emplace_back(self->http_field_, std::string_view(buf, len));
   if (CompareCaseInsensitiveASCII(self->http_field_, "Host"sv) == 0 && !self->http_is_connect_) {
     std::string authority = std::string(buf, len);
     std::string hostname;
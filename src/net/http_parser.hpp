@@ -4,7 +4,10 @@
 #ifndef H_NET_HTTP_PARSER_HPP
 #define H_NET_HTTP_PARSER_HPP
 
-#include <absl/container/flat_hash_map.h>
+#include <absl/container/inlined_vector.h>
+#include <string>
+#include <string_view>
+#include <utility>
 
 #include "core/span.hpp"
 
@@ -28,6 +31,14 @@ typedef struct http_parser http_parser;
 
 namespace net {
 
+/// A header line in order of appearance.
+///
+/// The views refer to the parser's header buffer (balsa) or to the input
+/// passed to Parse (http_parser), so they are valid as long as both the parser
+/// and the input are, i.e. reforge the request before consuming the input.
+using HttpHeaderLine = std::pair<std::string_view, std::string_view>;
+using HttpHeaderLines = absl::InlinedVector<HttpHeaderLine, 16>;
+
 #ifdef HAVE_BALSA_HTTP_PARSER
 // ParserStatus represents the internal state of the parser.
 enum class ParserStatus {
@@ -53,8 +64,14 @@ class HttpRequestParser : public quiche::BalsaVisitorInterface {
   const std::string& proxy_authorization() const { return proxy_authorization_; }
   bool transfer_encoding_is_chunked() const { return headers_.transfer_encoding_is_chunked(); }
 
-  void ReforgeHttpRequest(std::string* header,
-                          const absl::flat_hash_map<std::string, std::string>* additional_headers = nullptr);
+  /// Convert plain http proxy request header to http request header
+  ///
+  /// \param header the output, reserved once with the exact size
+  /// \param additional_headers the headers to add, replacing the same ones in request
+  void ReforgeHttpRequest(std::string* header, const HttpHeaderLines* additional_headers = nullptr);
+
+  /// the parsed headers in order of appearance
+  const HttpHeaderLines& headers() const { return http_headers_; }
 
   const char* ErrorMessage() { return error_message_.empty() ? "" : error_message_.data(); }
 
@@ -89,18 +106,18 @@ class HttpRequestParser : public quiche::BalsaVisitorInterface {
   quiche::BalsaFrame framer_;
   quiche::BalsaHeaders headers_;
 
-  /// copy of method
-  std::string method_;
-  /// copy of url
-  std::string http_url_;
-  /// copy of version input
-  std::string version_input_;
+  /// view of method
+  std::string_view method_;
+  /// view of url
+  std::string_view http_url_;
+  /// view of version input
+  std::string_view version_input_;
   /// copy of parsed connect host or host field
   std::string http_host_;
   /// copy of parsed connect host or host field
   uint16_t http_port_ = 0U;
-  /// copy of parsed headers
-  absl::flat_hash_map<std::string, std::string> http_headers_;
+  /// views of parsed headers
+  HttpHeaderLines http_headers_;
   /// copy of connect method
   bool http_is_connect_ = false;
   /// copy of content type
@@ -110,6 +127,8 @@ class HttpRequestParser : public quiche::BalsaVisitorInterface {
   /// copy of proxy_authorization
   std::string proxy_authorization_;
 
+  /// the framer is reset lazily on next input, so the views stay valid
+  bool message_done_ = false;
   bool first_byte_processed_ = false;
   bool headers_done_ = false;
   ParserStatus status_ = ParserStatus::Ok;
@@ -130,8 +149,14 @@ class HttpRequestParser {
 
   int Parse(span<const uint8_t> buf, bool* ok);
 
-  void ReforgeHttpRequest(std::string* header,
-                          const absl::flat_hash_map<std::string, std::string>* additional_headers = nullptr);
+  /// Convert plain http proxy request header to http request header
+  ///
+  /// \param header the output, reserved once with the exact size
+  /// \param additional_headers the headers to add, replacing the same ones in request
+  void ReforgeHttpRequest(std::string* header, const HttpHeaderLines* additional_headers = nullptr);
+
+  /// the parsed headers in order of appearance
+  const HttpHeaderLines& headers() const { return http_headers_; }
 
   const char* ErrorMessage() const;
 
@@ -158,18 +183,16 @@ class HttpRequestParser {
 
  protected:
   ::http_parser* parser_ = nullptr;
-  /// copy of url
-  std::string http_url_;
+  /// view of url
+  std::string_view http_url_;
   /// copy of parsed connect host or host field
   std::string http_host_;
   /// copy of parsed connect host or host field
   uint16_t http_port_ = 0U;
-  /// copy of parsed header field
-  std::string http_field_;
-  /// copy of parsed header value
-  std::string http_value_;
-  /// copy of parsed headers
-  absl::flat_hash_map<std::string, std::string> http_headers_;
+  /// view of parsed header field
+  std::string_view http_field_;
+  /// views of parsed headers
+  HttpHeaderLines http_headers_;
   /// copy of connect method
   bool http_is_connect_ = false;
   /// copy of content type
@@ -0,0 +1,140 @@
+// SPDX-License-Identifier: GPL-2.0
+/* Copyright (c) 2024 Chilledheart  */
+
+#include <benchmark/benchmark.h>
+
+#include <absl/container/flat_hash_map.h>
+#include <absl/strings/str_cat.h>
+#include <absl/strings/str_split.h>
+#include <base/strings/string_util.h>
+#include <sstream>
+
+#include "core/logging.hpp"
+#include "net/http_parser.hpp"
+#include "url/gurl.h"
+
+#include "benchmark_util.hpp"
+
+using namespace net;
+using namespace std::string_literals;
+using std::string_view_literals::operator""sv;
+
+namespace {
+
+constexpr const std::string_view kConnectRequest =
+    "CONNECT www.google.com:443 HTTP/1.1\r\n"
+    "Host: www.google.com:443\r\n"
+    "User-Agent: curl/7.77.0\r\n"
+    "Proxy-Connection: Keep-Alive\r\n"
+    "\r\n";
+
+constexpr const std::string_view kGetRequest =
+    "GET http://www.example.com/index.html HTTP/1.1\r\n"
+    "Host: www.example.com\r\n"
+    "User-Agent: curl/7.77.0\r\n"
+    "Accept: */*\r\n"
+    "Proxy-Connection: Keep-Alive\r\n"
+    "\r\n";
+
+span<const uint8_t> AsBytes(std::string_view input) {
+  return span<const uint8_t>(reinterpret_cast<const uint8_t*>(input.data()), input.size());
+}
+
+#ifdef HAVE_BALSA_HTTP_PARSER
+constexpr const char kBackend[] = "balsa";
+#else
+constexpr const char kBackend[] = "http_parser";
+#endif
+
+// the former reforging, which copies the header lines into an order-less map
+// and rebuilds the request with a stream and a full url parse
+void LegacyReforgeHttpRequest(std::string* header,
+                              std::string_view request,
+                              const absl::flat_hash_map<std::string, std::string>& additional_headers) {
+  std::string_view request_line = request.substr(0, request.find("\r\n"sv));
+  std::vector<std::string_view> parts = absl::StrSplit(request_line, ' ');
+  absl::flat_hash_map<std::string, std::string> headers;
+  for (std::string_view line : absl::StrSplit(request.substr(request_line.size() + 2), "\r\n"sv, absl::SkipEmpty())) {
+    std::pair<std::string_view, std::string_view> key_value = absl::StrSplit(line, absl::MaxSplits(": "sv, 1));
+    headers[std::string(key_value.first)] = std::string(key_value.second);
+  }
+
+  std::ostringstream ss;
+  std::string canon_uri(parts[1]);
+  GURL url(canon_uri);
+  if (url.is_valid() && url.has_host()) {
+    canon_uri = url.has_query() ? absl::StrCat(url.path(), "?", url.query()) : url.path();
+  }
+  ss << parts[0] << " " << canon_uri << " " << parts[2] << "\r\n";
+  for (const auto& [key, value] : headers) {
+    if (gurl_base::CompareCaseInsensitiveASCII(key, "Proxy-Connection"sv) == 0 ||
+        gurl_base::CompareCaseInsensitiveASCII(key, "Proxy-Authorization"sv) == 0 || additional_headers.contains(key)) {
+      continue;
+    }
+    ss << key << ": " << value << "\r\n";
+  }
+  for (const auto& [key, value] : additional_headers) {
+    ss << key << ": " << value << "\r\n";
+  }
+  ss << "\r\n";
+  *header = ss.str();
+}
+
+void BM_HttpRequestParserConnect(benchmark::State& state) {
+  state.SetLabel(kBackend);
+  uint64_t allocations = benchmark::GetAllocationCount();
+  for (auto _ : state) {
+    HttpRequestParser parser;
+    bool ok;
+    int nparsed = parser.Parse(AsBytes(kConnectRequest), &ok);
+    CHECK(ok) << parser.ErrorMessage();
+    benchmark::DoNotOptimize(nparsed);
+  }
+  benchmark::ReportComponentCounters(state, allocations, kConnectRequest.size());
+}
+
+// parse a plain http request and reforge it as the server does
+void BM_HttpRequestParserReforge(benchmark::State& state) {
+  state.SetLabel(kBackend);
+  HttpHeaderLines via_headers;
+  via_headers.emplace_back("Connection"sv, "Close"sv);
+  via_headers.emplace_back("Via"sv, "YASS/1.0"sv);
+
+  uint64_t allocations = benchmark::GetAllocationCount();
+  for (auto _ : state) {
+    HttpRequestParser parser;
+    bool ok;
+    parser.Parse(AsBytes(kGetRequest), &ok);
+    CHECK(ok) << parser.ErrorMessage();
+    std::string header;
+    parser.ReforgeHttpRequest(&header, &via_headers);
+    benchmark::DoNotOptimize(header.data());
+  }
+  benchmark::ReportComponentCounters(state, allocations, kGetRequest.size());
+}
+
+// the same as above but reforged in the former way, as the baseline
+void BM_HttpRequestParserReforgeLegacy(benchmark::State& state) {
+  state.SetLabel(kBackend);
+  absl::flat_hash_map<std::string, std::string> via_headers;
+  via_headers["Connection"s] = "Close"s;
+  via_headers["Via"s] = "YASS/1.0"s;
+
+  uint64_t allocations = benchmark::GetAllocationCount();
+  for (auto _ : state) {
+    HttpRequestParser parser;
+    bool ok;
+    int nparsed = parser.Parse(AsBytes(kGetRequest), &ok);
+    CHECK(ok) << parser.ErrorMessage();
+    std::string header;
+    LegacyReforgeHttpRequest(&header, kGetRequest.substr(0, nparsed), via_headers);
+    benchmark::DoNotOptimize(header.data());
+  }
+  benchmark::ReportComponentCounters(state, allocations, kGetRequest.size());
+}
+
+}  // namespace
+
+BENCHMARK(BM_HttpRequestParserConnect);
+BENCHMARK(BM_HttpRequestParserReforge);
+BENCHMARK(BM_HttpRequestParserReforgeLegacy);
@@ -0,0 +1,87 @@
+// SPDX-License-Identifier: GPL-2.0
+/* Copyright (c) 2024 Chilledheart  */
+
+#include <gtest/gtest-message.h>
+#include <gtest/gtest.h>
+
+#include "net/http_parser.hpp"
+
+using namespace net;
+using std::string_view_literals::operator""sv;
+
+namespace {
+
+span<const uint8_t> AsBytes(std::string_view input) {
+  return span<const uint8_t>(reinterpret_cast<const uint8_t*>(input.data()), input.size());
+}
+
+}  // namespace
+
+TEST(HttpParserTest, Connect) {
+  constexpr std::string_view kRequest =
+      "CONNECT www.google.com:443 HTTP/1.1\r\n"
+      "Host: www.google.com:443\r\n"
+      "Proxy-Connection: Keep-Alive\r\n"
+      "\r\n";
+  HttpRequestParser parser;
+  bool ok;
+  int nparsed = parser.Parse(AsBytes(kRequest), &ok);
+  ASSERT_TRUE(ok) << parser.ErrorMessage();
+  EXPECT_EQ(nparsed, (int)kRequest.size());
+  EXPECT_TRUE(parser.is_connect());
+  EXPECT_EQ(parser.host(), "www.google.com");
+  EXPECT_EQ(parser.port(), 443u);
+}
+
+TEST(HttpParserTest, ReforgeKeepsOrderAndDropsHopByHopHeaders) {
+  constexpr std::string_view kRequest =
+      "GET http://www.example.com/index.html?q=1#top HTTP/1.1\r\n"
+      "Host: www.example.com\r\n"
+      "User-Agent: curl/7.77.0\r\n"
+      "Proxy-Authorization: Basic dXNlcjpwYXNz\r\n"
+      "Accept: */*\r\n"
+      "connection: Keep-Alive\r\n"
+      "Proxy-Connection: Keep-Alive\r\n"
+      "\r\n";
+  HttpRequestParser parser;
+  bool ok;
+  parser.Parse(AsBytes(kRequest), &ok);
+  ASSERT_TRUE(ok) << parser.ErrorMessage();
+  EXPECT_FALSE(parser.is_connect());
+  EXPECT_EQ(parser.host(), "www.example.com");
+  EXPECT_EQ(parser.port(), 80u);
+  ASSERT_EQ(parser.headers().size(), 6u);
+  EXPECT_EQ(parser.headers()[0].first, "Host");
+
+  HttpHeaderLines via_headers;
+  via_headers.emplace_back("Connection"sv, "Close"sv);
+  via_headers.emplace_back("Via"sv, "YASS/1.0"sv);
+  std::string header;
+  parser.ReforgeHttpRequest(&header, &via_headers);
+  EXPECT_EQ(header,
+            "GET /index.html?q=1 HTTP/1.1\r\n"
+            "Host: www.example.com\r\n"
+            "User-Agent: curl/7.77.0\r\n"
+            "Accept: */*\r\n"
+            "Connection: Close\r\n"
+            "Via: YASS/1.0\r\n"
+            "\r\n");
+}
+
+TEST(HttpParserTest, ReforgeAbsoluteUriWithoutPath) {
+  constexpr std::string_view kRequest =
+      "GET http://www.example.com?q=1 HTTP/1.1\r\n"
+      "Host: www.example.com\r\n"
+      "\r\n";
+  HttpRequestParser parser;
+  bool ok;
+  parser.Parse(AsBytes(kRequest), &ok);
+  ASSERT_TRUE(ok) << parser.ErrorMessage();
+
+  std::string header;
+  parser.ReforgeHttpRequest(&header);
+  EXPECT_EQ(header,
+            "GET /?q=1 HTTP/1.1\r\n"
+            "Host: www.example.com\r\n"
+            "\r\n");
+}
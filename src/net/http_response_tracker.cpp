@@ -0,0 +1,203 @@
+// SPDX-License-Identifier: GPL-2.0
+/* Copyright (c) 2024 Chilledheart  */
+
+#include "net/http_response_tracker.hpp"
+
+#include <absl/strings/ascii.h>
+#include <absl/strings/match.h>
+#include <absl/strings/numbers.h>
+#include <absl/strings/str_split.h>
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+#include "core/logging.hpp"
+
+using std::string_view_literals::operator""sv;
+
+namespace net {
+
+void HttpResponseTracker::OnResponseData(const uint8_t* data, size_t length) {
+  while (length && !failed_) {
+    size_t consumed = 0;
+    bool line_complete = false;
+    switch (state_) {
+      case kHead: {
+        if (pending_requests_.empty()) {
+          VLOG(1) << "http response tracker: unsolicited response";
+          failed_ = true;
+          return;
+        }
+        size_t old_size = head_.size();
+        head_.append(reinterpret_cast<const char*>(data), length);
+        size_t pos = head_.find("\r\n\r\n"sv, old_size >= 3 ? old_size - 3 : 0);
+        if (pos == std::string::npos) {
+          if (head_.size() > kMaxLineSize) {
+            VLOG(1) << "http response tracker: response head too large";
+            failed_ = true;
+          }
+          return;
+        }
+        head_.resize(pos + 4);
+        consumed = head_.size() - old_size;
+        OnHead();
+        break;
+      }
+      case kBody:
+      case kChunkData:
+      case kChunkDataEnd:
+        consumed = std::min<uint64_t>(remaining_, length);
+        remaining_ -= consumed;
+        if (remaining_ == 0) {
+          if (state_ == kBody) {
+            OnResponseDone();
+          } else if (state_ == kChunkData) {
+            // CRLF after chunk data
+            state_ = kChunkDataEnd;
+            remaining_ = 2;
+          } else {
+            state_ = kChunkSize;
+          }
+        }
+        break;
+      case kChunkSize: {
+        consumed = ReadLine(data, length, &line_complete);
+        if (!line_complete) {
+          break;
+        }
+        std::string_view size = absl::StripAsciiWhitespace(std::string_view(line_).substr(0, line_.find(';')));
+        uint64_t chunk_size;
+        if (size.empty() || !absl::SimpleHexAtoi(size, &chunk_size)) {
+          VLOG(1) << "http response tracker: bad chunk size: " << line_;
+          failed_ = true;
+          return;
+        }
+        line_.clear();
+        if (chunk_size == 0) {
+          state_ = kTrailer;
+        } else {
+          state_ = kChunkData;
+          remaining_ = chunk_size;
+        }
+        break;
+      }
+      case kTrailer: {
+        consumed = ReadLine(data, length, &line_complete);
+        if (!line_complete) {
+          break;
+        }
+        bool empty_line = line_.empty();
+        line_.clear();
+        if (empty_line) {
+          OnResponseDone();
+        }
+        break;
+      }
+      case kUntilClose:
+        consumed = length;
+        break;
+    }
+    data += consumed;
+    length -= consumed;
+  }
+}
+
+void HttpResponseTracker::OnEof() {
+  if (state_ == kUntilClose) {
+    OnResponseDone();
+  }
+}
+
+void HttpResponseTracker::OnHead() {
+  std::string_view head = head_;
+  // the status line, e.g. "HTTP/1.1 200 OK"
+  std::string_view status_line = head.substr(0, head.find("\r\n"sv));
+  std::vector<std::string_view> status_parts = absl::StrSplit(status_line, absl::MaxSplits(' ', 2));
+  int status;
+  if (!absl::StartsWith(status_line, "HTTP/1."sv) || status_parts.size() < 2 ||
+      !absl::SimpleAtoi(status_parts[1], &status)) {
+    VLOG(1) << "http response tracker: bad status line: " << status_line;
+    failed_ = true;
+    return;
+  }
+
+  // the protocol is switched, nothing to track from now on
+  if (status == 101) {
+    VLOG(2) << "http response tracker: switching protocols";
+    failed_ = true;
+    return;
+  }
+  // interim responses are followed by the final one
+  if (status >= 100 && status < 200) {
+    head_.clear();
+    return;
+  }
+
+  bool chunked = false;
+  bool has_content_length = false;
+  uint64_t content_length = 0;
+  head.remove_prefix(status_line.size());
+  for (std::string_view line : absl::StrSplit(head, "\r\n"sv, absl::SkipEmpty())) {
+    std::pair<std::string_view, std::string_view> key_value = absl::StrSplit(line, absl::MaxSplits(':', 1));
+    std::string_view value = absl::StripAsciiWhitespace(key_value.second);
+    if (absl::EqualsIgnoreCase(key_value.first, "Transfer-Encoding"sv)) {
+      // chunked must be the last coding applied
+      chunked = absl::EndsWithIgnoreCase(value, "chunked"sv);
+    } else if (absl::EqualsIgnoreCase(key_value.first, "Content-Length"sv)) {
+      if (!absl::SimpleAtoi(value, &content_length)) {
+        VLOG(1) << "http response tracker: bad content length: " << value;
+        failed_ = true;
+        return;
+      }
+      has_content_length = true;
+    }
+  }
+
+  bool is_head = pending_requests_.front();
+  if (is_head || status == 204 || status == 304) {
+    OnResponseDone();
+  } else if (chunked) {
+    state_ = kChunkSize;
+  } else if (has_content_length) {
+    state_ = kBody;
+    remaining_ = content_length;
+    if (remaining_ == 0) {
+      OnResponseDone();
+    }
+  } else {
+    state_ = kUntilClose;
+  }
+}
+
+void HttpResponseTracker::OnResponseDone() {
+  DCHECK(!pending_requests_.empty());
+  pending_requests_.pop_front();
+  state_ = kHead;
+  head_.clear();
+  line_.clear();
+  remaining_ = 0;
+}
+
+size_t HttpResponseTracker::ReadLine(const uint8_t* data, size_t length, bool* line_complete) {
+  std::string_view input(reinterpret_cast<const char*>(data), length);
+  size_t pos = input.find('\n');
+  size_t consumed = pos == std::string_view::npos ? length : pos + 1;
+  line_.append(input.data(), consumed);
+  if (line_.size() > kMaxLineSize) {
+    VLOG(1) << "http response tracker: line too large";
+    failed_ = true;
+    *line_complete = false;
+    return consumed;
+  }
+  *line_complete = pos != std::string_view::npos;
+  if (*line_complete) {
+    // strip the line terminator
+    line_.pop_back();
+    if (!line_.empty() && line_.back() == '\r') {
+      line_.pop_back();
+    }
+  }
+  return consumed;
+}
+
+}  // namespace net
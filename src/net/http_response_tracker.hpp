@@ -0,0 +1,81 @@
+// SPDX-License-Identifier: GPL-2.0
+/* Copyright (c) 2024 Chilledheart  */
+
+#ifndef H_NET_HTTP_RESPONSE_TRACKER
+#define H_NET_HTTP_RESPONSE_TRACKER
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <string_view>
+
+namespace net {
+
+/// Follows the message framing (RFC 9112 section 6) of the HTTP/1.1 responses
+/// relayed on a keep-alive forward proxy connection.
+///
+/// Requests are registered in the order they are sent upstream, and the
+/// responses are consumed in the order they are written to the client. The
+/// tracker is idle once every response has been delivered in full, which is
+/// when the connection can be switched to another origin without mixing up
+/// responses.
+class HttpResponseTracker {
+ public:
+  /// the longest response head or chunk line accepted
+  static constexpr size_t kMaxLineSize = 64 * 1024;
+
+  /// a request is sent upstream, its response is expected after the ones in flight
+  ///
+  /// \param is_head the response to HEAD requests carries no body
+  void OnRequest(bool is_head) { pending_requests_.push_back(is_head); }
+
+  /// consume the response bytes written to the client, a malformed response
+  /// fails the tracker
+  void OnResponseData(const uint8_t* data, size_t length);
+
+  /// the origin closed the connection, which ends a close-delimited response
+  void OnEof();
+
+  /// all responses to the requests sent are delivered
+  bool idle() const { return !failed_ && state_ == kHead && head_.empty() && pending_requests_.empty(); }
+
+  /// the responses are malformed, unsolicited or switched to another protocol
+  bool failed() const { return failed_; }
+
+  /// the number of requests whose response is not delivered yet
+  size_t pending_requests() const { return pending_requests_.size(); }
+
+ private:
+  enum State {
+    kHead,
+    kBody,
+    kChunkSize,
+    kChunkData,
+    kChunkDataEnd,
+    kTrailer,
+    kUntilClose,
+  };
+
+  /// parse the response head and decide how the body is delimited
+  void OnHead();
+  void OnResponseDone();
+  /// append to line_ until CRLF
+  ///
+  /// \return the consumed bytes, line_complete is set if CRLF is reached
+  size_t ReadLine(const uint8_t* data, size_t length, bool* line_complete);
+
+  State state_ = kHead;
+  std::deque<bool> pending_requests_;
+  /// the pending response head
+  std::string head_;
+  /// the pending chunk size line or trailer line
+  std::string line_;
+  /// the remaining bytes of the body or chunk
+  uint64_t remaining_ = 0;
+  bool failed_ = false;
+};
+
+}  // namespace net
+
+#endif  // H_NET_HTTP_RESPONSE_TRACKER
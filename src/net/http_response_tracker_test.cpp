@@ -0,0 +1,89 @@
+// SPDX-License-Identifier: GPL-2.0
+/* Copyright (c) 2024 Chilledheart  */
+
+#include <gtest/gtest-message.h>
+#include <gtest/gtest.h>
+
+#include "net/http_response_tracker.hpp"
+
+using namespace net;
+
+namespace {
+
+void Feed(HttpResponseTracker* tracker, std::string_view data) {
+  tracker->OnResponseData(reinterpret_cast<const uint8_t*>(data.data()), data.size());
+}
+
+}  // namespace
+
+TEST(HttpResponseTrackerTest, ContentLength) {
+  HttpResponseTracker tracker;
+  EXPECT_TRUE(tracker.idle());
+  tracker.OnRequest(false);
+  tracker.OnRequest(false);
+  EXPECT_FALSE(tracker.idle());
+
+  Feed(&tracker, "HTTP/1.1 200 OK\r\nContent-Length: 5\r\n\r\nhel");
+  EXPECT_EQ(tracker.pending_requests(), 2u);
+  Feed(&tracker, "loHTTP/1.1 404 Not Found\r\ncontent-length:0\r\n\r\n");
+  EXPECT_TRUE(tracker.idle());
+  EXPECT_FALSE(tracker.failed());
+}
+
+TEST(HttpResponseTrackerTest, ChunkedSplitAnywhere) {
+  constexpr std::string_view kResponse =
+      "HTTP/1.1 200 OK\r\nTransfer-Encoding: gzip, chunked\r\n\r\n"
+      "5;ext=1\r\nhello\r\nA\r\n0123456789\r\n0\r\nX-Trailer: 1\r\n\r\n";
+  for (size_t split = 1; split < kResponse.size(); ++split) {
+    HttpResponseTracker tracker;
+    tracker.OnRequest(false);
+    Feed(&tracker, kResponse.substr(0, split));
+    EXPECT_FALSE(tracker.idle()) << split;
+    Feed(&tracker, kResponse.substr(split));
+    EXPECT_TRUE(tracker.idle()) << split;
+  }
+}
+
+TEST(HttpResponseTrackerTest, NoBody) {
+  HttpResponseTracker tracker;
+  tracker.OnRequest(true);
+  tracker.OnRequest(false);
+  tracker.OnRequest(false);
+  Feed(&tracker, "HTTP/1.1 200 OK\r\nContent-Length: 100\r\n\r\n");
+  EXPECT_EQ(tracker.pending_requests(), 2u);
+  Feed(&tracker, "HTTP/1.1 100 Continue\r\n\r\n");
+  EXPECT_EQ(tracker.pending_requests(), 2u);
+  Feed(&tracker, "HTTP/1.1 204 No Content\r\n\r\nHTTP/1.1 304 Not Modified\r\nContent-Length: 10\r\n\r\n");
+  EXPECT_TRUE(tracker.idle());
+}
+
+TEST(HttpResponseTrackerTest, CloseDelimited) {
+  HttpResponseTracker tracker;
+  tracker.OnRequest(false);
+  Feed(&tracker, "HTTP/1.0 200 OK\r\n\r\nsome data");
+  EXPECT_FALSE(tracker.idle());
+  tracker.OnEof();
+  EXPECT_TRUE(tracker.idle());
+}
+
+TEST(HttpResponseTrackerTest, Failures) {
+  HttpResponseTracker unsolicited;
+  Feed(&unsolicited, "HTTP/1.1 200 OK\r\n\r\n");
+  EXPECT_TRUE(unsolicited.failed());
+
+  HttpResponseTracker bad_status;
+  bad_status.OnRequest(false);
+  Feed(&bad_status, "SSH-2.0-OpenSSH\r\n\r\n");
+  EXPECT_TRUE(bad_status.failed());
+
+  HttpResponseTracker bad_chunk;
+  bad_chunk.OnRequest(false);
+  Feed(&bad_chunk, "HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\n\r\nzz\r\n");
+  EXPECT_TRUE(bad_chunk.failed());
+
+  HttpResponseTracker upgraded;
+  upgraded.OnRequest(false);
+  Feed(&upgraded, "HTTP/1.1 101 Switching Protocols\r\nUpgrade: websocket\r\n\r\n");
+  EXPECT_TRUE(upgraded.failed());
+  EXPECT_FALSE(upgraded.idle());
+}
@@ -4,32 +4,67 @@
 #ifndef CORE_IO_QUEUE_HPP
 #define CORE_IO_QUEUE_HPP
 
-#include <array>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
 #include <memory>
+#include <vector>
 #include "net/iobuf.hpp"
+#include "net/stats.hpp"
 
 namespace net {
 
+/// A ring of buffers, the storage grows on demand and can be released once
+/// drained, see shrink_to_fit.
+///
+/// The bytes queued are tracked, so the reader feeding the queue can be
+/// paused above the watermark, see set_watermark, and reported to the stats,
+/// see set_stats. The front buffer is counted by its length when pushed until
+/// it is popped, even if it is partially written.
 class IoQueue {
   using T = std::shared_ptr<IOBuf>;
 
  public:
+  static constexpr size_t kMinLength = 16;
+  /// more buffers than this are above the watermark whatever their bytes
+  static constexpr size_t kMaxLength = 4096;
+
   IoQueue() {}
-  IoQueue(const IoQueue&) = default;
-  IoQueue& operator=(const IoQueue&) = default;
+  ~IoQueue() {
+    if (stats_) {
+      stats_->Add(gauge_, -static_cast<int64_t>(reported_bytes_));
+    }
+  }
+  // the bytes reported to the stats are owned by the queue
+  IoQueue(const IoQueue&) = delete;
+  IoQueue& operator=(const IoQueue&) = delete;
 
   bool empty() const { return idx_ == end_idx_; }
 
   void replace_front(T buf) {
     DCHECK(!empty());
     dirty_front_ = true;
+    bytes_ = bytes_ - lengths_[idx_] + buf->length();
+    lengths_[idx_] = buf->length();
     queue_[idx_] = buf;
+    update();
   }
 
   void push_back(T buf) {
+    if (length() + 1 >= queue_.size()) {
+      grow();
+    }
+    bytes_ += buf->length();
+    lengths_[end_idx_] = buf->length();
     queue_[end_idx_] = buf;
     end_idx_ = (end_idx_ + 1) % queue_.size();
-    CHECK_NE(end_idx_, idx_) << "IO queue is full";
+    if (bytes_ > peak_bytes_) {
+      peak_bytes_ = bytes_;
+      if (stats_) {
+        stats_->Update(peak_, peak_bytes_);
+      }
+    }
+    update();
   }
 
   void push_back(const char* data, size_t length) { push_back(IOBuf::copyBuffer(data, length)); }
@@ -43,8 +78,98 @@ class IoQueue {
   void pop_front() {
     DCHECK(!empty());
     dirty_front_ = false;
+    bytes_ -= lengths_[idx_];
     queue_[idx_] = nullptr;
     idx_ = (idx_ + 1) % queue_.size();
+    update();
+  }
+
+  /// drop all buffers queued, the storage, the watermark and the stats are kept
+  void clear() {
+    while (!empty()) {
+      pop_front();
+    }
+  }
+
+  /// merge the (whole) buffers at the front into one up to |max_length|
+  /// bytes, so they are written at once
+  ///
+  /// The buffers longer than |max_copy| are never copied: at most one of them
+  /// is merged, by gathering the others into its headroom and tailroom.
+  ///
+  /// \return the buffers merged into the front one
+  size_t coalesce_front(size_t max_length, size_t max_copy = SIZE_MAX) {
+    size_t count = 0u, total = 0u;
+    // the position of the one not copied in the run, if any
+    size_t base = SIZE_MAX, before = 0u, after = 0u;
+    for (int i = idx_; i != end_idx_; i = (i + 1) % queue_.size()) {
+      size_t length = queue_[i]->length();
+      if (total + length > max_length) {
+        break;
+      }
+      if (length > max_copy) {
+        if (base != SIZE_MAX) {
+          break;
+        }
+        base = count;
+        before = total;
+      } else if (base != SIZE_MAX) {
+        after += length;
+      }
+      total += length;
+      ++count;
+    }
+    if (base != SIZE_MAX) {
+      const T& buf = queue_[(idx_ + base) % queue_.size()];
+      if (buf->headroom() < before) {
+        // the ones ahead are merged by copy only
+        count = base;
+        total = before;
+        base = SIZE_MAX;
+      } else if (buf->tailroom() < after) {
+        count = base + 1;
+        total -= after;
+        after = 0u;
+      }
+    }
+    if (count < 2) {
+      return 0u;
+    }
+
+    T merged;
+    if (base != SIZE_MAX) {
+      merged = queue_[(idx_ + base) % queue_.size()];
+      merged->prepend(before);
+    } else if (queue_[idx_]->tailroom() >= total - queue_[idx_]->length()) {
+      base = 0u;
+      merged = queue_[idx_];
+    } else {
+      base = count;
+      merged = IOBuf::create(total);
+      merged->append(total);
+    }
+    size_t pushed = 0u;
+    uint8_t* head = merged->mutable_data();
+    for (size_t i = 0; i < count; ++i) {
+      T& buf = queue_[idx_];
+      if (i < base) {
+        memcpy(head, buf->data(), buf->length());
+        head += buf->length();
+      } else if (i > base || merged != buf) {
+        memcpy(merged->mutable_tail(), buf->data(), buf->length());
+        merged->append(buf->length());
+      }
+      pushed += lengths_[idx_];
+      if (i + 1 < count) {
+        buf = nullptr;
+        idx_ = (idx_ + 1) % queue_.size();
+      }
+    }
+    bytes_ = bytes_ - pushed + total;
+    lengths_[idx_] = total;
+    queue_[idx_] = merged;
+    update();
+    return count - 1;
   }
 
   T back() {
@@ -52,23 +177,98 @@ class IoQueue {
     return queue_[(end_idx_ + queue_.size() - 1) % queue_.size()];
   }
 
-  size_t length() const { return (end_idx_ + queue_.size() - idx_) % queue_.size(); }
+  size_t length() const { return empty() ? 0u : (end_idx_ + queue_.size() - idx_) % queue_.size(); }
 
-  size_t byte_length() const {
-    if (empty()) {
+  size_t byte_length() const { return empty() ? 0u : bytes_ - lengths_[idx_] + queue_[idx_]->length(); }
+
+  /// the most bytes ever queued
+  size_t peak_byte_length() const { return peak_bytes_; }
+
+  /// set the watermark of the bytes queued, 0 to disable
+  ///
+  /// The readers feeding the queues read again only once the queue is drained,
+  /// so there is no low watermark to resume at.
+  ///
+  /// \param watermark the queue is above the watermark while it holds this many bytes
+  void set_watermark(size_t watermark) {
+    watermark_ = watermark;
+    update();
+  }
+
+  /// whether the reader feeding the queue should be paused
+  bool above_watermark() const { return above_watermark_; }
+
+  /// report the bytes queued to the gauge and the most bytes queued to the peak
+  ///
+  /// \param stats the stats to report to, which outlives the queue
+  /// \param gauge the gauge of the bytes queued, summed over the queues
+  /// \param peak the peak of the bytes queued, the maximum over the queues
+  void set_stats(Stats* stats, Stats::Gauge gauge, Stats::Peak peak) {
+    DCHECK(!stats_);
+    stats_ = stats;
+    gauge_ = gauge;
+    peak_ = peak;
+    stats_->Update(peak_, peak_bytes_);
+    update();
+  }
+
+  /// release the storage if drained
+  ///
+  /// \return the bytes released
+  size_t shrink_to_fit() {
+    if (!empty() || queue_.empty()) {
       return 0u;
     }
-    size_t ret = 0u;
-    for (int i = idx_; i != end_idx_; i = (i + 1) % queue_.size())
-      ret += queue_[i]->length();
-    return ret;
+    size_t bytes = queue_.capacity() * (sizeof(T) + sizeof(size_t));
+    std::vector<T>().swap(queue_);
+    std::vector<size_t>().swap(lengths_);
+    idx_ = end_idx_ = 0;
+    dirty_front_ = false;
+    return bytes;
   }
 
  private:
+  void grow() {
+    size_t length = this->length();
+    size_t size = queue_.empty() ? kMinLength : queue_.size() * 2;
+    std::vector<T> queue(size);
+    std::vector<size_t> lengths(size);
+    for (size_t i = 0; i < length; ++i) {
+      queue[i] = std::move(queue_[(idx_ + i) % queue_.size()]);
+      lengths[i] = lengths_[(idx_ + i) % queue_.size()];
+    }
+    queue_.swap(queue);
+    lengths_.swap(lengths);
+    idx_ = 0;
+    end_idx_ = length;
+  }
+
+  void update() {
+    above_watermark_ = watermark_ && (bytes_ >= watermark_ || length() >= kMaxLength);
+    if (stats_ && bytes_ != reported_bytes_) {
+      stats_->Add(gauge_, static_cast<int64_t>(bytes_) - static_cast<int64_t>(reported_bytes_));
+      reported_bytes_ = bytes_;
+    }
+  }
+
   int idx_ = 0;
   int end_idx_ = 0;
-  std::array<T, 4096> queue_;
+  std::vector<T> queue_;
+  /// the length of each buffer when pushed
+  std::vector<size_t> lengths_;
   bool dirty_front_ = false;
+
+  /// the sum of lengths_
+  size_t bytes_ = 0u;
+  size_t peak_bytes_ = 0u;
+  size_t watermark_ = 0u;
+  bool above_watermark_ = false;
+
+  Stats* stats_ = nullptr;
+  Stats::Gauge gauge_ = Stats::kGaugeMax;
+  Stats::Peak peak_ = Stats::kPeakMax;
+  /// the bytes added to the gauge
+  size_t reported_bytes_ = 0u;
 };
 
 }  // namespace net
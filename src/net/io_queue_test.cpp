@@ -0,0 +1,189 @@
+// SPDX-License-Identifier: GPL-2.0
+/* Copyright (c) 2024 Chilledheart  */
+
+#include <gtest/gtest-message.h>
+#include <gtest/gtest.h>
+
+#include <string>
+#include <vector>
+
+#include "net/io_queue.hpp"
+
+using namespace net;
+
+namespace {
+std::string Drain(IoQueue* queue, std::vector<size_t>* lengths) {
+  std::string data;
+  while (!queue->empty()) {
+    auto buf = queue->front();
+    lengths->push_back(buf->length());
+    data.append(reinterpret_cast<const char*>(buf->data()), buf->length());
+    queue->pop_front();
+  }
+  return data;
+}
+}  // namespace
+
+TEST(IoQueueTest, CoalesceFront) {
+  IoQueue queue;
+  queue.push_back("abc", 3);
+  queue.push_back("defg", 4);
+  queue.push_back("hi", 2);
+  queue.push_back("jklmnopq", 8);
+  // the buffers are merged whole
+  EXPECT_EQ(2u, queue.coalesce_front(10));
+  EXPECT_EQ(2u, queue.length());
+
+  std::vector<size_t> lengths;
+  EXPECT_EQ("abcdefghijklmnopq", Drain(&queue, &lengths));
+  EXPECT_EQ((std::vector<size_t>{9, 8}), lengths);
+}
+
+TEST(IoQueueTest, CoalesceFrontNothing) {
+  IoQueue queue;
+  EXPECT_EQ(0u, queue.coalesce_front(16));
+  queue.push_back("abc", 3);
+  EXPECT_EQ(0u, queue.coalesce_front(16));
+  // the front one is already large
+  queue.push_back("defg", 4);
+  EXPECT_EQ(0u, queue.coalesce_front(3));
+  EXPECT_EQ(2u, queue.length());
+}
+
+TEST(IoQueueTest, CoalesceFrontWrapped) {
+  IoQueue queue;
+  // move the ring around
+  for (size_t i = 0; i < IoQueue::kMinLength - 2; ++i) {
+    queue.push_back("x", 1);
+    queue.pop_front();
+  }
+  std::string expected;
+  for (char c = 'a'; c < 'a' + 8; ++c) {
+    queue.push_back(&c, 1);
+    expected.push_back(c);
+  }
+  queue.front()->trimStart(1);
+  EXPECT_EQ(7u, queue.coalesce_front(64));
+  EXPECT_EQ(1u, queue.length());
+
+  std::vector<size_t> lengths;
+  EXPECT_EQ(expected.substr(1), Drain(&queue, &lengths));
+}
+
+TEST(IoQueueTest, ByteLength) {
+  IoQueue queue;
+  EXPECT_EQ(0u, queue.byte_length());
+  queue.push_back("abc", 3);
+  queue.push_back("defg", 4);
+  EXPECT_EQ(7u, queue.byte_length());
+  // the front one is counted by what is left
+  queue.front()->trimStart(2);
+  EXPECT_EQ(5u, queue.byte_length());
+  queue.pop_front();
+  EXPECT_EQ(4u, queue.byte_length());
+  queue.replace_front(IOBuf::copyBuffer("hi", 2));
+  EXPECT_EQ(2u, queue.byte_length());
+  queue.pop_front();
+  EXPECT_EQ(0u, queue.byte_length());
+  EXPECT_EQ(7u, queue.peak_byte_length());
+
+  // beyond the initial storage
+  for (size_t i = 0; i < IoQueue::kMinLength * 4; ++i) {
+    queue.push_back("x", 1);
+  }
+  EXPECT_EQ(IoQueue::kMinLength * 4, queue.byte_length());
+}
+
+TEST(IoQueueTest, Watermark) {
+  IoQueue queue;
+  queue.set_watermark(8);
+  queue.push_back("abcd", 4);
+  queue.push_back("efg", 3);
+  EXPECT_FALSE(queue.above_watermark());
+  queue.push_back("h", 1);
+  EXPECT_TRUE(queue.above_watermark());
+  queue.pop_front();
+  EXPECT_FALSE(queue.above_watermark());
+  queue.clear();
+  EXPECT_TRUE(queue.empty());
+  EXPECT_EQ(0u, queue.byte_length());
+
+  // too many buffers
+  for (size_t i = 0; i < IoQueue::kMaxLength; ++i) {
+    queue.push_back(IOBuf::create(0));
+  }
+  EXPECT_TRUE(queue.above_watermark());
+  while (!queue.empty()) {
+    queue.pop_front();
+  }
+  EXPECT_FALSE(queue.above_watermark());
+
+  queue.set_watermark(0);
+  queue.push_back("abcdefghijk", 11);
+  EXPECT_FALSE(queue.above_watermark());
+}
+
+TEST(IoQueueTest, Stats) {
+  static Stats* stats = new Stats("test_io_queue");
+  {
+    IoQueue upstream, downstream;
+    upstream.set_stats(stats, Stats::kUpstreamQueuedBytes, Stats::kUpstreamQueuedBytesMax);
+    downstream.set_stats(stats, Stats::kDownstreamQueuedBytes, Stats::kDownstreamQueuedBytesMax);
+    upstream.push_back("abcd", 4);
+    upstream.push_back("efg", 3);
+    downstream.push_back("hi", 2);
+    EXPECT_EQ(7, stats->Get(Stats::kUpstreamQueuedBytes));
+    EXPECT_EQ(2, stats->Get(Stats::kDownstreamQueuedBytes));
+    upstream.pop_front();
+    EXPECT_EQ(3, stats->Get(Stats::kUpstreamQueuedBytes));
+    EXPECT_EQ(7u, stats->Get(Stats::kUpstreamQueuedBytesMax));
+    EXPECT_EQ(2u, stats->Get(Stats::kDownstreamQueuedBytesMax));
+  }
+  // the bytes left are taken back once the queues are gone
+  EXPECT_EQ(0, stats->Get(Stats::kUpstreamQueuedBytes));
+  EXPECT_EQ(0, stats->Get(Stats::kDownstreamQueuedBytes));
+  EXPECT_EQ(7u, stats->Get(Stats::kUpstreamQueuedBytesMax));
+}
+
+TEST(IoQueueTest, CoalesceFrontGather) {
+  IoQueue queue;
+  // a bulk buffer with room around it, as read from the sockets
+  std::shared_ptr<IOBuf> bulk = IOBuf::create(16 + 64 + 16);
+  bulk->advance(16);
+  memset(bulk->mutable_tail(), 'x', 64);
+  bulk->append(64);
+  const uint8_t* payload = bulk->data();
+
+  queue.push_back("ab", 2);
+  queue.push_back("cd", 2);
+  queue.push_back(bulk);
+  queue.push_back("ef", 2);
+  queue.push_back(IOBuf::copyBuffer(std::string(64, 'y')));
+  EXPECT_EQ(3u, queue.coalesce_front(1024, 8));
+  EXPECT_EQ(2u, queue.length());
+  EXPECT_EQ(4u + 64 + 2 + 64, queue.byte_length());
+
+  // gathered in place, the bulk payload is not copied
+  auto front = queue.front();
+  EXPECT_EQ(bulk, front);
+  EXPECT_EQ(payload - 4, front->data());
+
+  std::vector<size_t> lengths;
+  EXPECT_EQ("abcd" + std::string(64, 'x') + "ef" + std::string(64, 'y'), Drain(&queue, &lengths));
+  EXPECT_EQ((std::vector<size_t>{70, 64}), lengths);
+}
+
+TEST(IoQueueTest, CoalesceFrontNoRoom) {
+  IoQueue queue;
+  queue.push_back("ab", 2);
+  queue.push_back("cd", 2);
+  // no headroom, the bulk one is left alone
+  queue.push_back(IOBuf::copyBuffer(std::string(64, 'x')));
+  queue.push_back("ef", 2);
+  EXPECT_EQ(1u, queue.coalesce_front(1024, 8));
+  EXPECT_EQ(3u, queue.length());
+
+  std::vector<size_t> lengths;
+  EXPECT_EQ("abcd" + std::string(64, 'x') + "ef", Drain(&queue, &lengths));
+  EXPECT_EQ((std::vector<size_t>{4, 64, 2}), lengths);
+}
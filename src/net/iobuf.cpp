@@ -3,6 +3,8 @@
 
 #include "net/iobuf.hpp"
 
+#include "net/stats.hpp"
+
 namespace net {
 
 inline size_t goodMallocSize(size_t minSize) noexcept {
@@ -57,6 +59,9 @@ IOBuf::IOBuf(CreateOp, std::size_t capacity) {
   capacity_ = goodExtBufferSize(capacity);
   buf_ = static_cast<uint8_t*>(checkedMalloc(capacity_));
   data_ = buf_;
+  process_stats().Add(Stats::kIOBufAllocations);
+  process_stats().Add(Stats::kIOBufCount, 1);
+  process_stats().Add(Stats::kIOBufBytes, capacity_);
 }
 
 IOBuf::IOBuf(CopyBufferOp /* op */, const void* buf, std::size_t size, std::size_t headroom, std::size_t minTailroom)
@@ -75,6 +80,8 @@ IOBuf::IOBuf(CopyBufferOp op, ByteRange br, std::size_t headroom, std::size_t mi
 IOBuf::~IOBuf() {
   if (buf_) {
     free(buf_);
+    process_stats().Add(Stats::kIOBufCount, -1);
+    process_stats().Add(Stats::kIOBufBytes, -static_cast<int64_t>(capacity_));
   }
 }
 
@@ -82,6 +89,38 @@ std::unique_ptr<IOBuf> IOBuf::create(std::size_t capacity) {
   return std::make_unique<IOBuf>(CREATE, capacity);
 }
 
+namespace {
+
+// Refers to the data of the owner instead of a buffer of its own
+class SharedIOBuf : public IOBuf {
+ public:
+  SharedIOBuf(std::shared_ptr<IOBuf> owner, uint8_t* data, std::size_t size) : owner_(std::move(owner)) {
+    buf_ = data;
+    data_ = data;
+    length_ = size;
+    capacity_ = size;
+  }
+
+  ~SharedIOBuf() override {
+    // not ours to free
+    buf_ = nullptr;
+  }
+
+ private:
+  std::shared_ptr<IOBuf> owner_;
+};
+
+}  // namespace
+
+std::shared_ptr<IOBuf> IOBuf::shareBuffer(std::shared_ptr<IOBuf> owner, const void* data, std::size_t size) {
+  const uint8_t* p = static_cast<const uint8_t*>(data);
+  if (!owner || p < owner->data() || p + size > owner->tail()) {
+    return copyBuffer(data, size);
+  }
+  uint8_t* mutable_p = owner->mutable_data() + (p - owner->data());
+  return std::make_shared<SharedIOBuf>(std::move(owner), mutable_p, size);
+}
+
 std::unique_ptr<IOBuf> IOBuf::clone() const {
   return std::make_unique<IOBuf>(cloneAsValue());
 }
@@ -109,6 +148,10 @@ IOBuf::IOBuf(InternalConstructor, uint8_t* buf, std::size_t capacity, uint8_t* d
     : buf_(buf), data_(data), length_(length), capacity_(capacity) {
   DCHECK(data >= buf);
   DCHECK(data + length <= buf + capacity);
+  if (buf_) {
+    process_stats().Add(Stats::kIOBufCount, 1);
+    process_stats().Add(Stats::kIOBufBytes, capacity_);
+  }
 }
 
 IOBuf& IOBuf::operator=(IOBuf&& other) noexcept {
@@ -193,6 +236,11 @@ void IOBuf::reserveSlow(std::size_t minHeadroom, std::size_t minTailroom) {
     free(buf_);
   }
 
+  process_stats().Add(Stats::kIOBufAllocations);
+  if (!buf_) {
+    process_stats().Add(Stats::kIOBufCount, 1);
+  }
+  process_stats().Add(Stats::kIOBufBytes, static_cast<int64_t>(newAllocatedCapacity) - capacity_);
   capacity_ = newAllocatedCapacity;
   buf_ = newBuffer;
   data_ = newBuffer + newHeadroom;
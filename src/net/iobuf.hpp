@@ -81,6 +81,16 @@ class IOBuf {
   IOBuf(CopyBufferOp op, const std::string& buf, std::size_t headroom = 0, std::size_t minTailroom = 0)
       : IOBuf(op, buf.data(), buf.size(), headroom, minTailroom) {}
 
+  /**
+   * Create a new IOBuf referring to a sub-range of the data of owner, which
+   * is kept alive until the new IOBuf is destroyed.
+   *
+   * The new IOBuf has neither headroom nor tailroom, it can be trimmed but
+   * must never be grown (see reserve()).  If the range is not inside the data
+   * of owner, the bytes are copied instead.
+   */
+  static std::shared_ptr<IOBuf> shareBuffer(std::shared_ptr<IOBuf> owner, const void* data, std::size_t size);
+
   virtual ~IOBuf();
 
   // ref to internal buffer/headroom
@@ -0,0 +1,72 @@
+// SPDX-License-Identifier: GPL-2.0
+/* Copyright (c) 2024 Chilledheart  */
+
+#include <benchmark/benchmark.h>
+
+#include "net/io_queue.hpp"
+#include "net/iobuf.hpp"
+
+#include "benchmark_util.hpp"
+
+using namespace net;
+
+namespace {
+
+void BM_IOBufCreate(benchmark::State& state) {
+  const size_t size = state.range(0);
+  uint64_t allocations = benchmark::GetAllocationCount();
+  for (auto _ : state) {
+    auto buf = IOBuf::create(size);
+    benchmark::DoNotOptimize(buf->mutable_data());
+  }
+  benchmark::ReportComponentCounters(state, allocations, size);
+}
+
+// grow an empty buffer to the given tailroom, as the read path does
+void BM_IOBufReserve(benchmark::State& state) {
+  const size_t size = state.range(0);
+  uint64_t allocations = benchmark::GetAllocationCount();
+  for (auto _ : state) {
+    IOBuf buf;
+    buf.reserve(0, size);
+    benchmark::DoNotOptimize(buf.mutable_data());
+  }
+  benchmark::ReportComponentCounters(state, allocations, size);
+}
+
+void BM_IOBufCopyBuffer(benchmark::State& state) {
+  const size_t size = state.range(0);
+  auto payload = benchmark::GenerateRandContent(size);
+  uint64_t allocations = benchmark::GetAllocationCount();
+  for (auto _ : state) {
+    auto buf = IOBuf::copyBuffer(payload->data(), payload->length());
+    benchmark::DoNotOptimize(buf->data());
+  }
+  benchmark::ReportComponentCounters(state, allocations, size);
+}
+
+// push the given number of buffers then pop them all, the buffers are shared
+// so only the queue itself is measured
+void BM_IoQueuePushPop(benchmark::State& state) {
+  const int depth = state.range(0);
+  std::shared_ptr<IOBuf> buf = benchmark::GenerateRandContent(4096);
+  IoQueue queue;
+  uint64_t allocations = benchmark::GetAllocationCount();
+  for (auto _ : state) {
+    for (int i = 0; i < depth; ++i) {
+      queue.push_back(buf);
+    }
+    while (!queue.empty()) {
+      benchmark::DoNotOptimize(queue.front()->data());
+      queue.pop_front();
+    }
+  }
+  benchmark::ReportComponentCounters(state, allocations, depth * buf->length());
+}
+
+}  // namespace
+
+BENCHMARK(BM_IOBufCreate)->Arg(64)->Arg(4096)->Arg(16 * 1024);
+BENCHMARK(BM_IOBufReserve)->Arg(64)->Arg(4096)->Arg(16 * 1024);
+BENCHMARK(BM_IOBufCopyBuffer)->Arg(64)->Arg(4096)->Arg(16 * 1024);
+BENCHMARK(BM_IoQueuePushPop)->Arg(1)->Arg(16)->Arg(256);
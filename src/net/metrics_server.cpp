@@ -0,0 +1,173 @@
+// SPDX-License-Identifier: GPL-2.0
+/* Copyright (c) 2024 Chilledheart  */
+
+#include "net/metrics_server.hpp"
+
+#include <absl/strings/match.h>
+#include <absl/strings/str_cat.h>
+
+#include "core/logging.hpp"
+#include "core/utils.hpp"
+#include "net/timer_wheel.hpp"
+
+namespace net {
+
+namespace {
+
+/// large enough for any sane request line with headers
+constexpr size_t kMaxRequestSize = 8192;
+
+/// the deadline of a whole exchange, so a client which connects and sends
+/// nothing (or never reads the response) doesn't hold the session forever
+constexpr std::chrono::seconds kSessionTimeout(10);
+
+}  // namespace
+
+/// a single request-response exchange, the connection is closed after response
+class MetricsServer::Session : public std::enable_shared_from_this<MetricsServer::Session> {
+ public:
+  Session(MetricsServer* server, asio::ip::tcp::socket&& socket)
+      : server_(server), socket_(std::move(socket)), timer_wheel_(&TimerWheel::Get(server->io_context_)) {}
+
+  void start() {
+    // the timer is cancelled when the session is destroyed
+    timer_wheel_->Schedule(&timer_, kSessionTimeout, [this]() {
+      VLOG(1) << "metrics server: session timed out";
+      asio::error_code ec;
+      socket_.close(ec);
+    });
+    read();
+  }
+
+ private:
+  void read() {
+    auto self = shared_from_this();
+    request_.resize(request_size_ + 1024);
+    socket_.async_read_some(asio::buffer(request_.data() + request_size_, request_.size() - request_size_),
+                            [this, self](asio::error_code ec, size_t bytes_transferred) {
+                              if (ec) {
+                                return;
+                              }
+                              request_size_ += bytes_transferred;
+                              std::string_view request(request_.data(), request_size_);
+                              if (request.find("\r\n\r\n") == std::string_view::npos) {
+                                if (request_size_ >= kMaxRequestSize) {
+                                  respond("431 Request Header Fields Too Large", std::string());
+                                  return;
+                                }
+                                read();
+                                return;
+                              }
+                              if (absl::StartsWith(request, "GET /metrics ") ||
+                                  absl::StartsWith(request, "GET /metrics?") || absl::StartsWith(request, "GET / ")) {
+                                respond("200 OK", server_->Render());
+                              } else {
+                                respond("404 Not Found", std::string());
+                              }
+                            });
+  }
+
+  void respond(std::string_view status, std::string body) {
+    auto self = shared_from_this();
+    response_ = absl::StrCat("HTTP/1.1 ", status,
+                             "\r\n"
+                             "Content-Type: text/plain; version=0.0.4; charset=utf-8\r\n"
+                             "Content-Length: ",
+                             body.size(),
+                             "\r\n"
+                             "Connection: close\r\n\r\n",
+                             body);
+    asio::async_write(socket_, asio::buffer(response_), [this, self](asio::error_code ec, size_t) {
+      socket_.shutdown(asio::ip::tcp::socket::shutdown_both, ec);
+      socket_.close(ec);
+    });
+  }
+
+  MetricsServer* server_;
+  asio::ip::tcp::socket socket_;
+  std::string request_;
+  size_t request_size_ = 0;
+  std::string response_;
+  TimerWheel* timer_wheel_;
+  WheelTimer timer_;
+};
+
+MetricsServer::MetricsServer(std::vector<Stats*> stats) : stats_(std::move(stats)), acceptor_(io_context_) {}
+
+MetricsServer::~MetricsServer() {
+  stop();
+}
+
+void MetricsServer::listen(const asio::ip::tcp::endpoint& endpoint, asio::error_code& ec) {
+  acceptor_.open(endpoint.protocol(), ec);
+  if (ec) {
+    return;
+  }
+  acceptor_.set_option(asio::ip::tcp::acceptor::reuse_address(true), ec);
+  acceptor_.bind(endpoint, ec);
+  if (ec) {
+    asio::error_code ignored_ec;
+    acceptor_.close(ignored_ec);
+    return;
+  }
+  acceptor_.listen(asio::socket_base::max_listen_connections, ec);
+  if (ec) {
+    asio::error_code ignored_ec;
+    acceptor_.close(ignored_ec);
+    return;
+  }
+  accept();
+  thread_ = std::make_unique<std::thread>([this] {
+    if (!SetCurrentThreadName("metrics")) {
+      PLOG(WARNING) << "failed to set thread name";
+    }
+    io_context_.run();
+  });
+}
+
+void MetricsServer::stop() {
+  if (!thread_) {
+    return;
+  }
+  asio::post(io_context_, [this]() {
+    asio::error_code ec;
+    acceptor_.close(ec);
+    io_context_.stop();
+  });
+  thread_->join();
+  thread_.reset();
+}
+
+asio::ip::tcp::endpoint MetricsServer::endpoint() const {
+  asio::error_code ec;
+  return acceptor_.local_endpoint(ec);
+}
+
+std::string MetricsServer::Render() const {
+  std::vector<std::pair<std::string, Stats::Snapshot>> snapshots;
+  snapshots.reserve(stats_.size());
+  for (Stats* stats : stats_) {
+    snapshots.emplace_back(stats->name(), stats->GetSnapshot());
+  }
+  std::string out;
+  AppendPrometheusText(&out, snapshots);
+  absl::StrAppend(&out, "# TYPE yass_log_messages_dropped_total counter\n");
+  absl::StrAppend(&out, "yass_log_messages_dropped_total ", gurl_base::logging::GetDroppedLogMessages(), "\n");
+  return out;
+}
+
+void MetricsServer::accept() {
+  acceptor_.async_accept([this](asio::error_code ec, asio::ip::tcp::socket socket) {
+    if (ec == asio::error::operation_aborted || !acceptor_.is_open()) {
+      return;
+    }
+    if (!ec) {
+      std::make_shared<Session>(this, std::move(socket))->start();
+    } else {
+      VLOG(1) << "metrics server: failed to accept: " << ec;
+    }
+    accept();
+  });
+}
+
+}  // namespace net
@@ -0,0 +1,59 @@
+// SPDX-License-Identifier: GPL-2.0
+/* Copyright (c) 2024 Chilledheart  */
+
+#ifndef H_NET_METRICS_SERVER
+#define H_NET_METRICS_SERVER
+
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "net/asio.hpp"
+#include "net/stats.hpp"
+
+namespace net {
+
+/// Serves statistics in prometheus text exposition format over plain http.
+///
+/// The server owns its io context and thread, so a scrape only takes
+/// snapshots of the statistics and never runs on (nor blocks) the io context
+/// carrying the proxied traffic.
+class MetricsServer {
+ public:
+  /// \param stats the statistics to export, labeled by Stats::name()
+  explicit MetricsServer(std::vector<Stats*> stats);
+  ~MetricsServer();
+
+  MetricsServer(const MetricsServer&) = delete;
+  MetricsServer& operator=(const MetricsServer&) = delete;
+
+  /// start listening and serving in the background thread
+  ///
+  /// \param endpoint the endpoint to listen on
+  /// \param ec the error when listening fails
+  void listen(const asio::ip::tcp::endpoint& endpoint, asio::error_code& ec);
+
+  /// stop serving and join the background thread
+  void stop();
+
+  /// the endpoint listening on
+  asio::ip::tcp::endpoint endpoint() const;
+
+  /// render the exported statistics
+  std::string Render() const;
+
+ private:
+  class Session;
+
+  void accept();
+
+  const std::vector<Stats*> stats_;
+  asio::io_context io_context_;
+  asio::ip::tcp::acceptor acceptor_;
+  std::unique_ptr<std::thread> thread_;
+};
+
+}  // namespace net
+
+#endif  // H_NET_METRICS_SERVER
@@ -44,16 +44,32 @@ const uint32_t kSpdyMaxConcurrentPushedStreams = 1000;
 // Specifies the the default value for the push setting, which is disabled.
 const uint32_t kSpdyDisablePush = 0;
 
-// followed by curl's nghttp adapter
-/* this is how much we want "in flight" for a stream */
-#define H2_STREAM_WINDOW_SIZE (10 * 1024 * 1024)
-#define HTTP2_HUGE_WINDOW_SIZE (100 * H2_STREAM_WINDOW_SIZE)
+// the window of a connection before any WINDOW_UPDATE (RFC 9113 6.9.2)
+const int32_t kSpdyDefaultInitialWindowSize = 65535;
 
-// from net/spdy/spdy_session.h
-// If more than this many bytes have been read or more than that many
-// milliseconds have passed, return ERR_IO_PENDING from ReadLoop.
-const int kYieldAfterBytesRead = 32 * 1024;
-const int kYieldAfterDurationMilliseconds = 20;
+/* the initial receive window of a stream (and of its connection), it is
+ * auto-tuned after the bandwidth-delay product (see Http2WindowTuner) */
+#define H2_STREAM_WINDOW_SIZE (1024 * 1024)
+#define H2_STREAM_MAX_WINDOW_SIZE (64 * 1024 * 1024)
+
+// the largest plaintext of a TLS record (RFC 8446 5.1), the http2 frames
+// are coalesced up to it so each write makes a full record
+const size_t kMaxTlsRecordPayload = 16384;
+
+// the size of a http2 frame header (RFC 9113 4.1)
+const size_t kHttp2FrameHeaderSize = 9;
+
+// the frames longer than this are gathered in place rather than copied when
+// the http2 frames are coalesced
+const size_t kHttp2MaxCopiedFrame = 1024;
+
+// the headroom of the buffers read for the http2 DATA frames, room for the
+// frame header, the padding header and the small frames gathered ahead
+const size_t kHttp2ReadHeadroom = 64;
+
+// the most read at once for a http2 DATA frame, so the frame carrying it,
+// padded or not, fits in one TLS record and is sent in place
+const size_t kHttp2ReadSize = kMaxTlsRecordPayload - kHttp2FrameHeaderSize - 3 - 255;
 
 // from net/spdy/spdy_session.h
 // Maximum number of capped frames that can be queued at any time.
@@ -3,8 +3,16 @@
 
 #include "net/padding.hpp"
 
+#include <algorithm>
+
 #include <base/rand_util.h>
 
+#include "net/network.hpp"
+
+static_assert(net::kHttp2ReadSize + net::kHttp2FrameHeaderSize + net::kPaddingHeaderSize + net::kMaxPaddingSize <=
+                  net::kMaxTlsRecordPayload,
+              "a padded http2 read doesn't fit in a TLS record");
+
 /// <payload_length> <padding length> <payload> <padding>
 /// input:
 ///                                       *
@@ -18,16 +26,18 @@ void AddPadding(std::shared_ptr<net::IOBuf> buf) {
   size_t payload_size = buf->length();
   DCHECK_LE(payload_size, 0xffffu);
   size_t padding_size = gurl_base::RandInt(0, kMaxPaddingSize);
-  buf->reserve(kPaddingHeaderSize, padding_size);
+  // keep the headroom left for the frame header if reallocated
+  buf->reserve(std::max<size_t>(buf->headroom(), kPaddingHeaderSize), padding_size);
 
-  uint8_t* p = buf->mutable_buffer();
-  p[0] = payload_size >> 8;
-  p[1] = payload_size & 0xff;
-  p[2] = padding_size;
   memset(buf->mutable_tail(), 0, padding_size);
+  buf->append(padding_size);
 
+  // right before the payload, not at the start of the headroom
   buf->prepend(kPaddingHeaderSize);
-  buf->append(padding_size);
+  uint8_t* p = buf->mutable_data();
+  p[0] = payload_size >> 8;
+  p[1] = payload_size & 0xff;
+  p[2] = padding_size;
 }
 
 /// <payload_length> <padding length> <payload> <padding>
@@ -36,27 +46,35 @@ void AddPadding(std::shared_ptr<net::IOBuf> buf) {
 /// output:
 ///                                       *
 std::shared_ptr<net::IOBuf> RemovePadding(std::shared_ptr<net::IOBuf> buf, asio::error_code& ec) {
-  if (buf->length() < kPaddingHeaderSize) {
-    ec = asio::error::try_again;
+  size_t payload_size;
+  size_t record_size = ParsePadding(buf->data(), buf->length(), &payload_size, ec);
+  if (ec) {
     return nullptr;
   }
-  const uint8_t* p = buf->data();
-  size_t payload_size = (p[0] << 8) + p[1];
-  if (payload_size == 0) {
+  std::shared_ptr<net::IOBuf> result = net::IOBuf::copyBuffer(buf->data() + kPaddingHeaderSize, payload_size);
+  buf->trimStart(record_size);
+  buf->retreat(record_size);
+  return result;
+}
+
+size_t ParsePadding(const uint8_t* data, size_t length, size_t* payload_size, asio::error_code& ec) {
+  if (length < kPaddingHeaderSize) {
+    ec = asio::error::try_again;
+    return 0;
+  }
+  *payload_size = (data[0] << 8) + data[1];
+  if (*payload_size == 0) {
     ec = asio::error::invalid_argument;
-    return nullptr;
+    return 0;
   }
-  size_t padding_size = p[2];
-  if (buf->length() < kPaddingHeaderSize + payload_size + padding_size) {
+  size_t padding_size = data[2];
+  size_t record_size = kPaddingHeaderSize + *payload_size + padding_size;
+  if (length < record_size) {
     ec = asio::error::try_again;
-    return nullptr;
+    return 0;
   }
-  buf->trimStart(kPaddingHeaderSize);
-  std::shared_ptr<net::IOBuf> result = net::IOBuf::copyBuffer(buf->data(), payload_size);
-  buf->trimStart(payload_size + padding_size);
-  buf->retreat(kPaddingHeaderSize + payload_size + padding_size);
   ec = asio::error_code();
-  return result;
+  return record_size;
 }
 
 }  // namespace net
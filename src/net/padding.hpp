@@ -18,6 +18,13 @@ constexpr const int kMaxPaddingSize = 255;
 void AddPadding(std::shared_ptr<IOBuf> buf);
 std::shared_ptr<IOBuf> RemovePadding(std::shared_ptr<IOBuf> buf, asio::error_code& ec);
 
+/// locate the payload of the first padded record in place
+///
+/// \param payload_size the size of the payload, which follows the header
+/// \return the size of the whole record, 0 with ec try_again if incomplete
+///         or ec invalid_argument if malformed
+size_t ParsePadding(const uint8_t* data, size_t length, size_t* payload_size, asio::error_code& ec);
+
 }  // namespace net
 
 #endif  // H_NET_PADDING
@@ -0,0 +1,54 @@
+// SPDX-License-Identifier: GPL-2.0
+/* Copyright (c) 2024 Chilledheart  */
+
+#include <benchmark/benchmark.h>
+
+#include "core/logging.hpp"
+#include "net/padding.hpp"
+
+#include "benchmark_util.hpp"
+
+using namespace net;
+
+namespace {
+
+// includes the copy of the payload into the buffer
+void BM_AddPadding(benchmark::State& state) {
+  const size_t size = state.range(0);
+  auto payload = benchmark::GenerateRandContent(size);
+  std::shared_ptr<IOBuf> buf = IOBuf::create(kPaddingHeaderSize + size + kMaxPaddingSize);
+
+  uint64_t allocations = benchmark::GetAllocationCount();
+  for (auto _ : state) {
+    buf->clear();
+    memcpy(buf->mutable_data(), payload->data(), size);
+    buf->append(size);
+    AddPadding(buf);
+    benchmark::DoNotOptimize(buf->data());
+  }
+  benchmark::ReportComponentCounters(state, allocations, size);
+}
+
+void BM_RemovePadding(benchmark::State& state) {
+  const size_t size = state.range(0);
+  auto payload = benchmark::GenerateRandContent(size);
+  std::shared_ptr<IOBuf> buf = IOBuf::copyBuffer(payload->data(), payload->length());
+  AddPadding(buf);
+  const size_t padded_size = buf->length();
+
+  uint64_t allocations = benchmark::GetAllocationCount();
+  for (auto _ : state) {
+    asio::error_code ec;
+    auto result = RemovePadding(buf, ec);
+    CHECK(!ec) << ec;
+    benchmark::DoNotOptimize(result->data());
+    // the consumed bytes are still in place, take them back
+    buf->append(padded_size);
+  }
+  benchmark::ReportComponentCounters(state, allocations, size);
+}
+
+}  // namespace
+
+BENCHMARK(BM_AddPadding)->Arg(64)->Arg(1024)->Arg(16 * 1024 - 1);
+BENCHMARK(BM_RemovePadding)->Arg(64)->Arg(1024)->Arg(16 * 1024 - 1);
@@ -6,6 +6,7 @@
 
 #include <gmock/gmock.h>
 #include "net/padding.hpp"
+#include "net/protocol.hpp"
 
 #include "test_util.hpp"
 
@@ -30,3 +31,71 @@ TEST(NetworkTest, AddAndRemovePadding) {
 
   ASSERT_EQ(::testing::Bytes(recv_buf->data(), recv_buf->length()), ::testing::Bytes(buf->data(), buf->length()));
 }
+
+TEST(NetworkTest, AddPaddingKeepsHeadroom) {
+  // a full read buffer, reallocated for the padding
+  std::shared_ptr<IOBuf> buf = IOBuf::create(SOCKET_BUF_HEADROOM + SOCKET_BUF_SIZE);
+  buf->advance(SOCKET_BUF_HEADROOM);
+  memset(buf->mutable_tail(), 'x', buf->tailroom());
+  buf->append(buf->tailroom());
+
+  AddPadding(buf);
+
+  // room left for the http2 frame header (9 bytes)
+  EXPECT_GE(buf->headroom(), 9u);
+  EXPECT_GE(buf->length(), static_cast<size_t>(SOCKET_BUF_SIZE + kPaddingHeaderSize));
+}
+
+TEST(NetworkTest, AddPaddingWithHeadroom) {
+  for (size_t length : {size_t{1}, size_t{256}, size_t{SOCKET_BUF_SIZE}}) {
+    std::shared_ptr<IOBuf> buf = IOBuf::create(SOCKET_BUF_HEADROOM + length);
+    buf->advance(SOCKET_BUF_HEADROOM);
+    for (size_t i = 0; i < length; ++i) {
+      buf->mutable_tail()[i] = i & 255;
+    }
+    buf->append(length);
+    std::shared_ptr<IOBuf> expected = IOBuf::copyBuffer(buf->data(), buf->length());
+
+    AddPadding(buf);
+
+    asio::error_code ec;
+    auto recv_buf = RemovePadding(buf, ec);
+    ASSERT_FALSE(ec) << length;
+    EXPECT_TRUE(buf->empty());
+    ASSERT_EQ(::testing::Bytes(recv_buf->data(), recv_buf->length()),
+              ::testing::Bytes(expected->data(), expected->length()));
+  }
+}
+
+TEST(NetworkTest, StripPaddingInPlace) {
+  std::shared_ptr<IOBuf> buf = IOBuf::create(256);
+  for (size_t i = 0; i < buf->capacity(); ++i) {
+    buf->mutable_buffer()[i] = i & 255;
+  }
+  buf->append(256);
+
+  std::shared_ptr<IOBuf> send_buf = IOBuf::copyBuffer(buf->data(), buf->length());
+  AddPadding(send_buf);
+
+  asio::error_code ec;
+  size_t payload_size;
+  // incomplete
+  EXPECT_EQ(0u, ParsePadding(send_buf->data(), send_buf->length() - 1, &payload_size, ec));
+  EXPECT_EQ(asio::error::try_again, ec);
+
+  size_t record_size = ParsePadding(send_buf->data(), send_buf->length(), &payload_size, ec);
+  EXPECT_FALSE(ec);
+  EXPECT_EQ(record_size, send_buf->length());
+  ASSERT_EQ(payload_size, buf->length());
+
+  // the payload refers to the padded record
+  auto recv_buf = IOBuf::shareBuffer(send_buf, send_buf->data() + kPaddingHeaderSize, payload_size);
+  EXPECT_EQ(recv_buf->data(), send_buf->data() + kPaddingHeaderSize);
+  send_buf.reset();
+  ASSERT_EQ(::testing::Bytes(recv_buf->data(), recv_buf->length()), ::testing::Bytes(buf->data(), buf->length()));
+
+  // bytes outside are copied
+  auto copied_buf = IOBuf::shareBuffer(recv_buf, buf->data(), buf->length());
+  EXPECT_NE(copied_buf->data(), buf->data());
+  ASSERT_EQ(::testing::Bytes(copied_buf->data(), copied_buf->length()), ::testing::Bytes(buf->data(), buf->length()));
+}
@@ -20,6 +20,9 @@
 #define SOCKET_BUF_SIZE (16384)
 #define SOCKET_DEBUF_SIZE (16384)
 #define SS_FRAME_SIZE (16384 - 128)
+// room reserved ahead of the data read from sockets, so the http2 frame
+// header (9 bytes) and the padding header (3 bytes) are written in place
+#define SOCKET_BUF_HEADROOM (16)
 
 namespace net {
 
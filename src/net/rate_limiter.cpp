@@ -0,0 +1,80 @@
+// SPDX-License-Identifier: GPL-2.0
+/* Copyright (c) 2024 Chilledheart  */
+
+#include "net/rate_limiter.hpp"
+
+#include <algorithm>
+
+namespace net {
+
+namespace {
+
+double BurstOf(uint64_t rate) {
+  return std::max<double>(static_cast<double>(rate) * TokenBucket::kBurstMs / 1000, 1);
+}
+
+}  // namespace
+
+TokenBucket::TokenBucket(TokenBucket* parent, uint64_t rate, bool shared)
+    : parent_(parent), rate_(rate), mutex_(shared ? &lock_ : nullptr), tokens_(BurstOf(rate)) {}
+
+void TokenBucket::set_rate(uint64_t rate) {
+  absl::MutexLockMaybe lock(mutex_);
+  rate_.store(rate, std::memory_order_relaxed);
+  tokens_ = std::min(tokens_, BurstOf(rate));
+}
+
+uint64_t TokenBucket::Delay(uint64_t now) {
+  uint64_t delay = 0;
+  if (rate()) {
+    absl::MutexLockMaybe lock(mutex_);
+    Refill(now);
+    uint64_t rate = rate_.load(std::memory_order_relaxed);
+    if (rate && tokens_ < 1) {
+      // the time to get one token back
+      delay = static_cast<uint64_t>((1 - tokens_) * 1e9 / static_cast<double>(rate));
+      delay = std::max<uint64_t>(delay, 1);
+    }
+  }
+  if (parent_) {
+    delay = std::max(delay, parent_->Delay(now));
+  }
+  return delay;
+}
+
+void TokenBucket::Consume(uint64_t bytes, uint64_t now) {
+  if (rate()) {
+    absl::MutexLockMaybe lock(mutex_);
+    Refill(now);
+    tokens_ -= static_cast<double>(bytes);
+  }
+  if (parent_) {
+    parent_->Consume(bytes, now);
+  }
+}
+
+void TokenBucket::Refill(uint64_t now) {
+  if (now <= last_refill_) {
+    return;
+  }
+  uint64_t elapsed = now - last_refill_;
+  last_refill_ = now;
+  uint64_t rate = rate_.load(std::memory_order_relaxed);
+  tokens_ = std::min(tokens_ + static_cast<double>(rate) * static_cast<double>(elapsed) / 1e9, BurstOf(rate));
+}
+
+RateLimiter::RateLimiter(std::shared_ptr<RateLimiter> parent,
+                         uint64_t download_rate,
+                         uint64_t upload_rate,
+                         bool shared)
+    : parent_(std::move(parent)),
+      download_(parent_ ? parent_->download() : nullptr, download_rate, shared),
+      upload_(parent_ ? parent_->upload() : nullptr, upload_rate, shared) {}
+
+// static
+const std::shared_ptr<RateLimiter>& RateLimiter::Global() {
+  static const auto* global = new std::shared_ptr<RateLimiter>(std::make_shared<RateLimiter>(nullptr, 0, 0));
+  return *global;
+}
+
+}  // namespace net
@@ -0,0 +1,102 @@
+// SPDX-License-Identifier: GPL-2.0
+/* Copyright (c) 2024 Chilledheart  */
+
+#ifndef H_NET_RATE_LIMITER
+#define H_NET_RATE_LIMITER
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+#include <absl/base/thread_annotations.h>
+#include <absl/synchronization/mutex.h>
+
+namespace net {
+
+/// A token bucket refilled at a constant rate.
+///
+/// The bucket holds up to kBurstMs worth of tokens and a transfer is charged
+/// after it happens, so the bucket runs into debt when a single transfer
+/// exceeds the tokens available and the next transfer waits until the debt is
+/// paid off. Buckets are chained to their parent, a transfer is charged on
+/// every level and has to wait for the most limited one.
+///
+/// Shared buckets are thread-safe, the global and listener levels are shared
+/// between io contexts. The buckets of a connection are only used from its io
+/// context and skip the locking.
+class TokenBucket {
+ public:
+  /// the burst allowed after being idle, in milliseconds of the rate
+  static constexpr int64_t kBurstMs = 100;
+
+  /// \param parent the bucket on the upper level, or nullptr
+  /// \param rate the rate in bytes per second, 0 for unlimited
+  /// \param shared whether the bucket is used from more than one thread
+  TokenBucket(TokenBucket* parent, uint64_t rate, bool shared = true);
+
+  TokenBucket(const TokenBucket&) = delete;
+  TokenBucket& operator=(const TokenBucket&) = delete;
+
+  uint64_t rate() const { return rate_.load(std::memory_order_relaxed); }
+
+  /// change the rate, the tokens accumulated are kept within the new burst
+  void set_rate(uint64_t rate);
+
+  /// the time to wait before the next transfer
+  ///
+  /// \param now the monotonic time in nanoseconds
+  /// \return the nanoseconds to wait on the most limited level, 0 if ready
+  uint64_t Delay(uint64_t now);
+
+  /// charge the transferred bytes on this level and all upper levels
+  ///
+  /// \param bytes the bytes transferred
+  /// \param now the monotonic time in nanoseconds
+  void Consume(uint64_t bytes, uint64_t now);
+
+ private:
+  /// requires holding mutex_ if not null
+  void Refill(uint64_t now);
+
+  TokenBucket* const parent_;
+  std::atomic<uint64_t> rate_;
+
+  absl::Mutex lock_;
+  /// the lock of a shared bucket, nullptr otherwise
+  absl::Mutex* const mutex_;
+  /// guarded by mutex_ if not null
+  double tokens_;
+  uint64_t last_refill_ = 0;
+};
+
+/// One level of the rate limiting hierarchy: global, listener and connection.
+///
+/// Each level keeps one bucket per direction. The download direction is
+/// charged when reading from upstream, the upload direction when reading from
+/// downlink, so every byte relayed is charged exactly once.
+class RateLimiter {
+ public:
+  /// \param parent the limiter on the upper level, or nullptr
+  /// \param download_rate the rate towards the client in bytes per second, 0 for unlimited
+  /// \param upload_rate the rate from the client in bytes per second, 0 for unlimited
+  /// \param shared whether the limiter is used from more than one thread
+  RateLimiter(std::shared_ptr<RateLimiter> parent, uint64_t download_rate, uint64_t upload_rate, bool shared = true);
+
+  RateLimiter(const RateLimiter&) = delete;
+  RateLimiter& operator=(const RateLimiter&) = delete;
+
+  /// the process-wide limiter on the top of the hierarchy
+  static const std::shared_ptr<RateLimiter>& Global();
+
+  TokenBucket* download() { return &download_; }
+  TokenBucket* upload() { return &upload_; }
+
+ private:
+  const std::shared_ptr<RateLimiter> parent_;
+  TokenBucket download_;
+  TokenBucket upload_;
+};
+
+}  // namespace net
+
+#endif  // H_NET_RATE_LIMITER
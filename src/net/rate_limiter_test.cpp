@@ -0,0 +1,52 @@
+// SPDX-License-Identifier: GPL-2.0
+/* Copyright (c) 2024 Chilledheart  */
+
+#include <gtest/gtest-message.h>
+#include <gtest/gtest.h>
+
+#include "net/rate_limiter.hpp"
+
+using namespace net;
+
+namespace {
+constexpr uint64_t kMs = 1000 * 1000;
+}  // namespace
+
+TEST(RateLimiterTest, Unlimited) {
+  TokenBucket bucket(nullptr, 0);
+  bucket.Consume(1 << 30, 1);
+  EXPECT_EQ(0u, bucket.Delay(1));
+}
+
+TEST(RateLimiterTest, DebtIsPaidOff) {
+  // 1000 bytes per second with a burst of 100 bytes
+  TokenBucket bucket(nullptr, 1000);
+  uint64_t now = 1000 * kMs;
+  EXPECT_EQ(0u, bucket.Delay(now));
+  bucket.Consume(600, now);
+  // 500 bytes in debt plus one byte to go
+  EXPECT_NEAR(501.0 * kMs, bucket.Delay(now), kMs);
+  EXPECT_NEAR(1.0 * kMs, bucket.Delay(now + 500 * kMs), kMs);
+  EXPECT_EQ(0u, bucket.Delay(now + 501 * kMs));
+  // the tokens never exceed the burst after being idle
+  bucket.Consume(TokenBucket::kBurstMs + 1, now + 100 * 1000 * kMs);
+  EXPECT_NE(0u, bucket.Delay(now + 100 * 1000 * kMs));
+}
+
+TEST(RateLimiterTest, Hierarchy) {
+  auto global = std::make_shared<RateLimiter>(nullptr, 1000, 0);
+  auto listener = std::make_shared<RateLimiter>(global, 0, 0);
+  RateLimiter conn1(listener, 0, 0, /*shared=*/false);
+  RateLimiter conn2(listener, 0, 0, /*shared=*/false);
+  uint64_t now = 1000 * kMs;
+  conn1.download()->Consume(600, now);
+  // the sibling is throttled by the shared global level
+  EXPECT_NEAR(501.0 * kMs, conn2.download()->Delay(now), kMs);
+  // the directions are independent
+  EXPECT_EQ(0u, conn2.upload()->Delay(now));
+  conn1.upload()->Consume(1 << 20, now);
+  EXPECT_EQ(0u, conn1.upload()->Delay(now));
+
+  global->download()->set_rate(0);
+  EXPECT_EQ(0u, conn2.download()->Delay(now));
+}
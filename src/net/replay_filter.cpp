@@ -0,0 +1,147 @@
+// SPDX-License-Identifier: GPL-2.0
+/* Copyright (c) 2024 Chilledheart  */
+
+#include "net/replay_filter.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include <base/rand_util.h>
+
+#include "core/logging.hpp"
+
+namespace net {
+
+namespace {
+
+// the finalizer of MurmurHash3
+inline uint64_t Mix(uint64_t x) {
+  x ^= x >> 33;
+  x *= 0xff51afd7ed558ccdULL;
+  x ^= x >> 33;
+  x *= 0xc4ceb9fe1a85ec53ULL;
+  x ^= x >> 33;
+  return x;
+}
+
+}  // namespace
+
+ReplayFilter::ReplayFilter(size_t capacity, double fp_rate)
+    : capacity_(std::max<size_t>(capacity, 1)), seed_(gurl_base::RandUint64()), current_(0) {
+  DCHECK_GT(fp_rate, 0.0);
+  DCHECK_LT(fp_rate, 1.0);
+  fp_rate = std::clamp(fp_rate, 1e-12, 0.5);
+
+  // optimal number of bits and hash functions for a standard Bloom filter
+  const double ln2 = std::log(2.0);
+  double bits = std::ceil(-static_cast<double>(capacity_) * std::log(fp_rate) / (ln2 * ln2));
+  num_blocks_ = std::max<size_t>(1, static_cast<size_t>(std::ceil(bits / kBlockBits)));
+  hash_count_ = std::clamp(static_cast<int>(std::lround(bits / capacity_ * ln2)), 1, kMaxHashCount);
+
+  for (Generation& generation : generations_) {
+    generation.words.reset(new std::atomic<uint64_t>[num_blocks_ * kBlockWords]());
+    generation.count = 0;
+  }
+
+  VLOG(1) << "ReplayFilter: capacity: " << capacity_ << " false positive rate: " << fp_rate
+          << " blocks: " << num_blocks_ << " hashes: " << hash_count_ << " memory: " << memory_usage() << " bytes";
+}
+
+ReplayFilter::~ReplayFilter() = default;
+
+bool ReplayFilter::CheckAndInsert(const uint8_t* salt, size_t salt_len) {
+  uint64_t mask[kBlockWords];
+  size_t block = Locate(salt, salt_len, mask);
+
+  int index = current_.load(std::memory_order_acquire);
+  bool seen = Contains(generations_[index ^ 1], block, mask);
+  // refresh the salt seen by the previous generation as well
+  seen |= Set(index, block, mask);
+  return !seen;
+}
+
+void ReplayFilter::Insert(const uint8_t* salt, size_t salt_len) {
+  uint64_t mask[kBlockWords];
+  size_t block = Locate(salt, salt_len, mask);
+
+  int index = current_.load(std::memory_order_acquire);
+  Set(index, block, mask);
+}
+
+size_t ReplayFilter::Locate(const uint8_t* salt, size_t salt_len, uint64_t mask[kBlockWords]) const {
+  uint64_t h = seed_;
+  size_t i = 0;
+  for (; i + sizeof(uint64_t) <= salt_len; i += sizeof(uint64_t)) {
+    uint64_t word;
+    memcpy(&word, salt + i, sizeof(word));
+    h = Mix(h ^ word);
+  }
+  if (i < salt_len) {
+    uint64_t word = 0;
+    memcpy(&word, salt + i, salt_len - i);
+    h = Mix(h ^ word);
+  }
+  uint64_t h1 = Mix(h ^ salt_len);
+  uint64_t h2 = Mix(h1 ^ seed_);
+
+  // the block is chosen by the upper bits (fast range reduction),
+  // the bits inside the block by double hashing with an odd step
+  size_t block = static_cast<size_t>(((h1 >> 32) * static_cast<uint64_t>(num_blocks_)) >> 32);
+  uint32_t pos = static_cast<uint32_t>(h2);
+  uint32_t step = static_cast<uint32_t>(h2 >> 32) | 1;
+
+  std::fill(mask, mask + kBlockWords, 0);
+  for (int k = 0; k < hash_count_; ++k) {
+    uint32_t bit = pos % kBlockBits;
+    mask[bit / 64] |= uint64_t{1} << (bit % 64);
+    pos += step;
+  }
+  return block;
+}
+
+bool ReplayFilter::Contains(const Generation& generation, size_t block, const uint64_t mask[kBlockWords]) const {
+  const std::atomic<uint64_t>* words = &generation.words[block * kBlockWords];
+  uint64_t missing = 0;
+  for (size_t w = 0; w < kBlockWords; ++w) {
+    missing |= mask[w] & ~words[w].load(std::memory_order_relaxed);
+  }
+  return missing == 0;
+}
+
+bool ReplayFilter::Set(int index, size_t block, const uint64_t mask[kBlockWords]) {
+  Generation& generation = generations_[index];
+  std::atomic<uint64_t>* words = &generation.words[block * kBlockWords];
+  uint64_t missing = 0;
+  for (size_t w = 0; w < kBlockWords; ++w) {
+    if (mask[w]) {
+      missing |= mask[w] & ~words[w].fetch_or(mask[w], std::memory_order_relaxed);
+    }
+  }
+  if (missing == 0) {
+    return true;
+  }
+  if (generation.count.fetch_add(1, std::memory_order_relaxed) + 1 >= capacity_) {
+    Rotate(index);
+  }
+  return false;
+}
+
+void ReplayFilter::Rotate(int index) {
+  if (rotating_.test_and_set(std::memory_order_acquire)) {
+    return;
+  }
+  // rotated by another thread already
+  if (current_.load(std::memory_order_relaxed) == index) {
+    Generation& previous = generations_[index ^ 1];
+    for (size_t i = 0; i < num_blocks_ * kBlockWords; ++i) {
+      previous.words[i].store(0, std::memory_order_relaxed);
+    }
+    previous.count.store(0, std::memory_order_relaxed);
+    current_.store(index ^ 1, std::memory_order_release);
+    VLOG(1) << "ReplayFilter: rotated after " << capacity_ << " salts";
+  }
+  rotating_.clear(std::memory_order_release);
+}
+
+}  // namespace net
@@ -0,0 +1,90 @@
+// SPDX-License-Identifier: GPL-2.0
+/* Copyright (c) 2024 Chilledheart  */
+
+#ifndef H_NET_REPLAY_FILTER
+#define H_NET_REPLAY_FILTER
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+namespace net {
+
+/// Remembers the salts (or IVs) of the first packets received, so a replayed
+/// first packet is rejected (see SIP004 and SIP022).
+///
+/// Salts are kept in two generations of blocked Bloom filters, each holding
+/// up to |capacity| salts. Once the current generation is full, the previous
+/// one is cleared and takes over, so the memory stays flat and a salt is
+/// remembered for at least |capacity| more salts.
+///
+/// A salt maps to a single cache line (512 bits) of each filter, and the bits
+/// tested are gathered into a mask of eight words, so a lookup costs two cache
+/// misses and a few vectorizable word operations.
+///
+/// The filter is shared by all io threads without locks: the bits are set with
+/// atomic fetch_or. Two connections presenting the same salt at the very same
+/// time might both be accepted, and the generation being cleared by a rotation
+/// might miss a few of the oldest salts.
+class ReplayFilter {
+ public:
+  static constexpr size_t kBlockBits = 512;
+  static constexpr size_t kBlockWords = kBlockBits / 64;
+  static constexpr int kMaxHashCount = 16;
+
+  /// \param capacity the salts remembered by each generation
+  /// \param fp_rate the false positive rate of a lookup in each generation, in (0, 1)
+  ReplayFilter(size_t capacity, double fp_rate);
+  ~ReplayFilter();
+
+  ReplayFilter(const ReplayFilter&) = delete;
+  ReplayFilter& operator=(const ReplayFilter&) = delete;
+
+  /// check the salt against the remembered ones and remember it
+  ///
+  /// \return false if the salt has been seen (or a false positive)
+  bool CheckAndInsert(const uint8_t* salt, size_t salt_len);
+
+  /// remember the salt without checking, e.g. the salts generated locally
+  void Insert(const uint8_t* salt, size_t salt_len);
+
+  size_t capacity() const { return capacity_; }
+  int hash_count() const { return hash_count_; }
+  /// the bytes held by both generations
+  size_t memory_usage() const { return 2 * num_blocks_ * kBlockWords * sizeof(uint64_t); }
+
+ private:
+  struct Generation {
+    std::unique_ptr<std::atomic<uint64_t>[]> words;
+    std::atomic<size_t> count;
+  };
+
+  /// locate the block and the bits of the salt
+  size_t Locate(const uint8_t* salt, size_t salt_len, uint64_t mask[kBlockWords]) const;
+
+  /// \return true if all the bits in mask are set
+  bool Contains(const Generation& generation, size_t block, const uint64_t mask[kBlockWords]) const;
+
+  /// set the bits and count the salt
+  ///
+  /// \return true if all the bits in mask were set before
+  bool Set(int index, size_t block, const uint64_t mask[kBlockWords]);
+
+  /// clear the previous generation and make it the current one
+  void Rotate(int index);
+
+  const size_t capacity_;
+  size_t num_blocks_;
+  int hash_count_;
+  /// random seed to keep the block and bits unpredictable to peers
+  uint64_t seed_;
+
+  Generation generations_[2];
+  std::atomic<int> current_;
+  std::atomic_flag rotating_ = ATOMIC_FLAG_INIT;
+};
+
+}  // namespace net
+
+#endif  // H_NET_REPLAY_FILTER
@@ -0,0 +1,46 @@
+// SPDX-License-Identifier: GPL-2.0
+/* Copyright (c) 2024 Chilledheart  */
+
+#include <benchmark/benchmark.h>
+
+#include "core/logging.hpp"
+#include "net/replay_filter.hpp"
+
+#include "benchmark_util.hpp"
+
+using namespace net;
+
+namespace {
+
+constexpr size_t kSaltSize = 32;
+// salts presented per iteration, distinct so each check misses the cache
+constexpr size_t kSaltCount = 64 * 1024;
+
+// shared by the threaded runs, like the server filter shared by io threads
+ReplayFilter* GetFilter() {
+  static ReplayFilter* filter = new ReplayFilter(1000000, 1e-6);
+  return filter;
+}
+
+// one check per first packet, the salts are fresh (never seen)
+void BM_ReplayFilterCheckAndInsert(benchmark::State& state) {
+  ReplayFilter* filter = GetFilter();
+  auto salts = benchmark::GenerateRandContent(kSaltSize * kSaltCount);
+  size_t i = 0;
+
+  uint64_t allocations = benchmark::GetAllocationCount();
+  for (auto _ : state) {
+    uint8_t* salt = salts->mutable_data() + (i % kSaltCount) * kSaltSize;
+    // make the salt unique across rounds
+    ++*reinterpret_cast<uint64_t*>(salt);
+    benchmark::DoNotOptimize(filter->CheckAndInsert(salt, kSaltSize));
+    ++i;
+  }
+  benchmark::ReportComponentCounters(state, allocations, kSaltSize);
+  state.counters["checks"] = benchmark::Counter(static_cast<double>(state.iterations()), benchmark::Counter::kIsRate);
+  state.counters["memory"] = static_cast<double>(filter->memory_usage());
+}
+
+}  // namespace
+
+BENCHMARK(BM_ReplayFilterCheckAndInsert)->Threads(1)->Threads(4);
@@ -0,0 +1,113 @@
+// SPDX-License-Identifier: GPL-2.0
+/* Copyright (c) 2024 Chilledheart  */
+
+#include <gtest/gtest-message.h>
+#include <gtest/gtest.h>
+
+#include <base/rand_util.h>
+#include <thread>
+#include <vector>
+
+#include "net/replay_filter.hpp"
+
+using namespace net;
+
+namespace {
+
+constexpr size_t kSaltSize = 32;
+
+std::vector<uint8_t> RandSalt() {
+  std::vector<uint8_t> salt(kSaltSize);
+  gurl_base::RandBytes(salt.data(), salt.size());
+  return salt;
+}
+
+}  // namespace
+
+TEST(ReplayFilterTest, DetectReplay) {
+  ReplayFilter filter(1000, 1e-6);
+  auto salt = RandSalt();
+  EXPECT_TRUE(filter.CheckAndInsert(salt.data(), salt.size()));
+  EXPECT_FALSE(filter.CheckAndInsert(salt.data(), salt.size()));
+
+  auto local_salt = RandSalt();
+  filter.Insert(local_salt.data(), local_salt.size());
+  EXPECT_FALSE(filter.CheckAndInsert(local_salt.data(), local_salt.size()));
+
+  // salts differ in the last byte only
+  auto other_salt = salt;
+  other_salt.back() ^= 1;
+  EXPECT_TRUE(filter.CheckAndInsert(other_salt.data(), other_salt.size()));
+}
+
+TEST(ReplayFilterTest, FalsePositiveRate) {
+  constexpr size_t kCapacity = 10000;
+  ReplayFilter filter(kCapacity, 1e-3);
+  EXPECT_GT(filter.memory_usage(), 0u);
+  EXPECT_GE(filter.hash_count(), 1);
+
+  std::vector<std::vector<uint8_t>> salts;
+  for (size_t i = 0; i < kCapacity - 1; ++i) {
+    salts.push_back(RandSalt());
+    filter.Insert(salts.back().data(), salts.back().size());
+  }
+  // no false negatives
+  for (const auto& salt : salts) {
+    ASSERT_FALSE(filter.CheckAndInsert(salt.data(), salt.size()));
+  }
+  // a handful of false positives, with a generous margin for the blocked layout
+  size_t false_positives = 0;
+  for (size_t i = 0; i < kCapacity; ++i) {
+    auto salt = RandSalt();
+    false_positives += !filter.CheckAndInsert(salt.data(), salt.size());
+  }
+  EXPECT_LE(false_positives, kCapacity * 1e-3 * 10);
+}
+
+TEST(ReplayFilterTest, RotateGenerations) {
+  constexpr size_t kCapacity = 100;
+  ReplayFilter filter(kCapacity, 1e-6);
+  auto salt = RandSalt();
+  ASSERT_TRUE(filter.CheckAndInsert(salt.data(), salt.size()));
+
+  // remembered by the previous generation after one rotation
+  for (size_t i = 0; i < kCapacity; ++i) {
+    auto other_salt = RandSalt();
+    filter.Insert(other_salt.data(), other_salt.size());
+  }
+  EXPECT_FALSE(filter.CheckAndInsert(salt.data(), salt.size()));
+
+  // forgotten after two more rotations without refreshing
+  for (size_t i = 0; i < 2 * kCapacity; ++i) {
+    auto other_salt = RandSalt();
+    filter.Insert(other_salt.data(), other_salt.size());
+  }
+  EXPECT_TRUE(filter.CheckAndInsert(salt.data(), salt.size()));
+}
+
+TEST(ReplayFilterTest, SharedByThreads) {
+  constexpr int kThreads = 4;
+  constexpr size_t kSaltsPerThread = 10000;
+  ReplayFilter filter(kThreads * kSaltsPerThread * 2, 1e-6);
+
+  std::vector<std::vector<std::vector<uint8_t>>> salts(kThreads);
+  std::vector<std::thread> threads;
+  std::vector<size_t> rejected(kThreads);
+  for (int t = 0; t < kThreads; ++t) {
+    threads.emplace_back([&, t]() {
+      for (size_t i = 0; i < kSaltsPerThread; ++i) {
+        salts[t].push_back(RandSalt());
+        rejected[t] += !filter.CheckAndInsert(salts[t].back().data(), kSaltSize);
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  for (int t = 0; t < kThreads; ++t) {
+    EXPECT_LE(rejected[t], 1u);
+    for (const auto& salt : salts[t]) {
+      ASSERT_FALSE(filter.CheckAndInsert(salt.data(), salt.size()));
+    }
+  }
+}
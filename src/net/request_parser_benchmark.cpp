@@ -0,0 +1,61 @@
+// SPDX-License-Identifier: GPL-2.0
+/* Copyright (c) 2024 Chilledheart  */
+
+#include <benchmark/benchmark.h>
+
+#include "core/logging.hpp"
+#include "net/socks4_request_parser.hpp"
+#include "net/socks5_request_parser.hpp"
+#include "net/ss_request_parser.hpp"
+
+#include "benchmark_util.hpp"
+
+using namespace net;
+
+namespace {
+
+// CONNECT www.google.com:443
+constexpr const uint8_t kSocks5Request[] = {0x05, 0x01, 0x00, 0x03, 0x0e, 'w', 'w', 'w', '.', 'g', 'o',
+                                            'o',  'g',  'l',  'e',  '.',  'c', 'o', 'm', 0x01, 0xbb};
+
+// CONNECT www.google.com:443 (socks4a)
+constexpr const uint8_t kSocks4Request[] = {0x04, 0x01, 0x01, 0xbb, 0x00, 0x00, 0x00, 0x01, 'u', 's', 'e', 'r',
+                                            0x00, 'w',  'w',  'w',  '.',  'g',  'o',  'o',  'g', 'l', 'e', '.',
+                                            'c',  'o',  'm',  0x00};
+
+// www.google.com:443
+constexpr const uint8_t kSsRequest[] = {0x03, 0x0e, 'w', 'w', 'w', '.', 'g',  'o', 'o',
+                                        'g',  'l',  'e', '.', 'c', 'o', 'm', 0x01, 0xbb};
+
+template <typename Parser, typename Request, size_t N>
+void RunRequestParser(benchmark::State& state, const uint8_t (&input)[N]) {
+  Parser parser;
+  uint64_t allocations = benchmark::GetAllocationCount();
+  for (auto _ : state) {
+    Request request;
+    parser.reset();
+    typename Parser::result_type result;
+    std::tie(result, std::ignore) = parser.parse(request, std::begin(input), std::end(input));
+    CHECK_EQ(result, Parser::good);
+    benchmark::DoNotOptimize(request);
+  }
+  benchmark::ReportComponentCounters(state, allocations, N);
+}
+
+void BM_Socks5RequestParser(benchmark::State& state) {
+  RunRequestParser<socks5::request_parser, socks5::request>(state, kSocks5Request);
+}
+
+void BM_Socks4RequestParser(benchmark::State& state) {
+  RunRequestParser<socks4::request_parser, socks4::request>(state, kSocks4Request);
+}
+
+void BM_SsRequestParser(benchmark::State& state) {
+  RunRequestParser<ss::request_parser, ss::request>(state, kSsRequest);
+}
+
+}  // namespace
+
+BENCHMARK(BM_Socks5RequestParser);
+BENCHMARK(BM_Socks4RequestParser);
+BENCHMARK(BM_SsRequestParser);
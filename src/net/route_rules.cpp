@@ -0,0 +1,550 @@
+// SPDX-License-Identifier: GPL-2.0
+/* Copyright (c) 2024 Chilledheart  */
+
+#include "net/route_rules.hpp"
+
+#include <absl/strings/ascii.h>
+#include <absl/strings/numbers.h>
+#include <absl/strings/str_cat.h>
+#include <absl/strings/str_split.h>
+#include <base/files/memory_mapped_file.h>
+#include <algorithm>
+#include <cstring>
+#include <map>
+#include <mutex>
+
+#include "core/logging.hpp"
+#include "core/utils.hpp"
+
+namespace net {
+
+struct RouteRules::Key {
+  uint64_t hi;
+  uint64_t lo;
+
+  bool operator==(const Key& other) const { return hi == other.hi && lo == other.lo; }
+  bool operator!=(const Key& other) const { return !(*this == other); }
+  bool operator<(const Key& other) const { return hi < other.hi || (hi == other.hi && lo < other.lo); }
+};
+
+struct RouteRules::Node {
+  uint32_t first_edge;
+  uint32_t edge_count;
+  /// the action of the domain and its subdomains
+  uint8_t suffix;
+  /// the action of the domain only
+  uint8_t exact;
+  uint16_t reserved;
+};
+
+struct RouteRules::Edge {
+  uint32_t label_offset;
+  uint32_t label_size;
+  uint32_t child;
+};
+
+namespace {
+
+/// the header of the binary form, followed by the range starts, the nodes,
+/// the edges, the range actions and the labels
+struct Header {
+  char magic[8];
+  uint32_t byte_order;
+  uint32_t range_count;
+  uint32_t node_count;
+  uint32_t edge_count;
+  uint32_t labels_size;
+  uint32_t domain_count;
+};
+
+constexpr char kMagic[8] = {'Y', 'A', 'S', 'S', 'R', 'R', '1', '\n'};
+constexpr uint32_t kByteOrder = 0x01020304u;
+
+/// IPv4 addresses are keyed as IPv4-mapped IPv6 addresses
+constexpr uint64_t kV4MappedPrefix = 0x0000ffff00000000ull;
+
+/// computed in 64 bits, so a crafted header can't wrap it on 32-bit targets
+uint64_t BinarySize(const Header& header) {
+  return sizeof(Header) + uint64_t{header.range_count} * (2 * sizeof(uint64_t) + 1) +
+         uint64_t{header.node_count} * 3 * sizeof(uint32_t) + uint64_t{header.edge_count} * 3 * sizeof(uint32_t) +
+         header.labels_size;
+}
+
+bool ParseAction(std::string_view name, RouteRules::Action* action) {
+  if (name == "proxy") {
+    *action = RouteRules::kProxy;
+  } else if (name == "direct") {
+    *action = RouteRules::kDirect;
+  } else if (name == "reject") {
+    *action = RouteRules::kReject;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+/// compare the label stored in lower case with the label looked up
+int CompareLabel(std::string_view stored, std::string_view label) {
+  size_t size = std::min(stored.size(), label.size());
+  for (size_t i = 0; i < size; ++i) {
+    unsigned char a = stored[i];
+    unsigned char b = absl::ascii_tolower(label[i]);
+    if (a != b) {
+      return a < b ? -1 : 1;
+    }
+  }
+  return stored.size() == label.size() ? 0 : (stored.size() < label.size() ? -1 : 1);
+}
+
+void AddressToKey(const asio::ip::address& address, uint64_t* hi, uint64_t* lo) {
+  if (address.is_v4()) {
+    *hi = 0;
+    *lo = kV4MappedPrefix | address.to_v4().to_uint();
+    return;
+  }
+  auto bytes = address.to_v6().to_bytes();
+  *hi = *lo = 0;
+  for (int i = 0; i < 8; ++i) {
+    *hi = (*hi << 8) | bytes[i];
+    *lo = (*lo << 8) | bytes[i + 8];
+  }
+}
+
+}  // namespace
+
+static_assert(sizeof(Header) == 32, "unexpected padding in route rules header");
+
+// static
+const char* RouteRules::ActionName(Action action) {
+  switch (action) {
+    case kNone:
+      return "none";
+    case kProxy:
+      return "proxy";
+    case kDirect:
+      return "direct";
+    case kReject:
+      return "reject";
+    default:
+      return "unknown";
+  }
+}
+
+RouteRules::RouteRules() = default;
+
+RouteRules::~RouteRules() = default;
+
+bool RouteRules::Parse(std::string_view data, std::string* err) {
+  mapped_file_.reset();
+  if (data.size() >= sizeof(kMagic) && memcmp(data.data(), kMagic, sizeof(kMagic)) == 0) {
+    // copy into the aligned storage
+    storage_.assign((data.size() + sizeof(uint64_t) - 1) / sizeof(uint64_t), 0);
+    memcpy(storage_.data(), data.data(), data.size());
+    return Attach(reinterpret_cast<const uint8_t*>(storage_.data()), data.size(), err);
+  }
+  return Compile(data, err);
+}
+
+bool RouteRules::Load(const std::string& path, std::string* err) {
+  PlatformFile pf = OpenReadFile(path);
+  if (pf == gurl_base::kInvalidPlatformFile) {
+    *err = absl::StrCat("failed to open rules file: ", path);
+    return false;
+  }
+  auto mapped_file = std::make_unique<gurl_base::MemoryMappedFile>();
+  // take ownship of pf
+  if (!mapped_file->Initialize(pf, gurl_base::MemoryMappedFile::Region::kWholeFile)) {
+    *err = absl::StrCat("failed to map rules file: ", path);
+    return false;
+  }
+  std::string_view data(reinterpret_cast<const char*>(mapped_file->data()), mapped_file->length());
+  if (data.size() >= sizeof(kMagic) && memcmp(data.data(), kMagic, sizeof(kMagic)) == 0) {
+    // the tables are used in place
+    storage_.clear();
+    mapped_file_ = std::move(mapped_file);
+    return Attach(mapped_file_->data(), mapped_file_->length(), err);
+  }
+  bool ret = Compile(data, err);
+  if (!ret) {
+    *err = absl::StrCat(path, ": ", *err);
+  }
+  return ret;
+}
+
+std::string RouteRules::Serialize() const {
+  return std::string(reinterpret_cast<const char*>(data_), size_);
+}
+
+RouteRules::Action RouteRules::Match(std::string_view domain) const {
+  if (!domain.empty() && domain.back() == '.') {
+    domain.remove_suffix(1);
+  }
+  if (!node_count_ || domain.empty()) {
+    return kProxy;
+  }
+  uint8_t action = kNone;
+  const Node* node = &nodes_[0];
+  while (true) {
+    size_t dot = domain.rfind('.');
+    std::string_view label = dot == std::string_view::npos ? domain : domain.substr(dot + 1);
+    const Edge* edge = FindEdge(*node, label);
+    if (!edge) {
+      break;
+    }
+    node = &nodes_[edge->child];
+    if (dot == std::string_view::npos) {
+      if (node->exact) {
+        action = node->exact;
+      } else if (node->suffix) {
+        action = node->suffix;
+      }
+      break;
+    }
+    if (node->suffix) {
+      action = node->suffix;
+    }
+    domain = domain.substr(0, dot);
+  }
+  return action == kNone ? kProxy : static_cast<Action>(action);
+}
+
+RouteRules::Action RouteRules::Match(const asio::ip::address& address) const {
+  if (!range_count_) {
+    return kProxy;
+  }
+  Key key;
+  AddressToKey(address, &key.hi, &key.lo);
+  // the last range starting at or before the key
+  const Key* end = range_starts_ + range_count_;
+  const Key* it = std::upper_bound(range_starts_, end, key);
+  if (it == range_starts_) {
+    return kProxy;
+  }
+  uint8_t action = range_actions_[it - range_starts_ - 1];
+  return action == kNone ? kProxy : static_cast<Action>(action);
+}
+
+namespace {
+std::mutex& GlobalMutex() {
+  static auto* mutex = new std::mutex;
+  return *mutex;
+}
+
+std::shared_ptr<const RouteRules>& GlobalRules() {
+  static auto* rules = new std::shared_ptr<const RouteRules>();
+  return *rules;
+}
+}  // namespace
+
+// static
+std::shared_ptr<const RouteRules> RouteRules::Global() {
+  std::lock_guard<std::mutex> lock(GlobalMutex());
+  return GlobalRules();
+}
+
+// static
+bool RouteRules::LoadGlobal(const std::string& path, std::string* err) {
+  std::shared_ptr<RouteRules> rules;
+  if (!path.empty()) {
+    rules = std::make_shared<RouteRules>();
+    if (!rules->Load(path, err)) {
+      return false;
+    }
+    LOG(INFO) << "route: loaded " << rules->domain_count() << " domains and " << rules->range_count()
+              << " address ranges from " << path;
+  }
+  std::lock_guard<std::mutex> lock(GlobalMutex());
+  GlobalRules() = std::move(rules);
+  return true;
+}
+
+bool RouteRules::Attach(const uint8_t* data, size_t size, std::string* err) {
+  static_assert(sizeof(Key) == 2 * sizeof(uint64_t), "unexpected padding in route rules key");
+  static_assert(sizeof(Node) == 3 * sizeof(uint32_t), "unexpected padding in route rules node");
+  static_assert(sizeof(Edge) == 3 * sizeof(uint32_t), "unexpected padding in route rules edge");
+  data_ = nullptr;
+  size_ = 0;
+  range_count_ = node_count_ = edge_count_ = labels_size_ = domain_count_ = 0;
+
+  Header header;
+  if (size < sizeof(header)) {
+    *err = "truncated rules header";
+    return false;
+  }
+  memcpy(&header, data, sizeof(header));
+  if (memcmp(header.magic, kMagic, sizeof(kMagic)) != 0 || header.byte_order != kByteOrder) {
+    *err = "bad rules header";
+    return false;
+  }
+  if (header.range_count > size / (sizeof(Key) + 1) || header.node_count > size / sizeof(Node) ||
+      header.edge_count > size / sizeof(Edge) || header.labels_size > size || BinarySize(header) != size) {
+    *err = "bad rules size";
+    return false;
+  }
+  const uint8_t* p = data + sizeof(header);
+  auto range_starts = reinterpret_cast<const Key*>(p);
+  p += header.range_count * sizeof(Key);
+  auto nodes = reinterpret_cast<const Node*>(p);
+  p += header.node_count * sizeof(Node);
+  auto edges = reinterpret_cast<const Edge*>(p);
+  p += header.edge_count * sizeof(Edge);
+  auto range_actions = p;
+  p += header.range_count;
+  auto labels = reinterpret_cast<const char*>(p);
+
+  // the lookups trust the tables once validated
+  for (uint32_t i = 0; i < header.node_count; ++i) {
+    const Node& node = nodes[i];
+    if (node.first_edge > header.edge_count || node.edge_count > header.edge_count - node.first_edge ||
+        node.suffix > kReject || node.exact > kReject) {
+      *err = "bad rules node";
+      return false;
+    }
+  }
+  for (uint32_t i = 0; i < header.edge_count; ++i) {
+    const Edge& edge = edges[i];
+    if (edge.child == 0 || edge.child >= header.node_count || edge.label_offset > header.labels_size ||
+        edge.label_size > header.labels_size - edge.label_offset) {
+      *err = "bad rules edge";
+      return false;
+    }
+  }
+  for (uint32_t i = 0; i < header.range_count; ++i) {
+    if (range_actions[i] > kReject || (i && !(range_starts[i - 1] < range_starts[i]))) {
+      *err = "bad rules range";
+      return false;
+    }
+  }
+
+  data_ = data;
+  size_ = size;
+  range_starts_ = range_starts;
+  range_actions_ = range_actions;
+  range_count_ = header.range_count;
+  nodes_ = nodes;
+  node_count_ = header.node_count;
+  edges_ = edges;
+  edge_count_ = header.edge_count;
+  labels_ = labels;
+  labels_size_ = header.labels_size;
+  domain_count_ = header.domain_count;
+  return true;
+}
+
+bool RouteRules::Compile(std::string_view text, std::string* err) {
+  struct TrieNode {
+    std::map<std::string, uint32_t, std::less<>> children;
+    uint8_t suffix = kNone;
+    uint8_t exact = kNone;
+  };
+  struct Prefix {
+    Key lo;
+    Key hi;
+    uint8_t action;
+  };
+  std::vector<TrieNode> trie(1);
+  std::vector<Prefix> prefixes;
+  size_t domain_count = 0;
+
+  int line_number = 0;
+  for (std::string_view line : absl::StrSplit(text, '\n')) {
+    ++line_number;
+    line = line.substr(0, line.find('#'));
+    std::vector<std::string_view> fields = absl::StrSplit(line, absl::ByAnyChar(" \t\r"), absl::SkipEmpty());
+    if (fields.empty()) {
+      continue;
+    }
+    Action action;
+    if (fields.size() != 2 || !ParseAction(fields[0], &action)) {
+      *err = absl::StrCat("line ", line_number, ": bad rule: ", absl::StripAsciiWhitespace(line));
+      return false;
+    }
+    std::string_view pattern = fields[1];
+
+    // address prefix
+    std::string_view address_part = pattern.substr(0, pattern.find('/'));
+    asio::error_code ec;
+    auto address = asio::ip::make_address(std::string(address_part), ec);
+    if (!ec) {
+      int max_length = address.is_v4() ? 32 : 128;
+      int length = max_length;
+      if (address_part.size() != pattern.size() &&
+          (!absl::SimpleAtoi(pattern.substr(address_part.size() + 1), &length) || length < 0 ||
+           length > max_length)) {
+        *err = absl::StrCat("line ", line_number, ": bad prefix length: ", pattern);
+        return false;
+      }
+      Key key;
+      AddressToKey(address, &key.hi, &key.lo);
+      if (address.is_v4()) {
+        length += 96;
+      }
+      uint64_t mask_hi = length >= 64 ? ~0ull : (length == 0 ? 0 : ~0ull << (64 - length));
+      uint64_t mask_lo = length <= 64 ? 0 : (length == 128 ? ~0ull : ~0ull << (128 - length));
+      Key lo{key.hi & mask_hi, key.lo & mask_lo};
+      Key hi{lo.hi | ~mask_hi, lo.lo | ~mask_lo};
+      prefixes.push_back({lo, hi, action});
+      continue;
+    }
+
+    // domain
+    bool exact = false;
+    if (absl::ConsumePrefix(&pattern, "full:")) {
+      exact = true;
+    } else {
+      absl::ConsumePrefix(&pattern, "domain:");
+    }
+    if (!pattern.empty() && pattern.back() == '.') {
+      pattern.remove_suffix(1);
+    }
+    std::vector<std::string_view> labels = absl::StrSplit(pattern, '.');
+    if (pattern.empty() || pattern.size() > 255 ||
+        std::any_of(labels.begin(), labels.end(), [](std::string_view label) { return label.empty(); })) {
+      *err = absl::StrCat("line ", line_number, ": bad domain: ", fields[1]);
+      return false;
+    }
+    uint32_t node = 0;
+    for (auto it = labels.rbegin(); it != labels.rend(); ++it) {
+      std::string label = absl::AsciiStrToLower(*it);
+      auto child = trie[node].children.find(label);
+      if (child != trie[node].children.end()) {
+        node = child->second;
+        continue;
+      }
+      uint32_t next = trie.size();
+      trie[node].children.emplace(std::move(label), next);
+      trie.emplace_back();
+      node = next;
+    }
+    uint8_t& slot = exact ? trie[node].exact : trie[node].suffix;
+    if (slot == kNone) {
+      ++domain_count;
+      // the first one of the duplicated rules wins
+      slot = action;
+    }
+  }
+
+  // flatten the address prefixes into disjoint ranges, the longest prefix
+  // covering an address decides its action
+  std::stable_sort(prefixes.begin(), prefixes.end(), [](const Prefix& a, const Prefix& b) {
+    if (a.lo != b.lo) {
+      return a.lo < b.lo;
+    }
+    // the wider one contains the narrower one
+    return b.hi < a.hi;
+  });
+  std::vector<std::pair<Key, uint8_t>> points;
+  auto mark = [&points](const Key& start, uint8_t action) {
+    if (!points.empty() && points.back().first == start) {
+      points.back().second = action;
+    } else {
+      points.emplace_back(start, action);
+    }
+  };
+  std::vector<const Prefix*> stack;
+  auto pop = [&]() {
+    const Prefix* top = stack.back();
+    stack.pop_back();
+    if (top->hi.hi != ~0ull || top->hi.lo != ~0ull) {
+      Key next{top->hi.lo == ~0ull ? top->hi.hi + 1 : top->hi.hi, top->hi.lo + 1};
+      mark(next, stack.empty() ? uint8_t{kNone} : stack.back()->action);
+    }
+  };
+  for (size_t i = 0; i < prefixes.size(); ++i) {
+    const Prefix& prefix = prefixes[i];
+    if (i && prefix.lo == prefixes[i - 1].lo && prefix.hi == prefixes[i - 1].hi) {
+      continue;
+    }
+    while (!stack.empty() && stack.back()->hi < prefix.lo) {
+      pop();
+    }
+    mark(prefix.lo, prefix.action);
+    stack.push_back(&prefix);
+  }
+  while (!stack.empty()) {
+    pop();
+  }
+  std::vector<std::pair<Key, uint8_t>> ranges;
+  for (const auto& point : points) {
+    uint8_t last = ranges.empty() ? uint8_t{kNone} : ranges.back().second;
+    if (point.second != last) {
+      ranges.push_back(point);
+    }
+  }
+
+  // lay out the tables, the nodes keep their indexes and the edges of a node
+  // are sorted by label
+  std::vector<Node> nodes;
+  std::vector<Edge> edges;
+  std::string labels;
+  nodes.reserve(trie.size());
+  for (const TrieNode& trie_node : trie) {
+    Node node{};
+    node.first_edge = edges.size();
+    node.edge_count = trie_node.children.size();
+    node.suffix = trie_node.suffix;
+    node.exact = trie_node.exact;
+    nodes.push_back(node);
+    for (const auto& [label, child] : trie_node.children) {
+      edges.push_back({static_cast<uint32_t>(labels.size()), static_cast<uint32_t>(label.size()), child});
+      labels += label;
+    }
+  }
+  // no domains at all
+  if (trie.size() == 1) {
+    nodes.clear();
+  }
+
+  Header header{};
+  memcpy(header.magic, kMagic, sizeof(kMagic));
+  header.byte_order = kByteOrder;
+  header.range_count = ranges.size();
+  header.node_count = nodes.size();
+  header.edge_count = edges.size();
+  header.labels_size = labels.size();
+  header.domain_count = domain_count;
+
+  size_t size = static_cast<size_t>(BinarySize(header));
+  mapped_file_.reset();
+  storage_.assign((size + sizeof(uint64_t) - 1) / sizeof(uint64_t), 0);
+  uint8_t* p = reinterpret_cast<uint8_t*>(storage_.data());
+  memcpy(p, &header, sizeof(header));
+  p += sizeof(header);
+  for (const auto& range : ranges) {
+    memcpy(p, &range.first, sizeof(Key));
+    p += sizeof(Key);
+  }
+  p = std::copy(reinterpret_cast<const uint8_t*>(nodes.data()),
+                reinterpret_cast<const uint8_t*>(nodes.data() + nodes.size()), p);
+  p = std::copy(reinterpret_cast<const uint8_t*>(edges.data()),
+                reinterpret_cast<const uint8_t*>(edges.data() + edges.size()), p);
+  for (const auto& range : ranges) {
+    *p++ = range.second;
+  }
+  std::copy(labels.begin(), labels.end(), p);
+
+  return Attach(reinterpret_cast<const uint8_t*>(storage_.data()), size, err);
+}
+
+const RouteRules::Edge* RouteRules::FindEdge(const Node& node, std::string_view label) const {
+  const Edge* first = edges_ + node.first_edge;
+  size_t count = node.edge_count;
+  // binary search of the sorted labels
+  while (count) {
+    size_t half = count / 2;
+    const Edge* middle = first + half;
+    int result = CompareLabel(std::string_view(labels_ + middle->label_offset, middle->label_size), label);
+    if (result == 0) {
+      return middle;
+    }
+    if (result < 0) {
+      first = middle + 1;
+      count -= half + 1;
+    } else {
+      count = half;
+    }
+  }
+  return nullptr;
+}
+
+}  // namespace net
@@ -0,0 +1,126 @@
+// SPDX-License-Identifier: GPL-2.0
+/* Copyright (c) 2024 Chilledheart  */
+
+#ifndef H_NET_ROUTE_RULES
+#define H_NET_ROUTE_RULES
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "net/asio.hpp"
+
+namespace gurl_base {
+class MemoryMappedFile;
+}  // namespace gurl_base
+
+namespace net {
+
+/// The rules routing the requests of the local clients by their targets.
+///
+/// The rules file has one rule per line, `<action> <pattern>`, and `#` starts
+/// a comment. The action is one of `proxy`, `direct` and `reject`, and the
+/// pattern is one of
+///   - `example.com` or `domain:example.com`, the domain and its subdomains
+///   - `full:example.com`, the domain only
+///   - `10.0.0.0/8`, `fd00::/8` or `192.168.1.1`, the addresses in the range
+///
+/// The most specific rule wins: the longest domain suffix (the exact domain
+/// before the suffix of the same domain), or the longest address prefix, and
+/// the first one of the duplicated rules. The targets matching no rule are
+/// proxied.
+///
+/// The rules are compiled into flat tables, a trie of the domain labels in
+/// reversed order and the address ranges sorted for binary search, so the
+/// lookups never allocate. The tables are also the binary form of the rules
+/// file (see Serialize), which is mapped into memory as is instead of being
+/// parsed.
+class RouteRules {
+ public:
+  enum Action : uint8_t {
+    kNone = 0,
+    kProxy,
+    kDirect,
+    kReject,
+  };
+
+  static const char* ActionName(Action action);
+
+  RouteRules();
+  ~RouteRules();
+
+  RouteRules(const RouteRules&) = delete;
+  RouteRules& operator=(const RouteRules&) = delete;
+
+  /// compile the rules
+  ///
+  /// \param data the rules in either text or binary form
+  /// \param err the error of the first bad rule
+  /// \return whether all the rules are compiled
+  bool Parse(std::string_view data, std::string* err);
+
+  /// load the rules file, the binary form is mapped into memory
+  ///
+  /// \param path the path to the rules file
+  /// \param err the error if failed
+  /// \return whether all the rules are loaded
+  bool Load(const std::string& path, std::string* err);
+
+  /// the compiled rules in binary form
+  std::string Serialize() const;
+
+  /// the action for the domain, kProxy if no rule matches
+  Action Match(std::string_view domain) const;
+
+  /// the action for the address, kProxy if no rule matches
+  Action Match(const asio::ip::address& address) const;
+
+  /// the number of domains in the rules
+  size_t domain_count() const { return domain_count_; }
+
+  /// the number of the disjoint address ranges the prefixes are compiled into
+  size_t range_count() const { return range_count_; }
+
+  /// the rules consulted by the new connections, null if none
+  static std::shared_ptr<const RouteRules> Global();
+
+  /// replace the global rules by the rules file
+  ///
+  /// \param path the path to the rules file, the global rules are cleared if empty
+  /// \param err the error if failed, the global rules are kept then
+  /// \return whether the rules file is loaded
+  static bool LoadGlobal(const std::string& path, std::string* err);
+
+ private:
+  struct Key;
+  struct Node;
+  struct Edge;
+
+  bool Attach(const uint8_t* data, size_t size, std::string* err);
+  bool Compile(std::string_view text, std::string* err);
+  const Edge* FindEdge(const Node& node, std::string_view label) const;
+
+  /// the binary form, mapped from the rules file or compiled into storage_
+  std::unique_ptr<gurl_base::MemoryMappedFile> mapped_file_;
+  std::vector<uint64_t> storage_;
+  const uint8_t* data_ = nullptr;
+  size_t size_ = 0;
+
+  const Key* range_starts_ = nullptr;
+  const uint8_t* range_actions_ = nullptr;
+  size_t range_count_ = 0;
+  const Node* nodes_ = nullptr;
+  size_t node_count_ = 0;
+  const Edge* edges_ = nullptr;
+  size_t edge_count_ = 0;
+  const char* labels_ = nullptr;
+  size_t labels_size_ = 0;
+  size_t domain_count_ = 0;
+};
+
+}  // namespace net
+
+#endif  // H_NET_ROUTE_RULES
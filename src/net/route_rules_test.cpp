@@ -0,0 +1,125 @@
+// SPDX-License-Identifier: GPL-2.0
+/* Copyright (c) 2024 Chilledheart  */
+
+#include <gtest/gtest-message.h>
+#include <gtest/gtest.h>
+
+#include <cstring>
+
+#include "net/route_rules.hpp"
+
+using namespace net;
+
+namespace {
+asio::ip::address Address(const char* address) {
+  return asio::ip::make_address(address);
+}
+}  // namespace
+
+TEST(RouteRulesTest, Domain) {
+  RouteRules rules;
+  std::string err;
+  ASSERT_TRUE(rules.Parse(R"(# comment
+direct cn
+proxy  google.cn   # more specific
+reject domain:ads.example.com
+direct full:example.com
+reject example.com
+direct cn
+)",
+                          &err))
+      << err;
+  EXPECT_EQ(5u, rules.domain_count());
+
+  EXPECT_EQ(RouteRules::kDirect, rules.Match("cn"));
+  EXPECT_EQ(RouteRules::kDirect, rules.Match("www.baidu.cn"));
+  EXPECT_EQ(RouteRules::kProxy, rules.Match("www.google.cn"));
+  EXPECT_EQ(RouteRules::kProxy, rules.Match("google.cn"));
+  // lookups are case insensitive and the trailing dot is ignored
+  EXPECT_EQ(RouteRules::kProxy, rules.Match("WWW.Google.CN."));
+  EXPECT_EQ(RouteRules::kDirect, rules.Match("notgoogle.cn"));
+
+  // the exact domain before the suffix
+  EXPECT_EQ(RouteRules::kDirect, rules.Match("example.com"));
+  EXPECT_EQ(RouteRules::kReject, rules.Match("www.example.com"));
+  EXPECT_EQ(RouteRules::kReject, rules.Match("x.ads.example.com"));
+
+  // no rule
+  EXPECT_EQ(RouteRules::kProxy, rules.Match("com"));
+  EXPECT_EQ(RouteRules::kProxy, rules.Match("example.org"));
+  EXPECT_EQ(RouteRules::kProxy, rules.Match(""));
+  EXPECT_EQ(RouteRules::kProxy, rules.Match("cn.example.org"));
+}
+
+TEST(RouteRulesTest, Address) {
+  RouteRules rules;
+  std::string err;
+  ASSERT_TRUE(rules.Parse(R"(
+direct 10.0.0.0/8
+proxy  10.1.0.0/16
+reject 10.1.2.3
+direct 10.255.255.255/32
+direct 192.168.1.1/16
+direct fd00::/8
+reject fd00:1::/32
+reject 0.0.0.0/0
+reject 10.0.0.0/8
+)",
+                          &err))
+      << err;
+
+  EXPECT_EQ(RouteRules::kDirect, rules.Match(Address("10.0.0.1")));
+  EXPECT_EQ(RouteRules::kProxy, rules.Match(Address("10.1.0.1")));
+  EXPECT_EQ(RouteRules::kReject, rules.Match(Address("10.1.2.3")));
+  EXPECT_EQ(RouteRules::kProxy, rules.Match(Address("10.1.2.4")));
+  EXPECT_EQ(RouteRules::kDirect, rules.Match(Address("10.2.0.0")));
+  EXPECT_EQ(RouteRules::kDirect, rules.Match(Address("10.255.255.255")));
+  // the host bits are ignored
+  EXPECT_EQ(RouteRules::kDirect, rules.Match(Address("192.168.200.1")));
+  // the catch-all ipv4 rule
+  EXPECT_EQ(RouteRules::kReject, rules.Match(Address("11.0.0.0")));
+  EXPECT_EQ(RouteRules::kReject, rules.Match(Address("255.255.255.255")));
+  EXPECT_EQ(RouteRules::kReject, rules.Match(Address("::ffff:8.8.8.8")));
+
+  EXPECT_EQ(RouteRules::kDirect, rules.Match(Address("fd12::1")));
+  EXPECT_EQ(RouteRules::kReject, rules.Match(Address("fd00:1:ffff::1")));
+  EXPECT_EQ(RouteRules::kProxy, rules.Match(Address("2001:db8::1")));
+  EXPECT_EQ(RouteRules::kProxy, rules.Match(Address("::1")));
+}
+
+TEST(RouteRulesTest, Serialize) {
+  RouteRules rules;
+  std::string err;
+  ASSERT_TRUE(rules.Parse("direct example.com\nreject 127.0.0.0/8\n", &err)) << err;
+  std::string binary = rules.Serialize();
+
+  RouteRules loaded;
+  ASSERT_TRUE(loaded.Parse(binary, &err)) << err;
+  EXPECT_EQ(binary, loaded.Serialize());
+  EXPECT_EQ(1u, loaded.domain_count());
+  EXPECT_EQ(RouteRules::kDirect, loaded.Match("a.example.com"));
+  EXPECT_EQ(RouteRules::kReject, loaded.Match(Address("127.0.0.1")));
+  EXPECT_EQ(RouteRules::kProxy, loaded.Match(Address("128.0.0.1")));
+
+  // truncated
+  EXPECT_FALSE(loaded.Parse(binary.substr(0, binary.size() - 1), &err));
+
+  // counts that would wrap the size on 32-bit targets
+  std::string crafted = binary;
+  uint32_t range_count = (uint32_t{1} << 32) / 17 + 1;
+  memcpy(&crafted[12], &range_count, sizeof(range_count));
+  EXPECT_FALSE(loaded.Parse(crafted, &err));
+  EXPECT_EQ("bad rules size", err);
+}
+
+TEST(RouteRulesTest, Invalid) {
+  RouteRules rules;
+  std::string err;
+  EXPECT_FALSE(rules.Parse("bypass example.com\n", &err));
+  EXPECT_EQ("line 1: bad rule: bypass example.com", err);
+  EXPECT_FALSE(rules.Parse("\ndirect example.com extra\n", &err));
+  EXPECT_FALSE(rules.Parse("direct 10.0.0.0/33\n", &err));
+  EXPECT_EQ("line 1: bad prefix length: 10.0.0.0/33", err);
+  EXPECT_FALSE(rules.Parse("direct a..example.com\n", &err));
+  EXPECT_TRUE(rules.Parse("", &err));
+}
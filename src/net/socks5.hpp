@@ -194,7 +194,7 @@ class reply {
   enum status_type {
     request_granted = 0x00,
     request_failed = 0x01,
-    request_failed_no_identd = 0x02,
+    request_failed_not_allowed = 0x02,
     request_failed_network_unreachable = 0x03,
     request_failed_host_unreachable = 0x04,
     request_failed_conn_refused = 0x05,
@@ -5,6 +5,7 @@
 
 #include "config/config_tls.hpp"
 #include "net/openssl_util.hpp"
+#include "net/stats.hpp"
 #include "third_party/boringssl/src/include/openssl/err.h"
 
 #define GotoState(s) next_handshake_state_ = s
@@ -331,6 +332,11 @@ int SSLServerSocket::DoHandshake(int* openssl_result) {
     }
 #endif
 
+    process_stats().Add(Stats::kTlsHandshakes);
+    if (SSL_session_reused(ssl_.get())) {
+      process_stats().Add(Stats::kTlsResumptions);
+    }
+
     completed_handshake_ = true;
   } else {
     int ssl_error = SSL_get_error(ssl_.get(), rv);
@@ -5,6 +5,7 @@
 
 #include <absl/container/flat_hash_map.h>
 #include "config/config_tls.hpp"
+#include "net/stats.hpp"
 
 using namespace std::string_view_literals;
 
@@ -103,6 +104,8 @@ SSLSocket::SSLSocket(int ssl_socket_data_index,
 
   mode.ConfigureFlag(SSL_MODE_RELEASE_BUFFERS, true);
   mode.ConfigureFlag(SSL_MODE_CBC_RECORD_SPLITTING, true);
+  // the frames queued behind a blocked write might be coalesced into it
+  mode.ConfigureFlag(SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER, true);
 
   mode.ConfigureFlag(SSL_MODE_ENABLE_FALSE_START, true);
 
@@ -585,6 +588,10 @@ int SSLSocket::DoHandshakeComplete(int result) {
     }
   }
   (void)details;
+  process_stats().Add(Stats::kTlsHandshakes);
+  if (SSL_session_reused(ssl_.get())) {
+    process_stats().Add(Stats::kTlsResumptions);
+  }
 
   // Measure TLS connections that implement the renegotiation_info extension.
   // Note this records true for TLS 1.3. By removing renegotiation altogether,
@@ -72,7 +72,8 @@ class ssl_stream : public stream {
       return;
     }
     scoped_refptr<stream> self(this);
-    ssl_socket_->Connect([this, channel, self](int rv) {
+    uint64_t handshake_start_time = GetMonotonicTime();
+    ssl_socket_->Connect([this, channel, self, handshake_start_time](int rv) {
       if (closed_) {
         DCHECK(!user_connect_callback_);
         return;
@@ -83,6 +84,7 @@ class ssl_stream : public stream {
         on_async_connected(channel, ec);
         return;
       }
+      tls_handshake_latency_ = GetMonotonicTime() - handshake_start_time;
 
       auto alpn = ssl_socket_->negotiated_protocol();
       VLOG(2) << "Alpn selected (client): " << NextProtoToString(alpn);
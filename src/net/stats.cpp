@@ -0,0 +1,409 @@
+// SPDX-License-Identifier: GPL-2.0
+/* Copyright (c) 2024 Chilledheart  */
+
+#include "net/stats.hpp"
+
+#include <algorithm>
+#include <bit>
+
+#include <absl/strings/str_cat.h>
+
+#include "core/logging.hpp"
+
+namespace net {
+
+namespace {
+
+/// the upper limit of Stats instances per process
+constexpr int kMaxStatsInstances = 8;
+
+std::atomic<int> g_stats_instances;
+
+}  // namespace
+
+/// per-thread cache of shards, one slot per Stats instance
+struct StatsThreadCache {
+  ~StatsThreadCache() {
+    for (int i = 0; i < kMaxStatsInstances; ++i) {
+      if (owners[i]) {
+        owners[i]->ReleaseShard(shards[i]);
+      }
+    }
+  }
+
+  Stats::Shard* shards[kMaxStatsInstances] = {};
+  Stats* owners[kMaxStatsInstances] = {};
+};
+
+static thread_local StatsThreadCache tls_stats_cache;
+
+// static
+int Stats::BucketIndex(uint64_t value) {
+  if (value < kSubBucketCount) {
+    return static_cast<int>(value);
+  }
+  int msb = std::bit_width(value) - 1;
+  if (msb >= kMaxValueBits) {
+    return kBucketCount - 1;
+  }
+  int sub = static_cast<int>(value >> (msb - kSubBucketBits)) & (kSubBucketCount - 1);
+  return (msb - kSubBucketBits + 1) * kSubBucketCount + sub;
+}
+
+// static
+uint64_t Stats::BucketLowerBound(int index) {
+  if (index < kSubBucketCount) {
+    return index;
+  }
+  int msb = index / kSubBucketCount + kSubBucketBits - 1;
+  uint64_t sub = index % kSubBucketCount;
+  return (kSubBucketCount + sub) << (msb - kSubBucketBits);
+}
+
+// static
+uint64_t Stats::BucketUpperBound(int index) {
+  if (index < kSubBucketCount) {
+    return index;
+  }
+  int msb = index / kSubBucketCount + kSubBucketBits - 1;
+  return BucketLowerBound(index) + (uint64_t{1} << (msb - kSubBucketBits)) - 1;
+}
+
+uint64_t Stats::HistogramSnapshot::ValueAtPercentile(double percentile) const {
+  if (count_ == 0) {
+    return 0;
+  }
+  percentile = std::clamp(percentile, 0.0, 100.0);
+  uint64_t target = static_cast<uint64_t>(percentile / 100.0 * count_ + 0.5);
+  target = std::clamp<uint64_t>(target, 1, count_);
+  uint64_t seen = 0;
+  for (int i = 0; i < kBucketCount; ++i) {
+    seen += buckets_[i];
+    if (seen >= target) {
+      return std::min(BucketUpperBound(i), max_);
+    }
+  }
+  return max_;
+}
+
+Stats::Stats(std::string_view name) : name_(name), index_(g_stats_instances++) {
+  CHECK_LT(index_, kMaxStatsInstances) << "too many stats instances";
+}
+
+void Stats::Record(Histogram histogram, uint64_t value_us) {
+  HistogramShard& h = LocalShard()->histograms[histogram];
+  std::atomic<uint64_t>& bucket = h.buckets[BucketIndex(value_us)];
+  bucket.store(bucket.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+  h.sum.store(h.sum.load(std::memory_order_relaxed) + value_us, std::memory_order_relaxed);
+  if (value_us > h.max.load(std::memory_order_relaxed)) {
+    h.max.store(value_us, std::memory_order_relaxed);
+  }
+  // publish the count last so readers rarely see a count ahead of buckets
+  h.count.store(h.count.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+uint64_t Stats::Get(Counter counter) const {
+  uint64_t value = 0;
+  absl::MutexLock lk(&mutex_);
+  for (const auto& shard : shards_) {
+    value += shard->counters[counter].load(std::memory_order_relaxed);
+  }
+  return value;
+}
+
+int64_t Stats::Get(Gauge gauge) const {
+  int64_t value = 0;
+  absl::MutexLock lk(&mutex_);
+  for (const auto& shard : shards_) {
+    value += shard->gauges[gauge].load(std::memory_order_relaxed);
+  }
+  return value;
+}
+
+uint64_t Stats::Get(Peak peak) const {
+  uint64_t value = 0;
+  absl::MutexLock lk(&mutex_);
+  for (const auto& shard : shards_) {
+    value = std::max(value, shard->peaks[peak].load(std::memory_order_relaxed));
+  }
+  return value;
+}
+
+Stats::Snapshot Stats::GetSnapshot() const {
+  Snapshot snapshot;
+  absl::MutexLock lk(&mutex_);
+  for (const auto& shard : shards_) {
+    for (int i = 0; i < kCounterMax; ++i) {
+      snapshot.counters[i] += shard->counters[i].load(std::memory_order_relaxed);
+    }
+    for (int i = 0; i < kGaugeMax; ++i) {
+      snapshot.gauges[i] += shard->gauges[i].load(std::memory_order_relaxed);
+    }
+    for (int i = 0; i < kPeakMax; ++i) {
+      snapshot.peaks[i] = std::max(snapshot.peaks[i], shard->peaks[i].load(std::memory_order_relaxed));
+    }
+    for (int i = 0; i < kHistogramMax; ++i) {
+      const HistogramShard& h = shard->histograms[i];
+      HistogramSnapshot& s = snapshot.histograms[i];
+      s.count_ += h.count.load(std::memory_order_acquire);
+      s.sum_ += h.sum.load(std::memory_order_relaxed);
+      s.max_ = std::max(s.max_, h.max.load(std::memory_order_relaxed));
+      for (int j = 0; j < kBucketCount; ++j) {
+        s.buckets_[j] += h.buckets[j].load(std::memory_order_relaxed);
+      }
+    }
+  }
+  return snapshot;
+}
+
+// static
+const char* Stats::CounterName(Counter counter) {
+  switch (counter) {
+    case kRxBytes:
+      return "rx_bytes";
+    case kTxBytes:
+      return "tx_bytes";
+    case kRxTimes:
+      return "rx_times";
+    case kTxTimes:
+      return "tx_times";
+    case kRxYields:
+      return "rx_yields";
+    case kTxYields:
+      return "tx_yields";
+    case kConnectionsOpened:
+      return "connections_opened";
+    case kConnectionsClosed:
+      return "connections_closed";
+    case kConnectErrors:
+      return "connect_errors";
+    case kTlsHandshakes:
+      return "tls_handshakes";
+    case kTlsResumptions:
+      return "tls_resumptions";
+    case kDnsLookups:
+      return "dns_lookups";
+    case kDnsCacheHits:
+      return "dns_cache_hits";
+    case kRateLimitStalls:
+      return "rate_limit_stalls";
+    case kIdleTimeouts:
+      return "idle_timeouts";
+    case kIdleTrims:
+      return "idle_trims";
+    case kIdleTrimmedBytes:
+      return "idle_trimmed_bytes";
+    case kIOBufAllocations:
+      return "iobuf_allocations";
+    case kConfigReloads:
+      return "config_reloads";
+    case kUdpAssociations:
+      return "udp_associations";
+    case kUdpDatagramsSent:
+      return "udp_datagrams_sent";
+    case kUdpDatagramsReceived:
+      return "udp_datagrams_received";
+    case kUdpDatagramsDropped:
+      return "udp_datagrams_dropped";
+    case kH2WindowGrowths:
+      return "h2_window_growths";
+    case kH2CoalescedFrames:
+      return "h2_coalesced_frames";
+    case kReadPauses:
+      return "read_pauses";
+    case kRouteDirect:
+      return "route_direct";
+    case kRouteRejected:
+      return "route_rejected";
+    case kUpstreamFailovers:
+      return "upstream_failovers";
+    case kHttpReroutes:
+      return "http_reroutes";
+    default:
+      return "unknown";
+  }
+}
+
+// static
+const char* Stats::GaugeName(Gauge gauge) {
+  switch (gauge) {
+    case kConnectionsInHandshake:
+      return "handshake";
+    case kConnectionsInStream:
+      return "stream";
+    case kConnectionsInError:
+      return "error";
+    case kIOBufCount:
+      return "iobuf_count";
+    case kIOBufBytes:
+      return "iobuf_bytes";
+    case kH2BufferedBytes:
+      return "h2_buffered_bytes";
+    case kUpstreamQueuedBytes:
+      return "upstream_queued_bytes";
+    case kDownstreamQueuedBytes:
+      return "downstream_queued_bytes";
+    default:
+      return "unknown";
+  }
+}
+
+// static
+const char* Stats::PeakName(Peak peak) {
+  switch (peak) {
+    case kUpstreamQueuedBytesMax:
+      return "upstream_queued_bytes_max";
+    case kDownstreamQueuedBytesMax:
+      return "downstream_queued_bytes_max";
+    default:
+      return "unknown";
+  }
+}
+
+// static
+const char* Stats::HistogramName(Histogram histogram) {
+  switch (histogram) {
+    case kDnsLatency:
+      return "dns";
+    case kConnectLatency:
+      return "connect";
+    case kTlsHandshakeLatency:
+      return "tls_handshake";
+    case kHandshakeLatency:
+      return "handshake";
+    case kTtfbLatency:
+      return "ttfb";
+    case kConfigReloadLatency:
+      return "config_reload";
+    case kH2RttLatency:
+      return "h2_rtt";
+    default:
+      return "unknown";
+  }
+}
+
+// static
+Stats::Shard* Stats::LocalShardFast(int index) {
+  return tls_stats_cache.shards[index];
+}
+
+Stats::Shard* Stats::AcquireShard() {
+  Shard* shard = nullptr;
+  {
+    absl::MutexLock lk(&mutex_);
+    // reuse the shard left by an exited thread, the counts it holds are kept
+    for (auto& s : shards_) {
+      if (!s->in_use) {
+        s->in_use = true;
+        shard = s.get();
+        break;
+      }
+    }
+    if (!shard) {
+      shards_.push_back(std::make_unique<Shard>());
+      shard = shards_.back().get();
+    }
+  }
+  tls_stats_cache.shards[index_] = shard;
+  tls_stats_cache.owners[index_] = this;
+  return shard;
+}
+
+void Stats::ReleaseShard(Shard* shard) {
+  absl::MutexLock lk(&mutex_);
+  shard->in_use = false;
+}
+
+Stats& process_stats() {
+  static Stats* stats = new Stats("process");
+  return *stats;
+}
+
+void AppendPrometheusText(std::string* out,
+                          const std::vector<std::pair<std::string, Stats::Snapshot>>& snapshots) {
+  for (int i = 0; i < Stats::kCounterMax; ++i) {
+    auto counter = static_cast<Stats::Counter>(i);
+    absl::StrAppend(out, "# TYPE yass_", Stats::CounterName(counter), "_total counter\n");
+    for (const auto& [kind, snapshot] : snapshots) {
+      absl::StrAppend(out, "yass_", Stats::CounterName(counter), "_total{kind=\"", kind, "\"} ", snapshot[counter],
+                      "\n");
+    }
+  }
+
+  absl::StrAppend(out, "# TYPE yass_connections gauge\n");
+  for (const auto& [kind, snapshot] : snapshots) {
+    for (auto gauge : {Stats::kConnectionsInHandshake, Stats::kConnectionsInStream, Stats::kConnectionsInError}) {
+      absl::StrAppend(out, "yass_connections{kind=\"", kind, "\",state=\"", Stats::GaugeName(gauge), "\"} ",
+                      snapshot[gauge], "\n");
+    }
+  }
+  for (auto gauge : {Stats::kIOBufCount, Stats::kIOBufBytes, Stats::kH2BufferedBytes, Stats::kUpstreamQueuedBytes,
+                     Stats::kDownstreamQueuedBytes}) {
+    absl::StrAppend(out, "# TYPE yass_", Stats::GaugeName(gauge), " gauge\n");
+    for (const auto& [kind, snapshot] : snapshots) {
+      absl::StrAppend(out, "yass_", Stats::GaugeName(gauge), "{kind=\"", kind, "\"} ", snapshot[gauge], "\n");
+    }
+  }
+  for (int i = 0; i < Stats::kPeakMax; ++i) {
+    auto peak = static_cast<Stats::Peak>(i);
+    absl::StrAppend(out, "# TYPE yass_", Stats::PeakName(peak), " gauge\n");
+    for (const auto& [kind, snapshot] : snapshots) {
+      absl::StrAppend(out, "yass_", Stats::PeakName(peak), "{kind=\"", kind, "\"} ", snapshot[peak], "\n");
+    }
+  }
+
+  auto ratio = [](uint64_t part, uint64_t total) -> double { return total ? double(part) / double(total) : 0.0; };
+  absl::StrAppend(out, "# TYPE yass_dns_cache_hit_ratio gauge\n");
+  for (const auto& [kind, snapshot] : snapshots) {
+    uint64_t hits = snapshot[Stats::kDnsCacheHits];
+    absl::StrAppend(out, "yass_dns_cache_hit_ratio{kind=\"", kind, "\"} ",
+                    ratio(hits, hits + snapshot[Stats::kDnsLookups]), "\n");
+  }
+  absl::StrAppend(out, "# TYPE yass_tls_resumption_ratio gauge\n");
+  for (const auto& [kind, snapshot] : snapshots) {
+    absl::StrAppend(out, "yass_tls_resumption_ratio{kind=\"", kind, "\"} ",
+                    ratio(snapshot[Stats::kTlsResumptions], snapshot[Stats::kTlsHandshakes]), "\n");
+  }
+
+  // bucket boundaries are aligned to powers of two, so exporting one bucket per
+  // power of two keeps the exposition small without losing precision at le
+  for (int i = 0; i < Stats::kHistogramMax; ++i) {
+    auto histogram = static_cast<Stats::Histogram>(i);
+    std::string name = absl::StrCat("yass_", Stats::HistogramName(histogram), "_latency_seconds");
+    absl::StrAppend(out, "# TYPE ", name, " histogram\n");
+    for (const auto& [kind, snapshot] : snapshots) {
+      const auto& h = snapshot.histogram(histogram);
+      uint64_t cumulative = 0;
+      int index = 0;
+      for (int bits = Stats::kSubBucketBits; bits <= Stats::kMaxValueBits; ++bits) {
+        uint64_t le = uint64_t{1} << bits;
+        for (; index < Stats::kBucketCount && Stats::BucketUpperBound(index) < le; ++index) {
+          cumulative += h.bucket(index);
+        }
+        absl::StrAppend(out, name, "_bucket{kind=\"", kind, "\",le=\"", double(le) / 1e6, "\"} ", cumulative, "\n");
+      }
+      // use the sum of buckets rather than count() to stay consistent with the
+      // buckets above if the snapshot races with a writer
+      absl::StrAppend(out, name, "_bucket{kind=\"", kind, "\",le=\"+Inf\"} ", cumulative, "\n");
+      absl::StrAppend(out, name, "_sum{kind=\"", kind, "\"} ", double(h.sum()) / 1e6, "\n");
+      absl::StrAppend(out, name, "_count{kind=\"", kind, "\"} ", cumulative, "\n");
+    }
+  }
+}
+
+void PrintStatsHistograms(std::string_view prefix, const Stats::Snapshot& snapshot) {
+  for (int i = 0; i < Stats::kHistogramMax; ++i) {
+    const auto& h = snapshot.histograms[i];
+    if (!h.count()) {
+      continue;
+    }
+    LOG(ERROR) << prefix << ": " << Stats::HistogramName(static_cast<Stats::Histogram>(i)) << " latency:"
+               << " count " << h.count() << " mean " << h.mean() << "us"
+               << " p50 " << h.ValueAtPercentile(50) << "us"
+               << " p90 " << h.ValueAtPercentile(90) << "us"
+               << " p99 " << h.ValueAtPercentile(99) << "us"
+               << " max " << h.max() << "us";
+  }
+}
+
+}  // namespace net
@@ -0,0 +1,299 @@
+// SPDX-License-Identifier: GPL-2.0
+/* Copyright (c) 2024 Chilledheart  */
+
+#ifndef H_NET_STATS
+#define H_NET_STATS
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include <absl/base/optimization.h>
+#include <absl/base/thread_annotations.h>
+#include <absl/synchronization/mutex.h>
+
+namespace net {
+
+/// Traffic counters and latency histograms shared by all connections of a
+/// given kind (cli or server).
+///
+/// Every thread updating a Stats object owns a cache-line aligned shard, so the
+/// data path never contends on a shared cache line nor issues locked
+/// instructions. Readers (GUI status bars, PrintCliStats, admin endpoints) sum
+/// the shards into a Snapshot, which is wait-free for the writers.
+///
+/// Stats instances are never destroyed, see cli::stats() and server::stats().
+class Stats {
+ public:
+  enum Counter {
+    /// total received bytes (non-encoded)
+    kRxBytes,
+    /// total sent bytes (non-encoded)
+    kTxBytes,
+    /// total received times (non-encoded)
+    kRxTimes,
+    /// total sent times (non-encoded)
+    kTxTimes,
+    /// total yield times (rx)
+    kRxYields,
+    /// total yield times (tx)
+    kTxYields,
+    /// total accepted connections
+    kConnectionsOpened,
+    /// total closed connections
+    kConnectionsClosed,
+    /// total failed upstream connects
+    kConnectErrors,
+    /// total completed tls handshakes
+    kTlsHandshakes,
+    /// total completed tls handshakes with session resumed
+    kTlsResumptions,
+    /// total name resolutions issued to the resolver
+    kDnsLookups,
+    /// total name resolutions served by pre-resolved or cached addresses
+    kDnsCacheHits,
+    /// total times a stream is delayed by the rate limiter
+    kRateLimitStalls,
+    /// total connections closed by idle timeout
+    kIdleTimeouts,
+    /// total times idle connections release their buffers
+    kIdleTrims,
+    /// total bytes released by idle connections
+    kIdleTrimmedBytes,
+    /// total buffers allocated (or reallocated) by IOBufs
+    kIOBufAllocations,
+    /// total config reloads applied in place
+    kConfigReloads,
+    /// total udp associations (socks5 udp associate, or udp relays on server)
+    kUdpAssociations,
+    /// total udp datagrams sent
+    kUdpDatagramsSent,
+    /// total udp datagrams received
+    kUdpDatagramsReceived,
+    /// total udp datagrams dropped (malformed, unexpected peers or full buffers)
+    kUdpDatagramsDropped,
+    /// total times a http2 stream window is grown
+    kH2WindowGrowths,
+    /// total http2 frames coalesced into the writes of others
+    kH2CoalescedFrames,
+    /// total times the reading is paused as the other side has too much data queued
+    kReadPauses,
+    /// total requests connected to the target directly by the route rules
+    kRouteDirect,
+    /// total requests rejected by the route rules
+    kRouteRejected,
+    /// total tunnels connected to another upstream server after a failed connect
+    kUpstreamFailovers,
+    /// total tunnels re-established to another origin by keep-alive http requests
+    kHttpReroutes,
+    kCounterMax,
+  };
+
+  enum Gauge {
+    /// connections in handshake state
+    kConnectionsInHandshake,
+    /// connections in stream state
+    kConnectionsInStream,
+    /// connections in error state (not yet closed)
+    kConnectionsInError,
+    /// IOBufs alive
+    kIOBufCount,
+    /// bytes held by alive IOBufs
+    kIOBufBytes,
+    /// bytes received by http2 streams but not yet written to the local socket
+    kH2BufferedBytes,
+    /// bytes queued to upstream by live connections
+    kUpstreamQueuedBytes,
+    /// bytes queued to downstream by live connections
+    kDownstreamQueuedBytes,
+    kGaugeMax,
+  };
+
+  /// the most ever seen, the maximum over the shards rather than the sum
+  enum Peak {
+    /// the most bytes queued to upstream by a connection
+    kUpstreamQueuedBytesMax,
+    /// the most bytes queued to downstream by a connection
+    kDownstreamQueuedBytesMax,
+    kPeakMax,
+  };
+
+  enum Histogram {
+    /// upstream name resolution
+    kDnsLatency,
+    /// upstream tcp connect (per successful endpoint)
+    kConnectLatency,
+    /// upstream tls handshake
+    kTlsHandshakeLatency,
+    /// downstream proxy handshake (from accept to request parsed)
+    kHandshakeLatency,
+    /// time to first byte from upstream (from connect request)
+    kTtfbLatency,
+    /// config reload applied in place (from reload request)
+    kConfigReloadLatency,
+    /// http2 round trip time measured by PING frames
+    kH2RttLatency,
+    kHistogramMax,
+  };
+
+  /// The histogram keeps 16 linear sub-buckets per power of two, which bounds
+  /// the relative error to ~6% like HdrHistogram with 2 significant digits.
+  static constexpr int kSubBucketBits = 4;
+  static constexpr int kSubBucketCount = 1 << kSubBucketBits;
+  /// values are clamped to 2^36 microseconds (~19 hours)
+  static constexpr int kMaxValueBits = 36;
+  static constexpr int kBucketCount = (kMaxValueBits - kSubBucketBits + 1) * kSubBucketCount;
+
+  static int BucketIndex(uint64_t value);
+  static uint64_t BucketLowerBound(int index);
+  static uint64_t BucketUpperBound(int index);
+
+  /// A point-in-time copy of a histogram, values are in microseconds
+  class HistogramSnapshot {
+   public:
+    uint64_t count() const { return count_; }
+    uint64_t sum() const { return sum_; }
+    uint64_t max() const { return max_; }
+    uint64_t mean() const { return count_ ? sum_ / count_ : 0; }
+    /// \param percentile in range of [0, 100]
+    uint64_t ValueAtPercentile(double percentile) const;
+    /// the number of samples in the given bucket
+    uint64_t bucket(int index) const { return buckets_[index]; }
+
+   private:
+    friend class Stats;
+    uint64_t count_ = 0;
+    uint64_t sum_ = 0;
+    uint64_t max_ = 0;
+    std::array<uint64_t, kBucketCount> buckets_{};
+  };
+
+  /// A point-in-time sum of all shards
+  struct Snapshot {
+    std::array<uint64_t, kCounterMax> counters{};
+    std::array<int64_t, kGaugeMax> gauges{};
+    std::array<uint64_t, kPeakMax> peaks{};
+    std::array<HistogramSnapshot, kHistogramMax> histograms;
+
+    uint64_t operator[](Counter counter) const { return counters[counter]; }
+    int64_t operator[](Gauge gauge) const { return gauges[gauge]; }
+    uint64_t operator[](Peak peak) const { return peaks[peak]; }
+    const HistogramSnapshot& histogram(Histogram histogram) const { return histograms[histogram]; }
+  };
+
+  explicit Stats(std::string_view name);
+  Stats(const Stats&) = delete;
+  Stats& operator=(const Stats&) = delete;
+
+  const std::string& name() const { return name_; }
+
+  /// increase the counter by value
+  void Add(Counter counter, uint64_t value = 1) {
+    std::atomic<uint64_t>& v = LocalShard()->counters[counter];
+    v.store(v.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+  }
+
+  /// adjust the gauge by delta, the shard might go negative if it is decreased
+  /// by another thread but the sum is exact
+  void Add(Gauge gauge, int64_t delta) {
+    std::atomic<int64_t>& v = LocalShard()->gauges[gauge];
+    v.store(v.load(std::memory_order_relaxed) + delta, std::memory_order_relaxed);
+  }
+
+  /// raise the peak to value if higher
+  void Update(Peak peak, uint64_t value) {
+    std::atomic<uint64_t>& v = LocalShard()->peaks[peak];
+    if (value > v.load(std::memory_order_relaxed)) {
+      v.store(value, std::memory_order_relaxed);
+    }
+  }
+
+  /// record a latency sample
+  ///
+  /// \param histogram the histogram to record
+  /// \param value_us the sample in microseconds
+  void Record(Histogram histogram, uint64_t value_us);
+
+  /// record a latency sample measured by GetMonotonicTime
+  void RecordNanoseconds(Histogram histogram, uint64_t value_ns) { Record(histogram, value_ns / 1000); }
+
+  /// sum of the given counter over all shards, cheaper than GetSnapshot
+  uint64_t Get(Counter counter) const;
+
+  /// sum of the given gauge over all shards, cheaper than GetSnapshot
+  int64_t Get(Gauge gauge) const;
+
+  /// maximum of the given peak over all shards, cheaper than GetSnapshot
+  uint64_t Get(Peak peak) const;
+
+  /// sum of all counters and histograms over all shards
+  Snapshot GetSnapshot() const;
+
+  static const char* CounterName(Counter counter);
+  static const char* GaugeName(Gauge gauge);
+  static const char* PeakName(Peak peak);
+  static const char* HistogramName(Histogram histogram);
+
+ private:
+  struct HistogramShard {
+    std::atomic<uint64_t> count;
+    std::atomic<uint64_t> sum;
+    std::atomic<uint64_t> max;
+    std::array<std::atomic<uint64_t>, kBucketCount> buckets;
+  };
+
+  // std::atomic is value-initialized since c++20
+  struct alignas(ABSL_CACHELINE_SIZE) Shard {
+    std::array<std::atomic<uint64_t>, kCounterMax> counters;
+    std::array<std::atomic<int64_t>, kGaugeMax> gauges;
+    std::array<std::atomic<uint64_t>, kPeakMax> peaks;
+    std::array<HistogramShard, kHistogramMax> histograms;
+    /// owned by a living thread
+    bool in_use = true;
+  };
+
+  friend struct StatsThreadCache;
+
+  Shard* LocalShard() {
+    Shard* shard = LocalShardFast(index_);
+    if (ABSL_PREDICT_FALSE(shard == nullptr)) {
+      shard = AcquireShard();
+    }
+    return shard;
+  }
+  static Shard* LocalShardFast(int index);
+  Shard* AcquireShard();
+  void ReleaseShard(Shard* shard);
+
+  const std::string name_;
+  const int index_;
+
+  mutable absl::Mutex mutex_;
+  std::vector<std::unique_ptr<Shard>> shards_ ABSL_GUARDED_BY(mutex_);
+};
+
+/// statistics of process-wide resources shared by cli and server, e.g. IOBufs,
+/// tls sessions, name resolutions and the rate limiter
+Stats& process_stats();
+
+/// render snapshots in prometheus text exposition format (version 0.0.4)
+///
+/// \param out the string to append to
+/// \param snapshots the snapshots labeled with kind="<name>"
+void AppendPrometheusText(std::string* out,
+                          const std::vector<std::pair<std::string, Stats::Snapshot>>& snapshots);
+
+/// log the percentiles of all histograms in the snapshot
+///
+/// \param prefix the prefix of each log line
+/// \param snapshot the snapshot to print
+void PrintStatsHistograms(std::string_view prefix, const Stats::Snapshot& snapshot);
+
+}  // namespace net
+
+#endif  // H_NET_STATS
@@ -0,0 +1,81 @@
+// SPDX-License-Identifier: GPL-2.0
+/* Copyright (c) 2024 Chilledheart  */
+
+#include <gtest/gtest-message.h>
+#include <gtest/gtest.h>
+
+#include <thread>
+#include <vector>
+
+#include "net/stats.hpp"
+
+using namespace net;
+
+TEST(StatsTest, BucketBoundaries) {
+  for (int i = 0; i < Stats::kBucketCount; ++i) {
+    EXPECT_EQ(i, Stats::BucketIndex(Stats::BucketLowerBound(i)));
+    EXPECT_EQ(i, Stats::BucketIndex(Stats::BucketUpperBound(i)));
+  }
+  EXPECT_EQ(Stats::kBucketCount - 1, Stats::BucketIndex(UINT64_MAX));
+}
+
+TEST(StatsTest, CountersAcrossThreads) {
+  static Stats* stats = new Stats("test_counters");
+  constexpr int kThreads = 4;
+  constexpr int kIterations = 10000;
+  std::vector<std::thread> threads;
+  for (int i = 0; i < kThreads; ++i) {
+    threads.emplace_back([]() {
+      for (int j = 0; j < kIterations; ++j) {
+        stats->Add(Stats::kRxBytes, 2);
+        stats->Add(Stats::kRxTimes);
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  // shards left by exited threads are reused and keep their counts
+  std::thread([]() { stats->Add(Stats::kTxBytes, 3); }).join();
+  std::thread([]() { stats->Add(Stats::kTxBytes, 5); }).join();
+
+  Stats::Snapshot snapshot = stats->GetSnapshot();
+  EXPECT_EQ(2u * kThreads * kIterations, snapshot[Stats::kRxBytes]);
+  EXPECT_EQ(1u * kThreads * kIterations, snapshot[Stats::kRxTimes]);
+  EXPECT_EQ(8u, snapshot[Stats::kTxBytes]);
+  EXPECT_EQ(8u, stats->Get(Stats::kTxBytes));
+}
+
+TEST(StatsTest, HistogramPercentile) {
+  static Stats* stats = new Stats("test_histogram");
+  for (uint64_t i = 1; i <= 10000; ++i) {
+    stats->Record(Stats::kTtfbLatency, i);
+  }
+  auto snapshot = stats->GetSnapshot();
+  const auto& h = snapshot.histogram(Stats::kTtfbLatency);
+  EXPECT_EQ(10000u, h.count());
+  EXPECT_EQ(10000u, h.max());
+  EXPECT_EQ(5000u, h.mean());
+  // relative error bounded by the sub-bucket resolution
+  EXPECT_NEAR(5000.0, h.ValueAtPercentile(50), 5000.0 / Stats::kSubBucketCount);
+  EXPECT_NEAR(9900.0, h.ValueAtPercentile(99), 9900.0 / Stats::kSubBucketCount);
+  EXPECT_EQ(10000u, h.ValueAtPercentile(100));
+  EXPECT_EQ(0u, snapshot.histogram(Stats::kDnsLatency).count());
+}
+
+TEST(StatsTest, PrometheusText) {
+  static Stats* stats = new Stats("test_prometheus");
+  stats->Add(Stats::kRxBytes, 42);
+  stats->Add(Stats::kConnectionsInStream, 2);
+  stats->Add(Stats::kConnectionsInStream, -1);
+  stats->Record(Stats::kConnectLatency, 100);
+  stats->Record(Stats::kConnectLatency, 3000);
+
+  std::string out;
+  AppendPrometheusText(&out, {{stats->name(), stats->GetSnapshot()}});
+  EXPECT_NE(std::string::npos, out.find("yass_rx_bytes_total{kind=\"test_prometheus\"} 42\n"));
+  EXPECT_NE(std::string::npos, out.find("yass_connections{kind=\"test_prometheus\",state=\"stream\"} 1\n"));
+  EXPECT_NE(std::string::npos,
+            out.find("yass_connect_latency_seconds_bucket{kind=\"test_prometheus\",le=\"+Inf\"} 2\n"));
+  EXPECT_NE(std::string::npos, out.find("yass_connect_latency_seconds_count{kind=\"test_prometheus\"} 2\n"));
+}
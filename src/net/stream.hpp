@@ -13,10 +13,14 @@
 #include "core/logging.hpp"
 #include "core/utils.hpp"
 #include "net/asio.hpp"
+#include "net/fair_scheduler.hpp"
 #include "net/network.hpp"
 #include "net/protocol.hpp"
+#include "net/rate_limiter.hpp"
 #include "net/resolver.hpp"
 #include "net/ssl_socket.hpp"
+#include "net/stats.hpp"
+#include "net/timer_wheel.hpp"
 
 #ifdef __OHOS__
 #include "harmony/yass.hpp"
@@ -25,51 +29,10 @@
 #include <absl/functional/any_invocable.h>
 #include <absl/strings/str_cat.h>
 #include <absl/strings/str_split.h>
-#include <absl/time/time.h>
 #include <base/memory/scoped_refptr.h>
 
 namespace net {
 
-/* check rate limits within this many recent milliseconds, at minimum. */
-#define MIN_RATE_LIMIT_PERIOD 3000
-
-// modified from curl's lib/multi.c
-inline int64_t pgrsLimitWaitTime(int64_t cursize, int64_t startsize, int64_t limit, absl::Time start, absl::Time now) {
-  int64_t size = cursize - startsize;
-  int64_t minimum;
-  int64_t actual;
-
-  if (!limit || !size)
-    return 0;
-
-  /*
-   * 'minimum' is the number of milliseconds 'size' should take to download to
-   * stay below 'limit'.
-   */
-  if (size < INT64_MAX / 1000)
-    minimum = (int64_t)(int64_t(1000) * size / limit);
-  else {
-    minimum = (int64_t)(size / limit);
-    if (minimum < INT64_MAX / 1000)
-      minimum *= 1000;
-    else
-      minimum = INT64_MAX;
-  }
-
-  /*
-   * 'actual' is the time in milliseconds it took to actually download the
-   * last 'size' bytes.
-   */
-  actual = absl::ToInt64Milliseconds(now - start);
-  if (actual < minimum) {
-    /* if it downloaded the data faster than the limit, make it wait the
-       difference */
-    return (minimum - actual);
-  }
-
-  return 0;
-}
-
 /// the class to describe the traffic between given node (endpoint)
 class stream : public gurl_base::RefCountedThreadSafe<stream> {
  public:
@@ -99,14 +62,9 @@ class stream : public gurl_base::RefCountedThreadSafe<stream> {
         host_sni_(host_sni),
         port_(port),
         io_context_(io_context),
+        timer_wheel_(&TimerWheel::Get(io_context)),
         socket_(io_context),
-        connect_timer_(io_context),
-        channel_(channel),
-        read_yield_timer_(io_context),
-        dl_limit_rate_(absl::GetFlag(FLAGS_limit_rate).rate),
-        dl_delay_timer(io_context),
-        ul_limit_rate_(absl::GetFlag(FLAGS_limit_rate).rate),
-        ul_delay_timer(io_context) {
+        channel_(channel) {
     CHECK(channel && "channel must defined to use with stream");
   }
 
@@ -118,7 +76,7 @@ class stream : public gurl_base::RefCountedThreadSafe<stream> {
     }
   }
 
-  void async_connect(handle_t callback) {
+  virtual void async_connect(handle_t callback) {
     Channel* channel = channel_;
     DCHECK_EQ(closed_, false);
     DCHECK(callback);
@@ -147,6 +105,7 @@ class stream : public gurl_base::RefCountedThreadSafe<stream> {
         closed_ = true;
         on_async_connect_callback(asio::error::host_not_found);
       } else {
+        process_stats().Add(Stats::kDnsCacheHits);
         on_try_next_endpoint(channel);
       }
       return;
@@ -157,6 +116,7 @@ class stream : public gurl_base::RefCountedThreadSafe<stream> {
     bool host_is_ip_address = !ec;
     if (host_is_ip_address) {
       VLOG(1) << "resolved ip-like address (post-resolved): " << addr.to_string();
+      process_stats().Add(Stats::kDnsCacheHits);
       endpoints_.emplace_back(addr, port_);
       on_try_next_endpoint(channel);
       return;
@@ -171,6 +131,8 @@ class stream : public gurl_base::RefCountedThreadSafe<stream> {
     }
 
     scoped_refptr<stream> self(this);
+    process_stats().Add(Stats::kDnsLookups);
+    resolve_start_time_ = GetMonotonicTime();
     resolver_.AsyncResolve(
         host_sni_, port_,
         [this, channel, self](const asio::error_code& ec, asio::ip::tcp::resolver::results_type results) {
@@ -186,6 +148,7 @@ class stream : public gurl_base::RefCountedThreadSafe<stream> {
             on_async_connected(channel, ec);
             return;
           }
+          dns_latency_ = GetMonotonicTime() - resolve_start_time_;
           for (auto iter = std::begin(results); iter != std::end(results); ++iter) {
             endpoints_.push_back(*iter);
             VLOG(1) << "found ip address (post-resolved): " << endpoints_.back().address().to_string();
@@ -204,9 +167,34 @@ class stream : public gurl_base::RefCountedThreadSafe<stream> {
 
   bool read_inprogress() const { return read_inprogress_; }
 
+  /// the latency of name resolution (in nanoseconds), 0 if resolved ahead
+  uint64_t dns_latency() const { return dns_latency_; }
+
+  /// report the latency of name resolution, tcp connect and tls handshake
+  ///
+  /// \param stats the statistics to record into
+  void report_stats(Stats* stats) const {
+    if (dns_latency_) {
+      stats->RecordNanoseconds(Stats::kDnsLatency, dns_latency_);
+    }
+    if (connect_latency_) {
+      stats->RecordNanoseconds(Stats::kConnectLatency, connect_latency_);
+    }
+    if (tls_handshake_latency_) {
+      stats->RecordNanoseconds(Stats::kTlsHandshakeLatency, tls_handshake_latency_);
+    }
+  }
+
+  /// set the rate limiter charged by reads (download direction)
+  ///
+  /// \param rate_limiter the rate limiter on the connection level, or nullptr
+  void set_rate_limiter(std::shared_ptr<RateLimiter> rate_limiter) { rate_limiter_ = std::move(rate_limiter); }
+
   /// wait read routine
   ///
-  void wait_read(handle_t callback, bool yield) {
+  /// \param callback the callback invoked when readable
+  /// \param yield_flow the flow yielding its turn to the others first, or nullptr
+  void wait_read(handle_t callback, ScheduledFlow* yield_flow) {
     DCHECK(!read_inprogress_);
     DCHECK(callback);
 
@@ -218,42 +206,21 @@ class stream : public gurl_base::RefCountedThreadSafe<stream> {
     wait_read_callback_ = std::move(callback);
     scoped_refptr<stream> self(this);
 
-    if (dl_limit_rate_) {
-      auto recv_timeout_ms =
-          pgrsLimitWaitTime(rbytes_transferred_, dl_limit_size_, dl_limit_rate_, dl_limit_start_, absl::Now());
-      if (recv_timeout_ms) {
-        if (!ul_limit_state_ && !dl_limit_state_) {
-          // entering ratelimit state
-          ratelimit(absl::Now());
-        }
-        dl_limit_state_ = true;
-        dl_delay_timer.expires_after(std::chrono::milliseconds(recv_timeout_ms));
-        dl_delay_timer.async_wait([this, self](asio::error_code ec) {
-          if (UNLIKELY(ec == asio::error::operation_aborted)) {
-            return;
-          }
+    if (rate_limiter_) {
+      if (uint64_t delay = rate_limiter_->download()->Delay(GetMonotonicTime())) {
+        process_stats().Add(Stats::kRateLimitStalls);
+        timer_wheel_->ScheduleNanoseconds(&read_delay_timer_, delay, [this, self]() {
           auto callback = std::move(wait_read_callback_);
           DCHECK(!wait_read_callback_);
           read_inprogress_ = false;
-          // Cancelled, safe to ignore
-          wait_read(std::move(callback), false);
+          wait_read(std::move(callback), nullptr);
         });
         return;
       }
     }
 
-    if (dl_limit_state_ && !ul_limit_state_) {
-      // leaving ratelimit state
-      ratelimit(absl::Now());
-    }
-    dl_limit_state_ = false;
-
-    if (yield) {
-      read_yield_timer_.expires_after(std::chrono::microseconds(kReadYieldIntervalUs));
-      read_yield_timer_.async_wait([this, self](asio::error_code ec) {
-        if (UNLIKELY(ec == asio::error::operation_aborted)) {
-          return;
-        }
+    if (yield_flow) {
+      FairScheduler::Get(io_context_).Yield(yield_flow, [this, self]() {
         auto callback = std::move(wait_read_callback_);
         DCHECK(!wait_read_callback_);
         read_inprogress_ = false;
@@ -261,8 +228,7 @@ class stream : public gurl_base::RefCountedThreadSafe<stream> {
           DCHECK(!user_connect_callback_);
           return;
         }
-        // Cancelled, safe to ignore
-        wait_read(std::move(callback), false);
+        wait_read(std::move(callback), nullptr);
       });
       return;
     }
@@ -289,6 +255,9 @@ class stream : public gurl_base::RefCountedThreadSafe<stream> {
     DCHECK(!closed_ && "I/O on closed upstream connection");
     size_t read = s_read_some(buf, ec);
     rbytes_transferred_ += read;
+    if (read && rate_limiter_) {
+      rate_limiter_->download()->Consume(read, GetMonotonicTime());
+    }
     if (UNLIKELY(ec && ec != asio::error::try_again && ec != asio::error::would_block)) {
       on_disconnect(channel_, ec);
     }
@@ -307,38 +276,9 @@ class stream : public gurl_base::RefCountedThreadSafe<stream> {
       return;
     }
 
-    if (ul_limit_rate_) {
-      auto send_timeout_ms =
-          pgrsLimitWaitTime(wbytes_transferred_, ul_limit_size_, ul_limit_rate_, ul_limit_start_, absl::Now());
-      if (send_timeout_ms) {
-        if (!ul_limit_state_ && !dl_limit_state_) {
-          // entering ratelimit state
-          ratelimit(absl::Now());
-        }
-        ul_limit_state_ = true;
-        scoped_refptr<stream> self(this);
-        ul_delay_timer.expires_after(std::chrono::milliseconds(send_timeout_ms));
-        wait_write_callback_ = std::move(callback);
-        DCHECK(!wait_write_callback_);
-        ul_delay_timer.async_wait([this, self](asio::error_code ec) {
-          if (UNLIKELY(ec == asio::error::operation_aborted)) {
-            return;
-          }
-          auto callback = std::move(wait_write_callback_);
-          wait_write(std::move(callback));
-        });
-        return;
-      }
-    }
-
     write_inprogress_ = true;
     wait_write_callback_ = std::move(callback);
     scoped_refptr<stream> self(this);
-    if (ul_limit_state_ && !dl_limit_state_) {
-      // leaving ratelimit state
-      ratelimit(absl::Now());
-    }
-    ul_limit_state_ = false;
     s_wait_write([this, self](asio::error_code ec) {
       // Cancelled, safe to ignore
       if (UNLIKELY(ec == asio::error::bad_descriptor || ec == asio::error::operation_aborted)) {
@@ -385,9 +325,7 @@ class stream : public gurl_base::RefCountedThreadSafe<stream> {
     if (ec) {
       VLOG(2) << "close() error: " << ec;
     }
-    dl_delay_timer.cancel();
-    ul_delay_timer.cancel();
-    read_yield_timer_.cancel();
+    read_delay_timer_.cancel();
     connect_timer_.cancel();
     resolver_.Cancel();
   }
@@ -436,15 +374,10 @@ class stream : public gurl_base::RefCountedThreadSafe<stream> {
     socket_.non_blocking(true, ec);
     scoped_refptr<stream> self(this);
     if (auto connect_timeout = absl::GetFlag(FLAGS_connect_timeout)) {
-      connect_timer_.expires_after(std::chrono::seconds(connect_timeout));
-      connect_timer_.async_wait([this, channel, self](asio::error_code ec) {
-        // Cancelled, safe to ignore
-        if (UNLIKELY(ec == asio::error::operation_aborted)) {
-          return;
-        }
-        on_async_connect_expired(channel, ec);
-      });
+      timer_wheel_->Schedule(&connect_timer_, std::chrono::seconds(connect_timeout),
+                                            [this, channel, self]() { on_async_connect_expired(channel); });
     }
+    connect_start_time_ = GetMonotonicTime();
     socket_.async_connect(endpoint_, [this, channel, self](asio::error_code ec) {
       // Cancelled, safe to ignore
       if (UNLIKELY(ec == asio::error::bad_descriptor || ec == asio::error::operation_aborted)) {
@@ -454,6 +387,9 @@ class stream : public gurl_base::RefCountedThreadSafe<stream> {
         DCHECK(!user_connect_callback_);
         return;
       }
+      if (!ec) {
+        connect_latency_ = GetMonotonicTime() - connect_start_time_;
+      }
       on_async_connected(channel, ec);
     });
   }
@@ -476,16 +412,11 @@ class stream : public gurl_base::RefCountedThreadSafe<stream> {
     }
     SetSocketTcpNoDelay(&socket_, ec);
 
-    auto start = absl::Now();
-    ul_limit_size_ = dl_limit_size_ = 0;
-    ul_limit_start_ = dl_limit_start_ = start;
-    ul_limit_state_ = dl_limit_state_ = false;
-    ratelimit(start);
     on_async_connect_callback(asio::error_code());
   }
 
  private:
-  void on_async_connect_expired(Channel* channel, asio::error_code ec) {
+  void on_async_connect_expired(Channel* channel) {
     // Rarely happens, cancel fails but expire still there
     if (connected_) {
       DCHECK(!user_connect_callback_);
@@ -493,10 +424,7 @@ class stream : public gurl_base::RefCountedThreadSafe<stream> {
     }
     VLOG(1) << "connection timed out with endpoint: " << endpoint_;
     eof_ = true;
-    if (!ec) {
-      ec = asio::error::timed_out;
-    }
-    on_async_connect_callback(ec);
+    on_async_connect_callback(asio::error::timed_out);
   }
 
   void on_disconnect(Channel* channel, asio::error_code ec) {
@@ -547,26 +475,6 @@ class stream : public gurl_base::RefCountedThreadSafe<stream> {
   size_t rbytes_transferred() const { return rbytes_transferred_; }
   size_t wbytes_transferred() const { return wbytes_transferred_; }
 
- private:
-  /*
-   * Update the timestamp and sizestamp to use for rate limit calculations.
-   */
-  void ratelimit(absl::Time now) {
-    /* do not set a new stamp unless the time since last update is long enough */
-    if (dl_limit_rate_) {
-      if (absl::ToInt64Milliseconds(now - dl_limit_start_) >= MIN_RATE_LIMIT_PERIOD) {
-        dl_limit_start_ = now;
-        dl_limit_size_ = rbytes_transferred_;
-      }
-    }
-    if (ul_limit_rate_) {
-      if (absl::ToInt64Milliseconds(now - ul_limit_start_) >= MIN_RATE_LIMIT_PERIOD) {
-        ul_limit_start_ = now;
-        ul_limit_size_ = wbytes_transferred_;
-      }
-    }
-  }
-
  private:
   /// used to resolve local and remote endpoint
   net::Resolver resolver_;
@@ -577,8 +485,10 @@ class stream : public gurl_base::RefCountedThreadSafe<stream> {
   uint16_t port_;
   asio::ip::tcp::endpoint endpoint_;
   asio::io_context& io_context_;
+  /// cached to skip the service lookup per read
+  TimerWheel* timer_wheel_;
   asio::ip::tcp::socket socket_;
-  asio::steady_timer connect_timer_;
+  WheelTimer connect_timer_;
   std::deque<asio::ip::tcp::endpoint> endpoints_;
 
   Channel* channel_;
@@ -587,6 +497,13 @@ class stream : public gurl_base::RefCountedThreadSafe<stream> {
   bool closed_ = false;
   handle_t user_connect_callback_;
 
+  // latency statistics (in nanoseconds)
+  uint64_t resolve_start_time_ = 0;
+  uint64_t dns_latency_ = 0;
+  uint64_t connect_start_time_ = 0;
+  uint64_t connect_latency_ = 0;
+  uint64_t tls_handshake_latency_ = 0;
+
  private:
   bool read_inprogress_ = false;
   bool write_inprogress_ = false;
@@ -597,23 +514,9 @@ class stream : public gurl_base::RefCountedThreadSafe<stream> {
   int64_t rbytes_transferred_ = 0;
   int64_t wbytes_transferred_ = 0;
 
-  // post yield
-  asio::steady_timer read_yield_timer_;
-  static constexpr const uint64_t kReadYieldIntervalUs = 10;
-
-  // rate limiter (download)
-  const int64_t dl_limit_rate_;
-  asio::steady_timer dl_delay_timer;
-  absl::Time dl_limit_start_;
-  int64_t dl_limit_size_;
-  bool dl_limit_state_;
-
-  // rate limiter (upload)
-  const int64_t ul_limit_rate_;
-  asio::steady_timer ul_delay_timer;
-  absl::Time ul_limit_start_;
-  int64_t ul_limit_size_;
-  bool ul_limit_state_;
+  // rate limiter, charged by reads (download)
+  std::shared_ptr<RateLimiter> rate_limiter_;
+  WheelTimer read_delay_timer_;
 };
 
 }  // namespace net
@@ -0,0 +1,287 @@
+// SPDX-License-Identifier: GPL-2.0
+/* Copyright (c) 2024 Chilledheart  */
+
+#include "net/timer_wheel.hpp"
+
+#include <algorithm>
+#include <bit>
+
+#include "core/logging.hpp"
+#include "core/utils.hpp"
+
+namespace net {
+
+namespace {
+
+uint64_t CurrentTick() {
+  return GetMonotonicTime() / TimerWheel::kTickNs;
+}
+
+/// the distance from start to the first set bit of the bitmap, wrapping
+/// around, kSlotCount if the bitmap is empty
+template <size_t N>
+size_t FindOccupied(const std::array<uint64_t, N>& bitmap, size_t start) {
+  size_t start_word = start / 64;
+  for (size_t i = 0; i <= N; ++i) {
+    size_t word = (start_word + i) % N;
+    uint64_t bits = bitmap[word];
+    if (i == 0) {
+      bits &= ~uint64_t{0} << (start % 64);
+    } else if (i == N) {
+      bits &= (uint64_t{1} << (start % 64)) - 1;
+    }
+    if (bits) {
+      size_t slot = word * 64 + std::countr_zero(bits);
+      return (slot - start) & (N * 64 - 1);
+    }
+  }
+  return N * 64;
+}
+
+}  // namespace
+
+void WheelTimer::cancel() {
+  if (wheel_) {
+    wheel_->Unlink(this);
+    callback_ = nullptr;
+  }
+}
+
+asio::execution_context::id TimerWheel::id;
+
+TimerWheel::TimerWheel(asio::io_context& io_context)
+    : asio::execution_context::service(io_context), tick_timer_(io_context) {}
+
+TimerWheel::~TimerWheel() {
+  DCHECK_EQ(size_, 0u);
+}
+
+void TimerWheel::ScheduleNanoseconds(WheelTimer* timer, uint64_t delay_ns, WheelTimer::callback_t&& callback) {
+  DCHECK(callback);
+  timer->cancel();
+  // the slots being walked are not yet processed, only resync an idle wheel
+  if (!in_tick_ && !size_) {
+    current_tick_ = CurrentTick();
+  }
+  // round up from the time rather than the tick, and never fire within the
+  // current tick
+  uint64_t now = GetMonotonicTime();
+  timer->deadline_ = std::max((now + delay_ns + kTickNs - 1) / kTickNs, std::max(now / kTickNs, current_tick_) + 1);
+  timer->callback_ = std::move(callback);
+  Link(timer);
+  if (!in_tick_) {
+    ArmTickTimer();
+  }
+}
+
+void TimerWheel::shutdown() {
+  asio::error_code ec;
+  tick_timer_.cancel(ec);
+  wake_tick_ = 0;
+  auto drop = [this](WheelTimer* timer) {
+    Unlink(timer);
+    // the callback might own the timer
+    auto callback = std::move(timer->callback_);
+  };
+  for (WheelTimer*& head : slots_) {
+    while (head) {
+      drop(head);
+    }
+  }
+  for (WheelTimer*& head : blocks_) {
+    while (head) {
+      drop(head);
+    }
+  }
+  while (overflow_) {
+    drop(overflow_);
+  }
+  DCHECK_EQ(size_, 0u);
+}
+
+void TimerWheel::Link(WheelTimer* timer) {
+  DCHECK(!timer->wheel_);
+  DCHECK_GT(timer->deadline_, current_tick_);
+  WheelTimer** head;
+  uint64_t block = timer->deadline_ >> kSlotBits;
+  if (timer->deadline_ - current_tick_ <= static_cast<uint64_t>(kSlotCount)) {
+    size_t slot = timer->deadline_ & (kSlotCount - 1);
+    head = &slots_[slot];
+    occupied_[slot / 64] |= uint64_t{1} << (slot % 64);
+  } else if (block - (current_tick_ >> kSlotBits) < static_cast<uint64_t>(kSlotCount)) {
+    size_t slot = block & (kSlotCount - 1);
+    head = &blocks_[slot];
+    blocks_occupied_[slot / 64] |= uint64_t{1} << (slot % 64);
+  } else {
+    head = &overflow_;
+    overflow_min_ = std::min(overflow_min_, timer->deadline_);
+  }
+  timer->wheel_ = this;
+  timer->prev_ = nullptr;
+  timer->next_ = *head;
+  if (*head) {
+    (*head)->prev_ = timer;
+  }
+  *head = timer;
+  ++size_;
+}
+
+void TimerWheel::Unlink(WheelTimer* timer) {
+  DCHECK_EQ(timer->wheel_, this);
+  if (timer->prev_) {
+    timer->prev_->next_ = timer->next_;
+  } else if (size_t slot = timer->deadline_ & (kSlotCount - 1); slots_[slot] == timer) {
+    slots_[slot] = timer->next_;
+    if (!slots_[slot]) {
+      occupied_[slot / 64] &= ~(uint64_t{1} << (slot % 64));
+    }
+  } else if (size_t block = (timer->deadline_ >> kSlotBits) & (kSlotCount - 1); blocks_[block] == timer) {
+    blocks_[block] = timer->next_;
+    if (!blocks_[block]) {
+      blocks_occupied_[block / 64] &= ~(uint64_t{1} << (block % 64));
+    }
+  } else {
+    DCHECK_EQ(overflow_, timer);
+    overflow_ = timer->next_;
+    if (!overflow_) {
+      overflow_min_ = UINT64_MAX;
+    }
+  }
+  if (timer->next_) {
+    timer->next_->prev_ = timer->prev_;
+  }
+  timer->wheel_ = nullptr;
+  timer->prev_ = timer->next_ = nullptr;
+  --size_;
+  // don't keep the io context running for the cancelled timers
+  if (!size_ && !in_tick_ && wake_tick_) {
+    asio::error_code ec;
+    tick_timer_.cancel(ec);
+    wake_tick_ = 0;
+  }
+}
+
+void TimerWheel::CascadeBlock(uint64_t block) {
+  // right before the first tick of the block, so all of them fit into the slots
+  DCHECK_EQ(current_tick_ + 1, block << kSlotBits);
+  WheelTimer*& head = blocks_[block & (kSlotCount - 1)];
+  while (WheelTimer* timer = head) {
+    DCHECK_EQ(timer->deadline_ >> kSlotBits, block);
+    Unlink(timer);
+    Link(timer);
+  }
+}
+
+void TimerWheel::Cascade() {
+  // half a revolution of the blocks ahead, so the list is walked at most
+  // twice a revolution
+  if (!overflow_ || (overflow_min_ >> kSlotBits) > (current_tick_ >> kSlotBits) + kSlotCount / 2) {
+    return;
+  }
+  overflow_min_ = UINT64_MAX;
+  WheelTimer* timer = overflow_;
+  while (timer) {
+    WheelTimer* next = timer->next_;
+    if ((timer->deadline_ >> kSlotBits) - (current_tick_ >> kSlotBits) < static_cast<uint64_t>(kSlotCount)) {
+      Unlink(timer);
+      // already late if the io context was blocked, fire it on the next tick
+      timer->deadline_ = std::max(timer->deadline_, current_tick_ + 1);
+      Link(timer);
+    } else {
+      overflow_min_ = std::min(overflow_min_, timer->deadline_);
+    }
+    timer = next;
+  }
+}
+
+uint64_t TimerWheel::NextWalkTick() const {
+  uint64_t tick = 0;
+  // the first non-empty slot after the current tick, all the timers in it are
+  // due on the same tick
+  size_t distance = FindOccupied(occupied_, (current_tick_ + 1) & (kSlotCount - 1));
+  if (distance < static_cast<size_t>(kSlotCount)) {
+    tick = current_tick_ + 1 + distance;
+  }
+  // the first tick of the first non-empty block
+  uint64_t current_block = current_tick_ >> kSlotBits;
+  distance = FindOccupied(blocks_occupied_, (current_block + 1) & (kSlotCount - 1));
+  if (distance < static_cast<size_t>(kSlotCount)) {
+    uint64_t block_tick = (current_block + 1 + distance) << kSlotBits;
+    if (!tick || block_tick < tick) {
+      tick = block_tick;
+    }
+  }
+  return tick;
+}
+
+uint64_t TimerWheel::NextWakeTick() const {
+  uint64_t wake = NextWalkTick();
+  if (overflow_) {
+    uint64_t cascade = ((overflow_min_ >> kSlotBits) - kSlotCount / 2) << kSlotBits;
+    cascade = std::max(cascade, current_tick_ + 1);
+    if (!wake || cascade < wake) {
+      wake = cascade;
+    }
+  }
+  return wake;
+}
+
+void TimerWheel::ArmTickTimer() {
+  uint64_t wake = NextWakeTick();
+  if (!wake || (wake_tick_ && wake_tick_ <= wake)) {
+    return;
+  }
+  wake_tick_ = wake;
+  uint64_t now = GetMonotonicTime();
+  uint64_t expiry = wake * kTickNs;
+  tick_timer_.expires_after(std::chrono::nanoseconds(expiry > now ? expiry - now : 0));
+  tick_timer_.async_wait([this](asio::error_code ec) {
+    if (UNLIKELY(ec == asio::error::operation_aborted)) {
+      return;
+    }
+    wake_tick_ = 0;
+    OnTick();
+  });
+}
+
+void TimerWheel::OnTick() {
+  // the callbacks might re-arm timers, which must not resync the current tick
+  // before the walk is done
+  in_tick_ = true;
+  uint64_t now = CurrentTick();
+  // only the ticks with an occupied slot or block are visited
+  while (current_tick_ < now) {
+    uint64_t tick = NextWalkTick();
+    if (!tick || tick > now) {
+      current_tick_ = now;
+      break;
+    }
+    if ((tick & (kSlotCount - 1)) == 0) {
+      current_tick_ = tick - 1;
+      CascadeBlock(tick >> kSlotBits);
+    }
+    current_tick_ = tick;
+    WheelTimer* timer = slots_[tick & (kSlotCount - 1)];
+    while (timer) {
+      WheelTimer* next = timer->next_;
+      // the re-armed timers might be due a revolution later
+      if (timer->deadline_ <= tick) {
+        Unlink(timer);
+        // the callback might re-arm or destroy the timer
+        auto callback = std::move(timer->callback_);
+        callback();
+        // the next timer might be cancelled by the callback, restart the slot
+        timer = slots_[tick & (kSlotCount - 1)];
+        continue;
+      }
+      timer = next;
+    }
+  }
+  Cascade();
+  in_tick_ = false;
+  if (size_) {
+    ArmTickTimer();
+  }
+}
+
+}  // namespace net
@@ -0,0 +1,132 @@
+// SPDX-License-Identifier: GPL-2.0
+/* Copyright (c) 2024 Chilledheart  */
+
+#ifndef H_NET_TIMER_WHEEL
+#define H_NET_TIMER_WHEEL
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+
+#include <absl/functional/any_invocable.h>
+
+#include "net/asio.hpp"
+
+namespace net {
+
+class TimerWheel;
+
+/// A timer scheduled on the TimerWheel of an io context.
+///
+/// The timer is intrusive, arming and cancelling it never allocates. It is
+/// cancelled when destroyed, and it must be used from the thread running the
+/// io context only.
+class WheelTimer {
+ public:
+  using callback_t = absl::AnyInvocable<void()>;
+
+  WheelTimer() = default;
+  ~WheelTimer() { cancel(); }
+
+  WheelTimer(const WheelTimer&) = delete;
+  WheelTimer& operator=(const WheelTimer&) = delete;
+
+  /// whether the timer is scheduled and not yet fired
+  bool armed() const { return wheel_ != nullptr; }
+
+  /// cancel the timer and drop its callback, do nothing if not armed
+  void cancel();
+
+ private:
+  friend class TimerWheel;
+
+  TimerWheel* wheel_ = nullptr;
+  WheelTimer* prev_ = nullptr;
+  WheelTimer* next_ = nullptr;
+  uint64_t deadline_ = 0;
+  callback_t callback_;
+};
+
+/// A coarse hierarchical timer wheel, one per io context.
+///
+/// Deadlines are rounded up to the tick (1ms) and hashed into kSlotCount
+/// slots, so arming and cancelling a timer are O(1). The timers beyond one
+/// revolution of the wheel are hashed by kSlotCount ticks into the blocks of
+/// the second level, and each block is moved into the slots once, right
+/// before its first tick. Only the timers beyond a revolution of the second
+/// level (about 4 minutes) wait in an overflow list.
+///
+/// The wheel is driven by a single steady_timer, which is armed for the
+/// earliest occupied slot or block rather than every tick, so a wheel holding
+/// only long timers rarely wakes up.
+class TimerWheel : public asio::execution_context::service {
+ public:
+  static asio::execution_context::id id;
+
+  static constexpr int kSlotBits = 9;
+  static constexpr int kSlotCount = 1 << kSlotBits;
+  static constexpr uint64_t kTickNs = 1000 * 1000;
+
+  explicit TimerWheel(asio::io_context& io_context);
+  ~TimerWheel() override;
+
+  /// the timer wheel associated with the io context
+  static TimerWheel& Get(asio::io_context& io_context) { return asio::use_service<TimerWheel>(io_context); }
+
+  /// arm the timer, re-arming an armed timer replaces its deadline and callback
+  ///
+  /// \param timer the timer to arm
+  /// \param delay the duration to wait, rounded up to the tick
+  /// \param callback the callback invoked on the io context when expired
+  template <typename Rep, typename Period>
+  void Schedule(WheelTimer* timer, std::chrono::duration<Rep, Period> delay, WheelTimer::callback_t&& callback) {
+    ScheduleNanoseconds(timer, std::chrono::duration_cast<std::chrono::nanoseconds>(delay).count(),
+                        std::move(callback));
+  }
+
+  /// see Schedule
+  void ScheduleNanoseconds(WheelTimer* timer, uint64_t delay_ns, WheelTimer::callback_t&& callback);
+
+  /// the number of armed timers
+  size_t size() const { return size_; }
+
+ private:
+  friend class WheelTimer;
+
+  void shutdown() override;
+
+  void Link(WheelTimer* timer);
+  void Unlink(WheelTimer* timer);
+  void CascadeBlock(uint64_t block);
+  void Cascade();
+  uint64_t NextWalkTick() const;
+  uint64_t NextWakeTick() const;
+  void ArmTickTimer();
+  void OnTick();
+
+  asio::steady_timer tick_timer_;
+  /// the tick the tick timer is armed for, 0 if not armed
+  uint64_t wake_tick_ = 0;
+  /// the slots are being walked, the tick timer is re-armed after the walk
+  bool in_tick_ = false;
+  /// all ticks up to (and including) this one have been processed
+  uint64_t current_tick_ = 0;
+  size_t size_ = 0;
+  /// the slots hold the timers due in (current_tick_, current_tick_ + kSlotCount]
+  std::array<WheelTimer*, kSlotCount> slots_{};
+  /// the bitmap of the non-empty slots
+  std::array<uint64_t, kSlotCount / 64> occupied_{};
+  /// the blocks hold the other timers due in the next kSlotCount - 1 blocks
+  /// after the current one, a block being kSlotCount ticks
+  std::array<WheelTimer*, kSlotCount> blocks_{};
+  /// the bitmap of the non-empty blocks
+  std::array<uint64_t, kSlotCount / 64> blocks_occupied_{};
+  /// the timers due later than the blocks
+  WheelTimer* overflow_ = nullptr;
+  /// no later than the earliest deadline in the overflow list
+  uint64_t overflow_min_ = UINT64_MAX;
+};
+
+}  // namespace net
+
+#endif  // H_NET_TIMER_WHEEL
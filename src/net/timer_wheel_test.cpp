@@ -0,0 +1,140 @@
+// SPDX-License-Identifier: GPL-2.0
+/* Copyright (c) 2024 Chilledheart  */
+
+#include <gtest/gtest-message.h>
+#include <gtest/gtest.h>
+
+#include <functional>
+#include <thread>
+#include <vector>
+
+#include "core/utils.hpp"
+#include "net/timer_wheel.hpp"
+
+using namespace net;
+
+TEST(TimerWheelTest, FireInOrder) {
+  asio::io_context io_context;
+  TimerWheel& wheel = TimerWheel::Get(io_context);
+  EXPECT_EQ(&wheel, &TimerWheel::Get(io_context));
+
+  std::vector<int> fired;
+  WheelTimer timers[3];
+  uint64_t start = GetMonotonicTime();
+  wheel.Schedule(&timers[0], std::chrono::milliseconds(30), [&]() { fired.push_back(0); });
+  wheel.Schedule(&timers[1], std::chrono::milliseconds(10), [&]() { fired.push_back(1); });
+  wheel.Schedule(&timers[2], std::chrono::milliseconds(20), [&]() { fired.push_back(2); });
+  EXPECT_EQ(3u, wheel.size());
+  EXPECT_TRUE(timers[0].armed());
+  io_context.run();
+
+  EXPECT_GE(GetMonotonicTime() - start, 30u * 1000 * 1000);
+  EXPECT_EQ((std::vector<int>{1, 2, 0}), fired);
+  EXPECT_EQ(0u, wheel.size());
+  EXPECT_FALSE(timers[0].armed());
+}
+
+TEST(TimerWheelTest, CancelAndRearm) {
+  asio::io_context io_context;
+  TimerWheel& wheel = TimerWheel::Get(io_context);
+
+  int fired = 0;
+  WheelTimer timer, cancelled;
+  // beyond one revolution of the wheel
+  wheel.Schedule(&cancelled, std::chrono::milliseconds(TimerWheel::kSlotCount + 5), [&]() { fired += 100; });
+  wheel.Schedule(&timer, std::chrono::milliseconds(1), [&]() {
+    ++fired;
+    cancelled.cancel();
+    wheel.Schedule(&timer, std::chrono::milliseconds(1), [&]() { ++fired; });
+  });
+  io_context.run();
+
+  EXPECT_EQ(2, fired);
+  EXPECT_EQ(0u, wheel.size());
+}
+
+TEST(TimerWheelTest, LongDelay) {
+  asio::io_context io_context;
+  TimerWheel& wheel = TimerWheel::Get(io_context);
+
+  bool fired = false;
+  WheelTimer timer;
+  uint64_t start = GetMonotonicTime();
+  wheel.Schedule(&timer, std::chrono::milliseconds(TimerWheel::kSlotCount + 5), [&]() { fired = true; });
+  io_context.run();
+
+  EXPECT_TRUE(fired);
+  EXPECT_GE(GetMonotonicTime() - start, (TimerWheel::kSlotCount + 5u) * 1000 * 1000);
+}
+
+TEST(TimerWheelTest, SecondLevel) {
+  asio::io_context io_context;
+  TimerWheel& wheel = TimerWheel::Get(io_context);
+
+  std::vector<int> fired;
+  std::vector<uint64_t> elapsed(3);
+  WheelTimer timers[3];
+  const uint64_t delays[] = {2 * TimerWheel::kSlotCount + 7, TimerWheel::kSlotCount + 30, 5};
+  uint64_t start = GetMonotonicTime();
+  for (int i = 0; i < 3; ++i) {
+    wheel.Schedule(&timers[i], std::chrono::milliseconds(delays[i]), [&, i]() {
+      fired.push_back(i);
+      elapsed[i] = GetMonotonicTime() - start;
+    });
+  }
+  io_context.run();
+
+  EXPECT_EQ((std::vector<int>{2, 1, 0}), fired);
+  for (int i = 0; i < 3; ++i) {
+    EXPECT_GE(elapsed[i], delays[i] * TimerWheel::kTickNs);
+    EXPECT_LT(elapsed[i], (delays[i] + 50) * TimerWheel::kTickNs);
+  }
+}
+
+TEST(TimerWheelTest, RearmWhileCatchingUp) {
+  asio::io_context io_context;
+  TimerWheel& wheel = TimerWheel::Get(io_context);
+
+  WheelTimer rearming, other;
+  bool other_fired = false;
+  uint64_t other_elapsed = 0;
+  uint64_t start = GetMonotonicTime();
+  std::function<void()> rearm = [&]() {
+    if (!other_fired) {
+      wheel.Schedule(&rearming, std::chrono::milliseconds(1), [&]() { rearm(); });
+    }
+  };
+  wheel.Schedule(&rearming, std::chrono::milliseconds(1), [&]() { rearm(); });
+  wheel.Schedule(&other, std::chrono::milliseconds(3), [&]() {
+    other_fired = true;
+    other_elapsed = GetMonotonicTime() - start;
+  });
+  // both are expired when the wheel catches up
+  asio::post(io_context, []() { std::this_thread::sleep_for(std::chrono::milliseconds(10)); });
+  io_context.run();
+
+  EXPECT_TRUE(other_fired);
+  // not held back for another revolution of the wheel
+  EXPECT_LT(other_elapsed, TimerWheel::kSlotCount / 2 * TimerWheel::kTickNs);
+}
+
+TEST(TimerWheelTest, CancelLongDelay) {
+  asio::io_context io_context;
+  TimerWheel& wheel = TimerWheel::Get(io_context);
+
+  WheelTimer timer, far;
+  uint64_t start = GetMonotonicTime();
+  wheel.Schedule(&timer, std::chrono::seconds(60), []() {});
+  wheel.Schedule(&timer, std::chrono::seconds(30), []() {});
+  // beyond the second level
+  wheel.Schedule(&far, std::chrono::minutes(10), []() {});
+  asio::post(io_context, [&]() {
+    timer.cancel();
+    far.cancel();
+  });
+  io_context.run();
+
+  // the io context is not kept running by the cancelled timer
+  EXPECT_LT(GetMonotonicTime() - start, 1000u * 1000 * 1000);
+  EXPECT_EQ(0u, wheel.size());
+}
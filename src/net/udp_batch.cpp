@@ -0,0 +1,305 @@
+// SPDX-License-Identifier: GPL-2.0
+/* Copyright (c) 2024 Chilledheart  */
+
+#include "net/udp_batch.hpp"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <memory>
+
+#include <build/build_config.h>
+
+#if BUILDFLAG(IS_LINUX) || BUILDFLAG(IS_ANDROID)
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#endif
+
+#include "core/logging.hpp"
+
+#if BUILDFLAG(IS_LINUX) || BUILDFLAG(IS_ANDROID)
+#define HAVE_UDP_MMSG 1
+#ifndef SOL_UDP
+#define SOL_UDP 17
+#endif
+#ifndef UDP_SEGMENT
+#define UDP_SEGMENT 103
+#endif
+#ifndef UDP_GRO
+#define UDP_GRO 104
+#endif
+#endif
+
+namespace net {
+
+namespace {
+
+/// GRO coalesces up to 64 KiB into one message
+constexpr size_t kReceiveBufferSize = 65536;
+
+/// keeps the segments below the usual path mtu (1500 bytes ethernet, ipv6),
+/// larger segments are rejected by the kernel instead of being fragmented
+constexpr size_t kMaxSegmentSize = 1452;
+
+/// the payload of a segmented message can't exceed a single udp datagram
+constexpr size_t kMaxSegmentedLength = 65000;
+
+/// receive buffers shared by the sockets of an io thread, the datagrams are
+/// consumed by the visitor right away
+struct ReceiveBuffers {
+  uint8_t data[kUdpBatchSize][kReceiveBufferSize];
+};
+
+ReceiveBuffers* GetReceiveBuffers() {
+  thread_local std::unique_ptr<ReceiveBuffers> buffers;
+  if (!buffers) {
+    buffers = std::make_unique<ReceiveBuffers>();
+  }
+  return buffers.get();
+}
+
+#ifdef HAVE_UDP_MMSG
+/// cleared once the kernel rejects segmentation offload
+std::atomic<bool> g_udp_segment_supported = true;
+
+bool IsWouldBlock(int err) {
+  return err == EAGAIN || err == EWOULDBLOCK || err == ENOBUFS;
+}
+
+bool IsFatal(int err) {
+  return err == EBADF || err == ENOTSOCK || err == EFAULT;
+}
+#endif
+
+}  // namespace
+
+void SetUdpReceiveOffload(asio::ip::udp::socket* socket) {
+#ifdef HAVE_UDP_MMSG
+  int opt = 1;
+  if (setsockopt(socket->native_handle(), SOL_UDP, UDP_GRO, &opt, sizeof(opt)) < 0) {
+    VLOG(2) << "UDP_GRO is not supported on this platform";
+  } else {
+    VLOG(3) << "Applied current udp_option: udp_gro";
+  }
+#else
+  (void)socket;
+#endif
+}
+
+#ifdef HAVE_UDP_MMSG
+size_t ReceiveUdpPackets(asio::ip::udp::socket* socket, UdpPacketVisitor visitor, asio::error_code& ec) {
+  ReceiveBuffers* buffers = GetReceiveBuffers();
+  mmsghdr msgs[kUdpBatchSize];
+  iovec iovs[kUdpBatchSize];
+  sockaddr_storage names[kUdpBatchSize];
+  alignas(cmsghdr) uint8_t controls[kUdpBatchSize][CMSG_SPACE(sizeof(int))];
+
+  memset(msgs, 0, sizeof(msgs));
+  for (size_t i = 0; i < kUdpBatchSize; ++i) {
+    iovs[i].iov_base = buffers->data[i];
+    iovs[i].iov_len = kReceiveBufferSize;
+    msgs[i].msg_hdr.msg_name = &names[i];
+    msgs[i].msg_hdr.msg_namelen = sizeof(names[i]);
+    msgs[i].msg_hdr.msg_iov = &iovs[i];
+    msgs[i].msg_hdr.msg_iovlen = 1;
+    msgs[i].msg_hdr.msg_control = controls[i];
+    msgs[i].msg_hdr.msg_controllen = sizeof(controls[i]);
+  }
+
+  int ret;
+  do {
+    ret = recvmmsg(socket->native_handle(), msgs, kUdpBatchSize, MSG_DONTWAIT, nullptr);
+  } while (ret < 0 && errno == EINTR);
+  if (ret < 0) {
+    ec = IsWouldBlock(errno) ? asio::error::would_block : asio::error_code(errno, asio::error::get_system_category());
+    return 0;
+  }
+  ec = asio::error_code();
+
+  size_t received = 0;
+  for (int i = 0; i < ret; ++i) {
+    const msghdr& hdr = msgs[i].msg_hdr;
+    if (hdr.msg_flags & MSG_TRUNC) {
+      VLOG(2) << "udp: dropped truncated datagram";
+      continue;
+    }
+    asio::ip::udp::endpoint endpoint;
+    if (hdr.msg_namelen > endpoint.capacity()) {
+      continue;
+    }
+    memcpy(endpoint.data(), hdr.msg_name, hdr.msg_namelen);
+    endpoint.resize(hdr.msg_namelen);
+
+    size_t segment_size = 0;
+    for (cmsghdr* cmsg = CMSG_FIRSTHDR(&hdr); cmsg; cmsg = CMSG_NXTHDR(const_cast<msghdr*>(&hdr), cmsg)) {
+      if (cmsg->cmsg_level == SOL_UDP && cmsg->cmsg_type == UDP_GRO) {
+        int gso_size = 0;
+        memcpy(&gso_size, CMSG_DATA(cmsg), std::min<size_t>(sizeof(gso_size), cmsg->cmsg_len - CMSG_LEN(0)));
+        segment_size = gso_size > 0 ? gso_size : 0;
+      }
+    }
+
+    // split the datagrams coalesced by GRO, all but the last are segment_size long
+    const uint8_t* data = buffers->data[i];
+    size_t length = msgs[i].msg_len;
+    if (!segment_size) {
+      segment_size = length;
+    }
+    do {
+      size_t segment = std::min(segment_size, length);
+      visitor(endpoint, data, segment);
+      ++received;
+      data += segment;
+      length -= segment;
+    } while (length);
+  }
+  return received;
+}
+
+size_t SendUdpPackets(asio::ip::udp::socket* socket, const UdpPacket* packets, size_t count, asio::error_code& ec) {
+  mmsghdr msgs[kUdpBatchSize];
+  // a header and a payload per datagram
+  iovec iovs[kUdpBatchSize * kUdpMaxSegments * 2];
+  // the number of datagrams and whether segmentation is used per message
+  size_t packets_per_msg[kUdpBatchSize];
+  bool segmented[kUdpBatchSize];
+  alignas(cmsghdr) uint8_t controls[kUdpBatchSize][CMSG_SPACE(sizeof(uint16_t))];
+
+  const bool use_segment = g_udp_segment_supported.load(std::memory_order_relaxed);
+  size_t nmsgs = 0, niovs = 0, consumed = 0;
+  memset(msgs, 0, sizeof(msgs));
+  while (consumed < count && nmsgs < kUdpBatchSize) {
+    const UdpPacket& first = packets[consumed];
+    msghdr& hdr = msgs[nmsgs].msg_hdr;
+    hdr.msg_name = const_cast<sockaddr*>(first.endpoint.data());
+    hdr.msg_namelen = first.endpoint.size();
+    hdr.msg_iov = &iovs[niovs];
+
+    // gather the datagrams of the same size (the last might be shorter) to the same endpoint
+    size_t n = 0, total = 0;
+    const size_t segment_size = first.size();
+    while (consumed + n < count) {
+      const UdpPacket& packet = packets[consumed + n];
+      if (n > 0 && (!use_segment || segment_size > kMaxSegmentSize || n >= kUdpMaxSegments ||
+                    packet.size() > segment_size || total + packet.size() > kMaxSegmentedLength ||
+                    packet.endpoint != first.endpoint)) {
+        break;
+      }
+      if (packet.header_length) {
+        iovs[niovs++] = {const_cast<uint8_t*>(packet.header), packet.header_length};
+      }
+      iovs[niovs++] = {const_cast<uint8_t*>(packet.data), packet.length};
+      total += packet.size();
+      ++n;
+      // a shorter datagram ends the run
+      if (packet.size() < segment_size) {
+        break;
+      }
+    }
+    hdr.msg_iovlen = &iovs[niovs] - hdr.msg_iov;
+    packets_per_msg[nmsgs] = n;
+    segmented[nmsgs] = n > 1;
+    if (n > 1) {
+      hdr.msg_control = controls[nmsgs];
+      hdr.msg_controllen = CMSG_SPACE(sizeof(uint16_t));
+      cmsghdr* cmsg = CMSG_FIRSTHDR(&hdr);
+      cmsg->cmsg_level = SOL_UDP;
+      cmsg->cmsg_type = UDP_SEGMENT;
+      cmsg->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+      uint16_t gso_size = segment_size;
+      memcpy(CMSG_DATA(cmsg), &gso_size, sizeof(gso_size));
+    }
+    consumed += n;
+    ++nmsgs;
+  }
+
+  size_t sent_msgs = 0, sent = 0;
+  ec = asio::error_code();
+  while (sent_msgs < nmsgs) {
+    int ret;
+    do {
+      ret = sendmmsg(socket->native_handle(), msgs + sent_msgs, nmsgs - sent_msgs, MSG_DONTWAIT);
+    } while (ret < 0 && errno == EINTR);
+    if (ret >= 0) {
+      for (int i = 0; i < ret; ++i) {
+        sent += packets_per_msg[sent_msgs + i];
+      }
+      sent_msgs += ret;
+      if (ret == 0) {
+        break;
+      }
+      continue;
+    }
+    int err = errno;
+    if (IsWouldBlock(err)) {
+      ec = asio::error::would_block;
+      break;
+    }
+    if (IsFatal(err)) {
+      ec = asio::error_code(err, asio::error::get_system_category());
+      break;
+    }
+    if (segmented[sent_msgs] && (err == EINVAL || err == EIO || err == EOPNOTSUPP)) {
+      // retried without segmentation by the next call
+      LOG(WARNING) << "udp: segmentation offload disabled: " << strerror(err);
+      g_udp_segment_supported.store(false, std::memory_order_relaxed);
+      break;
+    }
+    VLOG(2) << "udp: dropped " << packets_per_msg[sent_msgs] << " datagram(s) to "
+            << packets[sent].endpoint << ": " << strerror(err);
+    sent += packets_per_msg[sent_msgs];
+    ++sent_msgs;
+  }
+  return sent;
+}
+#else
+size_t ReceiveUdpPackets(asio::ip::udp::socket* socket, UdpPacketVisitor visitor, asio::error_code& ec) {
+  ReceiveBuffers* buffers = GetReceiveBuffers();
+  size_t received = 0;
+  for (size_t i = 0; i < kUdpBatchSize; ++i) {
+    asio::ip::udp::endpoint endpoint;
+    size_t length = socket->receive_from(asio::mutable_buffer(buffers->data[0], kReceiveBufferSize), endpoint, 0, ec);
+    if (ec == asio::error::message_size) {
+      VLOG(2) << "udp: dropped truncated datagram";
+      continue;
+    }
+    if (ec) {
+      break;
+    }
+    visitor(endpoint, buffers->data[0], length);
+    ++received;
+  }
+  if (received && (ec == asio::error::would_block || ec == asio::error::try_again)) {
+    ec = asio::error_code();
+  }
+  return received;
+}
+
+size_t SendUdpPackets(asio::ip::udp::socket* socket, const UdpPacket* packets, size_t count, asio::error_code& ec) {
+  size_t sent = 0;
+  ec = asio::error_code();
+  for (; sent < count; ++sent) {
+    const UdpPacket& packet = packets[sent];
+    std::array<asio::const_buffer, 2> buffers = {asio::const_buffer(packet.header, packet.header_length),
+                                                 asio::const_buffer(packet.data, packet.length)};
+    socket->send_to(buffers, packet.endpoint, 0, ec);
+    if (ec == asio::error::would_block || ec == asio::error::try_again || ec == asio::error::no_buffer_space) {
+      ec = asio::error::would_block;
+      break;
+    }
+    if (ec == asio::error::bad_descriptor || ec == asio::error::not_socket) {
+      break;
+    }
+    if (ec) {
+      VLOG(2) << "udp: dropped datagram to " << packet.endpoint << ": " << ec;
+      ec = asio::error_code();
+    }
+  }
+  return sent;
+}
+#endif
+
+}  // namespace net
@@ -0,0 +1,65 @@
+// SPDX-License-Identifier: GPL-2.0
+/* Copyright (c) 2024 Chilledheart  */
+
+#ifndef H_NET_UDP_BATCH
+#define H_NET_UDP_BATCH
+
+#include <cstddef>
+#include <cstdint>
+
+#include <absl/functional/function_ref.h>
+
+#include "net/asio.hpp"
+
+namespace net {
+
+/// a datagram to send, the header (if any) and the payload are gathered
+struct UdpPacket {
+  asio::ip::udp::endpoint endpoint;
+  const uint8_t* header = nullptr;
+  size_t header_length = 0;
+  const uint8_t* data = nullptr;
+  size_t length = 0;
+
+  size_t size() const { return header_length + length; }
+};
+
+/// the messages handled by one batched system call
+inline constexpr size_t kUdpBatchSize = 16;
+
+/// the datagrams coalesced into one message by segmentation offload (UDP_SEGMENT)
+inline constexpr size_t kUdpMaxSegments = 64;
+
+/// enable receive offload (UDP_GRO) on the socket if the kernel supports it,
+/// ReceiveUdpPackets splits the coalesced datagrams back
+void SetUdpReceiveOffload(asio::ip::udp::socket* socket);
+
+using UdpPacketVisitor =
+    absl::FunctionRef<void(const asio::ip::udp::endpoint& endpoint, const uint8_t* data, size_t length)>;
+
+/// receive the queued datagrams on a non-blocking socket
+///
+/// A single recvmmsg call is issued on Linux, other platforms call recvfrom up
+/// to kUdpBatchSize times. The data passed to visitor is only valid inside the
+/// call, it lives in buffers shared by the sockets of the calling thread.
+///
+/// \return the datagrams received, ec is would_block if none is queued
+size_t ReceiveUdpPackets(asio::ip::udp::socket* socket, UdpPacketVisitor visitor, asio::error_code& ec);
+
+/// send the datagrams on a non-blocking socket
+///
+/// A single sendmmsg call is issued on Linux, where the runs of datagrams of
+/// the same size to the same endpoint are sent as one message and segmented by
+/// the kernel (UDP_SEGMENT) if supported. Other platforms call sendto once per
+/// datagram.
+///
+/// Datagrams rejected by the kernel (e.g. unreachable or too big) are dropped
+/// and counted as consumed, as udp is unreliable anyway.
+///
+/// \return the datagrams consumed, ec is would_block if the socket buffer is
+///         full (retry the rest once writable) or a fatal socket error
+size_t SendUdpPackets(asio::ip::udp::socket* socket, const UdpPacket* packets, size_t count, asio::error_code& ec);
+
+}  // namespace net
+
+#endif  // H_NET_UDP_BATCH
@@ -0,0 +1,114 @@
+// SPDX-License-Identifier: GPL-2.0
+/* Copyright (c) 2024 Chilledheart  */
+
+#include <gtest/gtest-message.h>
+#include <gtest/gtest.h>
+
+#include <string>
+#include <vector>
+
+#include "net/udp_batch.hpp"
+
+using namespace net;
+
+namespace {
+
+class UdpBatchTest : public ::testing::Test {
+ public:
+  void SetUp() override {
+    asio::error_code ec;
+    for (asio::ip::udp::socket* socket : {&sender_, &receiver_}) {
+      socket->open(asio::ip::udp::v4(), ec);
+      ASSERT_FALSE(ec) << ec;
+      socket->non_blocking(true, ec);
+      ASSERT_FALSE(ec) << ec;
+      socket->bind(asio::ip::udp::endpoint(asio::ip::make_address("127.0.0.1"), 0), ec);
+      ASSERT_FALSE(ec) << ec;
+    }
+    SetUdpReceiveOffload(&receiver_);
+    sender_endpoint_ = sender_.local_endpoint(ec);
+    ASSERT_FALSE(ec) << ec;
+    receiver_endpoint_ = receiver_.local_endpoint(ec);
+    ASSERT_FALSE(ec) << ec;
+  }
+
+  /// receive until count datagrams arrive or nothing arrives for a while
+  std::vector<std::string> Receive(size_t count) {
+    std::vector<std::string> datagrams;
+    asio::error_code ec;
+    while (datagrams.size() < count) {
+      ReceiveUdpPackets(
+          &receiver_,
+          [&](const asio::ip::udp::endpoint& endpoint, const uint8_t* data, size_t length) {
+            EXPECT_EQ(sender_endpoint_, endpoint);
+            datagrams.emplace_back(reinterpret_cast<const char*>(data), length);
+          },
+          ec);
+      if (ec == asio::error::would_block || ec == asio::error::try_again) {
+        receiver_.wait(asio::ip::udp::socket::wait_read, ec);
+      }
+      if (ec) {
+        break;
+      }
+    }
+    return datagrams;
+  }
+
+ protected:
+  asio::io_context io_context_;
+  asio::ip::udp::socket sender_{io_context_};
+  asio::ip::udp::socket receiver_{io_context_};
+  asio::ip::udp::endpoint sender_endpoint_;
+  asio::ip::udp::endpoint receiver_endpoint_;
+};
+
+}  // namespace
+
+TEST_F(UdpBatchTest, SendAndReceive) {
+  const std::string header = "hdr:";
+  std::vector<std::string> payloads;
+  // a run of the same size (segmented if supported) ended by a shorter one
+  for (int i = 0; i < 8; ++i) {
+    payloads.push_back(std::string(1000, 'a' + i));
+  }
+  payloads.push_back("short");
+  // different sizes
+  payloads.push_back(std::string(3000, 'z'));
+  payloads.push_back(std::string());
+
+  std::vector<UdpPacket> packets;
+  for (const auto& payload : payloads) {
+    UdpPacket packet;
+    packet.endpoint = receiver_endpoint_;
+    packet.header = reinterpret_cast<const uint8_t*>(header.data());
+    packet.header_length = header.size();
+    packet.data = reinterpret_cast<const uint8_t*>(payload.data());
+    packet.length = payload.size();
+    packets.push_back(packet);
+  }
+
+  asio::error_code ec;
+  size_t sent = 0;
+  while (sent < packets.size()) {
+    sent += SendUdpPackets(&sender_, packets.data() + sent, packets.size() - sent, ec);
+    if (ec == asio::error::would_block) {
+      sender_.wait(asio::ip::udp::socket::wait_write, ec);
+    }
+    ASSERT_FALSE(ec) << ec;
+  }
+
+  std::vector<std::string> datagrams = Receive(payloads.size());
+  ASSERT_EQ(payloads.size(), datagrams.size());
+  for (size_t i = 0; i < payloads.size(); ++i) {
+    EXPECT_EQ(header + payloads[i], datagrams[i]);
+  }
+}
+
+TEST_F(UdpBatchTest, ReceiveNothing) {
+  asio::error_code ec;
+  size_t received = ReceiveUdpPackets(
+      &receiver_, [](const asio::ip::udp::endpoint&, const uint8_t*, size_t) { ADD_FAILURE() << "unexpected datagram"; },
+      ec);
+  EXPECT_EQ(0u, received);
+  EXPECT_EQ(asio::error::would_block, ec);
+}
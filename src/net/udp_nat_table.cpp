@@ -0,0 +1,69 @@
+// SPDX-License-Identifier: GPL-2.0
+/* Copyright (c) 2024 Chilledheart  */
+
+#include "net/udp_nat_table.hpp"
+
+#include <algorithm>
+
+#include "core/logging.hpp"
+
+namespace net {
+
+UdpNatTable::Key::Key(const asio::ip::udp::endpoint& endpoint) : port(endpoint.port()) {
+  const asio::ip::address& addr = endpoint.address();
+  if (addr.is_v4()) {
+    address = asio::ip::make_address_v6(asio::ip::v4_mapped, addr.to_v4()).to_bytes();
+  } else {
+    address = addr.to_v6().to_bytes();
+  }
+}
+
+UdpNatTable::UdpNatTable(uint64_t timeout_ns, size_t max_entries)
+    : timeout_ns_(timeout_ns), max_entries_(std::max<size_t>(max_entries, 1)) {}
+
+void UdpNatTable::OnSend(const asio::ip::udp::endpoint& peer, uint64_t now) {
+  if (now - last_sweep_ >= timeout_ns_) {
+    Expire(now);
+  }
+  Key key(peer);
+  auto iter = entries_.find(key);
+  if (iter != entries_.end()) {
+    iter->second = now;
+    return;
+  }
+  if (entries_.size() >= max_entries_) {
+    EvictOldest();
+  }
+  VLOG(3) << "udp nat: mapped " << peer;
+  entries_.emplace(key, now);
+}
+
+bool UdpNatTable::OnReceive(const asio::ip::udp::endpoint& peer, uint64_t now) {
+  auto iter = entries_.find(Key(peer));
+  if (iter == entries_.end()) {
+    return false;
+  }
+  if (now - iter->second >= timeout_ns_) {
+    VLOG(3) << "udp nat: expired " << peer;
+    entries_.erase(iter);
+    return false;
+  }
+  return true;
+}
+
+size_t UdpNatTable::Expire(uint64_t now) {
+  last_sweep_ = now;
+  return absl::erase_if(entries_, [this, now](const auto& entry) { return now - entry.second >= timeout_ns_; });
+}
+
+void UdpNatTable::EvictOldest() {
+  auto oldest = entries_.begin();
+  for (auto iter = entries_.begin(); iter != entries_.end(); ++iter) {
+    if (iter->second < oldest->second) {
+      oldest = iter;
+    }
+  }
+  entries_.erase(oldest);
+}
+
+}  // namespace net
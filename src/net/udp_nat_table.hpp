@@ -0,0 +1,78 @@
+// SPDX-License-Identifier: GPL-2.0
+/* Copyright (c) 2024 Chilledheart  */
+
+#ifndef H_NET_UDP_NAT_TABLE
+#define H_NET_UDP_NAT_TABLE
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+
+#include <absl/container/flat_hash_map.h>
+
+#include "net/asio.hpp"
+
+namespace net {
+
+/// Remembers the peers an udp association sends datagrams to, so only the
+/// datagrams from these peers are relayed back to the client, like an
+/// endpoint-dependent (port-restricted cone) NAT of RFC 4787.
+///
+/// A mapping is refreshed by the outgoing datagrams only and expires after
+/// the timeout without them. Expired mappings are dropped lazily by lookups
+/// and by a sweep at most once per timeout.
+class UdpNatTable {
+ public:
+  static constexpr size_t kDefaultMaxEntries = 1024;
+
+  /// \param timeout_ns the idle time (in nanoseconds) before a mapping expires
+  /// \param max_entries the mappings kept at most, the oldest one is evicted
+  explicit UdpNatTable(uint64_t timeout_ns, size_t max_entries = kDefaultMaxEntries);
+
+  /// a datagram is sent to the peer
+  ///
+  /// \param now the monotonic time in nanoseconds
+  void OnSend(const asio::ip::udp::endpoint& peer, uint64_t now);
+
+  /// a datagram is received from the peer
+  ///
+  /// \param now the monotonic time in nanoseconds
+  /// \return true if the peer is mapped, or the datagram should be dropped
+  bool OnReceive(const asio::ip::udp::endpoint& peer, uint64_t now);
+
+  /// drop the expired mappings
+  ///
+  /// \return the mappings dropped
+  size_t Expire(uint64_t now);
+
+  size_t size() const { return entries_.size(); }
+  bool empty() const { return entries_.empty(); }
+
+ private:
+  /// ipv4 addresses are stored as ipv4-mapped ipv6 addresses
+  struct Key {
+    asio::ip::address_v6::bytes_type address;
+    uint16_t port;
+
+    explicit Key(const asio::ip::udp::endpoint& endpoint);
+
+    bool operator==(const Key& other) const { return port == other.port && address == other.address; }
+
+    template <typename H>
+    friend H AbslHashValue(H h, const Key& key) {
+      return H::combine(H::combine_contiguous(std::move(h), key.address.data(), key.address.size()), key.port);
+    }
+  };
+
+  void EvictOldest();
+
+  const uint64_t timeout_ns_;
+  const size_t max_entries_;
+  uint64_t last_sweep_ = 0;
+  /// the time of the last datagram sent to the peer
+  absl::flat_hash_map<Key, uint64_t> entries_;
+};
+
+}  // namespace net
+
+#endif  // H_NET_UDP_NAT_TABLE
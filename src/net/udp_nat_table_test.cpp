@@ -0,0 +1,60 @@
+// SPDX-License-Identifier: GPL-2.0
+/* Copyright (c) 2024 Chilledheart  */
+
+#include <gtest/gtest-message.h>
+#include <gtest/gtest.h>
+
+#include "net/udp_nat_table.hpp"
+
+using namespace net;
+
+namespace {
+
+constexpr uint64_t kTimeout = 1000;
+
+asio::ip::udp::endpoint Endpoint(const char* address, uint16_t port) {
+  return asio::ip::udp::endpoint(asio::ip::make_address(address), port);
+}
+
+}  // namespace
+
+TEST(UdpNatTableTest, OnlyMappedPeers) {
+  UdpNatTable table(kTimeout);
+  table.OnSend(Endpoint("8.8.8.8", 53), 1);
+  EXPECT_TRUE(table.OnReceive(Endpoint("8.8.8.8", 53), 2));
+  // port-restricted
+  EXPECT_FALSE(table.OnReceive(Endpoint("8.8.8.8", 54), 2));
+  EXPECT_FALSE(table.OnReceive(Endpoint("8.8.4.4", 53), 2));
+  // ipv4-mapped addresses are the same peer
+  EXPECT_TRUE(table.OnReceive(Endpoint("::ffff:8.8.8.8", 53), 2));
+  EXPECT_EQ(1u, table.size());
+}
+
+TEST(UdpNatTableTest, Expire) {
+  UdpNatTable table(kTimeout);
+  table.OnSend(Endpoint("8.8.8.8", 53), 1);
+  table.OnSend(Endpoint("2001:db8::1", 443), 500);
+
+  // refreshed by outgoing datagrams only
+  EXPECT_TRUE(table.OnReceive(Endpoint("8.8.8.8", 53), 900));
+  EXPECT_FALSE(table.OnReceive(Endpoint("8.8.8.8", 53), 1001));
+  EXPECT_EQ(1u, table.size());
+
+  table.OnSend(Endpoint("2001:db8::1", 443), 1400);
+  EXPECT_TRUE(table.OnReceive(Endpoint("2001:db8::1", 443), 2000));
+  EXPECT_EQ(0u, table.Expire(2000));
+  EXPECT_EQ(1u, table.Expire(2400));
+  EXPECT_TRUE(table.empty());
+}
+
+TEST(UdpNatTableTest, EvictOldest) {
+  UdpNatTable table(kTimeout, 2);
+  table.OnSend(Endpoint("10.0.0.1", 1000), 1);
+  table.OnSend(Endpoint("10.0.0.2", 1000), 2);
+  table.OnSend(Endpoint("10.0.0.1", 1000), 3);
+  table.OnSend(Endpoint("10.0.0.3", 1000), 4);
+  EXPECT_EQ(2u, table.size());
+  EXPECT_TRUE(table.OnReceive(Endpoint("10.0.0.1", 1000), 5));
+  EXPECT_FALSE(table.OnReceive(Endpoint("10.0.0.2", 1000), 5));
+  EXPECT_TRUE(table.OnReceive(Endpoint("10.0.0.3", 1000), 5));
+}
@@ -0,0 +1,226 @@
+// SPDX-License-Identifier: GPL-2.0
+/* Copyright (c) 2024 Chilledheart  */
+
+#include "net/udp_over_tcp.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+#include "core/logging.hpp"
+#include "net/ss.hpp"
+
+namespace net {
+
+asio::ip::udp::endpoint UnmapUdpEndpoint(const asio::ip::udp::endpoint& endpoint) {
+  if (endpoint.address().is_v6() && endpoint.address().to_v6().is_v4_mapped()) {
+    return asio::ip::udp::endpoint(asio::ip::make_address_v4(asio::ip::v4_mapped, endpoint.address().to_v6()),
+                                   endpoint.port());
+  }
+  return endpoint;
+}
+
+size_t SerializeUdpAddress(const UdpAddress& address, uint8_t* out) {
+  uint8_t* p = out;
+  if (address.is_domain()) {
+    if (address.domain_name.size() > 255u) {
+      return 0;
+    }
+    *p++ = ss::domain;
+    *p++ = static_cast<uint8_t>(address.domain_name.size());
+    memcpy(p, address.domain_name.data(), address.domain_name.size());
+    p += address.domain_name.size();
+  } else {
+    asio::ip::udp::endpoint endpoint = UnmapUdpEndpoint(address.endpoint);
+    if (endpoint.address().is_v4()) {
+      auto bytes = endpoint.address().to_v4().to_bytes();
+      *p++ = ss::ipv4;
+      memcpy(p, bytes.data(), bytes.size());
+      p += bytes.size();
+    } else {
+      auto bytes = endpoint.address().to_v6().to_bytes();
+      *p++ = ss::ipv6;
+      memcpy(p, bytes.data(), bytes.size());
+      p += bytes.size();
+    }
+  }
+  *p++ = address.port >> 8;
+  *p++ = address.port & 0xff;
+  return p - out;
+}
+
+UdpParseResult ParseUdpAddress(const uint8_t* data, size_t length, UdpAddress* address, size_t* consumed) {
+  if (length < 1) {
+    return UdpParseResult::kIncomplete;
+  }
+  size_t address_length;
+  switch (data[0]) {
+    case ss::ipv4:
+      address_length = sizeof(asio::ip::address_v4::bytes_type);
+      break;
+    case ss::ipv6:
+      address_length = sizeof(asio::ip::address_v6::bytes_type);
+      break;
+    case ss::domain:
+      if (length < 2) {
+        return UdpParseResult::kIncomplete;
+      }
+      if (data[1] == 0) {
+        return UdpParseResult::kInvalid;
+      }
+      address_length = 1 + data[1];
+      break;
+    default:
+      return UdpParseResult::kInvalid;
+  }
+  if (length < 1 + address_length + 2) {
+    return UdpParseResult::kIncomplete;
+  }
+  const uint8_t* p = data + 1;
+  uint16_t port = (p[address_length] << 8) | p[address_length + 1];
+  switch (data[0]) {
+    case ss::ipv4: {
+      asio::ip::address_v4::bytes_type bytes;
+      memcpy(bytes.data(), p, bytes.size());
+      *address = UdpAddress(asio::ip::udp::endpoint(asio::ip::address_v4(bytes), port));
+      break;
+    }
+    case ss::ipv6: {
+      asio::ip::address_v6::bytes_type bytes;
+      memcpy(bytes.data(), p, bytes.size());
+      *address = UdpAddress(UnmapUdpEndpoint(asio::ip::udp::endpoint(asio::ip::address_v6(bytes), port)));
+      break;
+    }
+    case ss::domain:
+      *address = UdpAddress(std::string_view(reinterpret_cast<const char*>(p + 1), p[0]), port);
+      break;
+  }
+  *consumed = 1 + address_length + 2;
+  return UdpParseResult::kOk;
+}
+
+bool ParseSocks5UdpHeader(const uint8_t* data, size_t length, UdpAddress* address, size_t* header_length) {
+  // RSV and FRAG
+  if (length < 3 || data[0] != 0 || data[1] != 0) {
+    return false;
+  }
+  if (data[2] != 0) {
+    VLOG(2) << "socks5 udp: dropped fragment " << static_cast<int>(data[2]);
+    return false;
+  }
+  size_t consumed;
+  if (ParseUdpAddress(data + 3, length - 3, address, &consumed) != UdpParseResult::kOk) {
+    return false;
+  }
+  if (address->port == 0u) {
+    return false;
+  }
+  *header_length = 3 + consumed;
+  return true;
+}
+
+size_t SerializeSocks5UdpHeader(const asio::ip::udp::endpoint& endpoint, uint8_t* out) {
+  // RSV and FRAG
+  out[0] = 0;
+  out[1] = 0;
+  out[2] = 0;
+  return 3 + SerializeUdpAddress(UdpAddress(endpoint), out + 3);
+}
+
+size_t SerializeUdpOverTcpFrame(const UdpAddress& address, const uint8_t* data, size_t length, uint8_t* out) {
+  if (length > kMaxUdpPayloadLength) {
+    return 0;
+  }
+  uint8_t* p = out;
+  size_t address_length = SerializeUdpAddress(address, p);
+  if (!address_length) {
+    return 0;
+  }
+  p += address_length;
+  *p++ = length >> 8;
+  *p++ = length & 0xff;
+  memcpy(p, data, length);
+  return address_length + 2 + length;
+}
+
+bool AppendUdpOverTcpFrame(const UdpAddress& address, const uint8_t* data, size_t length, IOBuf* out) {
+  out->reserve(0, kMaxUdpAddressLength + 2 + length);
+  size_t frame_length = SerializeUdpOverTcpFrame(address, data, length, out->mutable_tail());
+  out->append(frame_length);
+  return frame_length != 0;
+}
+
+bool UdpOverTcpDecoder::Process(const uint8_t* data, size_t length, Visitor visitor) {
+  UdpAddress address;
+  size_t header_length;
+  if (!partial_.empty()) {
+    // complete the header first, then the rest of the frame, so the bytes
+    // after the frame are never copied
+    size_t old_size = partial_.size();
+    size_t copied = std::min(length, kMaxFrameHeaderLength - std::min(old_size, kMaxFrameHeaderLength));
+    partial_.insert(partial_.end(), data, data + copied);
+    int64_t frame_length = ParseFrame(partial_.data(), partial_.size(), &address, &header_length);
+    if (frame_length < 0) {
+      return false;
+    }
+    if (frame_length == 0) {
+      DCHECK_EQ(copied, length);
+      return true;
+    }
+    if (partial_.size() > static_cast<size_t>(frame_length)) {
+      copied -= partial_.size() - frame_length;
+      partial_.resize(frame_length);
+    }
+    size_t more = std::min<size_t>(frame_length - partial_.size(), length - copied);
+    partial_.insert(partial_.end(), data + copied, data + copied + more);
+    copied += more;
+    if (partial_.size() < static_cast<size_t>(frame_length)) {
+      DCHECK_EQ(copied, length);
+      return true;
+    }
+    visitor(address, partial_.data() + header_length, frame_length - header_length);
+    partial_.clear();
+    data += copied;
+    length -= copied;
+  }
+  while (length) {
+    int64_t frame_length = ParseFrame(data, length, &address, &header_length);
+    if (frame_length < 0) {
+      return false;
+    }
+    if (frame_length == 0 || static_cast<size_t>(frame_length) > length) {
+      partial_.assign(data, data + length);
+      break;
+    }
+    visitor(address, data + header_length, frame_length - header_length);
+    data += frame_length;
+    length -= frame_length;
+  }
+  return true;
+}
+
+// static
+int64_t UdpOverTcpDecoder::ParseFrame(const uint8_t* data,
+                                      size_t length,
+                                      UdpAddress* address,
+                                      size_t* header_length) {
+  size_t address_length;
+  switch (ParseUdpAddress(data, length, address, &address_length)) {
+    case UdpParseResult::kIncomplete:
+      return 0;
+    case UdpParseResult::kInvalid:
+      return -1;
+    case UdpParseResult::kOk:
+      break;
+  }
+  if (length < address_length + 2) {
+    return 0;
+  }
+  if (address->port == 0u) {
+    return -1;
+  }
+  size_t payload_length = (data[address_length] << 8) | data[address_length + 1];
+  *header_length = address_length + 2;
+  return *header_length + payload_length;
+}
+
+}  // namespace net
@@ -0,0 +1,142 @@
+// SPDX-License-Identifier: GPL-2.0
+/* Copyright (c) 2024 Chilledheart  */
+
+#ifndef H_NET_UDP_OVER_TCP
+#define H_NET_UDP_OVER_TCP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <absl/functional/function_ref.h>
+
+#include "net/asio.hpp"
+#include "net/iobuf.hpp"
+
+namespace net {
+
+/// the destination requested by the tunnels carrying udp datagrams, the same
+/// magic host used by UDP-over-TCP (version 1) of sing-box
+inline constexpr std::string_view kUdpOverTcpHost = "sp.udp-over-tcp.arpa";
+inline constexpr uint16_t kUdpOverTcpPort = 1;
+
+/// the address of a datagram, either an ip endpoint or a domain name
+struct UdpAddress {
+  /// the ip endpoint, valid if domain_name is empty
+  asio::ip::udp::endpoint endpoint;
+  /// the domain name, resolved by the server
+  std::string domain_name;
+  uint16_t port = 0;
+
+  UdpAddress() = default;
+  explicit UdpAddress(const asio::ip::udp::endpoint& endpoint) : endpoint(endpoint), port(endpoint.port()) {}
+  UdpAddress(std::string_view domain_name, uint16_t port) : domain_name(domain_name), port(port) {}
+
+  bool is_domain() const { return !domain_name.empty(); }
+};
+
+/// ATYP + the longest DST.ADDR (domain name) + DST.PORT
+inline constexpr size_t kMaxUdpAddressLength = 1 + 1 + 255 + 2;
+
+/// the largest payload of an ipv4/ipv6 datagram
+inline constexpr size_t kMaxUdpPayloadLength = 65535 - 8;
+
+/// IPv4-mapped IPv6 addresses (received by dual-stack sockets) are unmapped
+asio::ip::udp::endpoint UnmapUdpEndpoint(const asio::ip::udp::endpoint& endpoint);
+
+/// serialize the address in the socks5 layout
+///
+///    +------+----------+----------+
+///    | ATYP | DST.ADDR | DST.PORT |
+///    +------+----------+----------+
+///    |  1   | Variable |    2     |
+///    +------+----------+----------+
+///
+/// \param out at least kMaxUdpAddressLength bytes
+/// \return the bytes written, 0 if the domain name is too long
+size_t SerializeUdpAddress(const UdpAddress& address, uint8_t* out);
+
+enum class UdpParseResult {
+  kOk,
+  kIncomplete,
+  kInvalid,
+};
+
+/// parse the address in the socks5 layout
+///
+/// \param consumed the bytes of the address if kOk is returned
+UdpParseResult ParseUdpAddress(const uint8_t* data, size_t length, UdpAddress* address, size_t* consumed);
+
+/// parse the header of a datagram sent to the socks5 udp relay (RFC 1928 section 7)
+///
+///    +----+------+------+----------+----------+----------+
+///    |RSV | FRAG | ATYP | DST.ADDR | DST.PORT |   DATA   |
+///    +----+------+------+----------+----------+----------+
+///    | 2  |  1   |  1   | Variable |    2     | Variable |
+///    +----+------+------+----------+----------+----------+
+///
+/// Fragments are not supported, so datagrams with FRAG set are rejected.
+///
+/// \param header_length the bytes before DATA
+/// \return false if the header is malformed or fragmented
+bool ParseSocks5UdpHeader(const uint8_t* data, size_t length, UdpAddress* address, size_t* header_length);
+
+/// serialize the header of a datagram sent by the socks5 udp relay
+///
+/// \param out at least 3 + kMaxUdpAddressLength bytes
+/// \return the bytes written
+size_t SerializeSocks5UdpHeader(const asio::ip::udp::endpoint& endpoint, uint8_t* out);
+
+/// the bytes of the frame carrying the datagram, the header is up to
+/// kMaxUdpAddressLength + 2 bytes
+inline constexpr size_t kMaxUdpOverTcpFrameLength = kMaxUdpAddressLength + 2 + kMaxUdpPayloadLength;
+
+/// serialize a datagram in the byte stream of the tunnel
+///
+///    +------+----------+----------+--------+----------+
+///    | ATYP | DST.ADDR | DST.PORT | LENGTH |   DATA   |
+///    +------+----------+----------+--------+----------+
+///    |  1   | Variable |    2     |   2    | Variable |
+///    +------+----------+----------+--------+----------+
+///
+/// \param out at least kMaxUdpAddressLength + 2 + length bytes
+/// \return the bytes written, 0 if the address or the payload can't be framed
+size_t SerializeUdpOverTcpFrame(const UdpAddress& address, const uint8_t* data, size_t length, uint8_t* out);
+
+/// append a datagram to the byte stream of the tunnel, see SerializeUdpOverTcpFrame
+///
+/// \return false if the address or the payload can't be framed
+bool AppendUdpOverTcpFrame(const UdpAddress& address, const uint8_t* data, size_t length, IOBuf* out);
+
+/// Splits the byte stream of a tunnel into the datagrams it carries, the
+/// frames might be split at any byte by the underlying transport.
+class UdpOverTcpDecoder {
+ public:
+  using Visitor = absl::FunctionRef<void(const UdpAddress& address, const uint8_t* data, size_t length)>;
+
+  /// consume the bytes and call visitor on every complete datagram
+  ///
+  /// \return false if the stream is malformed
+  bool Process(const uint8_t* data, size_t length, Visitor visitor);
+
+  /// the bytes of the incomplete frame kept
+  size_t pending_bytes() const { return partial_.size(); }
+
+ private:
+  /// ATYP + DST.ADDR + DST.PORT + LENGTH
+  static constexpr size_t kMaxFrameHeaderLength = kMaxUdpAddressLength + 2;
+
+  /// parse the header of a frame
+  ///
+  /// \return the bytes of the whole frame (which might be more than length),
+  ///         0 if the header is incomplete, -1 if malformed
+  static int64_t ParseFrame(const uint8_t* data, size_t length, UdpAddress* address, size_t* header_length);
+
+  std::vector<uint8_t> partial_;
+};
+
+}  // namespace net
+
+#endif  // H_NET_UDP_OVER_TCP
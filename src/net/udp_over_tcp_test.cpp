@@ -0,0 +1,139 @@
+// SPDX-License-Identifier: GPL-2.0
+/* Copyright (c) 2024 Chilledheart  */
+
+#include <gtest/gtest-message.h>
+#include <gtest/gtest.h>
+
+#include <string>
+#include <vector>
+
+#include "net/udp_over_tcp.hpp"
+
+using namespace net;
+
+namespace {
+
+struct Datagram {
+  UdpAddress address;
+  std::string payload;
+};
+
+std::vector<Datagram> TestDatagrams() {
+  std::vector<Datagram> datagrams;
+  datagrams.push_back({UdpAddress(asio::ip::udp::endpoint(asio::ip::make_address("127.0.0.1"), 53)), "hello"});
+  datagrams.push_back({UdpAddress(asio::ip::udp::endpoint(asio::ip::make_address("::1"), 443)), std::string(1500, 'x')});
+  datagrams.push_back({UdpAddress("www.example.com", 8443), ""});
+  datagrams.push_back({UdpAddress(asio::ip::udp::endpoint(asio::ip::make_address("10.0.0.1"), 65535)), "world"});
+  return datagrams;
+}
+
+std::shared_ptr<IOBuf> Encode(const std::vector<Datagram>& datagrams) {
+  auto buf = IOBuf::create(0);
+  for (const auto& datagram : datagrams) {
+    EXPECT_TRUE(AppendUdpOverTcpFrame(datagram.address,
+                                      reinterpret_cast<const uint8_t*>(datagram.payload.data()),
+                                      datagram.payload.size(), buf.get()));
+  }
+  return buf;
+}
+
+void ExpectDatagrams(const std::vector<Datagram>& expected, const std::vector<Datagram>& decoded) {
+  ASSERT_EQ(expected.size(), decoded.size());
+  for (size_t i = 0; i < expected.size(); ++i) {
+    EXPECT_EQ(expected[i].address.is_domain(), decoded[i].address.is_domain());
+    EXPECT_EQ(expected[i].address.domain_name, decoded[i].address.domain_name);
+    EXPECT_EQ(expected[i].address.port, decoded[i].address.port);
+    if (!expected[i].address.is_domain()) {
+      EXPECT_EQ(expected[i].address.endpoint, decoded[i].address.endpoint);
+    }
+    EXPECT_EQ(expected[i].payload, decoded[i].payload);
+  }
+}
+
+}  // namespace
+
+TEST(UdpOverTcpTest, DecodeWhole) {
+  auto datagrams = TestDatagrams();
+  auto buf = Encode(datagrams);
+
+  std::vector<Datagram> decoded;
+  UdpOverTcpDecoder decoder;
+  ASSERT_TRUE(decoder.Process(buf->data(), buf->length(), [&](const UdpAddress& address, const uint8_t* data,
+                                                              size_t length) {
+    decoded.push_back({address, std::string(reinterpret_cast<const char*>(data), length)});
+  }));
+  EXPECT_EQ(0u, decoder.pending_bytes());
+  ExpectDatagrams(datagrams, decoded);
+}
+
+TEST(UdpOverTcpTest, DecodeByteByByte) {
+  auto datagrams = TestDatagrams();
+  auto buf = Encode(datagrams);
+
+  std::vector<Datagram> decoded;
+  UdpOverTcpDecoder decoder;
+  for (size_t i = 0; i < buf->length(); ++i) {
+    ASSERT_TRUE(decoder.Process(buf->data() + i, 1, [&](const UdpAddress& address, const uint8_t* data,
+                                                        size_t length) {
+      decoded.push_back({address, std::string(reinterpret_cast<const char*>(data), length)});
+    }));
+  }
+  EXPECT_EQ(0u, decoder.pending_bytes());
+  ExpectDatagrams(datagrams, decoded);
+}
+
+TEST(UdpOverTcpTest, DecodeMalformed) {
+  // unknown ATYP
+  const uint8_t bad_atyp[] = {0x05, 127, 0, 0, 1, 0, 53, 0, 1, 'x'};
+  UdpOverTcpDecoder decoder;
+  EXPECT_FALSE(decoder.Process(bad_atyp, sizeof(bad_atyp), [](const UdpAddress&, const uint8_t*, size_t) {
+    ADD_FAILURE() << "unexpected datagram";
+  }));
+
+  // port 0
+  const uint8_t zero_port[] = {0x01, 127, 0, 0, 1, 0, 0, 0, 1, 'x'};
+  UdpOverTcpDecoder zero_port_decoder;
+  EXPECT_FALSE(zero_port_decoder.Process(zero_port, sizeof(zero_port), [](const UdpAddress&, const uint8_t*, size_t) {
+    ADD_FAILURE() << "unexpected datagram";
+  }));
+}
+
+TEST(UdpOverTcpTest, SerializeLongDomainName) {
+  uint8_t out[kMaxUdpAddressLength + 2 + 1];
+  const uint8_t payload[] = {'x'};
+  EXPECT_EQ(0u, SerializeUdpOverTcpFrame(UdpAddress(std::string(256, 'a'), 80), payload, sizeof(payload), out));
+  EXPECT_NE(0u, SerializeUdpOverTcpFrame(UdpAddress(std::string(255, 'a'), 80), payload, sizeof(payload), out));
+}
+
+TEST(UdpOverTcpTest, Socks5UdpHeader) {
+  asio::ip::udp::endpoint endpoint(asio::ip::make_address("192.168.1.1"), 5353);
+  uint8_t datagram[3 + kMaxUdpAddressLength + 4];
+  size_t written = SerializeSocks5UdpHeader(endpoint, datagram);
+  ASSERT_EQ(3u + 1u + 4u + 2u, written);
+  memcpy(datagram + written, "ping", 4);
+
+  UdpAddress address;
+  size_t header_length;
+  ASSERT_TRUE(ParseSocks5UdpHeader(datagram, written + 4, &address, &header_length));
+  EXPECT_EQ(written, header_length);
+  EXPECT_FALSE(address.is_domain());
+  EXPECT_EQ(endpoint, address.endpoint);
+
+  // fragmented
+  datagram[2] = 1;
+  EXPECT_FALSE(ParseSocks5UdpHeader(datagram, written + 4, &address, &header_length));
+  datagram[2] = 0;
+
+  // truncated
+  EXPECT_FALSE(ParseSocks5UdpHeader(datagram, written - 1, &address, &header_length));
+}
+
+TEST(UdpOverTcpTest, UnmapEndpoint) {
+  asio::ip::udp::endpoint mapped(asio::ip::make_address("::ffff:127.0.0.1"), 53);
+  asio::ip::udp::endpoint unmapped = UnmapUdpEndpoint(mapped);
+  EXPECT_TRUE(unmapped.address().is_v4());
+  EXPECT_EQ(asio::ip::udp::endpoint(asio::ip::make_address("127.0.0.1"), 53), unmapped);
+
+  asio::ip::udp::endpoint v6(asio::ip::make_address("::1"), 53);
+  EXPECT_EQ(v6, UnmapUdpEndpoint(v6));
+}
@@ -0,0 +1,317 @@
+// SPDX-License-Identifier: GPL-2.0
+/* Copyright (c) 2024 Chilledheart  */
+
+#include "net/udp_stream.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+namespace net {
+
+namespace {
+
+/// datagrams to domain names queued while resolving, dropped beyond
+constexpr size_t kMaxUnresolvedDatagrams = 64;
+
+/// domain names resolved by an association, forgotten all at once beyond
+constexpr size_t kMaxResolvedNames = 64;
+
+}  // namespace
+
+udp_stream::udp_stream(asio::io_context& io_context, Channel* channel)
+    : stream(io_context, std::string(), std::string(kUdpOverTcpHost), kUdpOverTcpPort, channel),
+      udp_socket_(io_context),
+      nat_table_(static_cast<uint64_t>(absl::GetFlag(FLAGS_udp_timeout)) * NS_PER_SECOND),
+      udp_resolver_(io_context) {}
+
+udp_stream::~udp_stream() = default;
+
+void udp_stream::async_connect(handle_t callback) {
+  DCHECK_EQ(closed_, false);
+  DCHECK(callback);
+  user_connect_callback_ = std::move(callback);
+
+  // a dual-stack socket reaches both ipv4 and ipv6 peers
+  asio::error_code ec;
+  udp_socket_.open(asio::ip::udp::v6(), ec);
+  if (!ec) {
+    udp_socket_.set_option(asio::ip::v6_only(false), ec);
+    if (ec) {
+      asio::error_code close_ec;
+      udp_socket_.close(close_ec);
+    }
+  }
+  dual_stack_ = !ec;
+  if (!dual_stack_) {
+    udp_socket_.open(asio::ip::udp::v4(), ec);
+  }
+  if (!ec) {
+    udp_socket_.non_blocking(true, ec);
+  }
+  if (!ec) {
+    udp_socket_.bind(asio::ip::udp::endpoint(dual_stack_ ? asio::ip::udp::v6() : asio::ip::udp::v4(), 0), ec);
+  }
+  if (ec) {
+    LOG(WARNING) << "udp: failed to open socket: " << ec;
+    closed_ = true;
+    on_async_connect_callback(ec);
+    return;
+  }
+#ifdef __OHOS__
+  setProtectFd(udp_socket_.native_handle());
+#endif
+  SetUdpReceiveOffload(&udp_socket_);
+  process_stats().Add(Stats::kUdpAssociations);
+
+  // the callback is not expected to be called inside async_connect
+  scoped_refptr<stream> self(this);
+  asio::post(io_context_, [this, self]() {
+    if (closed_) {
+      DCHECK(!user_connect_callback_);
+      return;
+    }
+    connected_ = true;
+    on_async_connect_callback(asio::error_code());
+  });
+}
+
+void udp_stream::s_wait_read(handle_t&& cb) {
+  if (!pending_read_.empty()) {
+    asio::post(io_context_, [cb = std::move(cb)]() mutable { cb(asio::error_code()); });
+    return;
+  }
+  udp_socket_.async_wait(asio::ip::udp::socket::wait_read, std::move(cb));
+}
+
+size_t udp_stream::s_read_some(std::shared_ptr<IOBuf> buf, asio::error_code& ec) {
+  ec = asio::error_code();
+  uint8_t* out = buf->mutable_tail();
+  size_t read = 0;
+
+  if (pending_read_.empty()) {
+    uint64_t now = GetMonotonicTime();
+    size_t dropped = 0;
+    size_t received = ReceiveUdpPackets(
+        &udp_socket_,
+        [&](const asio::ip::udp::endpoint& peer, const uint8_t* data, size_t length) {
+          asio::ip::udp::endpoint endpoint = UnmapUdpEndpoint(peer);
+          if (!nat_table_.OnReceive(endpoint, now)) {
+            VLOG(2) << "udp: dropped datagram from unexpected peer " << endpoint;
+            ++dropped;
+            return;
+          }
+          // frame into the read buffer directly unless it is full
+          UdpAddress address(endpoint);
+          if (pending_read_.empty() && buf->tailroom() - read >= kMaxUdpAddressLength + 2 + length) {
+            read += SerializeUdpOverTcpFrame(address, data, length, out + read);
+          } else {
+            AppendUdpOverTcpFrame(address, data, length, &pending_read_);
+          }
+        },
+        ec);
+    process_stats().Add(Stats::kUdpDatagramsReceived, received);
+    process_stats().Add(Stats::kUdpDatagramsDropped, dropped);
+    if (ec == asio::error::would_block || ec == asio::error::try_again) {
+      ec = asio::error_code();
+    }
+    if (ec) {
+      return read;
+    }
+  }
+
+  if (!pending_read_.empty()) {
+    size_t copied = std::min(buf->tailroom() - read, pending_read_.length());
+    memcpy(out + read, pending_read_.data(), copied);
+    pending_read_.trimStart(copied);
+    if (pending_read_.empty()) {
+      pending_read_.clear();
+    }
+    read += copied;
+  }
+
+  if (!read) {
+    ec = asio::error::try_again;
+  }
+  return read;
+}
+
+void udp_stream::s_wait_write(handle_t&& cb) {
+  udp_socket_.async_wait(asio::ip::udp::socket::wait_write, std::move(cb));
+}
+
+size_t udp_stream::s_write_some(std::shared_ptr<IOBuf> buf, asio::error_code& ec) {
+  ec = asio::error_code();
+  std::vector<UdpPacket> packets;
+  const uint8_t* begin = buf->data();
+  const uint8_t* end = buf->data() + buf->length();
+  bool ok = decoder_.Process(buf->data(), buf->length(), [&](const UdpAddress& address, const uint8_t* data,
+                                                             size_t length) {
+    UdpPacket packet;
+    packet.data = data;
+    packet.length = length;
+    if (address.is_domain()) {
+      auto iter = resolved_.find(address.domain_name);
+      if (iter == resolved_.end()) {
+        if (unresolved_.size() >= kMaxUnresolvedDatagrams) {
+          VLOG(2) << "udp: dropped datagram to " << address.domain_name << ": too many pending resolutions";
+          process_stats().Add(Stats::kUdpDatagramsDropped);
+          return;
+        }
+        unresolved_.push_back({address.domain_name, address.port, std::vector<uint8_t>(data, data + length)});
+        return;
+      }
+      packet.endpoint = asio::ip::udp::endpoint(iter->second, address.port);
+    } else {
+      packet.endpoint = address.endpoint;
+    }
+    packets.push_back(packet);
+    // the frame completed from the bytes kept by decoder is gone after the call
+    if (data < begin || data >= end) {
+      SendPackets(&packets, ec);
+    }
+  });
+  if (!ok) {
+    LOG(WARNING) << "udp: malformed datagram frames";
+    ec = asio::error::invalid_argument;
+    return 0;
+  }
+  if (!ec) {
+    SendPackets(&packets, ec);
+  }
+  if (ec) {
+    return 0;
+  }
+  ResolveNext();
+  return buf->length();
+}
+
+void udp_stream::s_close(asio::error_code& ec) {
+  udp_resolver_.Cancel();
+  unresolved_.clear();
+  udp_socket_.close(ec);
+}
+
+bool udp_stream::MapEndpoint(asio::ip::udp::endpoint* endpoint) const {
+  const asio::ip::address& address = endpoint->address();
+  if (address.is_unspecified() || address.is_multicast() || endpoint->port() == 0u) {
+    return false;
+  }
+  if (address.is_v4()) {
+    if (address.to_v4() == asio::ip::address_v4::broadcast()) {
+      return false;
+    }
+    if (dual_stack_) {
+      endpoint->address(asio::ip::make_address_v6(asio::ip::v4_mapped, address.to_v4()));
+    }
+    return true;
+  }
+  return dual_stack_;
+}
+
+void udp_stream::SendPackets(std::vector<UdpPacket>* packets, asio::error_code& ec) {
+  uint64_t now = GetMonotonicTime();
+  size_t count = 0;
+  for (UdpPacket& packet : *packets) {
+    asio::ip::udp::endpoint peer = packet.endpoint;
+    if (!MapEndpoint(&packet.endpoint)) {
+      VLOG(2) << "udp: dropped datagram to " << peer;
+      process_stats().Add(Stats::kUdpDatagramsDropped);
+      continue;
+    }
+    nat_table_.OnSend(peer, now);
+    (*packets)[count++] = packet;
+  }
+
+  size_t sent = 0;
+  while (sent < count) {
+    sent += SendUdpPackets(&udp_socket_, packets->data() + sent, count - sent, ec);
+    if (ec) {
+      break;
+    }
+  }
+  process_stats().Add(Stats::kUdpDatagramsSent, sent);
+  // like a congested link, drop what the socket buffer can't take
+  if (ec == asio::error::would_block || ec == asio::error::try_again) {
+    VLOG(2) << "udp: dropped " << count - sent << " datagram(s): socket buffer is full";
+    process_stats().Add(Stats::kUdpDatagramsDropped, count - sent);
+    ec = asio::error_code();
+  }
+  packets->clear();
+}
+
+void udp_stream::ResolveNext() {
+  if (resolving_ || unresolved_.empty() || closed_) {
+    return;
+  }
+  int ret = udp_resolver_.Init();
+  if (ret < 0) {
+    LOG(WARNING) << "resolver initialize failure";
+    process_stats().Add(Stats::kUdpDatagramsDropped, unresolved_.size());
+    unresolved_.clear();
+    return;
+  }
+  resolving_ = true;
+  std::string domain_name = unresolved_.front().domain_name;
+  uint16_t port = unresolved_.front().port;
+  scoped_refptr<stream> self(this);
+  process_stats().Add(Stats::kDnsLookups);
+  udp_resolver_.AsyncResolve(
+      domain_name, port,
+      [this, self, domain_name](const asio::error_code& ec, asio::ip::tcp::resolver::results_type results) {
+        // Cancelled, safe to ignore
+        if (UNLIKELY(ec == asio::error::operation_aborted)) {
+          return;
+        }
+        if (closed_) {
+          return;
+        }
+        OnResolved(domain_name, ec, results);
+      });
+}
+
+void udp_stream::OnResolved(const std::string& domain_name,
+                            asio::error_code ec,
+                            const asio::ip::tcp::resolver::results_type& results) {
+  udp_resolver_.Reset();
+  resolving_ = false;
+
+  asio::ip::address address;
+  if (!ec && !results.empty()) {
+    address = results.begin()->endpoint().address();
+    VLOG(2) << "udp: resolved domain name " << domain_name << " to " << address;
+    if (resolved_.size() >= kMaxResolvedNames) {
+      resolved_.clear();
+    }
+    resolved_[domain_name] = address;
+  } else {
+    VLOG(1) << "udp: failed to resolve domain name " << domain_name << ": " << ec;
+  }
+
+  // send (or drop) the datagrams to the domain name in order
+  std::vector<UdpPacket> packets;
+  std::deque<UnresolvedDatagram> unresolved;
+  unresolved.swap(unresolved_);
+  for (UnresolvedDatagram& datagram : unresolved) {
+    if (datagram.domain_name != domain_name) {
+      unresolved_.push_back(std::move(datagram));
+      continue;
+    }
+    if (address.is_unspecified()) {
+      process_stats().Add(Stats::kUdpDatagramsDropped);
+      continue;
+    }
+    UdpPacket packet;
+    packet.endpoint = asio::ip::udp::endpoint(address, datagram.port);
+    packet.data = datagram.payload.data();
+    packet.length = datagram.payload.size();
+    packets.push_back(packet);
+  }
+  SendPackets(&packets, ec);
+  if (ec) {
+    VLOG(1) << "udp: failed to send datagrams: " << ec;
+  }
+
+  ResolveNext();
+}
+
+}  // namespace net
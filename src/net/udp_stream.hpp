@@ -0,0 +1,104 @@
+// SPDX-License-Identifier: GPL-2.0
+/* Copyright (c) 2024 Chilledheart  */
+
+#ifndef H_NET_UDP_STREAM
+#define H_NET_UDP_STREAM
+
+#include <deque>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <absl/container/flat_hash_map.h>
+
+#include "net/stream.hpp"
+#include "net/udp_batch.hpp"
+#include "net/udp_nat_table.hpp"
+#include "net/udp_over_tcp.hpp"
+
+namespace net {
+
+/// the class to relay the udp datagrams carried by a tunnel
+///
+/// The tunnel requests kUdpOverTcpHost instead of an origin, the bytes
+/// written are the datagrams framed by the client (see udp_over_tcp.hpp)
+/// which are sent to their destinations, and the bytes read are the datagrams
+/// received from the peers the client sent to (see UdpNatTable), framed the
+/// same way.
+///
+/// Datagrams are never queued for the socket buffer: like a congested link,
+/// the ones the kernel doesn't accept are dropped.
+class udp_stream : public stream {
+ public:
+  /// construct a udp_stream object
+  template <typename... Args>
+  static scoped_refptr<udp_stream> create(Args&&... args) {
+    return gurl_base::MakeRefCounted<udp_stream>(std::forward<Args>(args)...);
+  }
+
+  /// construct a udp stream object
+  ///
+  /// \param io_context the io context associated with the service
+  /// \param channel the underlying data channel used in stream
+  udp_stream(asio::io_context& io_context, Channel* channel);
+
+  ~udp_stream() override;
+
+  /// open the udp socket, there is nothing to resolve or connect
+  void async_connect(handle_t callback) override;
+
+ protected:
+  void s_wait_read(handle_t&& cb) override;
+
+  size_t s_read_some(std::shared_ptr<IOBuf> buf, asio::error_code& ec) override;
+
+  void s_wait_write(handle_t&& cb) override;
+
+  size_t s_write_some(std::shared_ptr<IOBuf> buf, asio::error_code& ec) override;
+
+  /// the client's eof closes the tunnel instead
+  void s_async_shutdown(handle_t&& cb) override { cb(asio::error_code()); }
+
+  void s_shutdown(asio::error_code& ec) override { ec = asio::error_code(); }
+
+  void s_close(asio::error_code& ec) override;
+
+ private:
+  /// the datagram (to a domain name) waiting for name resolution
+  struct UnresolvedDatagram {
+    std::string domain_name;
+    uint16_t port;
+    std::vector<uint8_t> payload;
+  };
+
+  /// the udp socket accepts the endpoint (ipv4-mapped for dual-stack sockets)
+  bool MapEndpoint(asio::ip::udp::endpoint* endpoint) const;
+
+  /// send the datagrams (and count them into the nat table)
+  void SendPackets(std::vector<UdpPacket>* packets, asio::error_code& ec);
+
+  /// resolve the domain name of the first unresolved datagram
+  void ResolveNext();
+
+  void OnResolved(const std::string& domain_name,
+                  asio::error_code ec,
+                  const asio::ip::tcp::resolver::results_type& results);
+
+  asio::ip::udp::socket udp_socket_;
+  bool dual_stack_ = false;
+
+  UdpOverTcpDecoder decoder_;
+  UdpNatTable nat_table_;
+  /// framed datagrams received but not fit in the read buffer
+  IOBuf pending_read_;
+
+  /// used to resolve the domain names, one at a time
+  net::Resolver udp_resolver_;
+  bool resolving_ = false;
+  std::deque<UnresolvedDatagram> unresolved_;
+  absl::flat_hash_map<std::string, asio::ip::address> resolved_;
+};
+
+}  // namespace net
+
+#endif  // H_NET_UDP_STREAM
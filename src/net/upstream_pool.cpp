@@ -0,0 +1,237 @@
+// SPDX-License-Identifier: GPL-2.0
+/* Copyright (c) 2024 Chilledheart  */
+
+#include "net/upstream_pool.hpp"
+
+#include <absl/strings/ascii.h>
+#include <absl/strings/numbers.h>
+#include <absl/strings/str_cat.h>
+#include <absl/strings/str_split.h>
+#include <algorithm>
+
+#include "core/logging.hpp"
+
+namespace net {
+
+namespace {
+
+bool SameConfig(const UpstreamServer::Config& a, const UpstreamServer::Config& b) {
+  return a.host == b.host && a.port == b.port && a.username == b.username && a.password == b.password;
+}
+
+uint64_t Smooth(uint64_t value, uint64_t sample) {
+  if (!value) {
+    return sample;
+  }
+  return static_cast<uint64_t>(value * (1 - UpstreamServer::kEwmaWeight) + sample * UpstreamServer::kEwmaWeight);
+}
+
+}  // namespace
+
+double UpstreamServer::Cost() const {
+  // the round trip time of the live tunnels only raises the estimate, as the
+  // handshakes take more than one round trip
+  uint64_t latency = std::max(handshake_latency_, srtt_);
+  if (!latency) {
+    latency = kInitialLatency;
+  }
+  return static_cast<double>(latency) * (active_ + 1) / std::max(1 - error_rate_, 0.1);
+}
+
+void UpstreamServer::OnPicked(uint64_t now) {
+  if (backoff_ && !ejected(now) && !trial_pending(now)) {
+    trial_started_ = now;
+  }
+}
+
+void UpstreamServer::OnTunnelClosed() {
+  DCHECK_GT(active_, 0u);
+  --active_;
+}
+
+void UpstreamServer::OnConnected(uint64_t latency) {
+  handshake_latency_ = Smooth(handshake_latency_, std::max<uint64_t>(latency, 1));
+  error_rate_ *= 1 - kEwmaWeight;
+  consecutive_failures_ = 0;
+  backoff_ = 0;
+  ejected_until_ = 0;
+  trial_started_ = 0;
+}
+
+void UpstreamServer::OnConnectFailed(uint64_t started, uint64_t now) {
+  error_rate_ = error_rate_ * (1 - kEwmaWeight) + kEwmaWeight;
+  // the tunnels started before the ejection ended, even if failing after it,
+  // neither extend the ejection nor count as the trial
+  if (started < ejected_until_) {
+    return;
+  }
+  if (++consecutive_failures_ < kMaxConsecutiveFailures) {
+    return;
+  }
+  // the trial after the ejection failed, eject it again for longer
+  trial_started_ = 0;
+  backoff_ = backoff_ ? std::min(backoff_ * 2, kMaxBackoff) : kMinBackoff;
+  ejected_until_ = now + backoff_;
+  LOG(WARNING) << "upstream: " << host() << ":" << port() << " ejected for " << backoff_ / 1000 / 1000 << " ms after "
+               << consecutive_failures_ << " failures";
+}
+
+void UpstreamServer::OnRttSample(uint64_t rtt) {
+  srtt_ = Smooth(srtt_, std::max<uint64_t>(rtt, 1));
+}
+
+asio::execution_context::id UpstreamPool::id;
+
+UpstreamPool::UpstreamPool(asio::io_context& io_context) : asio::execution_context::service(io_context) {}
+
+UpstreamPool::~UpstreamPool() = default;
+
+// static
+bool UpstreamPool::ParseServerList(std::string_view list,
+                                   uint16_t default_port,
+                                   std::vector<UpstreamServer::Config>* configs,
+                                   std::string* err) {
+  configs->clear();
+  for (std::string_view item : absl::StrSplit(list, ',', absl::SkipWhitespace())) {
+    std::string_view entry = absl::StripAsciiWhitespace(item);
+    UpstreamServer::Config config;
+    config.port = default_port;
+
+    size_t at = entry.rfind('@');
+    if (at != std::string_view::npos) {
+      std::string_view credentials = entry.substr(0, at);
+      size_t colon = credentials.find(':');
+      if (colon == std::string_view::npos) {
+        *err = absl::StrCat("bad credentials of server: ", entry);
+        return false;
+      }
+      config.username = std::string(credentials.substr(0, colon));
+      config.password = std::string(credentials.substr(colon + 1));
+      entry = entry.substr(at + 1);
+    }
+
+    std::string_view host = entry;
+    std::string_view port;
+    bool has_port = false;
+    if (!entry.empty() && entry.front() == '[') {
+      // ipv6 literal
+      size_t end = entry.find(']');
+      if (end == std::string_view::npos || (end + 1 < entry.size() && entry[end + 1] != ':')) {
+        *err = absl::StrCat("bad server: ", entry);
+        return false;
+      }
+      host = entry.substr(1, end - 1);
+      if (end + 1 < entry.size()) {
+        has_port = true;
+        port = entry.substr(end + 2);
+      }
+    } else if (size_t colon = entry.rfind(':'); colon != std::string_view::npos) {
+      if (entry.find(':') != colon) {
+        *err = absl::StrCat("ipv6 server requires brackets: ", entry);
+        return false;
+      }
+      host = entry.substr(0, colon);
+      has_port = true;
+      port = entry.substr(colon + 1);
+    }
+    int port_number;
+    if (has_port) {
+      if (!absl::SimpleAtoi(port, &port_number) || port_number <= 0 || port_number > 65535) {
+        *err = absl::StrCat("bad port of server: ", entry);
+        return false;
+      }
+      config.port = port_number;
+    }
+    if (host.empty() || host.size() > 255 || config.port == 0) {
+      *err = absl::StrCat("bad server: ", entry);
+      return false;
+    }
+    config.host = std::string(host);
+    configs->push_back(std::move(config));
+  }
+  return true;
+}
+
+bool UpstreamPool::Configure(const UpstreamServer::Config& primary, std::string_view server_list, std::string* err) {
+  std::vector<UpstreamServer::Config> configs;
+  if (!ParseServerList(server_list, primary.port, &configs, err)) {
+    return false;
+  }
+
+  std::vector<std::shared_ptr<UpstreamServer>> servers;
+  servers.reserve(configs.size() + 1);
+  if (!servers_.empty() && servers_.front()->primary() && SameConfig(servers_.front()->config(), primary)) {
+    servers.push_back(servers_.front());
+  } else {
+    servers.push_back(std::make_shared<UpstreamServer>(primary, true));
+  }
+  for (auto& config : configs) {
+    auto it = std::find_if(servers_.begin(), servers_.end(), [&](const std::shared_ptr<UpstreamServer>& server) {
+      return !server->primary() && SameConfig(server->config(), config) &&
+             std::find(servers.begin(), servers.end(), server) == servers.end();
+    });
+    if (it != servers_.end()) {
+      servers.push_back(*it);
+    } else {
+      servers.push_back(std::make_shared<UpstreamServer>(std::move(config)));
+    }
+  }
+  servers_ = std::move(servers);
+  if (servers_.size() > 1) {
+    LOG(INFO) << "upstream: balancing the tunnels across " << servers_.size() << " servers";
+  }
+  return true;
+}
+
+std::shared_ptr<UpstreamServer> UpstreamPool::Pick(uint64_t now, const UpstreamServer* exclude) {
+  std::shared_ptr<UpstreamServer> server = PickServer(now, exclude);
+  if (server) {
+    server->OnPicked(now);
+  }
+  return server;
+}
+
+std::shared_ptr<UpstreamServer> UpstreamPool::PickServer(uint64_t now, const UpstreamServer* exclude) {
+  if (servers_.size() <= 1) {
+    return servers_.empty() ? nullptr : servers_.front();
+  }
+  auto eligible = [&](const std::shared_ptr<UpstreamServer>& server) {
+    return server.get() != exclude && !server->ejected(now) && !server->trial_pending(now);
+  };
+  size_t candidates = std::count_if(servers_.begin(), servers_.end(), eligible);
+  if (!candidates) {
+    // all ejected or on trial, try the one back the soonest
+    std::shared_ptr<UpstreamServer> soonest;
+    for (const auto& server : servers_) {
+      if (server.get() != exclude && (!soonest || server->ejected_until() < soonest->ejected_until())) {
+        soonest = server;
+      }
+    }
+    return soonest;
+  }
+  auto nth = [&](size_t n) -> const std::shared_ptr<UpstreamServer>& {
+    for (const auto& server : servers_) {
+      if (eligible(server) && n-- == 0) {
+        return server;
+      }
+    }
+    return servers_.front();
+  };
+  if (candidates == 1) {
+    return nth(0);
+  }
+  size_t first = random_() % candidates;
+  size_t second = random_() % (candidates - 1);
+  if (second >= first) {
+    ++second;
+  }
+  const auto& a = nth(first);
+  const auto& b = nth(second);
+  return a->Cost() <= b->Cost() ? a : b;
+}
+
+void UpstreamPool::shutdown() {
+  servers_.clear();
+}
+
+}  // namespace net
@@ -0,0 +1,180 @@
+// SPDX-License-Identifier: GPL-2.0
+/* Copyright (c) 2024 Chilledheart  */
+
+#ifndef H_NET_UPSTREAM_POOL
+#define H_NET_UPSTREAM_POOL
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "net/asio.hpp"
+
+namespace net {
+
+/// An upstream server the tunnels are balanced across, with the health
+/// measured from the tunnels through it.
+///
+/// It must be used from the thread running the io context only.
+class UpstreamServer {
+ public:
+  struct Config {
+    std::string host;
+    uint16_t port = 0;
+    /// the credentials of --username and --password are used if empty
+    std::string username;
+    std::string password;
+  };
+
+  /// the weight of a new sample in the smoothed values
+  static constexpr double kEwmaWeight = 1.0 / 8;
+  /// the latency assumed before the first sample (in nanoseconds)
+  static constexpr uint64_t kInitialLatency = 1000 * 1000;
+  /// the server is ejected after so many connect failures in a row
+  static constexpr uint32_t kMaxConsecutiveFailures = 3;
+  /// the ejection time, doubled on each ejection in a row (in nanoseconds)
+  static constexpr uint64_t kMinBackoff = 1000ull * 1000 * 1000;
+  static constexpr uint64_t kMaxBackoff = 60ull * 1000 * 1000 * 1000;
+  /// the trial tunnel after an ejection is given up after (in nanoseconds),
+  /// e.g. closed by the client before connected
+  static constexpr uint64_t kTrialTimeout = 30ull * 1000 * 1000 * 1000;
+
+  explicit UpstreamServer(Config config, bool primary = false) : config_(std::move(config)), primary_(primary) {}
+
+  const std::string& host() const { return config_.host; }
+  uint16_t port() const { return config_.port; }
+  const std::string& username() const { return config_.username; }
+  const std::string& password() const { return config_.password; }
+  bool has_credentials() const { return !config_.username.empty() || !config_.password.empty(); }
+  const Config& config() const { return config_; }
+
+  /// whether it is the server of --server_host, which is connected by the
+  /// addresses resolved ahead
+  bool primary() const { return primary_; }
+
+  /// the smoothed round trip time (in nanoseconds), 0 if unknown
+  uint64_t srtt() const { return srtt_; }
+  /// the smoothed time to connect and handshake (in nanoseconds), 0 if unknown
+  uint64_t handshake_latency() const { return handshake_latency_; }
+  /// the smoothed ratio of the failed connects
+  double error_rate() const { return error_rate_; }
+  /// the number of tunnels through the server
+  uint32_t active() const { return active_; }
+
+  /// whether the server is ejected from the balancing
+  bool ejected(uint64_t now) const { return now < ejected_until_; }
+  uint64_t ejected_until() const { return ejected_until_; }
+
+  /// whether the trial tunnel after an ejection is in flight, the server is
+  /// not picked for other tunnels until it is done
+  bool trial_pending(uint64_t now) const { return trial_started_ && now - trial_started_ < kTrialTimeout; }
+
+  /// the expected latency of a new tunnel, weighted by the load and the errors
+  double Cost() const;
+
+  /// the server is picked for a new tunnel, the first one after an ejection
+  /// ends is the trial
+  ///
+  /// \param now the monotonic time in nanoseconds
+  void OnPicked(uint64_t now);
+
+  /// a tunnel is opened or closed through the server
+  void OnTunnelOpened() { ++active_; }
+  void OnTunnelClosed();
+
+  /// a tunnel is accepted by the server
+  ///
+  /// \param latency the time to connect and handshake, excluding the name
+  /// resolution (in nanoseconds)
+  void OnConnected(uint64_t latency);
+
+  /// a tunnel failed to connect or is refused by the server
+  ///
+  /// \param started the monotonic time the tunnel started to connect
+  /// \param now the monotonic time in nanoseconds
+  void OnConnectFailed(uint64_t started, uint64_t now);
+
+  /// a round trip time is measured on a tunnel (in nanoseconds)
+  void OnRttSample(uint64_t rtt);
+
+ private:
+  const Config config_;
+  const bool primary_;
+
+  uint64_t srtt_ = 0;
+  uint64_t handshake_latency_ = 0;
+  double error_rate_ = 0;
+  uint32_t active_ = 0;
+
+  uint32_t consecutive_failures_ = 0;
+  uint64_t backoff_ = 0;
+  uint64_t ejected_until_ = 0;
+  /// the start of the trial tunnel in flight, 0 if none
+  uint64_t trial_started_ = 0;
+};
+
+/// The upstream servers of an io context, picked for the new tunnels by the
+/// power of two choices: the cheaper one of two random servers not ejected
+/// and not waiting for a trial.
+///
+/// It avoids the herding of always picking the best server, whose
+/// measurements lag behind the tunnels just sent to it, while the slow and
+/// failing servers are picked less and less.
+class UpstreamPool : public asio::execution_context::service {
+ public:
+  static asio::execution_context::id id;
+
+  explicit UpstreamPool(asio::io_context& io_context);
+  ~UpstreamPool() override;
+
+  /// the pool associated with the io context
+  static UpstreamPool& Get(asio::io_context& io_context) { return asio::use_service<UpstreamPool>(io_context); }
+
+  /// parse a comma separated list of `[username:password@]host[:port]`
+  ///
+  /// \param list the list of servers
+  /// \param default_port the port of the servers without one
+  /// \param configs the parsed servers
+  /// \param err the error of the first bad server
+  /// \return whether the list is parsed
+  static bool ParseServerList(std::string_view list,
+                              uint16_t default_port,
+                              std::vector<UpstreamServer::Config>* configs,
+                              std::string* err);
+
+  /// replace the servers, the servers unchanged keep their measurements
+  ///
+  /// \param primary the server of --server_host
+  /// \param server_list the other servers, see ParseServerList
+  /// \param err the error if failed, the servers are kept then
+  /// \return whether the servers are replaced
+  bool Configure(const UpstreamServer::Config& primary, std::string_view server_list, std::string* err);
+
+  /// pick the server for a new tunnel
+  ///
+  /// \param now the monotonic time in nanoseconds
+  /// \param exclude the server just failed, skipped unless it is the only one
+  /// \return the server picked, null if not configured
+  std::shared_ptr<UpstreamServer> Pick(uint64_t now, const UpstreamServer* exclude = nullptr);
+
+  /// the number of the servers
+  size_t size() const { return servers_.size(); }
+
+  const std::vector<std::shared_ptr<UpstreamServer>>& servers() const { return servers_; }
+
+ private:
+  void shutdown() override;
+
+  std::shared_ptr<UpstreamServer> PickServer(uint64_t now, const UpstreamServer* exclude);
+
+  std::vector<std::shared_ptr<UpstreamServer>> servers_;
+  std::minstd_rand random_;
+};
+
+}  // namespace net
+
+#endif  // H_NET_UPSTREAM_POOL
@@ -0,0 +1,179 @@
+// SPDX-License-Identifier: GPL-2.0
+/* Copyright (c) 2024 Chilledheart  */
+
+#include <gtest/gtest-message.h>
+#include <gtest/gtest.h>
+
+#include <map>
+#include <string>
+
+#include "net/upstream_pool.hpp"
+
+using namespace net;
+
+namespace {
+constexpr uint64_t kMs = 1000 * 1000;
+
+UpstreamServer::Config Primary() {
+  UpstreamServer::Config config;
+  config.host = "primary.example.com";
+  config.port = 443;
+  return config;
+}
+}  // namespace
+
+TEST(UpstreamPoolTest, ParseServerList) {
+  std::vector<UpstreamServer::Config> configs;
+  std::string err;
+  std::string_view list = " a.example.com, user:p@ss@b.example.com:8443 ,[::1]:444,10.0.0.1,[fd00::1]";
+  ASSERT_TRUE(UpstreamPool::ParseServerList(list, 443, &configs, &err)) << err;
+  ASSERT_EQ(5u, configs.size());
+  EXPECT_EQ("a.example.com", configs[0].host);
+  EXPECT_EQ(443u, configs[0].port);
+  EXPECT_TRUE(configs[0].username.empty());
+  EXPECT_EQ("b.example.com", configs[1].host);
+  EXPECT_EQ(8443u, configs[1].port);
+  EXPECT_EQ("user", configs[1].username);
+  EXPECT_EQ("p@ss", configs[1].password);
+  EXPECT_EQ("::1", configs[2].host);
+  EXPECT_EQ(444u, configs[2].port);
+  EXPECT_EQ("10.0.0.1", configs[3].host);
+  EXPECT_EQ("fd00::1", configs[4].host);
+  EXPECT_EQ(443u, configs[4].port);
+
+  EXPECT_TRUE(UpstreamPool::ParseServerList("", 443, &configs, &err));
+  EXPECT_TRUE(configs.empty());
+  EXPECT_FALSE(UpstreamPool::ParseServerList("a.example.com:0", 443, &configs, &err));
+  EXPECT_FALSE(UpstreamPool::ParseServerList("a.example.com:http", 443, &configs, &err));
+  EXPECT_FALSE(UpstreamPool::ParseServerList("::1", 443, &configs, &err));
+  EXPECT_FALSE(UpstreamPool::ParseServerList("user@a.example.com", 443, &configs, &err));
+  EXPECT_FALSE(UpstreamPool::ParseServerList("[::1", 443, &configs, &err));
+}
+
+TEST(UpstreamPoolTest, Ejection) {
+  UpstreamServer server(Primary());
+  uint64_t now = 1000 * kMs;
+  for (uint32_t i = 1; i < UpstreamServer::kMaxConsecutiveFailures; ++i) {
+    server.OnConnectFailed(now, now);
+    EXPECT_FALSE(server.ejected(now));
+  }
+  server.OnConnectFailed(now, now);
+  EXPECT_TRUE(server.ejected(now));
+  EXPECT_FALSE(server.ejected(now + UpstreamServer::kMinBackoff));
+
+  // the tunnels in flight failing at once don't extend the ejection
+  for (int i = 0; i < 10; ++i) {
+    server.OnConnectFailed(now, now);
+  }
+  EXPECT_EQ(now + UpstreamServer::kMinBackoff, server.ejected_until());
+  EXPECT_GT(server.error_rate(), 0.3);
+
+  // nor do they once it ends, they started before
+  now += UpstreamServer::kMinBackoff;
+  server.OnConnectFailed(now - 1, now + 10 * kMs);
+  EXPECT_FALSE(server.ejected(now + 10 * kMs));
+
+  // the trial failed, ejected for longer
+  server.OnPicked(now);
+  EXPECT_TRUE(server.trial_pending(now));
+  server.OnConnectFailed(now, now + 10 * kMs);
+  EXPECT_FALSE(server.trial_pending(now + 10 * kMs));
+  now += 10 * kMs;
+  EXPECT_TRUE(server.ejected(now + UpstreamServer::kMinBackoff));
+  EXPECT_FALSE(server.ejected(now + 2 * UpstreamServer::kMinBackoff));
+
+  // a success clears the ejection
+  server.OnConnected(50 * kMs);
+  EXPECT_FALSE(server.ejected(now));
+  EXPECT_EQ(50 * kMs, server.handshake_latency());
+  server.OnConnected(90 * kMs);
+  EXPECT_EQ(55 * kMs, server.handshake_latency());
+}
+
+TEST(UpstreamPoolTest, Pick) {
+  asio::io_context io_context;
+  UpstreamPool& pool = UpstreamPool::Get(io_context);
+  EXPECT_EQ(nullptr, pool.Pick(0));
+
+  std::string err;
+  ASSERT_TRUE(pool.Configure(Primary(), "fast.example.com,slow.example.com", &err)) << err;
+  ASSERT_EQ(3u, pool.size());
+  auto primary = pool.servers()[0];
+  auto fast = pool.servers()[1];
+  auto slow = pool.servers()[2];
+  EXPECT_TRUE(primary->primary());
+  EXPECT_FALSE(fast->primary());
+
+  uint64_t now = 1000 * kMs;
+  primary->OnConnected(100 * kMs);
+  fast->OnConnected(10 * kMs);
+  slow->OnConnected(200 * kMs);
+
+  // the slowest one is never the cheaper one of two
+  std::map<UpstreamServer*, int> picks;
+  for (int i = 0; i < 300; ++i) {
+    ++picks[pool.Pick(now).get()];
+  }
+  EXPECT_EQ(0, picks[slow.get()]);
+  EXPECT_GT(picks[fast.get()], picks[primary.get()]);
+
+  // the load counts
+  for (int i = 0; i < 20; ++i) {
+    fast->OnTunnelOpened();
+  }
+  EXPECT_GT(fast->Cost(), primary->Cost());
+  for (int i = 0; i < 20; ++i) {
+    fast->OnTunnelClosed();
+  }
+
+  // the ejected and the excluded ones are skipped
+  for (uint32_t i = 0; i < UpstreamServer::kMaxConsecutiveFailures; ++i) {
+    fast->OnConnectFailed(now, now);
+  }
+  for (int i = 0; i < 20; ++i) {
+    EXPECT_EQ(primary, pool.Pick(now, slow.get()));
+  }
+  EXPECT_EQ(fast, pool.Pick(now + UpstreamServer::kMinBackoff, slow.get()));
+
+  // only one trial at a time once the ejection ends
+  for (int i = 0; i < 20; ++i) {
+    EXPECT_EQ(primary, pool.Pick(now + UpstreamServer::kMinBackoff, slow.get()));
+  }
+  EXPECT_EQ(fast, pool.Pick(now + UpstreamServer::kMinBackoff + UpstreamServer::kTrialTimeout, slow.get()));
+  fast->OnConnected(10 * kMs);
+  EXPECT_FALSE(fast->trial_pending(now + UpstreamServer::kMinBackoff + UpstreamServer::kTrialTimeout));
+
+  // all ejected, the one back the soonest
+  for (uint32_t i = 0; i < UpstreamServer::kMaxConsecutiveFailures; ++i) {
+    fast->OnConnectFailed(now, now);
+    primary->OnConnectFailed(now + 1, now + 1);
+    slow->OnConnectFailed(now + 2, now + 2);
+  }
+  EXPECT_EQ(fast, pool.Pick(now));
+  EXPECT_EQ(primary, pool.Pick(now, fast.get()));
+}
+
+TEST(UpstreamPoolTest, Configure) {
+  asio::io_context io_context;
+  UpstreamPool& pool = UpstreamPool::Get(io_context);
+  std::string err;
+  ASSERT_TRUE(pool.Configure(Primary(), "a.example.com,b.example.com", &err)) << err;
+  auto primary = pool.servers()[0];
+  auto b = pool.servers()[2];
+
+  // the servers unchanged are kept with their measurements
+  ASSERT_TRUE(pool.Configure(Primary(), "b.example.com,c.example.com:8443", &err)) << err;
+  ASSERT_EQ(3u, pool.size());
+  EXPECT_EQ(primary, pool.servers()[0]);
+  EXPECT_EQ(b, pool.servers()[1]);
+  EXPECT_EQ("c.example.com", pool.servers()[2]->host());
+  EXPECT_EQ(8443u, pool.servers()[2]->port());
+
+  // a bad list keeps the servers
+  EXPECT_FALSE(pool.Configure(Primary(), "b.example.com:99999", &err));
+  EXPECT_EQ(3u, pool.size());
+
+  ASSERT_TRUE(pool.Configure(Primary(), "", &err)) << err;
+  ASSERT_EQ(1u, pool.size());
+  EXPECT_EQ(primary, pool.Pick(0));
+}
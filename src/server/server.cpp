@@ -3,12 +3,14 @@
 
 #include "config/config.hpp"
 #include "crypto/crypter_export.hpp"
+#include "server/server_connection_stats.hpp"
 #include "server/server_server.hpp"
 
 #include <absl/debugging/failure_signal_handler.h>
 #include <absl/debugging/symbolize.h>
 #include <absl/flags/flag.h>
 #include <absl/strings/str_cat.h>
+#include <absl/strings/str_join.h>
 #include <locale.h>
 #include "third_party/boringssl/src/include/openssl/crypto.h"
 
@@ -22,9 +24,13 @@
 #endif
 
 #include "core/logging.hpp"
+#include "core/utils.hpp"
 #include "crypto/crypter_export.hpp"
 #include "net/asio.hpp"
+#include "net/cipher.hpp"
+#include "net/metrics_server.hpp"
 #include "net/resolver.hpp"
+#include "net/stats.hpp"
 #include "version.h"
 
 ABSL_FLAG(std::string, user, "", "set non-privileged user for worker");
@@ -36,6 +42,55 @@ const ProgramType pType = YASS_SERVER_DEFAULT;
 
 using namespace net::server;
 
+#ifdef SIGHUP
+/// re-read the config file and apply the changes to the running server in place
+///
+/// \param server the server to reload, the listeners and connections are kept
+/// \param snapshot the config the server is running with, updated on success
+static void ReloadConfig(ServerServer* server, config::ConfigSnapshot* snapshot) {
+  uint64_t start_time = GetMonotonicTime();
+
+  config::ReadConfig();
+  std::string err = config::ValidateConfig();
+  if (!err.empty()) {
+    LOG(WARNING) << "reload: invalid config: " << err;
+    config::RestoreConfig(*snapshot);
+    return;
+  }
+  std::vector<std::string> changed = config::DiffConfig(*snapshot);
+  if (changed.empty()) {
+    LOG(WARNING) << "reload: config unchanged";
+    return;
+  }
+  if (config::ConfigChangesRequireRestart(changed)) {
+    LOG(WARNING) << "reload: config changes require restart: " << absl::StrJoin(changed, ",");
+    config::RestoreConfig(*snapshot);
+    return;
+  }
+  // the certificates and keys are read from files
+  if (CIPHER_METHOD_IS_TLS(absl::GetFlag(FLAGS_method).method) && !config::ReadTLSConfigFile()) {
+    config::RestoreConfig(*snapshot);
+    return;
+  }
+  LOG(WARNING) << "reload: applying config changes: " << absl::StrJoin(changed, ",");
+
+  asio::error_code ec;
+  server->reload(std::string_view(), std::string_view(), 0, ec);
+  if (ec) {
+    LOG(WARNING) << "reload: failed to apply config changes due to: " << ec;
+    config::RestoreConfig(*snapshot);
+    return;
+  }
+  net::SelectCipherBackend(absl::GetFlag(FLAGS_method).method);
+
+  *snapshot = config::SnapshotConfig();
+  uint64_t reload_time = GetMonotonicTime() - start_time;
+  net::process_stats().Add(net::Stats::kConfigReloads);
+  net::process_stats().RecordNanoseconds(net::Stats::kConfigReloadLatency, reload_time);
+  LOG(WARNING) << "reload: config reloaded in " << reload_time / 1000 << " us";
+}
+#endif
+
 int main(int argc, const char* argv[]) {
 #ifndef _WIN32
   // setup signal handler
@@ -96,6 +151,7 @@ int main(int argc, const char* argv[]) {
     LOG(WARNING) << "Configuration Validated";
     return 0;
   }
+  net::SelectCipherBackend(absl::GetFlag(FLAGS_method).method);
 
 #ifdef _WIN32
   int iResult = 0;
@@ -167,12 +223,40 @@ int main(int argc, const char* argv[]) {
     LOG(WARNING) << "tcp server listening at " << endpoint;
   }
 
+  std::unique_ptr<net::MetricsServer> metrics_server;
+  if (uint16_t metrics_port = absl::GetFlag(FLAGS_metrics_port)) {
+    auto metrics_addr = asio::ip::make_address(absl::GetFlag(FLAGS_metrics_host), ec);
+    if (ec) {
+      LOG(ERROR) << "invalid metrics host: " << absl::GetFlag(FLAGS_metrics_host);
+      server.stop();
+      work_guard.reset();
+      return -1;
+    }
+    metrics_server =
+        std::make_unique<net::MetricsServer>(std::vector<net::Stats*>{&net::server::stats(), &net::process_stats()});
+    metrics_server->listen(asio::ip::tcp::endpoint(metrics_addr, metrics_port), ec);
+    if (ec) {
+      LOG(ERROR) << "metrics server listen failed due to: " << ec;
+      server.stop();
+      work_guard.reset();
+      return -1;
+    }
+    LOG(WARNING) << "metrics server listening at " << metrics_server->endpoint();
+  }
+
+#ifdef SIGHUP
+  config::ConfigSnapshot config_snapshot = config::SnapshotConfig();
+#endif
+
   asio::signal_set signals(io_context);
   signals.add(SIGINT, ec);
   signals.add(SIGTERM, ec);
 #ifdef SIGQUIT
   signals.add(SIGQUIT, ec);
 #endif
+#ifdef SIGHUP
+  signals.add(SIGHUP, ec);
+#endif
 #if defined(SIGUSR1)
   signals.add(SIGUSR1, ec);
 #endif
@@ -181,6 +265,14 @@ int main(int argc, const char* argv[]) {
 #if defined(SIGUSR1)
     if (signal_number == SIGUSR1) {
       PrintMallocStats();
+      PrintServerStats();
+      signals.async_wait(cb);
+      return;
+    }
+#endif
+#ifdef SIGHUP
+    if (signal_number == SIGHUP) {
+      ReloadConfig(&server, &config_snapshot);
       signals.async_wait(cb);
       return;
     }
@@ -193,6 +285,9 @@ int main(int argc, const char* argv[]) {
 #endif
       LOG(WARNING) << "Application exiting";
       server.stop();
+      if (metrics_server) {
+        metrics_server->stop();
+      }
 #ifdef SIGQUIT
     }
 #endif
@@ -266,6 +361,7 @@ int main(int argc, const char* argv[]) {
   io_context.run();
 
   PrintMallocStats();
+  PrintServerStats();
 
   return 0;
 }
@@ -7,6 +7,7 @@
 #include <absl/strings/str_cat.h>
 #include <base/rand_util.h>
 #include <base/strings/string_util.h>
+#include <algorithm>
 #include <cstdlib>
 
 #include "config/config.hpp"
@@ -15,6 +16,7 @@
 #include "net/base64.hpp"
 #include "net/http_parser.hpp"
 #include "net/padding.hpp"
+#include "net/replay_filter.hpp"
 #include "net/socks4.hpp"
 #include "net/socks4_request.hpp"
 #include "net/socks4_request_parser.hpp"
@@ -22,6 +24,7 @@
 #include "net/socks5_request.hpp"
 #include "net/socks5_request_parser.hpp"
 #include "net/ss_request_parser.hpp"
+#include "net/udp_stream.hpp"
 #include "version.h"
 
 ABSL_FLAG(bool, hide_via, true, "If true, the Via heaeder will not be added.");
@@ -54,6 +57,20 @@ static std::vector<http2::adapter::Header> GenerateHeaders(std::vector<std::pair
   return response_vector;
 }
 
+/// the replay filter shared by all server connections, nullptr if disabled
+/// its flags are not reloaded, see config::ConfigChangesRequireRestart
+static net::ReplayFilter* GetReplayFilter() {
+  static net::ReplayFilter* filter = []() -> net::ReplayFilter* {
+    uint32_t capacity = absl::GetFlag(FLAGS_replay_filter_capacity);
+    uint32_t fp_rate = absl::GetFlag(FLAGS_replay_filter_fp_rate);
+    if (!capacity || fp_rate < 2) {
+      return nullptr;
+    }
+    return new net::ReplayFilter(capacity, 1.0 / fp_rate);
+  }();
+  return filter;
+}
+
 static constexpr std::string_view kBasicAuthPrefix = "basic ";
 static bool VerifyProxyAuthorizationIdentity(std::string_view auth) {
   if (auth.size() <= kBasicAuthPrefix.size()) {
@@ -78,26 +95,30 @@ constexpr const std::string_view ServerConnection::http_connect_reply_ = "HTTP/1
 
 #ifdef HAVE_QUICHE
 bool DataFrameSource::Send(absl::string_view frame_header, size_t payload_length) {
-  std::string concatenated;
-  if (payload_length) {
-    DCHECK(!chunks_.empty());
-    absl::string_view payload(reinterpret_cast<const char*>(chunks_.front()->data()), payload_length);
-    concatenated = absl::StrCat(frame_header, payload);
-  } else {
-    concatenated = std::string{frame_header};
-  }
-  const int64_t result = connection_->OnReadyToSend(concatenated);
-
-  DCHECK_EQ(static_cast<size_t>(result), concatenated.size());
-
   if (!payload_length) {
+    connection_->OnReadyToSendDataFrame(IOBuf::copyBuffer(frame_header.data(), frame_header.size()));
     return true;
   }
 
-  chunks_.front()->trimStart(payload_length);
-
-  if (chunks_.front()->empty()) {
+  DCHECK(!chunks_.empty());
+  std::shared_ptr<IOBuf> chunk = chunks_.front();
+  if (payload_length == chunk->length() && chunk->headroom() >= frame_header.size()) {
+    // write the frame header in place and hand the chunk over
+    chunk->prepend(frame_header.size());
+    memcpy(chunk->mutable_data(), frame_header.data(), frame_header.size());
     chunks_.pop_front();
+    connection_->OnReadyToSendDataFrame(std::move(chunk));
+  } else {
+    std::shared_ptr<IOBuf> frame = IOBuf::create(frame_header.size() + payload_length);
+    memcpy(frame->mutable_tail(), frame_header.data(), frame_header.size());
+    memcpy(frame->mutable_tail() + frame_header.size(), chunk->data(), payload_length);
+    frame->append(frame_header.size() + payload_length);
+    connection_->OnReadyToSendDataFrame(std::move(frame));
+
+    chunk->trimStart(payload_length);
+    if (chunk->empty()) {
+      chunks_.pop_front();
+    }
   }
 
   if (chunks_.empty() && send_completion_callback_) {
@@ -141,13 +162,37 @@ ServerConnection::~ServerConnection() {
 }
 
 void ServerConnection::start() {
-  SetState(state_handshake);
+  stats().Add(Stats::kConnectionsOpened);
+  SetupQueues(&upstream_, &downstream_, &stats());
   closed_ = false;
   closing_ = false;
+  SetState(state_handshake);
   upstream_writable_ = false;
   downstream_readable_ = true;
 
   scoped_refptr<ServerConnection> self(this);
+  StartIdleTimer([this, self](IdleEvent event) {
+    if (closed_) {
+      return;
+    }
+    if (event == kIdleTrim) {
+      size_t bytes = ReleaseIdleMemory();
+      VLOG(2) << "Connection (server) " << connection_id() << " idle: released " << bytes << " bytes";
+      stats().Add(Stats::kIdleTrims);
+      stats().Add(Stats::kIdleTrimmedBytes, bytes);
+      return;
+    }
+    VLOG(1) << "Connection (server) " << connection_id() << " closed due to idle timeout";
+    stats().Add(Stats::kIdleTimeouts);
+    // nothing is in flight, let the client see an orderly shutdown
+    if (!shutdown_) {
+      shutdown_ = true;
+      asio::error_code ec;
+      downlink_->shutdown(ec);
+    }
+    OnDisconnect(asio::error::timed_out);
+  });
+
   downlink_->handshake([this, self](asio::error_code ec) {
     if (closed_ || closing_) {
       return;
@@ -161,6 +206,23 @@ void ServerConnection::start() {
   });
 }
 
+size_t ServerConnection::ReleaseIdleMemory() {
+  size_t bytes = 0;
+  bytes += upstream_.shrink_to_fit();
+  bytes += downstream_.shrink_to_fit();
+  if (padding_in_middle_buf_ && padding_in_middle_buf_->empty()) {
+    bytes += padding_in_middle_buf_->capacity();
+    padding_in_middle_buf_.reset();
+  }
+  if (encoder_) {
+    bytes += encoder_->trim();
+  }
+  if (decoder_) {
+    bytes += decoder_->trim();
+  }
+  return bytes;
+}
+
 void ServerConnection::close() {
   if (closing_) {
     return;
@@ -170,6 +232,17 @@ void ServerConnection::close() {
   asio::error_code ec;
   closing_ = true;
   closed_ = true;
+  stats().Add(Stats::kConnectionsClosed);
+  LogAccessRecord("server", handshake_ns_ ? &request_ : nullptr, upstream_, downstream_);
+  if (state_reported_) {
+    stats().Add(state_to_gauge(state_), -1);
+    state_reported_ = false;
+  }
+#ifdef HAVE_QUICHE
+  stats().Add(Stats::kH2BufferedBytes, -static_cast<int64_t>(http2_buffered_bytes_));
+  http2_buffered_bytes_ = 0;
+#endif
+  StopIdleTimer();
   if (enable_tls_ && !shutdown_) {
     shutdown_ = true;
   }
@@ -209,6 +282,11 @@ void ServerConnection::Start() {
         {http2::adapter::Http2KnownSettingsId::ENABLE_PUSH, kSpdyDisablePush},
     };
     adapter_->SubmitSettings(settings);
+    // the connection window stays at 64 KiB until updated
+    adapter_->SubmitWindowUpdate(0, H2_STREAM_WINDOW_SIZE - kSpdyDefaultInitialWindowSize);
+    // measure the round trip time for Http2WindowTuner
+    adapter_->SubmitPing(Http2WindowTuner::kPingId);
+    window_tuner_.OnPingSent(GetMonotonicTime());
     SendIfNotProcessing();
 
     WriteUpstreamInPipe();
@@ -227,6 +305,10 @@ void ServerConnection::Start() {
     } else {
       encoder_ = std::make_unique<cipher>("", absl::GetFlag(FLAGS_password), method(), this, true);
       decoder_ = std::make_unique<cipher>("", absl::GetFlag(FLAGS_password), method(), this);
+      if (ReplayFilter* filter = GetReplayFilter()) {
+        encoder_->set_replay_filter(filter);
+        decoder_->set_replay_filter(filter);
+      }
       ReadHandshake();
     }
   }
@@ -242,6 +324,16 @@ void ServerConnection::SendIfNotProcessing() {
     processing_responses_ = false;
   }
 }
+
+void ServerConnection::CoalesceHttp2Frames() {
+  if (!adapter_) {
+    return;
+  }
+  // only the frames already queued are merged, nothing waits for more
+  if (size_t coalesced = downstream_.coalesce_front(kMaxTlsRecordPayload, kHttp2MaxCopiedFrame)) {
+    stats().Add(Stats::kH2CoalescedFrames, coalesced);
+  }
+}
 #endif
 
 //
@@ -282,6 +374,10 @@ int64_t ServerConnection::OnReadyToSend(absl::string_view serialized) {
   return serialized.size();
 }
 
+void ServerConnection::OnReadyToSendDataFrame(std::shared_ptr<IOBuf> frame) {
+  downstream_.push_back(std::move(frame));
+}
+
 http2::adapter::Http2VisitorInterface::OnHeaderResult ServerConnection::OnHeaderForStream(StreamId stream_id,
                                                                                           absl::string_view key,
                                                                                           absl::string_view value) {
@@ -407,38 +503,106 @@ bool ServerConnection::OnBeginDataForStream(StreamId stream_id, size_t payload_l
 }
 
 bool ServerConnection::OnDataForStream(StreamId stream_id, absl::string_view data) {
+  size_t held_before = http2_buffered_bytes_ + (padding_in_middle_buf_ ? padding_in_middle_buf_->length() : 0);
+  QueueDataForStream(data);
+  size_t held_after = http2_buffered_bytes_ + (padding_in_middle_buf_ ? padding_in_middle_buf_->length() : 0);
+  // the payloads held are consumed once written (see OnHttp2DataWritten), the paddings right away
+  adapter_->MarkDataConsumedForStream(stream_id, data.size() + held_before - held_after);
+  return true;
+}
+
+void ServerConnection::QueueDataForStream(absl::string_view data) {
+  const uint8_t* p = reinterpret_cast<const uint8_t*>(data.data());
+  size_t length = data.size();
+
   if (padding_support_ && num_padding_recv_ < kFirstPaddings) {
     asio::error_code ec;
-    // Append buf to in_middle_buf
-    if (padding_in_middle_buf_) {
-      padding_in_middle_buf_->reserve(0, data.size());
-      memcpy(padding_in_middle_buf_->mutable_tail(), data.data(), data.size());
-      padding_in_middle_buf_->append(data.size());
-    } else {
-      padding_in_middle_buf_ = IOBuf::copyBuffer(data.data(), data.size());
-    }
-    adapter_->MarkDataConsumedForStream(stream_id, data.size());
-
-    // Deal with in_middle_buf
-    while (num_padding_recv_ < kFirstPaddings) {
-      auto buf = RemovePadding(padding_in_middle_buf_, ec);
+    // strip the paddings of the records inside data by offsets
+    while (num_padding_recv_ < kFirstPaddings && (!padding_in_middle_buf_ || padding_in_middle_buf_->empty())) {
+      size_t payload_size;
+      size_t record_size = ParsePadding(p, length, &payload_size, ec);
       if (ec) {
-        return true;
+        break;
       }
-      DCHECK(buf && buf->length());
-      upstream_.push_back(buf);
+      QueueHttp2Data(IOBuf::shareBuffer(http2_input_buf_, p + kPaddingHeaderSize, payload_size));
       ++num_padding_recv_;
+      p += record_size;
+      length -= record_size;
     }
-    // Deal with in_middle_buf outside paddings
-    if (num_padding_recv_ >= kFirstPaddings && !padding_in_middle_buf_->empty()) {
-      upstream_.push_back(std::move(padding_in_middle_buf_));
+    if (num_padding_recv_ < kFirstPaddings) {
+      if (!length) {
+        return;
+      }
+      // Append the record split across frames to in_middle_buf
+      if (padding_in_middle_buf_) {
+        padding_in_middle_buf_->reserve(0, length);
+        memcpy(padding_in_middle_buf_->mutable_tail(), p, length);
+        padding_in_middle_buf_->append(length);
+      } else {
+        padding_in_middle_buf_ = IOBuf::copyBuffer(p, length);
+      }
+
+      // Deal with in_middle_buf
+      while (num_padding_recv_ < kFirstPaddings) {
+        auto buf = RemovePadding(padding_in_middle_buf_, ec);
+        if (ec) {
+          return;
+        }
+        DCHECK(buf && buf->length());
+        QueueHttp2Data(buf);
+        ++num_padding_recv_;
+      }
+      // Deal with in_middle_buf outside paddings
+      if (!padding_in_middle_buf_->empty()) {
+        QueueHttp2Data(std::move(padding_in_middle_buf_));
+      }
+      return;
     }
-    return true;
   }
 
-  upstream_.push_back(data.data(), data.size());
-  adapter_->MarkDataConsumedForStream(stream_id, data.size());
-  return true;
+  // refer to the decrypted input instead of copying
+  if (length) {
+    QueueHttp2Data(IOBuf::shareBuffer(http2_input_buf_, p, length));
+  }
+}
+
+void ServerConnection::QueueHttp2Data(std::shared_ptr<IOBuf> buf) {
+  http2_buffered_bytes_ += buf->length();
+  stats().Add(Stats::kH2BufferedBytes, static_cast<int64_t>(buf->length()));
+  upstream_.push_back(std::move(buf));
+}
+
+void ServerConnection::OnHttp2DataWritten(size_t bytes) {
+  // other bytes might be queued ahead, e.g. the handshake replies
+  bytes = std::min(bytes, http2_buffered_bytes_);
+  if (!bytes) {
+    return;
+  }
+  http2_buffered_bytes_ -= bytes;
+  stats().Add(Stats::kH2BufferedBytes, -static_cast<int64_t>(bytes));
+  if (!stream_id_) {
+    return;
+  }
+  adapter_->MarkDataConsumedForStream(stream_id_, bytes);
+
+  uint64_t now = GetMonotonicTime();
+  // the local socket doesn't keep up if most of the window is still queued
+  bool backlogged = http2_buffered_bytes_ >= window_tuner_.window() / 2 || upstream_.above_watermark();
+  size_t increment = window_tuner_.OnDataConsumed(bytes, now, backlogged);
+  if (increment) {
+    // the connection carries a single stream, so its window follows the stream's
+    adapter_->SubmitWindowUpdate(0, increment);
+    adapter_->SubmitWindowUpdate(stream_id_, increment);
+    stats().Add(Stats::kH2WindowGrowths);
+  }
+  if (window_tuner_.WantsRttProbe(now)) {
+    adapter_->SubmitPing(Http2WindowTuner::kPingId);
+    window_tuner_.OnPingSent(now);
+  }
+  if (!http2_in_recv_callback_ && adapter_->want_write()) {
+    SendIfNotProcessing();
+    OnDownstreamWriteFlush();
+  }
 }
 
 bool ServerConnection::OnDataPaddingLength(StreamId stream_id, size_t padding_length) {
@@ -450,6 +614,16 @@ void ServerConnection::OnRstStream(StreamId stream_id, http2::adapter::Http2Erro
   OnDisconnect(asio::error::connection_reset);
 }
 
+void ServerConnection::OnPing(http2::adapter::Http2PingId ping_id, bool is_ack) {
+  if (!is_ack || ping_id != Http2WindowTuner::kPingId) {
+    return;
+  }
+  uint64_t rtt = window_tuner_.OnPingAck(GetMonotonicTime());
+  if (rtt) {
+    stats().RecordNanoseconds(Stats::kH2RttLatency, rtt);
+  }
+}
+
 bool ServerConnection::OnGoAway(StreamId last_accepted_stream_id,
                                 http2::adapter::Http2ErrorCode error_code,
                                 absl::string_view opaque_data) {
@@ -605,9 +779,6 @@ void ServerConnection::OnReadHandshakeViaHttps() {
   }
 
   if (ok) {
-    buf->trimStart(nparsed);
-    buf->retreat(nparsed);
-
     http_host_ = parser.host();
     http_port_ = parser.port();
     http_is_connect_ = parser.is_connect();
@@ -638,25 +809,32 @@ void ServerConnection::OnReadHandshakeViaHttps() {
     request_ = {http_host_, http_port_};
 
     if (!http_is_connect_) {
-      absl::flat_hash_map<std::string, std::string> via_headers;
-      via_headers["Connection"s] = "Close"s;
+      HttpHeaderLines via_headers;
+      via_headers.emplace_back("Connection"sv, "Close"sv);
+      std::string forwarded;
       if (!absl::GetFlag(FLAGS_hide_ip)) {
         std::ostringstream ss;
         ss << "for=\"" << peer_endpoint_ << "\"";
-        via_headers["Forwarded"s] = ss.str();
+        forwarded = ss.str();
+        via_headers.emplace_back("Forwarded"sv, forwarded);
       }
       // https://datatracker.ietf.org/doc/html/rfc7230#section-5.7.1
       if (!absl::GetFlag(FLAGS_hide_via)) {
-        via_headers["Via"s] = "YASS/" YASS_APP_PRODUCT_VERSION;
+        via_headers.emplace_back("Via"sv, std::string_view("YASS/" YASS_APP_PRODUCT_VERSION));
       }
+      // reforge before consuming the input, the parsed header lines refer to it
       std::string header;
       parser.ReforgeHttpRequest(&header, &via_headers);
 
+      buf->trimStart(nparsed);
+      buf->retreat(nparsed);
       buf->reserve(header.size(), 0);
       buf->prepend(header.size());
       memcpy(buf->mutable_data(), header.c_str(), header.size());
       VLOG(3) << "Connection (server) " << connection_id() << " Host: " << http_host_ << " Port: " << http_port_;
     } else {
+      buf->trimStart(nparsed);
+      buf->retreat(nparsed);
       VLOG(3) << "Connection (server) " << connection_id() << " CONNECT: " << http_host_ << " Port: " << http_port_;
     }
     ProcessReceivedData(buf, ec, buf->length());
@@ -1087,7 +1265,7 @@ void ServerConnection::ReadStream(bool yield) {
 
   downstream_read_inprogress_ = true;
   if (yield) {
-    asio::post(*io_context_, [this, self]() {
+    FairScheduler::Get(*io_context_).Yield(&upload_flow_, [this, self]() {
       downstream_read_inprogress_ = false;
       if (closed_) {
         return;
@@ -1142,8 +1320,7 @@ void ServerConnection::WriteStreamInPipe() {
   bool try_again = false;
   bool yield = false;
 
-  int bytes_read_without_yielding = 0;
-  uint64_t yield_after_time = GetMonotonicTime() + kYieldAfterDurationMilliseconds * 1000 * 1000;
+  FairScheduler& scheduler = FairScheduler::Get(*io_context_);
 
   asio::error_code ec;
 
@@ -1177,7 +1354,7 @@ void ServerConnection::WriteStreamInPipe() {
       }
     } while (false);
     buf->trimStart(written);
-    bytes_read_without_yielding += written;
+    bool quantum_used = scheduler.Charge(&download_flow_, written);
     wbytes_transferred += written;
     // continue to resume
     if (buf->empty()) {
@@ -1193,7 +1370,8 @@ void ServerConnection::WriteStreamInPipe() {
       ec = asio::error::try_again;
       break;
     }
-    if (bytes_read_without_yielding > kYieldAfterBytesRead || GetMonotonicTime() > yield_after_time) {
+    if (quantum_used) {
+      stats().Add(Stats::kTxYields);
       if (downstream_.empty()) {
         try_again = true;
         yield = true;
@@ -1217,7 +1395,7 @@ void ServerConnection::WriteStreamInPipe() {
             }
             received();
           },
-          yield);
+          yield ? &download_flow_ : nullptr);
     }
   }
   if (ec == asio::error::try_again || ec == asio::error::would_block) {
@@ -1241,6 +1419,9 @@ std::shared_ptr<IOBuf> ServerConnection::GetNextDownstreamBuf(asio::error_code&
   if (!downstream_.empty()) {
     DCHECK(!downstream_.front()->empty());
     ec = asio::error_code();
+#ifdef HAVE_QUICHE
+    CoalesceHttp2Frames();
+#endif
     return downstream_.front();
   }
   if (pending_downstream_read_error_) {
@@ -1273,7 +1454,16 @@ std::shared_ptr<IOBuf> ServerConnection::GetNextDownstreamBuf(asio::error_code&
 #endif
 
   do {
-    buf = IOBuf::create(SOCKET_BUF_SIZE);
+#ifdef HAVE_QUICHE
+    if (adapter_) {
+      buf = IOBuf::create(kHttp2ReadHeadroom + kHttp2ReadSize);
+      buf->advance(kHttp2ReadHeadroom);
+    } else
+#endif
+    {
+      buf = IOBuf::create(SOCKET_BUF_HEADROOM + SOCKET_BUF_SIZE);
+      buf->advance(SOCKET_BUF_HEADROOM);
+    }
     ec = asio::error_code();
     read = channel_->read_some(buf, ec);
     if (ec == asio::error::interrupted) {
@@ -1292,6 +1482,11 @@ std::shared_ptr<IOBuf> ServerConnection::GetNextDownstreamBuf(asio::error_code&
   } else {
     goto out;
   }
+  if (UNLIKELY(upstream_connect_time_)) {
+    ttfb_ns_ = GetMonotonicTime() - upstream_connect_time_;
+    stats().RecordNanoseconds(Stats::kTtfbLatency, ttfb_ns_);
+    upstream_connect_time_ = 0;
+  }
   *bytes_transferred += read;
 
 #ifdef HAVE_QUICHE
@@ -1337,6 +1532,9 @@ out:
   if (ec && ec != asio::error::try_again && ec != asio::error::would_block) {
     pending_downstream_read_error_ = std::move(ec);
   }
+#ifdef HAVE_QUICHE
+  CoalesceHttp2Frames();
+#endif
   return downstream_.front();
 }
 
@@ -1346,8 +1544,7 @@ void ServerConnection::WriteUpstreamInPipe() {
   bool try_again = false;
   bool yield = false;
 
-  int bytes_read_without_yielding = 0;
-  uint64_t yield_after_time = GetMonotonicTime() + kYieldAfterDurationMilliseconds * 1000 * 1000;
+  FairScheduler& scheduler = FairScheduler::Get(*io_context_);
 
   if (channel_ && channel_->write_inprogress()) {
     return;
@@ -1382,6 +1579,7 @@ void ServerConnection::WriteUpstreamInPipe() {
     } while (false);
     buf->trimStart(written);
     wbytes_transferred += written;
+    bool quantum_used = scheduler.Charge(&upload_flow_, written);
     if (ec == asio::error::try_again || ec == asio::error::would_block) {
       DCHECK_EQ(0u, written);
       break;
@@ -1401,7 +1599,8 @@ void ServerConnection::WriteUpstreamInPipe() {
       ec = asio::error::try_again;
       break;
     }
-    if (bytes_read_without_yielding > kYieldAfterBytesRead || GetMonotonicTime() > yield_after_time) {
+    if (quantum_used) {
+      stats().Add(Stats::kRxYields);
       if (upstream_.empty()) {
         try_again = true;
         yield = true;
@@ -1411,6 +1610,11 @@ void ServerConnection::WriteUpstreamInPipe() {
       break;
     }
   }
+#ifdef HAVE_QUICHE
+  if (adapter_ && wbytes_transferred) {
+    OnHttp2DataWritten(wbytes_transferred);
+  }
+#endif
   if (try_again) {
     if (!downstream_read_inprogress_) {
       ReadStream(yield);
@@ -1457,6 +1661,8 @@ try_again:
   }
   *bytes_transferred += read;
   rbytes_transferred_ += read;
+  stats().Add(Stats::kRxBytes, read);
+  stats().Add(Stats::kRxTimes);
   if (read) {
     VLOG(2) << "Connection (server) " << connection_id() << " received data (pipe): " << read << " bytes."
             << " done: " << rbytes_transferred_ << " bytes.";
@@ -1469,7 +1675,9 @@ try_again:
     absl::string_view remaining_buffer(reinterpret_cast<const char*>(buf->data()), buf->length());
     while (!remaining_buffer.empty() && adapter_->want_read()) {
       http2_in_recv_callback_ = true;
+      http2_input_buf_ = buf;
       int64_t result = adapter_->ProcessBytes(remaining_buffer);
+      http2_input_buf_ = nullptr;
       http2_in_recv_callback_ = false;
       if (result < 0) {
         /* handled in OnConnectionError inside ProcessBytes call */
@@ -1483,9 +1691,13 @@ try_again:
       OnDisconnect(ec);
       return nullptr;
     }
-    // not enough buffer for recv window
-    if (upstream_.byte_length() < H2_STREAM_WINDOW_SIZE) {
-      goto try_again;
+    // not enough buffer for recv window, unless the remote doesn't keep up
+    if (http2_buffered_bytes_ < window_tuner_.window()) {
+      if (UNLIKELY(upstream_.above_watermark())) {
+        stats().Add(Stats::kReadPauses);
+      } else {
+        goto try_again;
+      }
     }
   } else
 #endif
@@ -1521,6 +1733,8 @@ out:
 
 void ServerConnection::ProcessReceivedData(std::shared_ptr<IOBuf> buf, asio::error_code ec, size_t bytes_transferred) {
   rbytes_transferred_ += bytes_transferred;
+  stats().Add(Stats::kRxBytes, bytes_transferred);
+  stats().Add(Stats::kRxTimes);
   VLOG(2) << "Connection (server) " << connection_id() << " received data: " << bytes_transferred << " bytes"
           << " done: " << rbytes_transferred_ << " bytes."
           << " ec: " << ec;
@@ -1562,6 +1776,8 @@ void ServerConnection::ProcessReceivedData(std::shared_ptr<IOBuf> buf, asio::err
 
 void ServerConnection::ProcessSentData(asio::error_code ec, size_t bytes_transferred) {
   wbytes_transferred_ += bytes_transferred;
+  stats().Add(Stats::kTxBytes, bytes_transferred);
+  stats().Add(Stats::kTxTimes);
 
   VLOG(2) << "Connection (server) " << connection_id() << " sent data: " << bytes_transferred << " bytes."
           << " done: " << wbytes_transferred_ << " bytes."
@@ -1593,10 +1809,11 @@ void ServerConnection::ProcessSentData(asio::error_code ec, size_t bytes_transfe
 void ServerConnection::OnConnect() {
   scoped_refptr<ServerConnection> self(this);
   asio::error_code ec;
-  auto peer_endpoint = peer_endpoint_;
-  // TODO improve access log
-  LOG(INFO) << "Connection (server) " << connection_id() << " from: " << peer_endpoint << " connect "
-            << remote_domain();
+  VLOG(1) << "Connection (server) " << connection_id() << " from: " << peer_endpoint_ << " connect "
+          << remote_domain();
+  upstream_connect_time_ = GetMonotonicTime();
+  handshake_ns_ = upstream_connect_time_ - accept_time_;
+  stats().RecordNanoseconds(Stats::kHandshakeLatency, handshake_ns_);
   std::string host_name;
   uint16_t port = request_.port();
   if (request_.address_type() == ss::domain) {
@@ -1605,18 +1822,24 @@ void ServerConnection::OnConnect() {
   } else {
     host_name = request_.endpoint().address().to_string();
   }
-  if (enable_upstream_tls_) {
+  if (request_.address_type() == ss::domain && host_name == kUdpOverTcpHost) {
+    // the tunnel carries udp datagrams instead of a connection to origin
+    VLOG(1) << "Connection (server) " << connection_id() << " relaying udp datagrams";
+    channel_ = udp_stream::create(*io_context_, this);
+  } else if (enable_upstream_tls_) {
     channel_ = ssl_stream::create(ssl_socket_data_index(), *io_context_, std::string(), host_name, port, this,
-                                  upstream_https_fallback_, upstream_ssl_ctx_);
+                                  upstream_https_fallback_, upstream_ssl_ctx_.get());
 
   } else {
     channel_ = stream::create(*io_context_, std::string(), host_name, port, this);
   }
+  channel_->set_rate_limiter(rate_limiter_);
   channel_->async_connect([this, self](asio::error_code ec) {
     if (UNLIKELY(closed_)) {
       return;
     }
     if (UNLIKELY(ec)) {
+      stats().Add(Stats::kConnectErrors);
       disconnected(ec);
       return;
     }
@@ -1717,7 +1940,8 @@ void ServerConnection::OnDisconnect(asio::error_code ec) {
     ec = asio::error_code();
   }
 #endif
-  LOG(INFO) << "Connection (server) " << connection_id() << " closed: " << ec;
+  VLOG(1) << "Connection (server) " << connection_id() << " closed: " << ec;
+  close_reason_ = ec;
   close();
 }
 
@@ -1765,6 +1989,7 @@ void ServerConnection::connected() {
   scoped_refptr<ServerConnection> self(this);
   VLOG(1) << "Connection (server) " << connection_id()
           << " remote: established upstream connection with: " << remote_domain();
+  channel_->report_stats(&stats());
   upstream_readable_ = true;
   upstream_writable_ = true;
 
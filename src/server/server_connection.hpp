@@ -8,6 +8,7 @@
 #include "net/channel.hpp"
 #include "net/cipher.hpp"
 #include "net/connection.hpp"
+#include "net/http2_window_tuner.hpp"
 #include "net/io_queue.hpp"
 #include "net/iobuf.hpp"
 #include "net/protocol.hpp"
@@ -15,6 +16,7 @@
 #include "net/ss_request.hpp"
 #include "net/ssl_stream.hpp"
 #include "net/stream.hpp"
+#include "server/server_connection_stats.hpp"
 
 #include <absl/container/flat_hash_map.h>
 #include <absl/strings/str_cat.h>
@@ -55,6 +57,8 @@ class DataFrameSource : public http2::adapter::DataFrameSource {
     if (chunks_.empty())
       return {kBlocked, last_frame_};
 
+    // a full DATA frame fits in a TLS record
+    max_length = std::min(max_length, kMaxTlsRecordPayload - kHttp2FrameHeaderSize);
     bool finished = (chunks_.size() <= 1) && (chunks_.front()->length() <= max_length) && last_frame_;
 
     return {std::min(chunks_.front()->length(), max_length), finished};
@@ -113,6 +117,18 @@ class ServerConnection : public gurl_base::RefCountedThreadSafe<ServerConnection
     return "unknown";
   }
 
+  /// Convert the state of service into the gauge of statistics
+  static Stats::Gauge state_to_gauge(enum state state) {
+    switch (state) {
+      case state_error:
+        return Stats::kConnectionsInError;
+      case state_stream:
+        return Stats::kConnectionsInStream;
+      default:
+        return Stats::kConnectionsInHandshake;
+    }
+  }
+
   /// Construct the service with io context and socket
   ///
   /// \param io_context the io context associated with the service
@@ -152,6 +168,11 @@ class ServerConnection : public gurl_base::RefCountedThreadSafe<ServerConnection
   void close();
 
  private:
+  /// release the buffers of an idle connection
+  ///
+  /// \return the bytes released
+  size_t ReleaseIdleMemory();
+
   /// Enter the start phase
   void Start();
 
@@ -167,7 +188,23 @@ class ServerConnection : public gurl_base::RefCountedThreadSafe<ServerConnection
 #ifdef HAVE_QUICHE
  private:
   bool http2_in_recv_callback_ = false;
+  /// the input being processed, shared by the DATA payloads within
+  std::shared_ptr<IOBuf> http2_input_buf_;
+  /// queue the DATA payloads, the paddings are stripped
+  void QueueDataForStream(absl::string_view data);
+  void QueueHttp2Data(std::shared_ptr<IOBuf> buf);
+  /// mark the payloads written to the local socket consumed, see Http2WindowTuner
+  void OnHttp2DataWritten(size_t bytes);
+  /// sizes the receive window of the stream
+  Http2WindowTuner window_tuner_{H2_STREAM_WINDOW_SIZE, H2_STREAM_MAX_WINDOW_SIZE};
+  /// the payloads queued in upstream_ but not yet consumed
+  size_t http2_buffered_bytes_ = 0;
   void SendIfNotProcessing();
+  /// coalesce the small frames queued in downstream_ up to a full TLS record, so they
+  /// are written by one SSL_write (and one syscall)
+  void CoalesceHttp2Frames();
+  /// queue the serialized DATA frame by reference, see DataFrameSource::Send
+  void OnReadyToSendDataFrame(std::shared_ptr<IOBuf> frame);
   bool processing_responses_ = false;
   StreamId stream_id_ = 0;
   DataFrameSource* data_frame_ = nullptr;
@@ -212,7 +249,7 @@ class ServerConnection : public gurl_base::RefCountedThreadSafe<ServerConnection
   bool OnDataPaddingLength(StreamId stream_id, size_t padding_length) override;
   void OnRstStream(StreamId stream_id, http2::adapter::Http2ErrorCode error_code) override;
   void OnPriorityForStream(StreamId stream_id, StreamId parent_stream_id, int weight, bool exclusive) override {}
-  void OnPing(http2::adapter::Http2PingId ping_id, bool is_ack) override {}
+  void OnPing(http2::adapter::Http2PingId ping_id, bool is_ack) override;
   void OnPushPromiseForStream(StreamId stream_id, StreamId promised_stream_id) override {}
   bool OnGoAway(StreamId last_accepted_stream_id,
                 http2::adapter::Http2ErrorCode error_code,
@@ -244,7 +281,16 @@ class ServerConnection : public gurl_base::RefCountedThreadSafe<ServerConnection
   state CurrentState() const { return state_; }
   /// Set the state machine to the given state
   /// \param nextState the state the service would be set to
-  void SetState(state nextState) { state_ = nextState; }
+  void SetState(state nextState) {
+    if (!closed_) {
+      if (state_reported_) {
+        stats().Add(state_to_gauge(state_), -1);
+      }
+      stats().Add(state_to_gauge(nextState), 1);
+      state_reported_ = true;
+    }
+    state_ = nextState;
+  }
 
   /// Start to read handshake request
   void ReadHandshake();
@@ -291,6 +337,8 @@ class ServerConnection : public gurl_base::RefCountedThreadSafe<ServerConnection
   void ProcessSentData(asio::error_code ec, size_t bytes_transferred);
   /// state machine
   state state_;
+  /// if the state is counted in statistics
+  bool state_reported_ = false;
 
   /// copy of handshake request
   ss::request request_;
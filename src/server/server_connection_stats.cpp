@@ -0,0 +1,39 @@
+// SPDX-License-Identifier: GPL-2.0
+/* Copyright (c) 2024 Chilledheart  */
+
+#include "server/server_connection_stats.hpp"
+
+#include <sstream>
+
+#include "core/logging.hpp"
+#include "core/utils.hpp"
+
+namespace net::server {
+
+Stats& stats() {
+  static Stats* stats = new Stats("server");
+  return *stats;
+}
+
+}  // namespace net::server
+
+static std::string HumanReadableByteCountBinStr(uint64_t bytes) {
+  std::stringstream ss;
+
+  HumanReadableByteCountBin(&ss, bytes);
+  return ss.str();
+}
+
+void PrintServerStats() {
+  using net::Stats;
+  Stats::Snapshot s = net::server::stats().GetSnapshot();
+  LOG(ERROR) << "Server Connection Stats: Sent: " << HumanReadableByteCountBinStr(s[Stats::kTxBytes]);
+  LOG(ERROR) << "Server Connection Stats: Received: " << HumanReadableByteCountBinStr(s[Stats::kRxBytes]);
+  LOG(ERROR) << "Server Connection Stats: Sent Times: " << s[Stats::kTxTimes];
+  LOG(ERROR) << "Server Connection Stats: Received Times: " << s[Stats::kRxTimes];
+  LOG(ERROR) << "Server Connection Stats: Sent Yield Times: " << s[Stats::kTxYields];
+  LOG(ERROR) << "Server Connection Stats: Received Yield Times: " << s[Stats::kRxYields];
+  LOG(ERROR) << "Server Connection Stats: Connections: " << s[Stats::kConnectionsOpened]
+             << " Closed: " << s[Stats::kConnectionsClosed] << " Connect Errors: " << s[Stats::kConnectErrors];
+  net::PrintStatsHistograms("Server Connection Stats", s);
+}
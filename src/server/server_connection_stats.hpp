@@ -0,0 +1,18 @@
+// SPDX-License-Identifier: GPL-2.0
+/* Copyright (c) 2024 Chilledheart  */
+
+#ifndef H_SERVER_CONNECTION_STATS
+#define H_SERVER_CONNECTION_STATS
+
+#include "net/stats.hpp"
+
+namespace net::server {
+
+/// statistics of all server connections
+Stats& stats();
+
+}  // namespace net::server
+
+void PrintServerStats();
+
+#endif  // H_SERVER_CONNECTION_STATS
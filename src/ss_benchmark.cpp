@@ -19,13 +19,23 @@
 
 #ifdef _WIN32
 #include <ws2tcpip.h>
+#else
+#include <sys/resource.h>
+#include <unistd.h>
+#endif
+
+#ifdef __APPLE__
+#include <mach/mach.h>
 #endif
 
 #include "cli/cli_server.hpp"
 #include "config/config.hpp"
+#include "crypto/decrypter.hpp"
+#include "crypto/encrypter.hpp"
 #include "feature.h"
 #include "net/cipher.hpp"
 #include "net/iobuf.hpp"
+#include "server/server_connection_stats.hpp"
 #include "server/server_server.hpp"
 #include "version.h"
 
@@ -235,6 +245,149 @@ class ContentProviderConnection : public gurl_base::RefCountedThreadSafe<Content
 using ContentProviderConnectionFactory = ConnectionFactory<ContentProviderConnection>;
 using ContentProviderServer = ContentServer<ContentProviderConnectionFactory>;
 
+// Unlike the content provider above, which serves one tunnel at a time, the
+// echo connection writes back whatever it reads, so any number of tunnels can
+// be served concurrently.
+class EchoConnection : public gurl_base::RefCountedThreadSafe<EchoConnection>, public Connection {
+ public:
+  static constexpr const ConnectionFactoryType Type = CONNECTION_FACTORY_CONTENT_PROVIDER;
+  static constexpr const std::string_view Name = "echo";
+
+ public:
+  EchoConnection(asio::io_context& io_context,
+                 std::string_view remote_host_ips,
+                 std::string_view remote_host_sni,
+                 uint16_t remote_port,
+                 bool upstream_https_fallback,
+                 bool https_fallback,
+                 bool enable_upstream_tls,
+                 bool enable_tls,
+                 SSL_CTX* upstream_ssl_ctx,
+                 SSL_CTX* ssl_ctx)
+      : Connection(io_context,
+                   remote_host_ips,
+                   remote_host_sni,
+                   remote_port,
+                   upstream_https_fallback,
+                   https_fallback,
+                   enable_upstream_tls,
+                   enable_tls,
+                   upstream_ssl_ctx,
+                   ssl_ctx) {}
+
+  ~EchoConnection() override { VLOG(1) << "Connection (echo) freed memory"; }
+
+  EchoConnection(const EchoConnection&) = delete;
+  EchoConnection& operator=(const EchoConnection&) = delete;
+
+  EchoConnection(EchoConnection&&) = delete;
+  EchoConnection& operator=(EchoConnection&&) = delete;
+
+  void start() { do_read(); }
+
+  void close() {
+    VLOG(1) << "Connection (echo) disconnected";
+    asio::error_code ec;
+    downlink_->socket_.close(ec);
+    on_disconnect();
+  }
+
+ private:
+  void do_read() {
+    scoped_refptr<EchoConnection> self(this);
+    downlink_->socket_.async_read_some(asio::mutable_buffer(buf_, sizeof(buf_)),
+                                       [this, self](asio::error_code ec, size_t bytes_transferred) {
+                                         if (ec) {
+                                           close();
+                                           return;
+                                         }
+                                         do_write(bytes_transferred);
+                                       });
+  }
+
+  void do_write(size_t bytes) {
+    scoped_refptr<EchoConnection> self(this);
+    asio::async_write(downlink_->socket_, asio::const_buffer(buf_, bytes),
+                      [this, self](asio::error_code ec, size_t bytes_transferred) {
+                        if (ec) {
+                          close();
+                          return;
+                        }
+                        do_read();
+                      });
+  }
+
+  uint8_t buf_[4096];
+};
+
+using EchoConnectionFactory = ConnectionFactory<EchoConnection>;
+using EchoServer = ContentServer<EchoConnectionFactory>;
+
+// the cpu time consumed by all threads of the process, in seconds
+double GetProcessCpuTime() {
+#ifdef _WIN32
+  FILETIME creation_time, exit_time, kernel_time, user_time;
+  if (!::GetProcessTimes(::GetCurrentProcess(), &creation_time, &exit_time, &kernel_time, &user_time)) {
+    return 0;
+  }
+  auto to_100ns = [](const FILETIME& ft) -> uint64_t {
+    return (static_cast<uint64_t>(ft.dwHighDateTime) << 32) | ft.dwLowDateTime;
+  };
+  return static_cast<double>(to_100ns(kernel_time) + to_100ns(user_time)) / 1e7;
+#else
+  struct rusage usage;
+  if (::getrusage(RUSAGE_SELF, &usage) != 0) {
+    return 0;
+  }
+  return static_cast<double>(usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) +
+         static_cast<double>(usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+#endif
+}
+
+// the resident memory of the process in bytes, 0 if not available
+uint64_t GetResidentMemory() {
+#if BUILDFLAG(IS_LINUX) || BUILDFLAG(IS_ANDROID)
+  FILE* file = fopen("/proc/self/statm", "r");
+  if (!file) {
+    return 0;
+  }
+  unsigned long pages = 0;
+  int ret = fscanf(file, "%*lu %lu", &pages);
+  fclose(file);
+  return ret == 1 ? static_cast<uint64_t>(pages) * sysconf(_SC_PAGESIZE) : 0;
+#elif defined(__APPLE__)
+  mach_task_basic_info_data_t info;
+  mach_msg_type_number_t count = MACH_TASK_BASIC_INFO_COUNT;
+  if (task_info(mach_task_self(), MACH_TASK_BASIC_INFO, reinterpret_cast<task_info_t>(&info), &count) !=
+      KERN_SUCCESS) {
+    return 0;
+  }
+  return info.resident_size;
+#else
+  return 0;
+#endif
+}
+
+// raise the soft limit of open files if required
+bool EnsureFileDescriptors(uint64_t required) {
+#ifdef _WIN32
+  return true;
+#else
+  struct rlimit limit;
+  if (::getrlimit(RLIMIT_NOFILE, &limit) != 0) {
+    return false;
+  }
+  if (limit.rlim_cur == RLIM_INFINITY || limit.rlim_cur >= required) {
+    return true;
+  }
+  if (limit.rlim_max != RLIM_INFINITY && limit.rlim_max < required) {
+    return false;
+  }
+  limit.rlim_cur = required;
+  return ::setrlimit(RLIMIT_NOFILE, &limit) == 0;
+#endif
+}
+
 void GenerateConnectRequest(std::string_view host, int port_num, IOBuf* buf) {
   std::string request_header = absl::StrFormat(
       "CONNECT %s:%d HTTP/1.1\r\n"
@@ -248,6 +401,82 @@ void GenerateConnectRequest(std::string_view host, int port_num, IOBuf* buf) {
   buf->prepend(request_header.size());
 }
 
+// A tunnel from the content consumer to the echo server through ss local and ss server
+class EchoTunnel {
+ public:
+  using callback_t = absl::AnyInvocable<void(asio::error_code)>;
+
+  explicit EchoTunnel(asio::io_context& io_context) : socket_(io_context) {}
+
+  // connect to ss local and establish the tunnel with a CONNECT request
+  void AsyncOpen(const asio::ip::tcp::endpoint& local_endpoint, uint16_t port, callback_t&& callback) {
+    callback_ = std::move(callback);
+    socket_.async_connect(local_endpoint, [this, port](asio::error_code ec) {
+      if (ec) {
+        Done(ec);
+        return;
+      }
+      SetSocketTcpNoDelay(&socket_, ec);
+      request_.clear();
+      GenerateConnectRequest("localhost"sv, port, &request_);
+      asio::async_write(socket_, const_buffer(request_), [this](asio::error_code ec, size_t bytes_transferred) {
+        if (ec) {
+          Done(ec);
+          return;
+        }
+        asio::async_read(socket_, asio::mutable_buffer(response_, sizeof(response_)),
+                         [this](asio::error_code ec, size_t bytes_transferred) {
+                           if (!ec && std::string_view(response_, bytes_transferred) != kConnectResponse) {
+                             ec = asio::error::connection_refused;
+                           }
+                           Done(ec);
+                         });
+      });
+    });
+  }
+
+  // write the first bytes of the send buffer and read the echo back
+  void AsyncRoundTrip(size_t bytes, callback_t&& callback) {
+    DCHECK_LE(bytes, g_send_buffer.length());
+    callback_ = std::move(callback);
+    pending_ = 2;
+    ec_ = asio::error_code();
+    recv_buffer_.resize(bytes);
+    asio::async_write(socket_, asio::const_buffer(g_send_buffer.data(), bytes),
+                      [this](asio::error_code ec, size_t bytes_transferred) { OnRoundTrip(ec); });
+    asio::async_read(socket_, asio::mutable_buffer(recv_buffer_.data(), bytes),
+                     [this](asio::error_code ec, size_t bytes_transferred) { OnRoundTrip(ec); });
+  }
+
+  void Close() {
+    asio::error_code ec;
+    socket_.close(ec);
+  }
+
+ private:
+  void OnRoundTrip(asio::error_code ec) {
+    if (ec && !ec_) {
+      ec_ = ec;
+    }
+    if (--pending_ == 0) {
+      Done(ec_);
+    }
+  }
+
+  void Done(asio::error_code ec) {
+    auto callback = std::move(callback_);
+    callback(ec);
+  }
+
+  asio::ip::tcp::socket socket_;
+  IOBuf request_;
+  char response_[kConnectResponse.size()];
+  std::vector<uint8_t> recv_buffer_;
+  int pending_ = 0;
+  asio::error_code ec_;
+  callback_t callback_;
+};
+
 #define XX(num, name, string)                                   \
   struct CryptoTraits##name {                                   \
     static constexpr const cipher_method value = CRYPTO_##name; \
@@ -256,7 +485,7 @@ CIPHER_METHOD_VALID_MAP(XX)
 #undef XX
 
 // [content provider] <== [ss server] <== [ss local] <== [content consumer]
-template <typename T>
+template <typename T, typename ProviderServer = ContentProviderServer>
 class SsEndToEndBM : public benchmark::Fixture {
  public:
   void SetUp(::benchmark::State& state) override {
@@ -431,7 +660,7 @@ class SsEndToEndBM : public benchmark::Fixture {
   asio::error_code StartContentProvider(asio::ip::tcp::endpoint endpoint, int backlog) {
     asio::error_code ec;
 
-    content_provider_server_ = std::make_unique<ContentProviderServer>(io_context_);
+    content_provider_server_ = std::make_unique<ProviderServer>(io_context_);
     content_provider_server_->listen(endpoint, {}, backlog, ec);
     if (ec) {
       LOG(ERROR) << "listen failed due to: " << ec;
@@ -498,18 +727,185 @@ class SsEndToEndBM : public benchmark::Fixture {
     }
   }
 
- private:
+ protected:
   asio::io_context io_context_;
   std::unique_ptr<asio::executor_work_guard<asio::io_context::executor_type>> work_guard_;
   std::unique_ptr<std::thread> thread_;
 
-  std::unique_ptr<ContentProviderServer> content_provider_server_;
+  std::unique_ptr<ProviderServer> content_provider_server_;
   asio::ip::tcp::endpoint content_provider_endpoint_;
   std::unique_ptr<server::ServerServer> server_server_;
   asio::ip::tcp::endpoint server_endpoint_;
   std::unique_ptr<cli::CliServer> local_server_;
   asio::ip::tcp::endpoint local_endpoint_;
 };
+
+// [echo server] <== [ss server] <== [ss local] <== [content consumer] * N
+//
+// The cpu time and the resident memory are sampled from the whole process, so
+// they include the content consumer and the echo server ends of the tunnels.
+template <typename T>
+class SsTunnelBM : public SsEndToEndBM<T, EchoServer> {
+ public:
+  static constexpr const int kMaxTunnels = 10000;
+  // every tunnel takes up to 6 file descriptors along the chain
+  static constexpr const int kFileDescriptorsPerTunnel = 6;
+  // tunnels opened at once, which stays within the listen backlog
+  static constexpr const size_t kOpenBatch = 128;
+  // tunnels opened, exercised and closed per iteration of the tunnel rate benchmark
+  static constexpr const size_t kTunnelsPerIteration = 100;
+  // bytes sent by every tunnel per iteration of the concurrent tunnels benchmark
+  static constexpr const size_t kConcurrentPayload = 4096;
+  static constexpr const size_t kMaxPayload = 64 * 1024;
+
+  void SetUp(::benchmark::State& state) override {
+    absl::SetFlag(&FLAGS_parallel_max, std::max<uint32_t>(absl::GetFlag(FLAGS_parallel_max), 2 * kMaxTunnels));
+    this->StartWorkThread();
+    absl::SetFlag(&FLAGS_method, T::value);
+    this->StartBackgroundTasks();
+
+    GenerateRandContent(kMaxPayload);
+  }
+
+  // N tunnels are kept open, every iteration makes one round trip on each of them
+  void RunConcurrentTunnels(benchmark::State& state) {
+    const size_t count = state.range(0);
+    if (!EnsureFileDescriptors(count * kFileDescriptorsPerTunnel + 64)) {
+      state.SkipWithError("Not enough file descriptors");
+      return;
+    }
+    asio::io_context io_context;
+    std::vector<std::unique_ptr<EchoTunnel>> tunnels;
+    uint64_t rss_before = GetResidentMemory();
+    OpenTunnels(io_context, count, &tunnels);
+    // warm up the buffers of the tunnels
+    RoundTrip(io_context, tunnels, kConcurrentPayload);
+    uint64_t rss_after = GetResidentMemory();
+
+    double cpu_start = GetProcessCpuTime();
+    for (auto _ : state) {
+      auto start = std::chrono::high_resolution_clock::now();
+      RoundTrip(io_context, tunnels, kConcurrentPayload);
+      auto end = std::chrono::high_resolution_clock::now();
+      state.SetIterationTime(std::chrono::duration_cast<std::chrono::duration<double>>(end - start).count());
+    }
+    double cpu_time = GetProcessCpuTime() - cpu_start;
+    CloseTunnels(&tunnels);
+
+    uint64_t bytes = static_cast<uint64_t>(state.iterations()) * count * kConcurrentPayload;
+    state.SetBytesProcessed(bytes);
+    ReportCpuPerGB(state, cpu_time, bytes);
+    if (rss_before && rss_after > rss_before) {
+      state.counters["rss_per_tunnel"] = benchmark::Counter(static_cast<double>(rss_after - rss_before) / count,
+                                                            benchmark::Counter::kDefaults,
+                                                            benchmark::Counter::kIs1024);
+    }
+  }
+
+  // every iteration opens a batch of new tunnels, makes one small round trip
+  // on each of them and closes them
+  void RunTunnelRate(benchmark::State& state) {
+    const size_t payload = state.range(0);
+    if (!EnsureFileDescriptors(kTunnelsPerIteration * kFileDescriptorsPerTunnel + 64)) {
+      state.SkipWithError("Not enough file descriptors");
+      return;
+    }
+    asio::io_context io_context;
+    std::vector<std::unique_ptr<EchoTunnel>> tunnels;
+    double elapsed = 0;
+    double cpu_start = GetProcessCpuTime();
+    for (auto _ : state) {
+      auto start = std::chrono::high_resolution_clock::now();
+      OpenTunnels(io_context, kTunnelsPerIteration, &tunnels);
+      RoundTrip(io_context, tunnels, payload);
+      CloseTunnels(&tunnels);
+      auto end = std::chrono::high_resolution_clock::now();
+      double seconds = std::chrono::duration_cast<std::chrono::duration<double>>(end - start).count();
+      state.SetIterationTime(seconds);
+      elapsed += seconds;
+    }
+    double cpu_time = GetProcessCpuTime() - cpu_start;
+
+    double opened = static_cast<double>(state.iterations()) * kTunnelsPerIteration;
+    state.counters["tunnels_per_second"] = elapsed > 0 ? opened / elapsed : 0;
+    state.counters["cpu_us_per_tunnel"] = cpu_time * 1000 * 1000 / opened;
+  }
+
+  // one tunnel kept open, every iteration makes one request/response round trip
+  void RunRoundTrip(benchmark::State& state) {
+    const size_t payload = state.range(0);
+    asio::io_context io_context;
+    std::vector<std::unique_ptr<EchoTunnel>> tunnels;
+    OpenTunnels(io_context, 1, &tunnels);
+
+    std::vector<double> latencies;
+    double cpu_start = GetProcessCpuTime();
+    for (auto _ : state) {
+      auto start = std::chrono::high_resolution_clock::now();
+      RoundTrip(io_context, tunnels, payload);
+      auto end = std::chrono::high_resolution_clock::now();
+      double seconds = std::chrono::duration_cast<std::chrono::duration<double>>(end - start).count();
+      state.SetIterationTime(seconds);
+      latencies.push_back(seconds * 1000 * 1000);
+    }
+    double cpu_time = GetProcessCpuTime() - cpu_start;
+    CloseTunnels(&tunnels);
+
+    uint64_t bytes = static_cast<uint64_t>(state.iterations()) * payload;
+    state.SetBytesProcessed(bytes);
+    ReportCpuPerGB(state, cpu_time, bytes);
+    if (!latencies.empty()) {
+      state.counters["p50_us"] = Percentile(&latencies, 50);
+      state.counters["p99_us"] = Percentile(&latencies, 99);
+    }
+  }
+
+ private:
+  // open the tunnels in batches, so the listen backlog of ss local is never overflowed
+  void OpenTunnels(asio::io_context& io_context, size_t count, std::vector<std::unique_ptr<EchoTunnel>>* tunnels) {
+    for (size_t i = 0; i < count; i += kOpenBatch) {
+      size_t batch = std::min(kOpenBatch, count - i);
+      for (size_t j = 0; j < batch; ++j) {
+        auto tunnel = std::make_unique<EchoTunnel>(io_context);
+        tunnel->AsyncOpen(this->local_endpoint_, this->content_provider_endpoint_.port(), [](asio::error_code ec) {
+          CHECK(!ec) << "Connection (content-consumer) open tunnel failure " << ec;
+        });
+        tunnels->push_back(std::move(tunnel));
+      }
+      io_context.run();
+      io_context.restart();
+    }
+  }
+
+  void RoundTrip(asio::io_context& io_context, const std::vector<std::unique_ptr<EchoTunnel>>& tunnels, size_t bytes) {
+    for (auto& tunnel : tunnels) {
+      tunnel->AsyncRoundTrip(bytes, [](asio::error_code ec) {
+        CHECK(!ec) << "Connection (content-consumer) round trip failure " << ec;
+      });
+    }
+    io_context.run();
+    io_context.restart();
+  }
+
+  void CloseTunnels(std::vector<std::unique_ptr<EchoTunnel>>* tunnels) {
+    for (auto& tunnel : *tunnels) {
+      tunnel->Close();
+    }
+    tunnels->clear();
+  }
+
+  static void ReportCpuPerGB(benchmark::State& state, double cpu_time, uint64_t bytes) {
+    if (bytes) {
+      state.counters["cpu_s_per_GiB"] = cpu_time * (1024.0 * 1024 * 1024) / static_cast<double>(bytes);
+    }
+  }
+
+  static double Percentile(std::vector<double>* values, int percentile) {
+    size_t index = std::min(values->size() - 1, values->size() * percentile / 100);
+    std::nth_element(values->begin(), values->begin() + index, values->end());
+    return (*values)[index];
+  }
+};
 }  // namespace
 
 // Register the function as a benchmark
@@ -534,6 +930,86 @@ CIPHER_METHOD_MAP_HTTP(XX)
 CIPHER_METHOD_MAP_HTTP2(XX)
 #undef XX
 
+#define XX(num, name, string)                                                                                          \
+  BENCHMARK_TEMPLATE_DEFINE_F(SsTunnelBM, ConcurrentTunnels_##name, CryptoTraits##name)(benchmark::State & state) {    \
+    RunConcurrentTunnels(state);                                                                                       \
+  }                                                                                                                    \
+  BENCHMARK_REGISTER_F(SsTunnelBM, ConcurrentTunnels_##name)                                                           \
+      ->Name("SsTunnelBM_ConcurrentTunnels_" #name)                                                                    \
+      ->Arg(100)                                                                                                       \
+      ->Arg(1000)                                                                                                      \
+      ->Arg(10000)                                                                                                     \
+      ->UseManualTime();                                                                                               \
+  BENCHMARK_TEMPLATE_DEFINE_F(SsTunnelBM, TunnelRate_##name, CryptoTraits##name)(benchmark::State & state) {           \
+    RunTunnelRate(state);                                                                                              \
+  }                                                                                                                    \
+  BENCHMARK_REGISTER_F(SsTunnelBM, TunnelRate_##name)->Name("SsTunnelBM_TunnelRate_" #name)->Arg(64)->UseManualTime(); \
+  BENCHMARK_TEMPLATE_DEFINE_F(SsTunnelBM, RoundTrip_##name, CryptoTraits##name)(benchmark::State & state) {            \
+    RunRoundTrip(state);                                                                                               \
+  }                                                                                                                    \
+  BENCHMARK_REGISTER_F(SsTunnelBM, RoundTrip_##name)                                                                   \
+      ->Name("SsTunnelBM_RoundTrip_" #name)                                                                            \
+      ->Arg(64)                                                                                                        \
+      ->Arg(1024)                                                                                                      \
+      ->UseManualTime();
+CIPHER_METHOD_MAP_SODIUM(XX)
+CIPHER_METHOD_MAP_BORINGSSL(XX)
+CIPHER_METHOD_MAP_MBEDTLS(XX)
+CIPHER_METHOD_MAP_HTTP(XX)
+CIPHER_METHOD_MAP_HTTP2(XX)
+#undef XX
+
+#ifdef HAVE_MBEDTLS
+// the crypters alone, compare the backends of the stream methods
+template <cipher_method Method, crypter_backend Backend, bool Encrypt>
+void CrypterBM(benchmark::State& state) {
+  const size_t size = state.range(0);
+  const char zeros[MAX_KEY_LENGTH] = {};
+  auto input = std::make_unique<char[]>(size);
+  auto output = std::make_unique<char[]>(size);
+  memset(input.get(), 0, size);
+  uint64_t packet_number = 0;
+  size_t output_length;
+  if constexpr (Encrypt) {
+    auto encrypter = crypto::Encrypter::CreateFromCipherSuite(Method, Backend);
+    CHECK(encrypter->SetIV(zeros, encrypter->GetIVSize()) && encrypter->SetKey(zeros, encrypter->GetKeySize()));
+    for (auto _ : state) {
+      CHECK(encrypter->EncryptPacket(packet_number++, nullptr, 0U, input.get(), size, output.get(), &output_length,
+                                     size));
+      benchmark::DoNotOptimize(output.get());
+    }
+  } else {
+    auto decrypter = crypto::Decrypter::CreateFromCipherSuite(Method, Backend);
+    CHECK(decrypter->SetIV(zeros, decrypter->GetIVSize()) && decrypter->SetKey(zeros, decrypter->GetKeySize()));
+    for (auto _ : state) {
+      CHECK(decrypter->DecryptPacket(packet_number++, nullptr, 0U, input.get(), size, output.get(), &output_length,
+                                     size));
+      benchmark::DoNotOptimize(output.get());
+    }
+  }
+  state.SetBytesProcessed(int64_t(state.iterations()) * int64_t(size));
+}
+
+#define XX(num, name, string)                                                    \
+  BENCHMARK_TEMPLATE(CrypterBM, CRYPTO_##name, CRYPTER_BACKEND_BORINGSSL, true)  \
+      ->Name("CrypterBM_Encrypt_" #name "_boringssl")                            \
+      ->Arg(16384);                                                              \
+  BENCHMARK_TEMPLATE(CrypterBM, CRYPTO_##name, CRYPTER_BACKEND_MBEDTLS, true)    \
+      ->Name("CrypterBM_Encrypt_" #name "_mbedtls")                              \
+      ->Arg(16384);                                                              \
+  BENCHMARK_TEMPLATE(CrypterBM, CRYPTO_##name, CRYPTER_BACKEND_BORINGSSL, false) \
+      ->Name("CrypterBM_Decrypt_" #name "_boringssl")                            \
+      ->Arg(16384);                                                              \
+  BENCHMARK_TEMPLATE(CrypterBM, CRYPTO_##name, CRYPTER_BACKEND_MBEDTLS, false)   \
+      ->Name("CrypterBM_Decrypt_" #name "_mbedtls")                              \
+      ->Arg(16384);
+XX(0x22U, AES_128_CFB, "aes-128-cfb")
+XX(0x24U, AES_256_CFB, "aes-256-cfb")
+XX(0x25U, AES_128_CTR, "aes-128-ctr")
+XX(0x27U, AES_256_CTR, "aes-256-ctr")
+#undef XX
+#endif  // HAVE_MBEDTLS
+
 class ASIOFixture : public benchmark::Fixture {
  public:
   ASIOFixture() : s1(io_context), s2(io_context) {}
@@ -685,6 +1161,7 @@ int main(int argc, char** argv) {
 
   PrintMallocStats();
   PrintCliStats();
+  PrintServerStats();
 
   ::benchmark::Shutdown();
   return 0;
@@ -36,6 +36,8 @@ ABSL_FLAG(std::string, proxy_type, "http", "proxy type, available: socks4, socks
 #include "net/cipher.hpp"
 #include "net/http_parser.hpp"
 #include "net/iobuf.hpp"
+#include "net/udp_over_tcp.hpp"
+#include "server/server_connection_stats.hpp"
 #include "server/server_server.hpp"
 #include "version.h"
 
@@ -650,6 +652,140 @@ class EndToEndTest : public ::testing::TestWithParam<cipher_method> {
     }
   }
 
+  void SendDatagramsAndCheckEcho() {
+    if (CIPHER_METHOD_IS_SOCKS(GetParam())) {
+      GTEST_SKIP() << "skipped as socks upstreams not supporting udp associate";
+      return;
+    }
+    asio::io_context io_context;
+    asio::error_code ec;
+    asio::ip::address loopback = GetEndpoint(0).address();
+    auto protocol = loopback.is_v4() ? asio::ip::udp::v4() : asio::ip::udp::v6();
+
+    // Start udp echo server
+    asio::ip::udp::socket echo(io_context);
+    echo.open(protocol, ec);
+    ASSERT_FALSE(ec) << ec;
+    echo.bind(asio::ip::udp::endpoint(loopback, 0), ec);
+    ASSERT_FALSE(ec) << ec;
+    asio::ip::udp::endpoint echo_endpoint = echo.local_endpoint(ec);
+    ASSERT_FALSE(ec) << ec;
+    std::array<uint8_t, 2048> echo_buf;
+    asio::ip::udp::endpoint echo_peer;
+    std::function<void()> echo_loop = [&]() {
+      echo.async_receive_from(asio::buffer(echo_buf), echo_peer, [&](asio::error_code ec, size_t length) {
+        if (ec) {
+          return;
+        }
+        echo.send_to(asio::buffer(echo_buf.data(), length), echo_peer, 0, ec);
+        echo_loop();
+      });
+    };
+    echo_loop();
+
+    // Connect to proxy server
+    asio::ip::tcp::socket s(io_context);
+    s.connect(local_endpoint_, ec);
+    ASSERT_FALSE(ec) << ec;
+
+    // Socks5 method select without authentication
+    const uint8_t method_select[] = {0x05, 0x01, 0x00};
+    asio::write(s, asio::buffer(method_select), ec);
+    ASSERT_FALSE(ec) << ec;
+    uint8_t method_select_reply[2];
+    asio::read(s, asio::buffer(method_select_reply), ec);
+    ASSERT_FALSE(ec) << ec;
+    ASSERT_EQ(method_select_reply[0], 0x05);
+    ASSERT_EQ(method_select_reply[1], 0x00);
+
+    // Socks5 udp associate, the address the client sends from is unknown
+    const uint8_t udp_associate[] = {0x05, 0x03, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00};
+    asio::write(s, asio::buffer(udp_associate), ec);
+    ASSERT_FALSE(ec) << ec;
+
+    // Read the relay address: VER REP RSV ATYP BND.ADDR BND.PORT
+    uint8_t reply_hdr[4];
+    asio::read(s, asio::buffer(reply_hdr), ec);
+    ASSERT_FALSE(ec) << ec;
+    ASSERT_EQ(reply_hdr[1], 0x00) << "udp associate rejected";
+    ASSERT_TRUE(reply_hdr[3] == 0x01 || reply_hdr[3] == 0x04);
+    size_t address_length = reply_hdr[3] == 0x01 ? 4 : 16;
+    uint8_t reply_addr[16 + 2];
+    asio::read(s, asio::buffer(reply_addr, address_length + 2), ec);
+    ASSERT_FALSE(ec) << ec;
+    asio::ip::address relay_address;
+    if (address_length == 4) {
+      asio::ip::address_v4::bytes_type bytes;
+      memcpy(bytes.data(), reply_addr, bytes.size());
+      relay_address = asio::ip::address_v4(bytes);
+    } else {
+      asio::ip::address_v6::bytes_type bytes;
+      memcpy(bytes.data(), reply_addr, bytes.size());
+      relay_address = asio::ip::address_v6(bytes);
+    }
+    uint16_t relay_port = (reply_addr[address_length] << 8) | reply_addr[address_length + 1];
+    asio::ip::udp::endpoint relay_endpoint(relay_address, relay_port);
+    VLOG(1) << "Connection (content-consumer) udp relay at " << relay_endpoint;
+
+    asio::ip::udp::socket c(io_context);
+    c.open(protocol, ec);
+    ASSERT_FALSE(ec) << ec;
+    c.bind(asio::ip::udp::endpoint(loopback, 0), ec);
+    ASSERT_FALSE(ec) << ec;
+
+    // Read the datagrams echoed through the relay
+    std::vector<std::string> payloads;
+    for (int i = 0; i < 16; ++i) {
+      payloads.push_back(std::string(100 + i * 50, 'a' + i));
+    }
+    std::vector<std::string> echoed;
+    std::array<uint8_t, 2048> recv_buf;
+    asio::ip::udp::endpoint recv_peer;
+    std::function<void()> recv_loop = [&]() {
+      c.async_receive_from(asio::buffer(recv_buf), recv_peer, [&](asio::error_code ec, size_t length) {
+        if (ec) {
+          return;
+        }
+        EXPECT_EQ(recv_peer, relay_endpoint);
+        UdpAddress address;
+        size_t header_length;
+        ASSERT_TRUE(ParseSocks5UdpHeader(recv_buf.data(), length, &address, &header_length));
+        EXPECT_EQ(address.endpoint, echo_endpoint);
+        echoed.emplace_back(reinterpret_cast<const char*>(recv_buf.data()) + header_length, length - header_length);
+        if (echoed.size() < payloads.size()) {
+          recv_loop();
+        } else {
+          io_context.stop();
+        }
+      });
+    };
+    recv_loop();
+
+    // Write the datagrams to echo server through the relay
+    uint8_t header[3 + kMaxUdpAddressLength];
+    size_t header_length = SerializeSocks5UdpHeader(echo_endpoint, header);
+    for (const auto& payload : payloads) {
+      std::array<asio::const_buffer, 2> buffers = {asio::const_buffer(header, header_length),
+                                                   asio::buffer(payload)};
+      c.send_to(buffers, relay_endpoint, 0, ec);
+      ASSERT_FALSE(ec) << ec;
+    }
+    VLOG(1) << "Connection (content-consumer) written " << payloads.size() << " datagrams";
+
+    io_context.run_for(std::chrono::seconds(10));
+
+    // Datagrams are not reordered on loopback
+    ASSERT_EQ(echoed.size(), payloads.size());
+    for (size_t i = 0; i < payloads.size(); ++i) {
+      EXPECT_EQ(echoed[i], payloads[i]);
+    }
+
+    // Closing the control connection ends the association
+    s.close(ec);
+    c.close(ec);
+    echo.close(ec);
+  }
+
  private:
   asio::error_code StartContentProvider(asio::ip::tcp::endpoint endpoint, int backlog) {
     asio::error_code ec;
@@ -767,6 +903,10 @@ TEST_P(EndToEndTest, 1M) {
   SendRequestAndCheckResponse();
 }
 
+TEST_P(EndToEndTest, UdpAssociate) {
+  SendDatagramsAndCheckEcho();
+}
+
 static constexpr const cipher_method kCiphers[] = {
 #define XX(num, name, string) CRYPTO_##name,
     CIPHER_METHOD_VALID_MAP(XX)
@@ -901,6 +1041,7 @@ int main(int argc, char** argv) {
 
   PrintMallocStats();
   PrintCliStats();
+  PrintServerStats();
 
 #ifdef HAVE_CURL
   curl_global_cleanup();
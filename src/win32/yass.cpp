@@ -283,6 +283,9 @@ BOOL CYassApp::HandleThreadMessage(UINT message, WPARAM w, LPARAM l) {
     case WM_MYAPP_STOPPED:
       OnStopped(w, l);
       return TRUE;
+    case WM_MYAPP_RESTART:
+      OnRestart(w, l);
+      return TRUE;
     case WM_MYAPP_NETWORK_UP:
       if (state_ == STOPPED) {
         frame_->OnStartButtonClicked();
@@ -359,6 +362,26 @@ void CYassApp::OnStop(bool quiet) {
   worker_.Stop(std::move(callback));
 }
 
+void CYassApp::OnReload() {
+  if (state_ != STARTED) {
+    return;
+  }
+  DWORD main_thread_id = GetCurrentThreadId();
+  worker_.Reload([main_thread_id](asio::error_code ec) {
+    if (ec != asio::error::operation_not_supported) {
+      if (ec) {
+        LOG(WARNING) << "Failed to reload config due to: " << ec;
+      }
+      return;
+    }
+    // if the gui library exits, no more need to handle
+    bool ret = PostThreadMessageW(main_thread_id, WM_MYAPP_RESTART, 0, 0);
+    if (!ret) {
+      PLOG(WARNING) << "Internal error: PostThreadMessage";
+    }
+  });
+}
+
 // https://docs.microsoft.com/en-us/windows/win32/winprog/windows-data-types?redirectedfrom=MSDN
 void CYassApp::OnStarted(WPARAM /*w*/, LPARAM /*l*/) {
   state_ = STARTED;
@@ -377,6 +400,18 @@ void CYassApp::OnStartFailed(WPARAM w, LPARAM l) {
 void CYassApp::OnStopped(WPARAM /*w*/, LPARAM /*l*/) {
   state_ = STOPPED;
   frame_->OnStopped();
+  if (restart_pending_) {
+    restart_pending_ = false;
+    frame_->OnStartButtonClicked();
+  }
+}
+
+void CYassApp::OnRestart(WPARAM /*w*/, LPARAM /*l*/) {
+  if (state_ != STARTED) {
+    return;
+  }
+  restart_pending_ = true;
+  frame_->OnStopButtonClicked();
 }
 
 BOOL CYassApp::OnIdle() {
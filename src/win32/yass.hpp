@@ -26,6 +26,8 @@ class CYassApp {
 
   void OnStart(bool quiet = false);
   void OnStop(bool quiet = false);
+  /// apply the saved settings to the running worker, restarting it if needed
+  void OnReload();
 
   std::wstring GetStatus() const;
   enum YASSState { STARTED, STARTING, START_FAILED, STOPPING, STOPPED };
@@ -35,6 +37,7 @@ class CYassApp {
   void OnStarted(WPARAM w, LPARAM l);
   void OnStartFailed(WPARAM w, LPARAM l);
   void OnStopped(WPARAM w, LPARAM l);
+  void OnRestart(WPARAM w, LPARAM l);
 
   BOOL OnIdle();
 
@@ -44,6 +47,7 @@ class CYassApp {
 
  private:
   YASSState state_;
+  bool restart_pending_ = false;
 
   friend class CYassFrame;
   CYassFrame* frame_;
@@ -58,5 +62,6 @@ extern CYassApp* mApp;
 #define WM_MYAPP_START_FAILED (WM_USER + 101)
 #define WM_MYAPP_STOPPED (WM_USER + 102)
 #define WM_MYAPP_NETWORK_UP (WM_USER + 103)
+#define WM_MYAPP_RESTART (WM_USER + 104)
 
 #endif  // YASS_WIN32_APP
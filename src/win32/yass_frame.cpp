@@ -720,8 +720,8 @@ std::wstring CYassFrame::GetStatusMessage() {
   uint64_t sync_time = GetMonotonicTime();
   uint64_t delta_time = sync_time - last_sync_time_;
   if (delta_time > NS_PER_SECOND) {
-    uint64_t rx_bytes = net::cli::total_rx_bytes;
-    uint64_t tx_bytes = net::cli::total_tx_bytes;
+    uint64_t rx_bytes = net::cli::total_rx_bytes();
+    uint64_t tx_bytes = net::cli::total_tx_bytes();
     rx_rate_ = static_cast<double>(rx_bytes - last_rx_bytes_) / static_cast<double>(delta_time) * NS_PER_SECOND;
     tx_rate_ = static_cast<double>(tx_bytes - last_tx_bytes_) / static_cast<double>(delta_time) * NS_PER_SECOND;
     last_sync_time_ = sync_time;
@@ -1075,8 +1075,11 @@ void CYassFrame::OnCheckedSystemProxyButtonClicked() {
 }
 
 void CYassFrame::OnAppOption() {
-  DialogBoxParamW(m_hInstance, MAKEINTRESOURCEW(IDD_OPTIONBOX), m_hWnd, &CYassFrame::OnAppOptionMessage,
-                  reinterpret_cast<LPARAM>(m_hInstance));
+  INT_PTR ret = DialogBoxParamW(m_hInstance, MAKEINTRESOURCEW(IDD_OPTIONBOX), m_hWnd,
+                                &CYassFrame::OnAppOptionMessage, reinterpret_cast<LPARAM>(m_hInstance));
+  if (ret == IDOK) {
+    mApp->OnReload();
+  }
 }
 
 // static
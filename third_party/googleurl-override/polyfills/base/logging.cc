@@ -73,6 +73,7 @@
 #include <cerrno>  // for errno
 #include <mutex>
 #include <sstream>
+#include <thread>
 #include <vector>
 #if BUILDFLAG(IS_WIN)
 #include "base/win/dirent.h"
@@ -216,6 +217,7 @@ typedef FILE* FileHandle;
 #include <absl/flags/internal/program_name.h>
 #include <absl/strings/str_split.h>
 #include <absl/synchronization/mutex.h>
+#include <absl/time/clock.h>
 
 namespace {
 // simple init once flag
@@ -315,6 +317,16 @@ ABSL_FLAG(int32_t,
           " (-1 means don't buffer; 0 means buffer INFO only;"
           " ...)");
 ABSL_FLAG(int32_t, logbufsecs, 30, "Buffer log messages for at most this many seconds");
+ABSL_FLAG(bool,
+          async_logging,
+          false,
+          "Queue log messages below ERROR in per-thread buffers and write them "
+          "from a background thread");
+ABSL_FLAG(int32_t,
+          async_logging_buffer_size,
+          256,
+          "Size of per-thread buffer for async logging (in KiB), "
+          "messages are dropped when it is full");
 
 // Compute the default value for --log_dir
 static const char* DefaultLogDir() {
@@ -729,6 +741,7 @@ LogCleaner log_cleaner;
 class LogDestination {
  public:
   friend class LogMessage;
+  friend class AsyncLogger;
   friend void ReprintFatalMessage();
   friend Logger* GetLogger(LogSeverity);
   friend void SetLogger(LogSeverity, Logger*);
@@ -1278,6 +1291,308 @@ bool LogDestination::HasLogDestination(LogSeverity severity) {
   return log_destinations_[severity];
 }
 
+#ifdef THREAD_LOCAL_STORAGE
+// Messages below ERROR are queued in per-thread single-producer
+// single-consumer rings when --async_logging is set, so the threads logging
+// them never contend on log_mutex nor block on write(). A background thread
+// drains the rings and writes them to the usual destinations, it sleeps until
+// a ring turns non-empty. Messages of ERROR and above, and the oversized ones,
+// are still written synchronously, after draining the rings to keep them in
+// order.
+class AsyncLogger {
+ public:
+  static AsyncLogger* GetInstance() {
+    static AsyncLogger* logger = new AsyncLogger;
+    return logger;
+  }
+
+  // Queue the message to the ring of the current thread.
+  // Returns false if the message should be written synchronously instead.
+  bool Push(const LogMessage::LogMessageData* data);
+
+  // Write out all queued messages.
+  void Flush();
+
+  uint64_t dropped() const { return dropped_.load(std::memory_order_relaxed); }
+
+ private:
+  struct Record {
+    uint32_t size;  // including the header, aligned to kAlignment
+    uint32_t message_len;
+    int32_t severity;
+    int32_t line;
+    uint32_t prefix_len;
+    const char* fullname;
+    const char* basename;
+    uint64_t tick_counts;
+  };
+  static constexpr uint32_t kPadding = UINT32_MAX;
+  static constexpr size_t kAlignment = alignof(Record);
+
+  class Ring {
+   public:
+    explicit Ring(size_t capacity) : capacity_(capacity), buffer_(new char[capacity]) {}
+    ~Ring() { delete[] buffer_; }
+
+    Ring(const Ring&) = delete;
+    Ring& operator=(const Ring&) = delete;
+
+    // producer side
+    bool Push(const LogMessage::LogMessageData* data);
+    // consumer side
+    size_t Drain() ABSL_EXCLUSIVE_LOCKS_REQUIRED(log_mutex);
+
+    bool empty() const {
+      return head_.load(std::memory_order_acquire) == tail_.load(std::memory_order_relaxed);
+    }
+
+    std::atomic<bool> orphaned{false};
+
+   private:
+    const size_t capacity_;
+    char* const buffer_;
+    // written by the producer only
+    alignas(64) std::atomic<uint64_t> head_{0};
+    // written by the consumer only
+    alignas(64) std::atomic<uint64_t> tail_{0};
+  };
+
+  // Marks the ring orphaned once the owning thread exits, the flusher frees it
+  // after draining.
+  struct RingHolder {
+    Ring* ring = nullptr;
+    ~RingHolder() {
+      if (ring) {
+        ring->orphaned.store(true, std::memory_order_release);
+      }
+    }
+  };
+
+  AsyncLogger() = default;
+
+  Ring* LocalRing();
+  void Wake();
+  void Run();
+  size_t Drain() ABSL_EXCLUSIVE_LOCKS_REQUIRED(consumer_mutex_);
+  bool Empty();
+
+  absl::Mutex registry_mutex_;
+  std::vector<Ring*> rings_ ABSL_GUARDED_BY(registry_mutex_);
+  bool started_ ABSL_GUARDED_BY(registry_mutex_) = false;
+
+  // serializes the flusher thread and synchronous flushes
+  absl::Mutex consumer_mutex_;
+
+  // set by the flusher before it re-checks the rings and waits, a producer
+  // seeing it after its push wakes the flusher
+  std::atomic<bool> sleeping_{false};
+  absl::Mutex wake_mutex_;
+  bool pending_ ABSL_GUARDED_BY(wake_mutex_) = false;
+
+  std::atomic<uint64_t> dropped_{0};
+  uint64_t reported_dropped_ = 0;
+};
+
+bool AsyncLogger::Ring::Push(const LogMessage::LogMessageData* data) {
+  const size_t message_len = data->num_chars_to_log_;
+  const size_t size = (sizeof(Record) + message_len + kAlignment - 1) & ~(kAlignment - 1);
+
+  const uint64_t head = head_.load(std::memory_order_relaxed);
+  const uint64_t tail = tail_.load(std::memory_order_acquire);
+  const size_t offset = head % capacity_;
+  const size_t contiguous = capacity_ - offset;
+  // skip the tail of buffer if the record doesn't fit in
+  const size_t padding = contiguous < size ? contiguous : 0;
+  if (head + padding + size - tail > capacity_) {
+    return false;
+  }
+  if (padding >= sizeof(Record)) {
+    Record* record = reinterpret_cast<Record*>(buffer_ + offset);
+    record->size = padding;
+    record->message_len = kPadding;
+  }
+
+  Record* record = reinterpret_cast<Record*>(buffer_ + (head + padding) % capacity_);
+  record->size = size;
+  record->message_len = message_len;
+  record->severity = data->severity_;
+  record->line = data->line_;
+  record->prefix_len = data->num_prefix_chars_;
+  record->fullname = data->fullname_;
+  record->basename = data->basename_;
+  record->tick_counts = data->tick_counts_;
+  memcpy(record + 1, data->message_text_, message_len);
+
+  head_.store(head + padding + size, std::memory_order_release);
+  return true;
+}
+
+size_t AsyncLogger::Ring::Drain() ABSL_EXCLUSIVE_LOCKS_REQUIRED(log_mutex) {
+  size_t count = 0;
+  const uint64_t head = head_.load(std::memory_order_acquire);
+  uint64_t tail = tail_.load(std::memory_order_relaxed);
+  while (tail != head) {
+    const size_t offset = tail % capacity_;
+    const size_t contiguous = capacity_ - offset;
+    if (contiguous < sizeof(Record)) {
+      tail += contiguous;
+      continue;
+    }
+    const Record* record = reinterpret_cast<const Record*>(buffer_ + offset);
+    if (record->message_len != kPadding) {
+      const char* message = reinterpret_cast<const char*>(record + 1);
+      const LogSeverity severity = record->severity;
+      if (absl::GetFlag(FLAGS_logtostderr)) {
+        ColoredWriteToStderr(severity, message, record->message_len);
+      } else {
+        LogDestination::LogToAllLogfiles(severity, record->tick_counts, message, record->message_len);
+        LogDestination::MaybeLogToStderr(severity, message, record->message_len, record->prefix_len);
+      }
+      // NOTE: -1 removes trailing \n
+      LogDestination::LogToSinks(severity, record->fullname, record->basename, record->line,
+                                 message + record->prefix_len, record->message_len - record->prefix_len - 1,
+                                 record->tick_counts);
+      ++LogMessage::num_messages_[std::max(severity, LOGGING_INFO)];
+      ++count;
+    }
+    tail += record->size;
+  }
+  tail_.store(tail, std::memory_order_release);
+  return count;
+}
+
+AsyncLogger::Ring* AsyncLogger::LocalRing() {
+  static thread_local RingHolder holder;
+  if (ABSL_PREDICT_TRUE(holder.ring != nullptr)) {
+    return holder.ring;
+  }
+  const size_t capacity = std::max(absl::GetFlag(FLAGS_async_logging_buffer_size), 16) * 1024;
+  holder.ring = new Ring(capacity);
+
+  absl::MutexLock l(&registry_mutex_);
+  rings_.push_back(holder.ring);
+  if (!started_) {
+    started_ = true;
+    std::thread([this]() { Run(); }).detach();
+    atexit([]() { AsyncLogger::GetInstance()->Flush(); });
+  }
+  return holder.ring;
+}
+
+bool AsyncLogger::Push(const LogMessage::LogMessageData* data) {
+  // let the oversized messages go the synchronous way
+  const size_t capacity = std::max(absl::GetFlag(FLAGS_async_logging_buffer_size), 16) * 1024;
+  if (sizeof(Record) + data->num_chars_to_log_ > capacity / 4) {
+    return false;
+  }
+  Ring* ring = LocalRing();
+  if (!ring->Push(data)) {
+    dropped_.fetch_add(1, std::memory_order_relaxed);
+    return true;
+  }
+  // pairs with the fence in Run: either the flusher sees the message when it
+  // re-checks the rings, or we see it sleeping and wake it
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (sleeping_.load(std::memory_order_relaxed) && sleeping_.exchange(false, std::memory_order_relaxed)) {
+    Wake();
+  }
+  return true;
+}
+
+void AsyncLogger::Wake() {
+  absl::MutexLock l(&wake_mutex_);
+  pending_ = true;
+}
+
+bool AsyncLogger::Empty() {
+  // hold the registry lock, a concurrent Flush may free the orphaned rings
+  absl::MutexLock l(&registry_mutex_);
+  for (Ring* ring : rings_) {
+    if (!ring->empty()) {
+      return false;
+    }
+  }
+  return true;
+}
+
+size_t AsyncLogger::Drain() ABSL_EXCLUSIVE_LOCKS_REQUIRED(consumer_mutex_) {
+  std::vector<Ring*> rings;
+  {
+    absl::MutexLock l(&registry_mutex_);
+    rings = rings_;
+  }
+  size_t count = 0;
+  std::vector<Ring*> orphaned_rings;
+  for (Ring* ring : rings) {
+    // load the flag before draining, so nothing is pushed after the last drain
+    bool orphaned = ring->orphaned.load(std::memory_order_acquire);
+    if (!ring->empty()) {
+      absl::MutexLock l(&log_mutex);
+      count += ring->Drain();
+    }
+    if (orphaned) {
+      orphaned_rings.push_back(ring);
+    }
+  }
+  if (!orphaned_rings.empty()) {
+    absl::MutexLock l(&registry_mutex_);
+    for (Ring* ring : orphaned_rings) {
+      rings_.erase(std::find(rings_.begin(), rings_.end(), ring));
+      delete ring;
+    }
+  }
+  return count;
+}
+
+void AsyncLogger::Flush() {
+  absl::MutexLock l(&consumer_mutex_);
+  Drain();
+}
+
+void AsyncLogger::Run() {
+  while (true) {
+    size_t count;
+    {
+      absl::MutexLock l(&consumer_mutex_);
+      count = Drain();
+    }
+    uint64_t dropped = dropped_.load(std::memory_order_relaxed);
+    if (dropped != reported_dropped_) {
+      LOG(WARNING) << "Async logging: dropped " << dropped - reported_dropped_ << " messages";
+      reported_dropped_ = dropped;
+    }
+    if (count == 0) {
+      sleeping_.store(true, std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      // a message pushed before the producer could see the flag
+      if (!Empty()) {
+        sleeping_.store(false, std::memory_order_relaxed);
+        continue;
+      }
+      // the timeout is only a backstop
+      absl::MutexLock l(&wake_mutex_);
+      wake_mutex_.AwaitWithTimeout(absl::Condition(&pending_), absl::Seconds(1));
+      pending_ = false;
+      sleeping_.store(false, std::memory_order_relaxed);
+    }
+  }
+}
+
+void FlushAsyncLogMessages() {
+  AsyncLogger::GetInstance()->Flush();
+}
+
+uint64_t GetDroppedLogMessages() {
+  return AsyncLogger::GetInstance()->dropped();
+}
+#else
+void FlushAsyncLogMessages() {}
+
+uint64_t GetDroppedLogMessages() {
+  return 0;
+}
+#endif  // defined(THREAD_LOCAL_STORAGE)
+
 std::string g_application_fingerprint;
 
 void SetApplicationFingerprint(const std::string& fingerprint) {
@@ -2116,14 +2431,30 @@ void LogMessage::Flush() {
   }
   data_->message_text_[data_->num_chars_to_log_] = '\0';
 
-  // Prevent any subtle race conditions by wrapping a mutex lock around
-  // the actual logging action per se.
-  {
-    absl::MutexLock l(&log_mutex);
-    (this->*(data_->send_method_))();
-    ++num_messages_[std::max(data_->severity_, LOGGING_INFO)];
+#ifdef THREAD_LOCAL_STORAGE
+  bool queued = false;
+  if (absl::GetFlag(FLAGS_async_logging)) {
+    if (data_->severity_ < LOGGING_ERROR && data_->send_method_ == &LogMessage::SendToLog) {
+      queued = AsyncLogger::GetInstance()->Push(data_);
+    }
+    if (!queued) {
+      // keep the order with messages queued before
+      AsyncLogger::GetInstance()->Flush();
+    }
   }
-  LogDestination::WaitForSinks(data_);
+  if (!queued) {
+#endif
+    // Prevent any subtle race conditions by wrapping a mutex lock around
+    // the actual logging action per se.
+    {
+      absl::MutexLock l(&log_mutex);
+      (this->*(data_->send_method_))();
+      ++num_messages_[std::max(data_->severity_, LOGGING_INFO)];
+    }
+    LogDestination::WaitForSinks(data_);
+#ifdef THREAD_LOCAL_STORAGE
+  }
+#endif
 
 #if BUILDFLAG(IS_ANDROID)
   constexpr const char kLogTag[] = "gurl_base";
@@ -2325,6 +2656,11 @@ int64_t LogMessage::num_messages(int severity) {
 }
 
 void FlushLogFiles(LogSeverity min_severity) {
+#ifdef THREAD_LOCAL_STORAGE
+  if (absl::GetFlag(FLAGS_async_logging)) {
+    AsyncLogger::GetInstance()->Flush();
+  }
+#endif
   LogDestination::FlushLogFiles(min_severity);
 }
 
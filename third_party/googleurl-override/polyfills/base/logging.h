@@ -246,6 +246,8 @@ ABSL_DECLARE_FLAG(int32_t, stderrthreshold);
 ABSL_DECLARE_FLAG(int32_t, minloglevel);
 ABSL_DECLARE_FLAG(int32_t, logbuflevel);
 ABSL_DECLARE_FLAG(int32_t, logbufsecs);
+ABSL_DECLARE_FLAG(bool, async_logging);
+ABSL_DECLARE_FLAG(int32_t, async_logging_buffer_size);
 
 ABSL_DECLARE_FLAG(int32_t, logfile_mode);
 ABSL_DECLARE_FLAG(std::string, log_dir);
@@ -476,6 +478,7 @@ class LogMessage {
   LogMessageData* data_;
 
   friend class LogDestination;
+  friend class AsyncLogger;
 
   const LogSeverity severity_;
 
@@ -560,6 +563,13 @@ class ErrnoLogMessage : public LogMessage {
 // the specified severity level.  Thread-safe.
 void FlushLogFiles(LogSeverity min_severity);
 
+// Writes out the messages queued by --async_logging.  Thread-safe.
+void FlushAsyncLogMessages();
+
+// Returns the number of messages dropped because the per-thread buffer of
+// --async_logging was full.  Thread-safe.
+uint64_t GetDroppedLogMessages();
+
 // Flushes all log files that contains messages that are at least of
 // the specified severity level. Thread-hostile because it ignores
 // locking -- used for catastrophic failures.